@@ -2,16 +2,120 @@
 #include <gio/gio.h>
 #include "fileinfo_p.h"
 #include "gioptrs.h"
+#include "nativedirlister_p.h"
+#include "nativefilesearch_p.h"
+#include "foldersnapshot_p.h"
 #include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <thread>
 
 namespace Fm {
 
-DirListJob::DirListJob(const FilePath& path, Flags _flags) : dir_path{path}, flags{_flags}, emit_files_found{false} {}
+namespace {
+
+// Incremental listing: batch sizes double from the first to the last value while the batches
+// fill up, and a pending batch is flushed once it has waited this long.
+constexpr std::size_t kFirstBatchSize = 64;
+constexpr std::size_t kMaxBatchSize = 4096;
+constexpr std::chrono::milliseconds kMaxBatchDelay{50};
+
+// Hands the listed entries to |emit| from a thread of its own, so that a batch goes out when it
+// is due even while the enumeration blocks, e.g. on a stalled network mount.
+class BatchFlusher {
+   public:
+    explicit BatchFlusher(std::function<void(FileInfoList&)> emit)
+        : emit_{std::move(emit)}, batchSize_{kFirstBatchSize}, done_{false}, thread_{&BatchFlusher::run, this} {}
+
+    ~BatchFlusher() { finish(); }
+
+    // Moves the entries of |files| to the next batch.
+    void add(FileInfoList& files) {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (pending_.empty()) {
+                pending_.swap(files);
+            }
+            else {
+                pending_.insert(pending_.end(), std::make_move_iterator(files.begin()),
+                                std::make_move_iterator(files.end()));
+            }
+        }
+        files.clear();
+        cond_.notify_one();
+    }
+
+    // Stops the thread and returns what was not handed out yet.
+    FileInfoList finish() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            done_ = true;
+        }
+        cond_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        FileInfoList rest;
+        rest.swap(pending_);
+        return rest;
+    }
+
+   private:
+    void run() {
+        std::unique_lock<std::mutex> lock{mutex_};
+        auto lastFlush = std::chrono::steady_clock::now();
+        for (;;) {
+            // a full batch goes out at once, anything else once it waited long enough
+            cond_.wait_until(lock, lastFlush + kMaxBatchDelay,
+                             [this] { return done_ || pending_.size() >= batchSize_; });
+            if (!done_ && pending_.empty()) {
+                cond_.wait(lock, [this] { return done_ || !pending_.empty(); });
+            }
+            if (done_) {
+                break;
+            }
+            // a batch cut short by the delay means the enumeration is slow, where latency matters more
+            if (pending_.size() >= batchSize_) {
+                batchSize_ = std::min(batchSize_ * 2, kMaxBatchSize);
+            }
+            FileInfoList batch;
+            batch.swap(pending_);
+            lock.unlock();
+            emit_(batch);
+            lock.lock();
+            lastFlush = std::chrono::steady_clock::now();
+        }
+    }
+
+    std::function<void(FileInfoList&)> emit_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    FileInfoList pending_;
+    std::size_t batchSize_;
+    bool done_;
+    std::thread thread_;  // last, it uses the members above
+};
+
+}  // namespace
+
+DirListJob::DirListJob(const FilePath& path, Flags _flags)
+    : dir_path{path}, flags{_flags}, emit_files_found{false}, native_listing{true}, use_snapshot{false} {}
 
 void DirListJob::setIncremental(bool set) {
     emit_files_found = set;
 }
 
+void DirListJob::setNativeListing(bool set) {
+    native_listing = set;
+}
+
+void DirListJob::setSnapshotEnabled(bool set) {
+    use_snapshot = set;
+}
+
 void DirListJob::exec() {
     GErrorPtr err;
     GFileInfoPtr dir_inf;
@@ -24,6 +128,7 @@ void DirListJob::exec() {
         // FIXME: later we should refactor file search and remove this dirty hack.
         dir_gfile = GFilePtr{g_file_dup(dir_gfile.get())};
     }
+    const auto listingStart = std::chrono::steady_clock::now();
 _retry:
     err.reset();
     dir_inf = GFileInfoPtr{g_file_query_info(dir_gfile.get(), defaultGFileInfoQueryAttribs, G_FILE_QUERY_INFO_NONE,
@@ -71,123 +176,183 @@ _retry:
         dir_fi = std::make_shared<FileInfo>(dir_inf, dir_path);
     }
 
+    // only native listings are recorded, see NativeDirLister::setSnapshot()
+    std::unique_ptr<FolderSnapshot> snapshot;
+    if (use_snapshot && native_listing && !isFileSearch && dir_path.isNative()) {
+        snapshot = std::make_unique<FolderSnapshot>(dir_path);
+        FileInfoList snapshotFiles;
+        if (!snapshot->open()) {
+            snapshot.reset();
+        }
+        else if (snapshot->load(snapshotFiles) && !isCancelled()) {
+            Q_EMIT snapshotLoaded(snapshotFiles);
+        }
+    }
+    bool snapshotComplete = false;
+    qint64 listingTime = 0;
+
     FileInfoList foundFiles;
-    /* check if FS is R/O and set attr. into inf */
-    // FIXME:  _fm_file_info_job_update_fs_readonly(gf, inf, nullptr, nullptr);
-    err.reset();
-    GFileEnumeratorPtr enu =
-        GFileEnumeratorPtr{g_file_enumerate_children(dir_gfile.get(), defaultGFileInfoQueryAttribs,
-                                                     G_FILE_QUERY_INFO_NONE, cancellable().get(), &err),
-                           false};
-    if (enu) {
-        // qDebug() << "START LISTING:" << dir_path.toString().get();
-        while (!isCancelled()) {
-            err.reset();
-            GFileInfoPtr inf{g_file_enumerator_next_file(enu.get(), cancellable().get(), &err), false};
-            if (inf) {
-#if 0
-                FmPath* dir, *sub;
-                GFile* child;
-                if(G_UNLIKELY(job->flags & FM_DIR_LIST_JOB_DIR_ONLY)) {
-                    /* FIXME: handle symlinks */
-                    if(g_file_info_get_file_type(inf) != G_FILE_TYPE_DIRECTORY) {
-                        g_object_unref(inf);
-                        continue;
+    std::unique_ptr<BatchFlusher> flusher;
+    if (emit_files_found) {
+        flusher = std::make_unique<BatchFlusher>([this](FileInfoList& files) {
+            if (!isCancelled()) {
+                Q_EMIT filesFound(files);
+            }
+        });
+    }
+    auto deliver = [&]() {
+        if (flusher && !foundFiles.empty()) {
+            flusher->add(foundFiles);
+        }
+    };
+
+    bool listed = false;
+    if (native_listing && !isFileSearch && dir_path.isNative()) {
+        NativeDirLister lister{dir_path, flags != FAST};
+        err.reset();
+        if (lister.open(err)) {
+            listed = true;
+            lister.setSnapshot(snapshot.get());
+            while (!isCancelled()) {
+                err.reset();
+                // small steps, so that the first batch does not wait for a whole getdents64() buffer
+                if (!lister.nextBatch(foundFiles, err, emit_files_found ? kFirstBatchSize : SIZE_MAX)) {
+                    if (err) {
+                        ErrorAction act = emitError(err, ErrorSeverity::MILD);
+                        /* ErrorAction::RETRY is not supported. */
+                        if (act == ErrorAction::ABORT) {
+                            cancel();
+                        }
                     }
+                    /* otherwise it's EOL */
+                    snapshotComplete = !err;
+                    break;
                 }
-#endif
-                // virtual folders may return children not within them
-                // For example: the search:/// URI implemented by libfm might return files from different folders during
-                // enumeration. So here we call g_file_enumerator_get_container() to get the real parent path rather
-                // than simply using dir_path. This is not the behaviour of gio, but the extensions by libfm might do
-                // this.
-                // FIXME: after we port these vfs implementation from libfm, we can redesign this.
-                FilePath realParentPath = FilePath{g_file_enumerator_get_container(enu.get()), true};
-                if (isFileSearch) {  // this is a file sarch job (search:/// URI)
-                    // FIXME: redesign file search and remove this dirty hack
-                    // the libfm implementation of search:/// URI returns a customized GFile implementation that does
-                    // not behave normally. let's get its actual URI and re-create a normal gio GFile instance from it.
-                    realParentPath = FilePath::fromUri(realParentPath.uri().get());
-                }
-#if 0
-                if(g_file_info_get_file_type(inf) == G_FILE_TYPE_DIRECTORY)
-                    /* for dir: check if its FS is R/O and set attr. into inf */
-                {
-                    _fm_file_info_job_update_fs_readonly(child, inf, nullptr, nullptr);
-                }
-                fi = fm_file_info_new_from_g_file_data(child, inf, sub);
-#endif
-                auto fileInfo = std::make_shared<FileInfo>(inf, FilePath(), realParentPath);
-                if (emit_files_found) {
-                    // Q_EMIT filesFound();
-                }
-
-                foundFiles.push_back(std::move(fileInfo));
+                deliver();
             }
-            else {
-                if (err) {
-                    ErrorAction act = emitError(err, ErrorSeverity::MILD);
+            listingTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                                listingStart)
+                              .count();
+        }
+        // otherwise let GIO try, and report the error if it fails as well
+    }
+
+    if (native_listing && isFileSearch) {
+        // searches of local folders run in parallel, the rest through the GIO implementation
+        NativeFileSearch search{cancellable().get(), flags != FAST};
+        CStrPtr uri{g_file_get_uri(dir_gfile.get())};
+        if (search.start(uri.get())) {
+            listed = true;
+            auto reportErrors = [&]() {
+                for (auto& searchErr : search.takeErrors()) {
+                    if (isCancelled()) {
+                        break;
+                    }
                     /* ErrorAction::RETRY is not supported. */
-                    if (act == ErrorAction::ABORT) {
+                    if (emitError(searchErr, ErrorSeverity::MILD) == ErrorAction::ABORT) {
                         cancel();
                     }
                 }
-                /* otherwise it's EOL */
-                break;
+            };
+            while (!isCancelled() && search.waitForMatches(foundFiles, kMaxBatchDelay)) {
+                reportErrors();
+                deliver();
             }
+            reportErrors();
         }
-        err.reset();
-        g_file_enumerator_close(enu.get(), cancellable().get(), &err);
     }
-    else {
-        emitError(err, err.domain() == G_IO_ERROR && err.code() == G_IO_ERROR_CANCELLED
-                           ? ErrorSeverity::MILD  // may happen at Folder::reload()
-                           : ErrorSeverity::CRITICAL);
+
+    if (!listed) {
+        /* check if FS is R/O and set attr. into inf */
+        // FIXME:  _fm_file_info_job_update_fs_readonly(gf, inf, nullptr, nullptr);
+        err.reset();
+        GFileEnumeratorPtr enu =
+            GFileEnumeratorPtr{g_file_enumerate_children(dir_gfile.get(), defaultGFileInfoQueryAttribs,
+                                                         G_FILE_QUERY_INFO_NONE, cancellable().get(), &err),
+                               false};
+        if (enu) {
+            // qDebug() << "START LISTING:" << dir_path.toString().get();
+            while (!isCancelled()) {
+                err.reset();
+                GFileInfoPtr inf{g_file_enumerator_next_file(enu.get(), cancellable().get(), &err), false};
+                if (inf) {
+#if 0
+                    FmPath* dir, *sub;
+                    GFile* child;
+                    if(G_UNLIKELY(job->flags & FM_DIR_LIST_JOB_DIR_ONLY)) {
+                        /* FIXME: handle symlinks */
+                        if(g_file_info_get_file_type(inf) != G_FILE_TYPE_DIRECTORY) {
+                            g_object_unref(inf);
+                            continue;
+                        }
+                    }
+#endif
+                    // virtual folders may return children not within them
+                    // For example: the search:/// URI implemented by libfm might return files from different folders during
+                    // enumeration. So here we call g_file_enumerator_get_container() to get the real parent path rather
+                    // than simply using dir_path. This is not the behaviour of gio, but the extensions by libfm might do
+                    // this.
+                    // FIXME: after we port these vfs implementation from libfm, we can redesign this.
+                    FilePath realParentPath = FilePath{g_file_enumerator_get_container(enu.get()), true};
+                    if (isFileSearch) {  // this is a file sarch job (search:/// URI)
+                        // FIXME: redesign file search and remove this dirty hack
+                        // the libfm implementation of search:/// URI returns a customized GFile implementation that does
+                        // not behave normally. let's get its actual URI and re-create a normal gio GFile instance from it.
+                        realParentPath = FilePath::fromUri(realParentPath.uri().get());
+                    }
+#if 0
+                    if(g_file_info_get_file_type(inf) == G_FILE_TYPE_DIRECTORY)
+                        /* for dir: check if its FS is R/O and set attr. into inf */
+                    {
+                        _fm_file_info_job_update_fs_readonly(child, inf, nullptr, nullptr);
+                    }
+                    fi = fm_file_info_new_from_g_file_data(child, inf, sub);
+#endif
+                    auto fileInfo = std::make_shared<FileInfo>(inf, FilePath(), realParentPath);
+                    foundFiles.push_back(std::move(fileInfo));
+                    deliver();
+                }
+                else {
+                    if (err) {
+                        ErrorAction act = emitError(err, ErrorSeverity::MILD);
+                        /* ErrorAction::RETRY is not supported. */
+                        if (act == ErrorAction::ABORT) {
+                            cancel();
+                        }
+                    }
+                    /* otherwise it's EOL */
+                    break;
+                }
+            }
+            err.reset();
+            g_file_enumerator_close(enu.get(), cancellable().get(), &err);
+        }
+        else {
+            emitError(err, err.domain() == G_IO_ERROR && err.code() == G_IO_ERROR_CANCELLED
+                               ? ErrorSeverity::MILD  // may happen at Folder::reload()
+                               : ErrorSeverity::CRITICAL);
+        }
     }
 
     // qDebug() << "END LISTING:" << dir_path.toString().get();
+    if (flusher) {
+        FileInfoList rest = flusher->finish();
+        rest.insert(rest.end(), std::make_move_iterator(foundFiles.begin()), std::make_move_iterator(foundFiles.end()));
+        foundFiles.swap(rest);
+    }
+    if (emit_files_found && !foundFiles.empty() && !isCancelled()) {
+        Q_EMIT filesFound(foundFiles);
+        foundFiles.clear();
+    }
     if (!foundFiles.empty()) {
         std::lock_guard<std::mutex> lock{mutex_};
         files_.swap(foundFiles);
     }
-}
-
-#if 0
-//FIXME: incremental..
-
-static gboolean emit_found_files(gpointer user_data) {
-    /* this callback is called from the main thread */
-    FmDirListJob* job = FM_DIR_LIST_JOB(user_data);
-    /* g_print("emit_found_files: %d\n", g_slist_length(job->files_to_add)); */
-
-    if(g_source_is_destroyed(g_main_current_source())) {
-        return FALSE;
-    }
-    g_signal_emit(job, signals[FILES_FOUND], 0, job->files_to_add);
-    g_slist_free_full(job->files_to_add, (GDestroyNotify)fm_file_info_unref);
-    job->files_to_add = nullptr;
-    job->delay_add_files_handler = 0;
-    return FALSE;
-}
 
-static gpointer queue_add_file(FmJob* fmjob, gpointer user_data) {
-    FmDirListJob* job = FM_DIR_LIST_JOB(fmjob);
-    FmFileInfo* file = FM_FILE_INFO(user_data);
-    /* this callback is called from the main thread */
-    /* g_print("queue_add_file: %s\n", fm_file_info_get_disp_name(file)); */
-    job->files_to_add = g_slist_prepend(job->files_to_add, fm_file_info_ref(file));
-    if(job->delay_add_files_handler == 0)
-        job->delay_add_files_handler = g_timeout_add_seconds_full(G_PRIORITY_LOW,
-                                       1, emit_found_files, g_object_ref(job), g_object_unref);
-    return nullptr;
-}
-
-void fm_dir_list_job_add_found_file(FmDirListJob* job, FmFileInfo* file) {
-    fm_file_info_list_push_tail(job->files, file);
-    if(G_UNLIKELY(job->emit_files_found)) {
-        fm_job_call_main_thread(FM_JOB(job), queue_add_file, file);
+    // after the last batch went out, so that writing it does not hold the view back
+    if (snapshot && snapshotComplete && !isCancelled()) {
+        snapshot->save(listingTime);
     }
 }
-#endif
 
 }  // namespace Fm
@@ -17,12 +17,30 @@ class LIBFM_QT_API DirListJob : public Job {
 
     explicit DirListJob(const FilePath& path, Flags flags);
 
+    // In incremental mode this only holds entries not already delivered through filesFound(),
+    // which is nothing once the job finished normally.
     FileInfoList& files() { return files_; }
 
+    // Deliver entries in batches through filesFound() while the directory is being enumerated.
+    // Must be set before the job is started.
     void setIncremental(bool set);
 
     bool incremental() const { return emit_files_found; }
 
+    // List local directories with getdents64() and statx() instead of GIO's enumerator, and run
+    // search:// queries over local folders on several threads. On by default; remote and virtual
+    // locations always go through GIO.
+    void setNativeListing(bool set);
+
+    bool nativeListing() const { return native_listing; }
+
+    // Deliver the snapshot saved by an earlier listing of a local directory through snapshotLoaded()
+    // before listing it again, and save a new one if the directory is large or slow to list.
+    // Off by default; must be set before the job is started.
+    void setSnapshotEnabled(bool set);
+
+    bool snapshotEnabled() const { return use_snapshot; }
+
     FilePath dirPath() const {
         std::lock_guard<std::mutex> lock{mutex_};
         return dir_path;
@@ -34,8 +52,17 @@ class LIBFM_QT_API DirListJob : public Job {
     }
 
    Q_SIGNALS:
+    // A small first batch so the first screenful shows up at once, then batches that grow while
+    // enumeration keeps up, at least every 50 ms. With setIncremental(), the batches are emitted from
+    // a thread of the job's own so that they go out while the enumeration blocks, and only the last
+    // one from the thread running the job; receivers should not use Qt::DirectConnection.
     void filesFound(FileInfoList& foundFiles);
 
+    // Emitted from the thread running the job, before the directory is listed and before any
+    // filesFound(), if the saved snapshot still matches it. The listed entries are delivered as
+    // usual afterwards, whether they differ or not.
+    void snapshotLoaded(FileInfoList& snapshotFiles);
+
    protected:
     void exec() override;
 
@@ -46,8 +73,8 @@ class LIBFM_QT_API DirListJob : public Job {
     std::shared_ptr<const FileInfo> dir_fi;
     FileInfoList files_;
     bool emit_files_found;
-    // guint delay_add_files_handler;
-    // GSList* files_to_add;
+    bool native_listing;
+    bool use_snapshot;
 };
 
 }  // namespace Fm
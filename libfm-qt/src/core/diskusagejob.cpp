@@ -0,0 +1,71 @@
+/*
+ * Job measuring the disk usage of a local tree
+ * libfm-qt/src/core/diskusagejob.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "diskusagejob.h"
+#include "nativesizewalker_p.h"
+#include <cerrno>
+
+namespace Fm {
+
+DiskUsageJob::DiskUsageJob(const FilePath& path, bool sameFs)
+    : path_{path}, sameFs_{sameFs}, totalOnDiskSize_{0}, fileCount_{0}, unreadableDirCount_{0} {}
+
+DiskUsageJob::~DiskUsageJob() = default;
+
+std::vector<DiskUsageJob::Dir> DiskUsageJob::takeDirs() {
+    std::vector<Dir> dirs;
+    std::lock_guard<std::mutex> lock{mutex_};
+    dirs.swap(dirs_);
+    return dirs;
+}
+
+void DiskUsageJob::exec() {
+    auto localPath = path_.localPath();
+    if (!localPath) {
+        emitError(GErrorPtr{G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Not a local path"}, ErrorSeverity::CRITICAL);
+        return;
+    }
+    NativeSizeWalker walker{sameFs_, cancellable().get(), [this](const NativeSizeWalker::Counts& counts) {
+                                totalOnDiskSize_ += counts.onDiskSize;
+                                fileCount_ += counts.fileCount;
+                            }};
+    walker.setDirRead([this](NativeSizeWalker::Dir&& walked) {
+        Dir dir{std::move(walked.path), walked.counts.size, walked.counts.onDiskSize, walked.counts.fileCount,
+                std::move(walked.subdirs), {}};
+        dir.largestFiles.reserve(walked.largestFiles.size());
+        for (auto& file : walked.largestFiles) {
+            dir.largestFiles.push_back(File{std::move(file.name), file.size, file.onDiskSize});
+        }
+        std::lock_guard<std::mutex> lock{mutex_};
+        dirs_.push_back(std::move(dir));
+    });
+    if (!walker.walk(localPath.get(), true)) {
+        int errsv = errno;
+        emitError(GErrorPtr{G_IO_ERROR, static_cast<unsigned int>(g_io_error_from_errno(errsv)), g_strerror(errsv)},
+                  ErrorSeverity::CRITICAL);
+        return;
+    }
+    // a scan of a whole volume meets many of them, which are not worth a prompt each
+    unreadableDirCount_ += walker.takeErrors().size();
+}
+
+}  // namespace Fm
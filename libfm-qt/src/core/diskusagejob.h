@@ -0,0 +1,95 @@
+/*
+ * Job measuring the disk usage of a local tree
+ * libfm-qt/src/core/diskusagejob.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef FM2_DISKUSAGEJOB_H
+#define FM2_DISKUSAGEJOB_H
+
+#include "../libfmqtglobals.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "job.h"
+#include "filepath.h"
+
+namespace Fm {
+
+class NativeSizeWalker;
+
+// Measures a local tree for a disk usage view. The directories are handed out as they are read,
+// on several threads, so that a model builds the tree while the scan goes on; files only appear
+// as the few largest of each directory.
+class LIBFM_QT_API DiskUsageJob : public Job {
+    Q_OBJECT
+   public:
+    struct File {
+        std::string name;  // in the filesystem encoding
+        std::uint64_t size;
+        std::uint64_t onDiskSize;
+    };
+
+    struct Dir {
+        std::string path;  // local path, in the filesystem encoding
+        // of the entries, with the subdirectories themselves but not their contents
+        std::uint64_t size;
+        std::uint64_t onDiskSize;  // hard links count once in the whole scan
+        unsigned int fileCount;
+        std::vector<std::string> subdirs;  // each comes later, as path/name
+        std::vector<File> largestFiles;    // the largest first
+    };
+
+    // With |sameFs|, directories on other filesystems than |path| are not read.
+    explicit DiskUsageJob(const FilePath& path, bool sameFs = true);
+
+    ~DiskUsageJob() override;
+
+    const FilePath& path() const { return path_; }
+
+    // The directories read since the last call, each after its parent. It can be called from
+    // any thread while the job runs.
+    std::vector<Dir> takeDirs();
+
+    // The totals so far, which can be read from any thread.
+    std::uint64_t totalOnDiskSize() const { return totalOnDiskSize_; }
+
+    std::uint64_t fileCount() const { return fileCount_; }
+
+    unsigned int unreadableDirCount() const { return unreadableDirCount_; }
+
+   protected:
+    void exec() override;
+
+   private:
+    FilePath path_;
+    bool sameFs_;
+    std::mutex mutex_;
+    std::vector<Dir> dirs_;
+    std::atomic<std::uint64_t> totalOnDiskSize_;
+    std::atomic<std::uint64_t> fileCount_;
+    std::atomic<unsigned int> unreadableDirCount_;
+};
+
+}  // namespace Fm
+
+#endif  // FM2_DISKUSAGEJOB_H
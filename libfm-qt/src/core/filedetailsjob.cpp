@@ -0,0 +1,75 @@
+/*
+ * Job resolving the lazy attributes of files
+ * libfm-qt/src/core/filedetailsjob.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "filedetailsjob.h"
+#include <chrono>
+
+namespace Fm {
+
+namespace {
+
+// resolved files are handed over at least this often, so icons show up while scrolling
+constexpr std::size_t kBatchSize = 64;
+constexpr std::chrono::milliseconds kMaxBatchDelay{30};
+
+}  // namespace
+
+QThreadPool* FileDetailsJob::threadPool_ = nullptr;
+
+FileDetailsJob::FileDetailsJob(FileInfoList files, bool typeOnly) : files_{std::move(files)}, typeOnly_{typeOnly} {}
+
+QThreadPool* FileDetailsJob::threadPool() {
+    if (Q_UNLIKELY(threadPool_ == nullptr)) {
+        threadPool_ = new QThreadPool();
+        threadPool_->setMaxThreadCount(2);
+    }
+    return threadPool_;
+}
+
+void FileDetailsJob::exec() {
+    FileInfoList resolved;
+    auto lastFlush = std::chrono::steady_clock::now();
+    for (auto& file : files_) {
+        if (isCancelled()) {
+            return;
+        }
+        if (typeOnly_) {
+            file->resolveTypeDetails();
+        }
+        else {
+            file->resolveDetails();
+        }
+        resolved.push_back(file);
+
+        const auto now = std::chrono::steady_clock::now();
+        if (resolved.size() >= kBatchSize || now - lastFlush >= kMaxBatchDelay) {
+            Q_EMIT detailsResolved(resolved);
+            resolved.clear();
+            lastFlush = now;
+        }
+    }
+    if (!resolved.empty() && !isCancelled()) {
+        Q_EMIT detailsResolved(resolved);
+    }
+}
+
+}  // namespace Fm
@@ -0,0 +1,59 @@
+/*
+ * Job resolving the lazy attributes of files
+ * libfm-qt/src/core/filedetailsjob.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef FM2_FILEDETAILSJOB_H
+#define FM2_FILEDETAILSJOB_H
+
+#include "../libfmqtglobals.h"
+#include "fileinfo.h"
+#include "job.h"
+#include <QThreadPool>
+
+namespace Fm {
+
+// Resolves the lazily computed attributes of files (MIME type, icon, access flags) off the GUI
+// thread. FolderModel queues the rows a view actually shows, so visible files are served first.
+class LIBFM_QT_API FileDetailsJob : public Job {
+    Q_OBJECT
+   public:
+    // With |typeOnly|, only the type tier is resolved, see FileInfo::resolveTypeDetails().
+    explicit FileDetailsJob(FileInfoList files, bool typeOnly = false);
+
+    static QThreadPool* threadPool();
+
+   Q_SIGNALS:
+    // Emitted in batches from the job thread.
+    void detailsResolved(const Fm::FileInfoList& files);
+
+   protected:
+    void exec() override;
+
+   private:
+    FileInfoList files_;
+    bool typeOnly_;
+
+    static QThreadPool* threadPool_;
+};
+
+}  // namespace Fm
+
+#endif  // FM2_FILEDETAILSJOB_H
@@ -1,6 +1,10 @@
 #include "fileinfo.h"
 #include "fileinfo_p.h"
 #include <gio/gio.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
 
 #define METADATA_TRUST "metadata::trust"
 
@@ -19,8 +23,139 @@ const char defaultGFileInfoQueryAttribs[] =
     "mountable::can-unmount,"
     "mountable::can-eject," METADATA_TRUST;
 
+namespace {
+
+// Hands out small ids for shared values, so that each FileInfo stores 2 bytes instead of a
+// shared_ptr. Entries are never removed. Lookups by id take no lock; id 0 is the empty value.
+template <typename Key, typename Value>
+class SharedTable {
+   public:
+    SharedTable() { chunks_[0].store(new Value[kChunkSize], std::memory_order_release); }
+
+    const Value& at(quint16 id) const {
+        return chunks_[id / kChunkSize].load(std::memory_order_acquire)[id % kChunkSize];
+    }
+
+    // Returns the id of |key|, storing |value| for it if it is new, or 0 if the table is full.
+    quint16 idOf(const Key& key, const Value& value) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = ids_.find(key);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        if (ids_.size() + 1 >= kChunkSize * kChunkSize) {
+            return 0;
+        }
+        quint16 id = ids_.size() + 1;
+        Value* chunk = chunks_[id / kChunkSize].load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new Value[kChunkSize];
+        }
+        chunk[id % kChunkSize] = value;
+        chunks_[id / kChunkSize].store(chunk, std::memory_order_release);
+        ids_.emplace(key, id);
+        return id;
+    }
+
+   private:
+    static constexpr std::size_t kChunkSize = 256;
+
+    std::mutex mutex_;
+    std::unordered_map<Key, quint16> ids_;
+    std::atomic<Value*> chunks_[kChunkSize] = {};
+};
+
+typedef std::forward_list<std::shared_ptr<const IconInfo>> EmblemList;
+
+// the first id of mimeTypeTable(), given to the MIME types that do not fit in it
+constexpr quint16 kFallbackMimeTypeId = 1;
+
+// never destroyed, FileInfo objects may outlive static destruction in worker threads
+SharedTable<const MimeType*, std::shared_ptr<const MimeType>>& mimeTypeTable() {
+    static auto table = [] {
+        auto mimeTypes = new SharedTable<const MimeType*, std::shared_ptr<const MimeType>>;
+        const auto fallback = MimeType::fromName("application/octet-stream");
+        mimeTypes->idOf(fallback.get(), fallback);
+        return mimeTypes;
+    }();
+    return *table;
+}
+
+SharedTable<const IconInfo*, std::shared_ptr<const IconInfo>>& iconTable() {
+    static auto table = new SharedTable<const IconInfo*, std::shared_ptr<const IconInfo>>;
+    return *table;
+}
+
+SharedTable<std::string, EmblemList>& emblemsTable() {
+    static auto table = new SharedTable<std::string, EmblemList>;
+    return *table;
+}
+
+// unlike icons, every resolved file needs a MIME type, so a full table falls back to a generic one
+quint16 mimeTypeIdOf(const std::shared_ptr<const MimeType>& mimeType) {
+    if (!mimeType) {
+        return 0;
+    }
+    const quint16 id = mimeTypeTable().idOf(mimeType.get(), mimeType);
+    return id ? id : kFallbackMimeTypeId;
+}
+
+// icons beyond the capacity of the table fall back to the icon of the MIME type
+quint16 iconIdOf(const std::shared_ptr<const IconInfo>& icon) {
+    return icon ? iconTable().idOf(icon.get(), icon) : 0;
+}
+
+quint16 emblemsIdOf(const char* const* names) {
+    if (!names || !*names) {
+        return 0;
+    }
+    std::string key;
+    EmblemList emblems;
+    auto last = emblems.before_begin();
+    for (auto name = names; *name; ++name) {
+        key += *name;
+        key += '\n';
+        last = emblems.emplace_after(last, IconInfo::fromName(*name));
+    }
+    return emblemsTable().idOf(key, emblems);
+}
+
+// times before the epoch become 0
+quint32 packTime(qint64 time) {
+    return qBound<qint64>(0, time, std::numeric_limits<quint32>::max());
+}
+
+// GIO only has metadata:: attributes when GVfs provides them, there is nothing to query otherwise
+bool hasMetadataSupport() {
+    static const bool supported = [] {
+        GFilePtr home{g_file_new_for_path(g_get_home_dir()), false};
+        GFileAttributeInfoList* list = g_file_query_writable_namespaces(home.get(), nullptr, nullptr);
+        if (!list) {
+            return false;
+        }
+        bool found = g_file_attribute_info_list_lookup(list, "metadata") != nullptr;
+        g_file_attribute_info_list_unref(list);
+        return found;
+    }();
+    return supported;
+}
+
+// true if the display name of |name| is the name itself
+bool isDisplayableFileName(const char* name) {
+    const gchar** charsets;
+    return g_get_filename_charsets(&charsets) && g_utf8_validate(name, -1, nullptr);
+}
+
+}  // namespace
+
 FileInfo::FileInfo() {
     // FIXME: initialize numeric data members
+    fileId_ = nullptr;
+    mimeTypeId_ = iconId_ = emblemsId_ = 0;
+    isTrusted_ = false;
+    isNativeListed_ = false;
+    canSniffContent_ = false;
+    linkTargetType_ = 0;
 }
 
 FileInfo::FileInfo(const GFileInfoPtr& inf, const FilePath& filePath, const FilePath& parentDirPath) {
@@ -32,43 +167,38 @@ FileInfo::~FileInfo() {}
 void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
                                 const FilePath& filePath,
                                 const FilePath& parentDirPath) {
-    inf_ = inf;
-    filePath_ = filePath;
-    if (filePath_ && filePath_.hasParent()) {
-        dirPath_ = filePath_.parent();
+    isNativeListed_ = false;
+    canSniffContent_ = false;
+    linkTargetType_ = 0;
+    extra_.reset();
+    if (filePath) {
+        extra().filePath = filePath;
+    }
+    if (filePath && filePath.hasParent()) {
+        dirPath_ = filePath.parent();
     }
     else {
         dirPath_ = parentDirPath;
     }
     const char *tmp, *uri;
-    GIcon* gicon;
     GFileType type;
 
     if (const char* name = g_file_info_get_name(inf.get())) {
         name_ = name;
     }
 
-    dispName_ = QString::fromUtf8(g_file_info_get_display_name(inf.get()));
+    const char* dispName = g_file_info_get_display_name(inf.get());
+    if (dispName && name_ != dispName) {
+        extra().dispName = QString::fromUtf8(dispName);
+    }
 
     size_ = g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_STANDARD_SIZE);
+    realSize_ = g_file_info_get_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_BLOCK_SIZE) *
+                g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_UNIX_BLOCKS);
 
     type = g_file_info_get_file_type(inf.get());
 
     tmp = g_file_info_get_attribute_string(inf.get(), G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
-    if (tmp) {
-        if (size_ == 0 && type == G_FILE_TYPE_REGULAR) {
-            /* Treat zero-sized files based on their extensions,
-               and only if not possible, use GLib's type. */
-            mimeType_ = MimeType::guessFromFileName(name_.c_str());
-            if (mimeType_->isUnknownType()) {
-                mimeType_ = MimeType::fromName(tmp);
-            }
-            icon_ = mimeType_->icon();
-        }
-        else {
-            mimeType_ = MimeType::fromName(tmp);
-        }
-    }
 
     mode_ = g_file_info_get_attribute_uint32(inf.get(), G_FILE_ATTRIBUTE_UNIX_MODE);
 
@@ -96,7 +226,7 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
             case G_FILE_TYPE_MOUNTABLE:
                 break;
             case G_FILE_TYPE_SPECIAL:
-                if (mode_) {
+                if (mode_ || !tmp) {
                     break;
                 }
                 /* if it's a special file but it doesn't have UNIX mode, compose a fake one. */
@@ -119,33 +249,6 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
         }
     }
 
-    if (g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_READ)) {
-        isAccessible_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_READ);
-    }
-    else
-    /* assume it's accessible */
-    {
-        isAccessible_ = true;
-    }
-
-    if (g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE)) {
-        isWritable_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE);
-    }
-    else
-    /* assume it's writable */
-    {
-        isWritable_ = true;
-    }
-
-    if (g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE)) {
-        isDeletable_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE);
-    }
-    else
-    /* assume it's deletable */
-    {
-        isDeletable_ = true;
-    }
-
     isShortcut_ = (type == G_FILE_TYPE_SHORTCUT);
     isMountable_ = (type == G_FILE_TYPE_MOUNTABLE);
 
@@ -169,6 +272,7 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
 
     /* special handling for symlinks */
     if (g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK)) {
+        linkTargetType_ = (mode_ & S_IFMT) >> 12;
         mode_ &= ~S_IFMT; /* reset type */
         mode_ |= S_IFLNK; /* set type to symlink */
         goto _file_is_symlink;
@@ -182,38 +286,17 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
             if (uri) {
                 if (g_str_has_prefix(uri, "file:///")) {
                     auto filename = CStrPtr{g_filename_from_uri(uri, nullptr, nullptr)};
-                    target_ = filename.get();
+                    extra().target = filename.get();
                 }
                 else {
-                    target_ = uri;
-                }
-                if (!mimeType_) {
-                    mimeType_ = MimeType::guessFromFileName(target_.c_str());
-                }
-            }
-
-            /* if the mime-type is not determined or is unknown */
-            if (G_UNLIKELY(!mimeType_ || mimeType_->isUnknownType())) {
-                /* FIXME: is this appropriate? */
-                if (type == G_FILE_TYPE_SHORTCUT) {
-                    mimeType_ = MimeType::inodeShortcut();
-                }
-                else {
-                    mimeType_ = MimeType::inodeMountPoint();
+                    extra().target = uri;
                 }
             }
             break;
         case G_FILE_TYPE_DIRECTORY:
-            if (!mimeType_) {
-                mimeType_ = MimeType::inodeDirectory();
-            }
             if (g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_FILESYSTEM_READONLY)) {
                 isReadOnly_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_FILESYSTEM_READONLY);
             }
-            if (isReadOnly_ || !isWritable_) {
-                /* directories should be writable to be deleted by user */
-                isDeletable_ = false;
-            }
             if (g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE)) {
                 isRemote_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
             }
@@ -224,76 +307,15 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
             if (uri) {
                 if (g_str_has_prefix(uri, "file:///")) {
                     auto filename = CStrPtr{g_filename_from_uri(uri, nullptr, nullptr)};
-                    target_ = filename.get();
+                    extra().target = filename.get();
                 }
                 else {
-                    target_ = uri;
-                }
-                if (!mimeType_) {
-                    mimeType_ = MimeType::guessFromFileName(target_.c_str());
+                    extra().target = uri;
                 }
             }
-        /* Falls through. */
-        /* continue with absent mime type */
+            break;
         default: /* G_FILE_TYPE_UNKNOWN G_FILE_TYPE_REGULAR G_FILE_TYPE_SPECIAL */
-            if (G_UNLIKELY(!mimeType_)) {
-                if (!mimeType_) {
-                    mimeType_ = MimeType::guessFromFileName(name_.c_str());
-                }
-            }
-    }
-
-    if (!mimeType_) {
-        mimeType_ = MimeType::fromName("application/octet-stream");
-    }
-
-    /* if there is a custom folder icon, use it */
-    if (isNative() && type == G_FILE_TYPE_DIRECTORY) {
-        auto local_path = path().localPath();
-        auto dot_dir = CStrPtr{g_build_filename(local_path.get(), ".directory", nullptr)};
-        if (g_file_test(dot_dir.get(), G_FILE_TEST_IS_REGULAR)) {
-            GKeyFile* kf = g_key_file_new();
-            if (g_key_file_load_from_file(kf, dot_dir.get(), G_KEY_FILE_NONE, nullptr)) {
-                CStrPtr icon_name{g_key_file_get_string(kf, "Desktop Entry", "Icon", nullptr)};
-                if (icon_name) {
-                    // also allow relative icon paths
-                    auto dot_icon = IconInfo::fromName(g_strstr_len(icon_name.get(), -1, G_DIR_SEPARATOR_S)
-                                                           ? path().relativePath(icon_name.get()).toString().get()
-                                                           : icon_name.get());
-                    if (dot_icon && dot_icon->isValid()) {
-                        icon_ = dot_icon;
-                    }
-                }
-            }
-            g_key_file_free(kf);
-        }
-    }
-
-    if (!icon_) {
-        /* try file-specific icon first */
-        gicon = g_file_info_get_icon(inf.get());
-        if (gicon) {
-            icon_ = IconInfo::fromGIcon(gicon);
-        }
-    }
-
-#if 0
-    /* set "locked" icon on unaccessible folder */
-    else if(!accessible && type == G_FILE_TYPE_DIRECTORY) {
-        icon = g_object_ref(icon_locked_folder);
-    }
-    else {
-        icon = g_object_ref(fm_mime_type_get_icon(mime_type));
-    }
-#endif
-
-    /* if the file has emblems, add them to the icon */
-    auto emblem_names = g_file_info_get_attribute_stringv(inf.get(), "metadata::emblems");
-    if (emblem_names) {
-        auto n_emblems = g_strv_length(emblem_names);
-        for (int i = n_emblems - 1; i >= 0; --i) {
-            emblems_.emplace_front(Fm::IconInfo::fromName(emblem_names[i]));
-        }
+            break;
     }
 
     tmp = g_file_info_get_attribute_string(inf.get(), G_FILE_ATTRIBUTE_ID_FILESYSTEM);
@@ -302,65 +324,45 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
     tmp = g_file_info_get_attribute_string(inf.get(), G_FILE_ATTRIBUTE_ID_FILE);
     fileId_ = g_intern_string(tmp);
 
-    mtime_ = g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_MODIFIED);
-    atime_ = g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_ACCESS);
-    ctime_ = g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_CHANGED);
-    crtime_ = g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_CREATED);
+    mtime_ = packTime(g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_MODIFIED));
+    atime_ = packTime(g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_ACCESS));
+    ctime_ = packTime(g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_CHANGED));
+    crtime_ = packTime(g_file_info_get_attribute_uint64(inf.get(), G_FILE_ATTRIBUTE_TIME_CREATED));
     if (auto dt = g_file_info_get_deletion_date(inf.get())) {
-        dtime_ = g_date_time_to_unix(dt);
-    }
-    else {
-        dtime_ = 0;
+        extra().dtime = g_date_time_to_unix(dt);
+        g_date_time_unref(dt);
     }
     isHidden_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN);
     // g_file_info_get_is_backup() does not cover ".bak" and ".old".
-    // NOTE: Here, dispName_ is not modified for desktop entries yet.
+    // NOTE: Here, the display name is not modified for desktop entries yet.
     isBackup_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP) ||
-                dispName_.endsWith(QLatin1StringView(".bak")) || dispName_.endsWith(QLatin1StringView(".old"));
-    isNameChangeable_ = true; /* GVFS tends to ignore this attribute */
+                (dispName && (g_str_has_suffix(dispName, ".bak") || g_str_has_suffix(dispName, ".old")));
     isIconChangeable_ = isHiddenChangeable_ = false;
-    if (g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME)) {
-        isNameChangeable_ = g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME);
-    }
+
+    // Everything resolveDetails() needs is taken now, so that the GFileInfo can be dropped.
+    // The MIME type is refined there (zero-sized files, shortcuts, ...).
+    tmp = g_file_info_get_attribute_string(inf.get(), G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+    mimeTypeId_ = tmp ? mimeTypeIdOf(MimeType::fromName(tmp)) : 0;
+    GIcon* gicon = g_file_info_get_icon(inf.get());
+    iconId_ = gicon ? iconIdOf(IconInfo::fromGIcon(gicon)) : 0;
+    /* assume it's accessible, writable and deletable if GIO does not tell */
+    lazyFlags_.isAccessible = !g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_READ) ||
+                              g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_READ);
+    lazyFlags_.isWritable = !g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE) ||
+                            g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE);
+    lazyFlags_.isDeletable = !g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE) ||
+                             g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE);
+    /* GVFS tends to ignore this attribute */
+    lazyFlags_.isNameChangeable = !g_file_info_has_attribute(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME) ||
+                                  g_file_info_get_attribute_boolean(inf.get(), G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME);
+    loadMetadata(inf.get());
 
     // special handling for desktop entry files (show the name and icon defined in the desktop entry instead)
-    if (isNative() && G_UNLIKELY(isDesktopEntry())) {
-        auto local_path = path().localPath();
-        GKeyFile* kf = g_key_file_new();
-        if (g_key_file_load_from_file(kf, local_path.get(), G_KEY_FILE_NONE, nullptr)) {
-            /* check if type is correct and supported */
-            CStrPtr type{g_key_file_get_string(kf, "Desktop Entry", "Type", nullptr)};
-            if (type) {
-                // Type == "Link"
-                if (strcmp(type.get(), G_KEY_FILE_DESKTOP_TYPE_LINK) == 0) {
-                    CStrPtr uri{
-                        g_key_file_get_string(kf, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_URL, nullptr)};
-                    if (uri) {
-                        isShortcut_ = true;
-                        target_ = uri.get();
-                    }
-                }
-            }
-            CStrPtr icon_name{g_key_file_get_string(kf, "Desktop Entry", "Icon", nullptr)};
-            if (icon_name) {
-                icon_ = IconInfo::fromName(icon_name.get());
-            }
-            /* Use title of the desktop entry for display */
-            CStrPtr displayName{g_key_file_get_locale_string(kf, "Desktop Entry", "Name", nullptr, nullptr)};
-            if (displayName) {
-                dispName_ = QString::fromUtf8(displayName.get());
-            }
-            /* handle 'Hidden' key to set hidden attribute */
-            if (!isHidden_) {
-                isHidden_ = g_key_file_get_boolean(kf, "Desktop Entry", "Hidden", nullptr);
-            }
-        }
-        g_key_file_free(kf);
+    // The display name is not a lazy attribute, so these are resolved right away.
+    if (isNative() && G_UNLIKELY(g_str_has_suffix(name_.c_str(), ".desktop")) && isDesktopEntry()) {
+        applyDesktopEntry();
     }
 
-    if (!icon_ && mimeType_)
-        icon_ = mimeType_->icon();
-
 #if 0
     GFile* _gf = nullptr;
     GFileAttributeInfoList* list;
@@ -380,6 +382,334 @@ void FileInfo::setFromGFileInfo(const GObjectPtr<GFileInfo>& inf,
 #endif
 }
 
+void FileInfo::setFromNative(const NativeFileAttrs& attrs, const FilePath& parentDirPath) {
+    isNativeListed_ = true;
+    extra_.reset();
+    dirPath_ = parentDirPath;
+
+    name_ = attrs.name;
+    if (G_UNLIKELY(!isDisplayableFileName(attrs.name))) {
+        CStrPtr dispName{g_filename_display_name(attrs.name)};
+        extra().dispName = QString::fromUtf8(dispName.get());
+    }
+
+    const struct stat& st = attrs.st;
+    mode_ = st.st_mode;
+    uid_ = st.st_uid;
+    gid_ = st.st_gid;
+    size_ = st.st_size;
+    realSize_ = static_cast<uint64_t>(st.st_blksize) * st.st_blocks;
+    mtime_ = packTime(st.st_mtime);
+    atime_ = packTime(st.st_atime);
+    ctime_ = packTime(st.st_ctime);
+    crtime_ = packTime(attrs.btime);
+
+    linkTargetType_ = 0;
+    if (attrs.isSymlink) {
+        linkTargetType_ = (mode_ & S_IFMT) >> 12;
+        mode_ &= ~S_IFMT; /* reset type */
+        mode_ |= S_IFLNK; /* set type to symlink */
+        extra().target = attrs.linkTarget;
+    }
+
+    // refined by resolveDetails()
+    mimeTypeId_ = attrs.contentType ? mimeTypeIdOf(MimeType::fromName(attrs.contentType)) : 0;
+    canSniffContent_ = attrs.canSniff;
+    lazyFlags_.isAccessible = attrs.canRead;
+    lazyFlags_.isWritable = attrs.canWrite;
+    lazyFlags_.isDeletable = attrs.canDelete;
+    lazyFlags_.isNameChangeable = attrs.canRename;
+    iconId_ = iconIdOf(attrs.icon);
+    emblemsId_ = 0;
+    isTrusted_ = false;
+
+    isIconChangeable_ = isHiddenChangeable_ = false;
+    isHidden_ = attrs.isHidden;
+    isBackup_ = g_str_has_suffix(attrs.name, "~") || g_str_has_suffix(attrs.name, ".bak") ||
+                g_str_has_suffix(attrs.name, ".old");
+    isShortcut_ = isMountable_ = false;
+    canMount_ = canUnmount_ = canEject_ = false;
+    isReadOnly_ = false;
+    isRemote_ = false;
+
+    // the same form GIO's local backend uses for id::filesystem; id::file is built on demand,
+    // interning it for every listed file would never be freed
+    char id[64];
+    g_snprintf(id, sizeof(id), "l%" G_GUINT64_FORMAT, static_cast<guint64>(st.st_dev));
+    filesystemId_ = g_intern_string(id);
+    inode_ = st.st_ino;
+
+    if (G_UNLIKELY(g_str_has_suffix(attrs.name, ".desktop")) && isDesktopEntry()) {
+        applyDesktopEntry();
+    }
+}
+
+std::string FileInfo::fileId() const {
+    if (!isNativeListed_) {
+        return fileId_ ? fileId_ : std::string();
+    }
+    char id[128];
+    g_snprintf(id, sizeof(id), "%s:%" G_GUINT64_FORMAT, filesystemId_, static_cast<guint64>(inode_));
+    return id;
+}
+
+bool FileInfo::isSameFile(const FileInfo& other) const {
+    if (isNativeListed_ && other.isNativeListed_) {
+        return inode_ == other.inode_ && filesystemId_ == other.filesystemId_;  // both interned
+    }
+    if (!isNativeListed_ && !other.isNativeListed_) {
+        return fileId_ != nullptr && fileId_ == other.fileId_;  // both interned
+    }
+    const std::string id = fileId();
+    return !id.empty() && id == other.fileId();
+}
+
+const std::string& FileInfo::target() const {
+    static const std::string none;
+    return extra_ ? extra_->target : none;
+}
+
+const std::shared_ptr<const MimeType>& FileInfo::mimeType() const {
+    ensureDetails();
+    return mimeTypeTable().at(mimeTypeId_);
+}
+
+const std::shared_ptr<const IconInfo>& FileInfo::icon() const {
+    ensureDetails();
+    return iconTable().at(iconId_);
+}
+
+const std::forward_list<std::shared_ptr<const IconInfo>>& FileInfo::emblems() const {
+    ensureMetadata();
+    return emblemsTable().at(emblemsId_);
+}
+
+void FileInfo::resolveDetails() const {
+    resolveTypeDetails();
+    if (isNativeListed_) {
+        std::call_once(metadataOnce_, [this]() { resolveNativeMetadata(); });
+    }
+    detailsResolved_.store(true, std::memory_order_release);
+}
+
+void FileInfo::resolveTypeDetails() const {
+    std::call_once(detailsOnce_, [this]() {
+        std::shared_ptr<const MimeType> mimeType;
+        std::shared_ptr<const IconInfo> icon;
+        if (isNativeListed_) {
+            resolveNativeDetails(mimeType, icon);
+        }
+        else {
+            resolveGioDetails(mimeType, icon);
+        }
+        if (!mimeType) {
+            mimeType = MimeType::fromName("application/octet-stream");
+        }
+
+        /* if there is a custom folder icon, use it */
+        if (isNative() && (S_ISDIR(mode_) || (S_ISLNK(mode_) && mimeType->isDir()))) {
+            applyDirectoryIcon(icon);
+        }
+        if (!icon) {
+            /* then the file-specific icon (GIO's, or a special folder's) */
+            icon = iconTable().at(iconId_);
+        }
+        mimeTypeId_ = mimeTypeIdOf(mimeType);
+        iconId_ = iconIdOf(icon);
+        if (!iconId_) {
+            iconId_ = iconIdOf(mimeType->icon());
+        }
+        typeResolved_.store(true, std::memory_order_release);
+    });
+}
+
+void FileInfo::resolveGioDetails(std::shared_ptr<const MimeType>& mimeType,
+                                 std::shared_ptr<const IconInfo>& icon) const {
+    // the content type from GIO, see setFromGFileInfo()
+    const auto& contentType = mimeTypeTable().at(mimeTypeId_);
+    if (contentType) {
+        if (size_ == 0 && S_ISREG(mode_)) {
+            /* Treat zero-sized files based on their extensions,
+               and only if not possible, use GLib's type. */
+            mimeType = MimeType::guessFromFileName(name_.c_str());
+            if (mimeType->isUnknownType()) {
+                mimeType = contentType;
+            }
+            icon = mimeType->icon();
+        }
+        else {
+            mimeType = contentType;
+        }
+    }
+
+    const std::string& target = this->target();
+    if (S_ISLNK(mode_)) {
+        if (!mimeType && !target.empty()) {
+            mimeType = MimeType::guessFromFileName(target.c_str());
+        }
+    }
+    else if (isShortcut_ || isMountable_) {
+        if (!mimeType && !target.empty()) {
+            mimeType = MimeType::guessFromFileName(target.c_str());
+        }
+        /* if the mime-type is not determined or is unknown */
+        if (G_UNLIKELY(!mimeType || mimeType->isUnknownType())) {
+            /* FIXME: is this appropriate? */
+            if (isShortcut_) {
+                mimeType = MimeType::inodeShortcut();
+            }
+            else {
+                mimeType = MimeType::inodeMountPoint();
+            }
+        }
+    }
+    else if (S_ISDIR(mode_) && !mimeType) {
+        mimeType = MimeType::inodeDirectory();
+    }
+    if (G_UNLIKELY(!mimeType)) {
+        mimeType = MimeType::guessFromFileName(name_.c_str());
+    }
+
+    if (S_ISDIR(mode_) && (isReadOnly_ || !lazyFlags_.isWritable)) {
+        /* directories should be writable to be deleted by user */
+        lazyFlags_.isDeletable = false;
+    }
+}
+
+void FileInfo::resolveNativeDetails(std::shared_ptr<const MimeType>& mimeType,
+                                    std::shared_ptr<const IconInfo>& icon) const {
+    mimeType = mimeTypeTable().at(mimeTypeId_);
+    if (!mimeType) {
+        gboolean uncertain = FALSE;
+        CStrPtr guessed{g_content_type_guess(name_.c_str(), nullptr, 0, &uncertain)};
+        if (uncertain && canSniffContent_) {
+            // the name was not conclusive, look at the first bytes like GIO does
+            auto local_path = path().localPath();
+            int fd = open(local_path.get(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+            if (fd >= 0) {
+                guchar data[4096];
+                ssize_t len;
+                do {
+                    len = read(fd, data, sizeof(data));
+                } while (len < 0 && errno == EINTR);
+                close(fd);
+                if (len > 0) {
+                    guessed = CStrPtr{g_content_type_guess(name_.c_str(), data, len, nullptr)};
+                }
+            }
+        }
+        mimeType = MimeType::fromName(guessed ? guessed.get() : "application/octet-stream");
+    }
+
+    if (strcmp(mimeType->name(), "application/x-zerosize") == 0) {
+        /* same rule as for GIO: trust the extension of empty files first */
+        auto guessed = MimeType::guessFromFileName(name_.c_str());
+        if (!guessed->isUnknownType()) {
+            mimeType = std::move(guessed);
+        }
+        icon = mimeType->icon();
+    }
+
+    // the listing only looked at the mode bits; ACLs may grant more
+    if (!lazyFlags_.isAccessible || !lazyFlags_.isWritable) {
+        auto local_path = path().localPath();
+        if (!lazyFlags_.isAccessible) {
+            lazyFlags_.isAccessible = access(local_path.get(), R_OK) == 0;
+        }
+        if (!lazyFlags_.isWritable) {
+            lazyFlags_.isWritable = access(local_path.get(), W_OK) == 0;
+        }
+    }
+    if (S_ISDIR(mode_) && !lazyFlags_.isWritable) {
+        /* directories should be writable to be deleted by user */
+        lazyFlags_.isDeletable = false;
+    }
+}
+
+void FileInfo::resolveNativeMetadata() const {
+    // emblems and trust only live in GIO metadata; FileDetailsJob only gets here for the files on screen
+    if (!hasMetadataSupport()) {
+        return;
+    }
+    GFileInfoPtr inf{g_file_query_info(path().gfile().get(), "metadata::emblems," METADATA_TRUST,
+                                       G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, nullptr, nullptr),
+                     false};
+    if (inf) {
+        loadMetadata(inf.get());
+    }
+}
+
+void FileInfo::loadMetadata(GFileInfo* inf) const {
+    emblemsId_ = 0;
+    if (g_file_info_get_attribute_type(inf, "metadata::emblems") == G_FILE_ATTRIBUTE_TYPE_STRINGV) {
+        emblemsId_ = emblemsIdOf(g_file_info_get_attribute_stringv(inf, "metadata::emblems"));
+    }
+    isTrusted_ = false;
+    /* to avoid GIO assertion warning: */
+    if (g_file_info_get_attribute_type(inf, METADATA_TRUST) == G_FILE_ATTRIBUTE_TYPE_STRING) {
+        if (const auto data = g_file_info_get_attribute_string(inf, METADATA_TRUST)) {
+            isTrusted_ = (strcmp(data, "true") == 0);
+        }
+    }
+}
+
+void FileInfo::applyDirectoryIcon(std::shared_ptr<const IconInfo>& icon) const {
+    auto local_path = path().localPath();
+    auto dot_dir = CStrPtr{g_build_filename(local_path.get(), ".directory", nullptr)};
+    if (g_file_test(dot_dir.get(), G_FILE_TEST_IS_REGULAR)) {
+        GKeyFile* kf = g_key_file_new();
+        if (g_key_file_load_from_file(kf, dot_dir.get(), G_KEY_FILE_NONE, nullptr)) {
+            CStrPtr icon_name{g_key_file_get_string(kf, "Desktop Entry", "Icon", nullptr)};
+            if (icon_name) {
+                // also allow relative icon paths
+                auto dot_icon = IconInfo::fromName(g_strstr_len(icon_name.get(), -1, G_DIR_SEPARATOR_S)
+                                                       ? path().relativePath(icon_name.get()).toString().get()
+                                                       : icon_name.get());
+                if (dot_icon && dot_icon->isValid()) {
+                    icon = dot_icon;
+                }
+            }
+        }
+        g_key_file_free(kf);
+    }
+}
+
+void FileInfo::applyDesktopEntry() {
+    auto local_path = path().localPath();
+    GKeyFile* kf = g_key_file_new();
+    if (g_key_file_load_from_file(kf, local_path.get(), G_KEY_FILE_NONE, nullptr)) {
+        /* check if type is correct and supported */
+        CStrPtr type{g_key_file_get_string(kf, "Desktop Entry", "Type", nullptr)};
+        if (type) {
+            // Type == "Link"
+            if (strcmp(type.get(), G_KEY_FILE_DESKTOP_TYPE_LINK) == 0) {
+                CStrPtr uri{
+                    g_key_file_get_string(kf, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_URL, nullptr)};
+                if (uri) {
+                    isShortcut_ = true;
+                    extra().target = uri.get();
+                }
+            }
+        }
+        CStrPtr icon_name{g_key_file_get_string(kf, "Desktop Entry", "Icon", nullptr)};
+        if (icon_name) {
+            if (quint16 id = iconIdOf(IconInfo::fromName(icon_name.get()))) {
+                iconId_ = id;
+            }
+        }
+        /* Use title of the desktop entry for display */
+        CStrPtr displayName{g_key_file_get_locale_string(kf, "Desktop Entry", "Name", nullptr, nullptr)};
+        if (displayName) {
+            extra().dispName = QString::fromUtf8(displayName.get());
+        }
+        /* handle 'Hidden' key to set hidden attribute */
+        if (!isHidden_) {
+            isHidden_ = g_key_file_get_boolean(kf, "Desktop Entry", "Hidden", nullptr);
+        }
+    }
+    g_key_file_free(kf);
+}
+
 bool FileInfo::canThumbnail() const {
     /* Thumbnail generation is limited to real regular files. */
     if (size_ == 0 || /* don't generate thumbnails for empty files */
@@ -395,12 +725,12 @@ bool FileInfo::isExecutableType() const {
         /* treat desktop entries as executables if
          they are native and have read permission */
         if (isNative() && (mode_ & (S_IRUSR | S_IRGRP | S_IROTH))) {
-            if (isShortcut() && !target_.empty()) {
+            if (isShortcut() && !target().empty()) {
                 /* first check if this is a shortcut to a native file
                    (otherwise it is a link to a file under menu://),
                    then check for entries in /usr/share/applications and such
                    which may be considered as a safe desktop entry path */
-                auto target = FilePath::fromPathStr(target_.c_str());
+                auto target = FilePath::fromPathStr(this->target().c_str());
                 if (target.isNative()) {
                     auto usrShare = FilePath::fromPathStr("/usr/share/");
                     if (!usrShare.isPrefixOf(target)) {
@@ -431,18 +761,13 @@ bool FileInfo::isExecutableType() const {
         }
         return false;
     }
-    return mimeType_->canBeExecutable();
+    return mimeType()->canBeExecutable();
 }
 
 bool FileInfo::isTrustable() const {
     if (isExecutableType()) {
-        /* to avoid GIO assertion warning: */
-        if (g_file_info_get_attribute_type(inf_.get(), METADATA_TRUST) == G_FILE_ATTRIBUTE_TYPE_STRING) {
-            if (const auto data = g_file_info_get_attribute_string(inf_.get(), METADATA_TRUST)) {
-                return (strcmp(data, "true") == 0);
-            }
-        }
-        return false;
+        ensureMetadata();
+        return isTrusted_;
     }
     return true;
 }
@@ -451,44 +776,31 @@ void FileInfo::setTrustable(bool trust) const {
     if (!isExecutableType()) {
         return;  // METADATA_TRUST is only for executables
     }
+    ensureMetadata();
     GFileInfoPtr info{g_file_info_new(), false};  // used to set only this attribute
     if (trust) {
         g_file_info_set_attribute_string(info.get(), METADATA_TRUST, "true");
-        g_file_info_set_attribute_string(inf_.get(), METADATA_TRUST, "true");
     }
     else {
         g_file_info_set_attribute(info.get(), METADATA_TRUST, G_FILE_ATTRIBUTE_TYPE_INVALID, nullptr);
-        g_file_info_set_attribute(inf_.get(), METADATA_TRUST, G_FILE_ATTRIBUTE_TYPE_INVALID, nullptr);
     }
+    isTrusted_ = trust;
     g_file_set_attributes_from_info(path().gfile().get(), info.get(), G_FILE_QUERY_INFO_NONE, nullptr, nullptr);
 }
 
 void FileInfo::setEmblem(const QString& emblmeName, bool setGFileEmblem) const {
+    ensureMetadata();
     QByteArray str;
     if (!emblmeName.isEmpty()) {
         str = emblmeName.toLocal8Bit();
-        char* stringv[] = {str.data(), nullptr};
-        g_file_info_set_attribute_stringv(inf_.get(), "metadata::emblems", stringv);
-    }
-    else {
-        g_file_info_set_attribute(inf_.get(), "metadata::emblems", G_FILE_ATTRIBUTE_TYPE_INVALID, nullptr);
     }
+    char* stringv[] = {str.isEmpty() ? nullptr : str.data(), nullptr};
     // update current emblems
-    emblems_.clear();
-    if (g_file_info_get_attribute_type(inf_.get(), "metadata::emblems") == G_FILE_ATTRIBUTE_TYPE_STRINGV) {
-        auto emblem_names = g_file_info_get_attribute_stringv(inf_.get(), "metadata::emblems");
-        if (emblem_names) {
-            auto n_emblems = g_strv_length(emblem_names);
-            for (int i = n_emblems - 1; i >= 0; --i) {
-                emblems_.emplace_front(Fm::IconInfo::fromName(emblem_names[i]));
-            }
-        }
-    }
+    emblemsId_ = emblemsIdOf(stringv);
 
     if (setGFileEmblem) {  // really give the emblem to GFile
         GFileInfoPtr info{g_file_info_new(), false};
         if (!str.isEmpty()) {
-            char* stringv[] = {str.data(), nullptr};
             g_file_info_set_attribute_stringv(info.get(), "metadata::emblems", stringv);
         }
         else {
@@ -498,6 +810,18 @@ void FileInfo::setEmblem(const QString& emblmeName, bool setGFileEmblem) const {
     }
 }
 
+GObjectPtr<GFileInfo> FileInfo::gFileInfo() const {
+    GFileInfoPtr inf{g_file_query_info(path().gfile().get(), defaultGFileInfoQueryAttribs,
+                                       G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, nullptr, nullptr),
+                     false};
+    if (!inf) {
+        inf = GFileInfoPtr{g_file_info_new(), false};
+        g_file_info_set_name(inf.get(), name_.c_str());
+        g_file_info_set_display_name(inf.get(), displayName().toUtf8().constData());
+    }
+    return inf;
+}
+
 bool FileInfoList::isSameType() const {
     if (!empty()) {
         auto& item = front();
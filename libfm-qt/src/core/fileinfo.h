@@ -34,6 +34,9 @@
 #include <utility>
 #include <string>
 #include <forward_list>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 #include "gioptrs.h"
 #include "filepath.h"
@@ -45,19 +48,43 @@ namespace Fm {
 class FileInfoList;
 typedef std::set<unsigned int> HashSet;
 
+// What a native (non-GIO) directory listing knows about one entry, see NativeDirLister.
+struct NativeFileAttrs {
+    const char* name = nullptr;
+    struct stat st {};     // the target's stat for symlinks, unless dangling
+    quint64 btime = 0;     // birth time, 0 if unknown
+    bool isSymlink = false;
+    std::string linkTarget;
+    bool canRead = true;
+    bool canWrite = true;
+    bool canDelete = true;
+    bool canRename = true;
+    bool isHidden = false;
+    const char* contentType = nullptr;     // GIO-style content type, null to guess it from the name
+    bool canSniff = false;                 // the content may be read if the name is not conclusive
+    std::shared_ptr<const IconInfo> icon;  // special folder icon, if any
+};
+
+// FileInfo objects are kept for every file of every open folder, so they are laid out to stay small:
+// the parent path is shared with the folder, the display name is only stored when it is not the name
+// itself, MIME type, icon and emblems are ids into process-wide tables, and the GFileInfo the object
+// was created from is not retained.
 class LIBFM_QT_API FileInfo {
    public:
     explicit FileInfo();
 
     explicit FileInfo(const GFileInfoPtr& inf, const FilePath& filePath, const FilePath& parentDirPath = FilePath());
 
-    virtual ~FileInfo();
+    ~FileInfo();
 
     bool canSetHidden() const { return isHiddenChangeable_; }
 
     bool canSetIcon() const { return isIconChangeable_; }
 
-    bool canSetName() const { return isNameChangeable_; }
+    bool canSetName() const {
+        ensureDetails();
+        return lazyFlags_.isNameChangeable;
+    }
 
     bool canThumbnail() const;
 
@@ -67,11 +94,29 @@ class LIBFM_QT_API FileInfo {
 
     const char* filesystemId() const { return filesystemId_; }
 
-    const char* fileId() const { return fileId_; }
+    // Built on demand for natively listed files; use isSameFile() to compare files.
+    std::string fileId() const;
+
+    // True if both are the same file on the same filesystem, e.g. through different paths.
+    bool isSameFile(const FileInfo& other) const;
+
+    const std::shared_ptr<const IconInfo>& icon() const;
+
+    const std::shared_ptr<const MimeType>& mimeType() const;
+
+    // The MIME type, icon, emblems and access flags are resolved on first use, which may need I/O
+    // (content sniffing, access checks, GIO metadata). Views can check this and call resolveDetails()
+    // from a worker thread instead; see FileDetailsJob. Both are thread-safe.
+    // Emblems and trust are a tier of their own, so asking for the MIME type does not load them.
+    bool detailsResolved() const { return detailsResolved_.load(std::memory_order_acquire); }
+
+    // True once the MIME type, icon and access flags are known; implied by detailsResolved().
+    bool typeResolved() const { return typeResolved_.load(std::memory_order_acquire); }
 
-    const std::shared_ptr<const IconInfo>& icon() const { return icon_; }
+    void resolveDetails() const;
 
-    const std::shared_ptr<const MimeType>& mimeType() const { return mimeType_; }
+    // Only the MIME type, icon and access flags, without the emblems and trust.
+    void resolveTypeDetails() const;
 
     quint64 ctime() const { return ctime_; }
 
@@ -81,18 +126,28 @@ class LIBFM_QT_API FileInfo {
 
     quint64 mtime() const { return mtime_; }
 
-    quint64 dtime() const { return dtime_; }
-    const std::string& target() const { return target_; }
+    quint64 dtime() const { return extra_ ? extra_->dtime : 0; }
+
+    const std::string& target() const;
 
     bool isWritableDirectory() const { return (!isReadOnly_ && isDir()); }
 
     bool isRemoteDirectory() const { return (isRemote_ && isDir()); }
 
-    bool isAccessible() const { return isAccessible_; }
+    bool isAccessible() const {
+        ensureDetails();
+        return lazyFlags_.isAccessible;
+    }
 
-    bool isWritable() const { return isWritable_; }
+    bool isWritable() const {
+        ensureDetails();
+        return lazyFlags_.isWritable;
+    }
 
-    bool isDeletable() const { return isDeletable_; }
+    bool isDeletable() const {
+        ensureDetails();
+        return lazyFlags_.isDeletable;
+    }
 
     bool isExecutableType() const;
 
@@ -103,13 +158,13 @@ class LIBFM_QT_API FileInfo {
         return isHidden_;
     }
 
-    bool isUnknownType() const { return mimeType_->isUnknownType(); }
+    bool isUnknownType() const { return mimeType()->isUnknownType(); }
 
-    bool isDesktopEntry() const { return mimeType_->isDesktopEntry(); }
+    bool isDesktopEntry() const { return mimeType()->isDesktopEntry(); }
 
-    bool isText() const { return mimeType_->isText(); }
+    bool isText() const { return mimeType()->isText(); }
 
-    bool isImage() const { return mimeType_->isImage(); }
+    bool isImage() const { return mimeType()->isImage(); }
 
     bool isMountable() const { return isMountable_; }
 
@@ -117,7 +172,14 @@ class LIBFM_QT_API FileInfo {
 
     bool isSymlink() const { return S_ISLNK(mode_) ? true : false; }
 
-    bool isDir() const { return S_ISDIR(mode_) || mimeType_->isDir(); }
+    // answered from the file type, and for symlinks from their target's, so sorting and filtering
+    // don't need the MIME type; only shortcuts and mountables from GIO may have to look at it
+    bool isDir() const {
+        if (S_ISLNK(mode_)) {
+            return S_ISDIR(static_cast<mode_t>(linkTargetType_) << 12);
+        }
+        return S_ISDIR(mode_) || (!isNativeListed_ && !S_ISREG(mode_) && mimeType()->isDir());
+    }
 
     bool isNative() const { return dirPath_ ? dirPath_.isNative() : path().isNative(); }
 
@@ -129,25 +191,37 @@ class LIBFM_QT_API FileInfo {
 
     mode_t mode() const { return mode_; }
 
-    uint64_t realSize() const { return blksize_ * blocks_; }
+    uint64_t realSize() const { return realSize_; }
 
     uint64_t size() const { return size_; }
 
     const std::string& name() const { return name_; }
 
-    const QString& displayName() const { return dispName_; }
+    // Derived from the name unless GIO or a desktop entry gave the file another one.
+    QString displayName() const {
+        return extra_ && !extra_->dispName.isNull() ? extra_->dispName : QString::fromStdString(name_);
+    }
 
-    QString description() const { return QString::fromUtf8(mimeType_ ? mimeType_->desc() : ""); }
+    QString description() const {
+        auto& mimeType = this->mimeType();
+        return QString::fromUtf8(mimeType ? mimeType->desc() : "");
+    }
 
     FilePath path() const {
-        return filePath_ ? filePath_ : dirPath_ ? dirPath_.child(name_.c_str()) : FilePath::fromPathStr(name_.c_str());
+        return extra_ && extra_->filePath ? extra_->filePath
+               : dirPath_                 ? dirPath_.child(name_.c_str())
+                                          : FilePath::fromPathStr(name_.c_str());
     }
 
     const FilePath& dirPath() const { return dirPath_; }
 
     void setFromGFileInfo(const GFileInfoPtr& inf, const FilePath& filePath, const FilePath& parentDirPath);
 
-    const std::forward_list<std::shared_ptr<const IconInfo>>& emblems() const { return emblems_; }
+    // Fills the info from a native listing without creating a GFileInfo. The few attributes that
+    // only GIO metadata provides (emblems, trust) are queried with the lazy details.
+    void setFromNative(const NativeFileAttrs& attrs, const FilePath& parentDirPath);
+
+    const std::forward_list<std::shared_ptr<const IconInfo>>& emblems() const;
 
     void setEmblem(const QString& emblmeName, bool setGFileEmblem = true) const;
 
@@ -155,45 +229,89 @@ class LIBFM_QT_API FileInfo {
 
     void setTrustable(bool trust) const;
 
-    GObjectPtr<GFileInfo> gFileInfo() const { return inf_; }
+    // Queries the file again, since the GFileInfo this object was made from is not kept.
+    GObjectPtr<GFileInfo> gFileInfo() const;
 
    private:
-    GObjectPtr<GFileInfo> inf_;
+    // what only few files have, allocated on demand
+    struct ExtraInfo {
+        FilePath filePath;   // if given explicitly, listed files derive it from dirPath_
+        QString dispName;    // null if it is the name
+        std::string target;  // target of shortcut, symlink or mountable
+        quint64 dtime = 0;
+    };
+
+    ExtraInfo& extra() {
+        if (!extra_) {
+            extra_.reset(new ExtraInfo);
+        }
+        return *extra_;
+    }
+
+    // only the MIME type, icon and access flags
+    void ensureDetails() const {
+        if (!typeResolved_.load(std::memory_order_acquire)) {
+            resolveTypeDetails();
+        }
+    }
+    // the emblems and trust as well
+    void ensureMetadata() const {
+        if (!detailsResolved()) {
+            resolveDetails();
+        }
+    }
+    void resolveGioDetails(std::shared_ptr<const MimeType>& mimeType, std::shared_ptr<const IconInfo>& icon) const;
+    void resolveNativeDetails(std::shared_ptr<const MimeType>& mimeType, std::shared_ptr<const IconInfo>& icon) const;
+    void resolveNativeMetadata() const;
+    void loadMetadata(GFileInfo* inf) const;
+    void applyDirectoryIcon(std::shared_ptr<const IconInfo>& icon) const;
+    void applyDesktopEntry();
+
     std::string name_;
-    QString dispName_;
+    std::unique_ptr<ExtraInfo> extra_;
 
-    FilePath filePath_;
-    FilePath dirPath_;
+    FilePath dirPath_;  // shared with the folder and all its other files
 
-    mode_t mode_;
-    const char* filesystemId_;
-    const char* fileId_;
-    uid_t uid_;
-    gid_t gid_;
+    const char* filesystemId_;  // interned
+    union {
+        const char* fileId_;  // interned, entries from GIO
+        quint64 inode_;       // natively listed entries, fileId() is derived from it
+    };
     uint64_t size_;
-    quint64 mtime_;
-    quint64 atime_;
-    quint64 ctime_;
-    quint64 crtime_;
-    quint64 dtime_;
+    uint64_t realSize_;
 
-    uint64_t blksize_;
-    uint64_t blocks_;
+    // seconds since the epoch, saturated (the year 2106 is far enough)
+    quint32 mtime_;
+    quint32 atime_;
+    quint32 ctime_;
+    quint32 crtime_;
 
-    std::shared_ptr<const MimeType> mimeType_;
-    std::shared_ptr<const IconInfo> icon_;
-    mutable std::forward_list<std::shared_ptr<const IconInfo>> emblems_;
+    mode_t mode_;
+    uid_t uid_;
+    gid_t gid_;
 
-    std::string target_; /* target of shortcut or mountable. */
+    mutable std::once_flag detailsOnce_;
+    mutable std::once_flag metadataOnce_;
+    mutable std::atomic<bool> typeResolved_{false};
+    mutable std::atomic<bool> detailsResolved_{false};
+
+    // resolved lazily, see resolveDetails(); the ids index the tables in fileinfo.cpp, 0 is none
+    mutable quint16 mimeTypeId_;
+    mutable quint16 iconId_;
+    mutable quint16 emblemsId_;
+    // kept apart from the bit-fields below, which may be read while another thread resolves these
+    mutable struct {
+        bool isAccessible : 1;     /* TRUE if can be read by user */
+        bool isWritable : 1;       /* TRUE if can be written to by user */
+        bool isDeletable : 1;      /* TRUE if can be deleted by user */
+        bool isNameChangeable : 1; /* TRUE if name can be changed */
+    } lazyFlags_;
+    mutable bool isTrusted_; /* TRUE if METADATA_TRUST is set, only for executables */
 
     bool isShortcut_ : 1;         /* TRUE if file is shortcut type */
     bool isMountable_ : 1;        /* TRUE if file is mountable type */
-    bool isAccessible_ : 1;       /* TRUE if can be read by user */
-    bool isWritable_ : 1;         /* TRUE if can be written to by user */
-    bool isDeletable_ : 1;        /* TRUE if can be deleted by user */
     bool isHidden_ : 1;           /* TRUE if file is hidden */
     bool isBackup_ : 1;           /* TRUE if file is backup */
-    bool isNameChangeable_ : 1;   /* TRUE if name can be changed */
     bool isIconChangeable_ : 1;   /* TRUE if icon can be changed */
     bool isHiddenChangeable_ : 1; /* TRUE if hidden can be changed */
     bool isReadOnly_ : 1;         /* TRUE if host FS is R/O */
@@ -201,6 +319,11 @@ class LIBFM_QT_API FileInfo {
     bool canMount_ : 1;           /* TRUE if can be mounted */
     bool canUnmount_ : 1;         /* TRUE if can be unmounted */
     bool canEject_ : 1;           /* TRUE if can be ejected */
+    bool isNativeListed_ : 1;     /* TRUE if filled by setFromNative() */
+    bool canSniffContent_ : 1;    /* TRUE if the content type may be sniffed */
+
+    // the file type of a symlink's target as (mode & S_IFMT) >> 12, S_IFLNK if it is dangling
+    unsigned int linkTargetType_ : 4;
 };
 
 class LIBFM_QT_API FileInfoList : public std::vector<std::shared_ptr<const FileInfo>> {
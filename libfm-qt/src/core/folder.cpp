@@ -22,8 +22,10 @@
  */
 
 #include "folder.h"
+#include <algorithm>
 #include <cstring>
 #include <cassert>
+#include <QCoreApplication>
 #include <QTimer>
 #include <QDebug>
 
@@ -33,7 +35,31 @@
 
 namespace Fm {
 
+namespace {
+
+// file monitor events are collected until none came for this long (ms)...
+constexpr int kChangesQuietPeriod = 100;
+// ...but not longer than this after the first one, so that a steady stream of changes still shows up
+constexpr int kChangesMaxLatency = 500;
+
+// files of unused folders kept by default, see Folder::setRetentionBudget()
+constexpr std::size_t kDefaultRetentionBudget = 100000;
+// every kept folder also keeps its file monitor, an inotify watch for local ones
+constexpr std::size_t kMaxRetainedFolders = 32;
+
+// true if nothing a view shows has changed between a snapshot entry and its newly listed info
+bool isSameListing(const FileInfo& shown, const FileInfo& listed) {
+    return shown.mode() == listed.mode() && shown.size() == listed.size() && shown.mtime() == listed.mtime() &&
+           shown.ctime() == listed.ctime() && shown.uid() == listed.uid() && shown.gid() == listed.gid() &&
+           shown.isHidden() == listed.isHidden() && shown.target() == listed.target() &&
+           shown.displayName() == listed.displayName();
+}
+
+}  // namespace
+
 std::unordered_map<FilePath, std::weak_ptr<Folder>, FilePathHash> Folder::cache_;
+std::list<std::shared_ptr<Folder>> Folder::retainedFolders_;
+std::size_t Folder::retentionBudget_ = kDefaultRetentionBudget;
 std::mutex Folder::mutex_;
 
 Folder::Folder()
@@ -45,8 +71,11 @@ Folder::Folder()
       has_idle_update_handler{false},
       pending_change_notify{false},
       filesystem_info_pending{false},
-      wants_incremental{false},
+      wants_incremental{true},
       stop_emission{false}, /* don't set it 1 bit to not lock other bits */
+      revalidating_{false},
+      retained_{false},
+      dirty_{false},
       /* filesystem info - set in query thread, read in main */
       fs_total_size{0},
       fs_free_size{0},
@@ -54,6 +83,10 @@ Folder::Folder()
       defer_content_test{false} {
     connect(volumeManager_.get(), &VolumeManager::mountAdded, this, &Folder::onMountAdded);
     connect(volumeManager_.get(), &VolumeManager::mountRemoved, this, &Folder::onMountRemoved);
+
+    updateTimer_ = new QTimer(this);
+    updateTimer_->setSingleShot(true);
+    connect(updateTimer_, &QTimer::timeout, this, &Folder::processPendingChanges);
 }
 
 Folder::Folder(const FilePath& path) : Folder() {
@@ -61,13 +94,11 @@ Folder::Folder(const FilePath& path) : Folder() {
 }
 
 Folder::~Folder() {
-    const char* folderId = nullptr;
+    std::shared_ptr<const FileInfo> monitoredInfo;
     if (dirMonitor_) {
         g_signal_handlers_disconnect_by_data(dirMonitor_.get(), this);
         dirMonitor_.reset();
-        if (dirInfo_) {
-            folderId = dirInfo_->fileId();
-        }
+        monitoredInfo = dirInfo_;
     }
 
     if (dirlist_job) {
@@ -88,43 +119,144 @@ Folder::~Folder() {
     // freed, we need to remove its hash table entry.
     std::lock_guard<std::mutex> lock{mutex_};
     auto it = cache_.find(dirPath_);
-    if (it != cache_.end()) {
+    if (it != cache_.end() && it->second.expired()) {  // otherwise a new folder has the path already
         cache_.erase(it);
     }
 
     // Fully recreate file monitors of folders that have the same target
     // by reloading them. See reload() for why this workaround is needed.
-    if (folderId != nullptr) {
+    if (monitoredInfo) {
+        auto needsReload = [&monitoredInfo](const std::shared_ptr<Folder>& folder) {
+            return folder && folder->hasFileMonitor() && folder->isValid() &&
+                   folder->info()->isSameFile(*monitoredInfo);
+        };
         it = cache_.begin();
         while (it != cache_.end()) {
             auto folder = it->second.lock();
-            if (folder && folder->hasFileMonitor() && folder->isValid() && folder->info()->fileId() == folderId) {
+            if (needsReload(folder)) {
                 QTimer::singleShot(0, folder.get(), &Folder::reallyReload);
             }
             ++it;
         }
+        for (const auto& folder : retainedFolders_) {
+            if (needsReload(folder)) {
+                QTimer::singleShot(0, folder.get(), &Folder::reallyReload);
+            }
+        }
     }
 }
 
 // static
 std::shared_ptr<Folder> Folder::fromPath(const FilePath& path) {
-    std::lock_guard<std::mutex> lock{mutex_};
-    auto it = cache_.find(path);
-    if (it != cache_.end()) {
-        auto folder = it->second.lock();
-        if (folder) {
-            return folder;
+    std::shared_ptr<Folder> folder;
+    bool reused = false;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = cache_.find(path);
+        if (it != cache_.end()) {
+            folder = it->second.lock();
+            if (folder) {
+                return folder;
+            }
+        }
+        std::shared_ptr<Folder> owner;
+        auto retained_it =
+            std::find_if(retainedFolders_.begin(), retainedFolders_.end(),
+                         [&path](const std::shared_ptr<Folder>& retained) { return retained->dirPath_ == path; });
+        if (retained_it != retainedFolders_.end()) {
+            owner = std::move(*retained_it);
+            retainedFolders_.erase(retained_it);
+            reused = true;
         }
-        else {  // FIXME: is this possible?
-            cache_.erase(it);
+        else {
+            owner = std::make_shared<Folder>(path);
         }
+        // Users share a reference of their own. Once the last of them is gone, release() decides
+        // whether the folder is kept for later.
+        Folder* raw = owner.get();
+        folder = std::shared_ptr<Folder>{raw, [owner = std::move(owner)](Folder*) mutable { release(std::move(owner)); }};
+        cache_[path] = folder;
+    }
+    if (reused) {
+        folder->reuse();
+    }
+    else {
+        folder->reload();
     }
-    auto folder = std::make_shared<Folder>(path);
-    folder->reload();
-    cache_.emplace(path, folder);
     return folder;
 }
 
+// static
+void Folder::release(std::shared_ptr<Folder> folder) {
+    std::vector<std::shared_ptr<Folder>> evicted;  // destroyed after the lock is released, ~Folder() takes it
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (retentionBudget_ > 0 && folder->isValid() && folder->isLoaded() && QCoreApplication::instance()) {
+        static bool quitHooked = false;
+        if (!quitHooked) {
+            quitHooked = true;
+            // kept folders go with the application rather than with the static objects
+            QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, [] {
+                std::list<std::shared_ptr<Folder>> evicted;
+                std::lock_guard<std::mutex> lock{mutex_};
+                evicted.swap(retainedFolders_);
+            });
+        }
+        folder->retain();
+        retainedFolders_.push_front(std::move(folder));
+        trimRetained(evicted);
+    }
+    else {
+        evicted.push_back(std::move(folder));
+    }
+}
+
+// static
+void Folder::trimRetained(std::vector<std::shared_ptr<Folder>>& evicted) {
+    std::size_t n_files = 0;
+    std::size_t n_folders = 0;
+    for (auto it = retainedFolders_.begin(); it != retainedFolders_.end();) {
+        n_files += (*it)->files_.size() + 1;  // empty folders are not free either
+        if (n_files > retentionBudget_ || ++n_folders > kMaxRetainedFolders) {
+            evicted.push_back(std::move(*it));
+            it = retainedFolders_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+// static
+void Folder::setRetentionBudget(std::size_t fileCount) {
+    std::vector<std::shared_ptr<Folder>> evicted;
+    std::lock_guard<std::mutex> lock{mutex_};
+    retentionBudget_ = fileCount;
+    trimRetained(evicted);
+}
+
+// static
+std::size_t Folder::retentionBudget() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return retentionBudget_;
+}
+
+void Folder::retain() {
+    retained_ = true;
+    // without a monitor, nothing tells whether the folder changes
+    dirty_ = !dirMonitor_;
+}
+
+void Folder::reuse() {
+    retained_ = false;
+    if (dirty_) {
+        dirty_ = false;
+        // the files are shown as they were kept; the listing reports what changed since
+        if (!dirlist_job) {
+            startDirListJob(true);
+        }
+    }
+}
+
 // static
 // Checks if this is the path of a folder in use.
 std::shared_ptr<Folder> Folder::findByPath(const FilePath& path) {
@@ -139,6 +271,19 @@ std::shared_ptr<Folder> Folder::findByPath(const FilePath& path) {
     return nullptr;
 }
 
+// static
+bool Folder::isWarm(const FilePath& path) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto it = cache_.find(path);
+    if (it != cache_.end() && !it->second.expired()) {
+        return true;
+    }
+    return std::any_of(retainedFolders_.cbegin(), retainedFolders_.cend(),
+                       [&path](const std::shared_ptr<Folder>& retained) {
+                           return retained->dirPath_ == path && !retained->dirty_;
+                       });
+}
+
 bool Folder::makeDirectory(const char* /*name*/, GError** /*error*/) {
     // TODO:
     // FIXME: what the API is used for in the original libfm C API?
@@ -154,7 +299,7 @@ bool Folder::isValid() const {
 }
 
 bool Folder::isLoaded() const {
-    return (dirlist_job == nullptr);
+    return (dirlist_job == nullptr || revalidating_);
 }
 
 std::shared_ptr<const FileInfo> Folder::fileByName(const char* name) const {
@@ -244,15 +389,9 @@ void Folder::onFileInfoFinished() {
     FileInfoList files_to_delete;
     std::vector<FileInfoPair> files_to_update;
 
-    const auto& paths = job->paths();
-    const auto& infos = job->files();
-    auto path_it = paths.cbegin();
-    auto info_it = infos.cbegin();
-    for (; path_it != paths.cend() && info_it != infos.cend(); ++path_it, ++info_it) {
-        const auto& path = *path_it;
-        const auto& info = *info_it;
-
-        if (path == dirPath_) {  // got the info for the folder itself.
+    // NOTE: files that are already gone have no info, so the infos cannot be paired with job->paths()
+    for (const auto& info : job->files()) {
+        if (info->path() == dirPath_) {  // got the info for the folder itself.
             dirInfo_ = info;
         }
         else {
@@ -276,8 +415,8 @@ void Folder::onFileInfoFinished() {
 
     // process the changes accumulated during this info job
     if (filesystem_info_pending  // means a pending change; see "onFileSystemInfoFinished()"
-        || !paths_to_update.empty() || !paths_to_add.empty() || !paths_to_del.empty()) {
-        QTimer::singleShot(0, this, &Folder::processPendingChanges);
+        || !pending_changes.empty()) {
+        startUpdateTimer();
     }
     // there's no pending change at the moment; let the next one be processed
     else {
@@ -296,14 +435,38 @@ void Folder::processPendingChanges() {
         return;
     }
 
+    // additions and updates are queried with one job; deletions are applied right away
+    FilePathList paths;
+    FileInfoList deleted_files;
+    for (auto change_it = pending_changes.begin(); change_it != pending_changes.end();) {
+        const auto& path = change_it->first;
+        int& change = change_it->second;
+        if (change & (PendingAdd | PendingUpdate)) {
+            paths.push_back(path);
+            change &= ~(PendingAdd | PendingUpdate);
+        }
+        if (change & PendingDelete) {
+            auto it = files_.find(path.baseName().get());
+            if (it != files_.end()) {
+                unconfirmedFiles_.erase(it->second);
+                deleted_files.push_back(it->second);
+                files_.erase(it);
+                change &= ~PendingDelete;
+            }
+            // otherwise, the file may still be added by a running job; keep its deletion queued
+        }
+        if (change == 0) {
+            change_it = pending_changes.erase(change_it);
+        }
+        else {
+            ++change_it;
+        }
+    }
+    pendingSince_.invalidate();
+
     FileInfoJob* info_job = nullptr;
-    if (!paths_to_update.empty() || !paths_to_add.empty()) {
-        FilePathList paths;
-        paths.insert(paths.end(), paths_to_add.cbegin(), paths_to_add.cend());
-        paths.insert(paths.end(), paths_to_update.cbegin(), paths_to_update.cend());
-        info_job = new FileInfoJob{paths};
-        paths_to_update.clear();
-        paths_to_add.clear();
+    if (!paths.empty()) {
+        info_job = new FileInfoJob{std::move(paths)};
     }
     else {
         // let the next pending changes be processed; see "onFileInfoFinished()"
@@ -325,22 +488,6 @@ void Folder::processPendingChanges() {
 #endif
     }
 
-    // process deletion
-    FileInfoList deleted_files;
-    auto path_it = paths_to_del.begin();
-    while (path_it != paths_to_del.end()) {
-        const auto& path = *path_it;
-        auto name = path.baseName();
-        auto it = files_.find(name.get());
-        if (it != files_.end()) {
-            deleted_files.push_back(it->second);
-            files_.erase(it);
-            path_it = paths_to_del.erase(path_it);
-        }
-        else {
-            ++path_it;
-        }
-    }
     if (!deleted_files.empty()) {
         Q_EMIT filesRemoved(deleted_files);
         Q_EMIT contentChanged();
@@ -361,14 +508,26 @@ void Folder::processPendingChanges() {
 
 /* should be called only with G_LOCK(lists) on! */
 void Folder::queueUpdate() {
-    // qDebug() << "queue_update:" << !has_idle_handler << paths_to_add.size() << paths_to_update.size() <<
-    // paths_to_del.size();
-    if (!has_idle_update_handler) {
-        QTimer::singleShot(0, this, &Folder::processPendingChanges);
+    // qDebug() << "queue_update:" << !has_idle_update_handler << pending_changes.size();
+    if (!pendingSince_.isValid()) {
+        pendingSince_.start();
+    }
+    // while a file info job is running, onFileInfoFinished() schedules the next update
+    if (!has_idle_update_handler || updateTimer_->isActive()) {
         has_idle_update_handler = true;
+        startUpdateTimer();
     }
 }
 
+void Folder::startUpdateTimer() {
+    // wait until the burst of changes calms down, but not longer than the maximum latency
+    if (!pendingSince_.isValid()) {
+        pendingSince_.start();
+    }
+    qint64 remaining = kChangesMaxLatency - pendingSince_.elapsed();
+    updateTimer_->start(static_cast<int>(qBound<qint64>(0, remaining, kChangesQuietPeriod)));
+}
+
 /* NOTE: When queuing files for addition/update/deletion in the following functions,
    the currently detected files (namely, "files_") should not be taken into account
    because they might be changed soon due to a previous call to queueUpdate(). */
@@ -377,16 +536,14 @@ void Folder::queueUpdate() {
 bool Folder::eventFileAdded(const FilePath& path) {
     bool added = true;
     // G_LOCK(lists);
-    if (std::find(paths_to_del.cbegin(), paths_to_del.cend(), path) != paths_to_del.cend()) {
+    int& change = pending_changes[path];
+    if (change & PendingDelete) {
         // if the file was going to be deleted, its addition means an update,
         // so remove it from the deletion queue and add it to the update queue
-        paths_to_del.erase(std::remove(paths_to_del.begin(), paths_to_del.end(), path), paths_to_del.cend());
-        if (std::find(paths_to_update.cbegin(), paths_to_update.cend(), path) == paths_to_update.cend()) {
-            paths_to_update.push_back(path);
-        }
+        change = (change & ~PendingDelete) | PendingUpdate;
     }
-    else if (std::find(paths_to_add.cbegin(), paths_to_add.cend(), path) == paths_to_add.cend()) {
-        paths_to_add.push_back(path);
+    else if (!(change & PendingAdd)) {
+        change |= PendingAdd;
     }
     else {  // file already queued for adding, don't duplicate
         added = false;
@@ -402,9 +559,9 @@ bool Folder::eventFileAdded(const FilePath& path) {
 bool Folder::eventFileChanged(const FilePath& path) {
     bool added;
     // G_LOCK(lists);
-    if (std::find(paths_to_update.cbegin(), paths_to_update.cend(), path) == paths_to_update.cend() &&
-        std::find(paths_to_add.cbegin(), paths_to_add.cend(), path) == paths_to_add.cend()) {
-        paths_to_update.push_back(path);
+    int& change = pending_changes[path];
+    if (!(change & (PendingAdd | PendingUpdate))) {
+        change |= PendingUpdate;
         added = true;
         queueUpdate();
     }
@@ -422,11 +579,10 @@ void Folder::eventFileDeleted(const FilePath& path) {
     /* WARNING: If the file is in the addition queue, we should not remove it from that queue
        and ignore its deletion because it may have been added by the directory list job, in
        which case, ignoring an addition-deletion sequence would result in a nonexistent file. */
-    if (std::find(paths_to_del.cbegin(), paths_to_del.cend(), path) == paths_to_del.cend()) {
-        paths_to_del.push_back(path);
+    int& change = pending_changes[path];
+    if (!(change & PendingDelete)) {
         // the update queue can be cancelled for a file that is going to be deleted
-        paths_to_update.erase(std::remove(paths_to_update.begin(), paths_to_update.end(), path),
-                              paths_to_update.cend());
+        change = (change & ~PendingUpdate) | PendingDelete;
     }
     else {
         deleted = false;
@@ -459,8 +615,9 @@ void Folder::onDirChanged(GFileMonitorEvent evt) {
         case G_FILE_MONITOR_EVENT_CHANGED: {
             std::lock_guard<std::mutex> lock{mutex_};
             pending_change_notify = true;
-            if (std::find(paths_to_update.cbegin(), paths_to_update.cend(), dirPath_) != paths_to_update.cend()) {
-                paths_to_update.push_back(dirPath_);
+            int& change = pending_changes[dirPath_];
+            if (!(change & PendingUpdate)) {
+                change |= PendingUpdate;
                 queueUpdate();
             }
             /* g_debug("folder is changed"); */
@@ -485,6 +642,11 @@ void Folder::onFileChangeEvents(GFileMonitor* /*monitor*/, GFile* gf, GFile* /*o
         "G_FILE_MONITOR_EVENT_PRE_UNMOUNT",
         "G_FILE_MONITOR_EVENT_UNMOUNTED"
     }; */
+    if (retained_) {
+        // nobody shows the folder, it is listed again when reused
+        dirty_ = true;
+        return;
+    }
     if (dirPath_ == gf) {
         onDirChanged(evt);
         return;
@@ -512,20 +674,9 @@ void Folder::onFileChangeEvents(GFileMonitor* /*monitor*/, GFile* gf, GFile* /*o
     }
 }
 
-void Folder::onDirListFinished() {
-    DirListJob* job = static_cast<DirListJob*>(sender());
-    if (job->isCancelled()) {  // this is a cancelled job, ignore!
-        if (job == dirlist_job) {
-            dirlist_job = nullptr;
-            Q_EMIT finishLoading();  // this was the last job until now
-        }
-        return;
-    }
-    dirInfo_ = job->dirInfo();
-
+void Folder::mergeListedFiles(const FileInfoList& infos) {
     FileInfoList files_to_add;
     std::vector<FileInfoPair> files_to_update;
-    const auto& infos = job->files();
 
     // with "search://", there is no update for infos and all of them should be added
     if (dirPath_.hasUriScheme("search")) {
@@ -540,12 +691,17 @@ void Folder::onDirListFinished() {
             const auto& info = *info_it;
             auto it = files_.find(info->path().baseName().get());
             if (it != files_.end()) {
+                if (!unconfirmedFiles_.empty() && unconfirmedFiles_.erase(it->second) > 0 &&
+                    isSameListing(*it->second, *info)) {
+                    continue;  // keep the shown one, views have nothing to update
+                }
                 files_to_update.push_back(std::make_pair(it->second, info));
+                it->second = info;
             }
             else {
                 files_to_add.push_back(info);
+                files_.emplace(info->path().baseName().get(), info);
             }
-            files_[info->path().baseName().get()] = info;
         }
     }
 
@@ -555,6 +711,80 @@ void Folder::onDirListFinished() {
     if (!files_to_update.empty()) {
         Q_EMIT filesChanged(files_to_update);
     }
+}
+
+void Folder::onDirListFilesFound(FileInfoList& files) {
+    DirListJob* job = static_cast<DirListJob*>(sender());
+    if (job != dirlist_job || job->isCancelled()) {  // a batch from a job replaced by reload()
+        return;
+    }
+    // the dir info is known before the first entry, so views can use it while loading
+    if (!dirInfo_) {
+        dirInfo_ = job->dirInfo();
+    }
+    mergeListedFiles(files);
+}
+
+void Folder::onDirListSnapshotLoaded(FileInfoList& files) {
+    DirListJob* job = static_cast<DirListJob*>(sender());
+    if (job != dirlist_job || job->isCancelled()) {
+        return;
+    }
+    if (!dirInfo_) {
+        dirInfo_ = job->dirInfo();
+    }
+    // shown right away; the listing that follows confirms, updates or removes each entry
+    FileInfoList files_to_add;
+    files_to_add.reserve(files.size());
+    unconfirmedFiles_.reserve(files.size());
+    for (auto& file : files) {
+        if (files_.emplace(file->path().baseName().get(), file).second) {
+            unconfirmedFiles_.insert(file);
+            files_to_add.push_back(file);
+        }
+    }
+    if (!files_to_add.empty()) {
+        Q_EMIT filesAdded(files_to_add);
+        Q_EMIT contentChanged();
+    }
+}
+
+void Folder::onDirListFinished() {
+    DirListJob* job = static_cast<DirListJob*>(sender());
+    if (job->isCancelled()) {  // this is a cancelled job, ignore!
+        if (job == dirlist_job) {
+            unconfirmedFiles_.clear();
+            dirlist_job = nullptr;
+            if (revalidating_) {
+                revalidating_ = false;
+            }
+            else {
+                Q_EMIT finishLoading();  // this was the last job until now
+            }
+        }
+        return;
+    }
+    dirInfo_ = job->dirInfo();
+
+    // in incremental mode only entries that were not yet delivered are left here
+    mergeListedFiles(job->files());
+
+    // what the snapshot showed but the listing did not find is gone
+    if (!unconfirmedFiles_.empty()) {
+        FileInfoList files_to_remove;
+        for (const auto& file : unconfirmedFiles_) {
+            auto it = files_.find(file->path().baseName().get());
+            if (it != files_.end() && it->second == file) {
+                files_to_remove.push_back(file);
+                files_.erase(it);
+            }
+        }
+        unconfirmedFiles_.clear();
+        if (!files_to_remove.empty()) {
+            Q_EMIT filesRemoved(files_to_remove);
+            Q_EMIT contentChanged();
+        }
+    }
 
 #if 0
     if(dirlist_job->isCancelled() && !wants_incremental) {
@@ -612,7 +842,12 @@ void Folder::onDirListFinished() {
 #endif
 
     dirlist_job = nullptr;
-    Q_EMIT finishLoading();
+    if (revalidating_) {
+        revalidating_ = false;  // views were not told that the folder is loading
+    }
+    else {
+        Q_EMIT finishLoading();
+    }
 }
 
 #if 0
@@ -681,6 +916,7 @@ void Folder::reallyReload() {
     if (dirlist_job) {
         dirlist_job->cancel();
     }
+    revalidating_ = false;
     GError* err = nullptr;
     // cancel directory monitoring
     if (dirMonitor_) {
@@ -691,10 +927,9 @@ void Folder::reallyReload() {
     /* clear all update-lists now, see SF bug #919 - if update comes before
        listing job is finished, a duplicate may be created in the folder */
     if (has_idle_update_handler) {
-        // FIXME: cancel the idle handler
-        paths_to_add.clear();
-        paths_to_update.clear();
-        paths_to_del.clear();
+        updateTimer_->stop();
+        pending_changes.clear();
+        pendingSince_.invalidate();
 
         // cancel any file info job in progress.
         for (auto job : fileinfoJobs_) {
@@ -708,6 +943,7 @@ void Folder::reallyReload() {
     }
 
     /* remove all existing files */
+    unconfirmedFiles_.clear();
     if (!files_.empty()) {
         // FIXME: this is not very efficient :(
         auto tmp = files();
@@ -740,6 +976,24 @@ void Folder::reallyReload() {
 
     Q_EMIT contentChanged();
 
+    startDirListJob(false);
+
+    /* also reload filesystem info.
+     * FIXME: is this needed? */
+    queryFilesystemInfo();
+}
+
+// With |revalidate|, the files that are there already are kept and checked against the listing,
+// and views are not told that the folder is loading again.
+void Folder::startDirListJob(bool revalidate) {
+    revalidating_ = revalidate;
+    if (revalidate) {
+        unconfirmedFiles_.reserve(files_.size());
+        for (const auto& item : files_) {
+            unconfirmedFiles_.insert(item.second);
+        }
+    }
+
     /* run a new dir listing job */
     // FIXME:
     // defer_content_test = fm_config->defer_content_test;
@@ -747,19 +1001,20 @@ void Folder::reallyReload() {
     dirlist_job->setAutoDelete(true);
     connect(dirlist_job, &DirListJob::error, this, &Folder::error, Qt::BlockingQueuedConnection);
     connect(dirlist_job, &DirListJob::finished, this, &Folder::onDirListFinished, Qt::BlockingQueuedConnection);
-
-#if 0
-    if(wants_incremental) {
-        g_signal_connect(dirlist_job, "files-found", G_CALLBACK(on_dirlist_job_files_found), folder);
+    if (wants_incremental) {
+        // blocking, so each batch is merged before the job reuses its list
+        connect(dirlist_job, &DirListJob::filesFound, this, &Folder::onDirListFilesFound,
+                Qt::BlockingQueuedConnection);
+    }
+    dirlist_job->setIncremental(wants_incremental);
+    if (wants_incremental && !revalidate) {
+        // large local folders are shown from their last listing until the new one is done
+        connect(dirlist_job, &DirListJob::snapshotLoaded, this, &Folder::onDirListSnapshotLoaded,
+                Qt::BlockingQueuedConnection);
+        dirlist_job->setSnapshotEnabled(true);
     }
-    fm_dir_list_job_set_incremental(dirlist_job, wants_incremental);
-#endif
 
     dirlist_job->runAsync();
-
-    /* also reload filesystem info.
-     * FIXME: is this needed? */
-    queryFilesystemInfo();
 }
 
 #if 0
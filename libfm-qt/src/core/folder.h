@@ -22,14 +22,17 @@
 
 #include <gio/gio.h>
 #include <cstdint>
+#include <list>
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <functional>
 
 #include <QObject>
 #include <QtGlobal>
+#include <QElapsedTimer>
 #include "../libfmqtglobals.h"
 
 #include "gioptrs.h"
@@ -37,6 +40,8 @@
 #include "job.h"
 #include "volumemanager.h"
 
+class QTimer;
+
 namespace Fm {
 
 class DirListJob;
@@ -56,6 +61,18 @@ class LIBFM_QT_API Folder : public QObject {
 
     static std::shared_ptr<Folder> findByPath(const FilePath& path);
 
+    // True if a folder in use, or one kept for later that did not change, has the files of |path|,
+    // so that fromPath() does not need to list it.
+    static bool isWarm(const FilePath& path);
+
+    // Folders nobody uses any more are kept, the most recently used first, as long as they hold
+    // fewer files than this together, so that going back to one of them is instant. While kept,
+    // their file monitors only note that something changed, and they are listed again in the
+    // background when reused. 0 disables this.
+    static void setRetentionBudget(std::size_t fileCount);
+
+    static std::size_t retentionBudget();
+
     bool makeDirectory(const char* name, GError** error);
 
     void queryFilesystemInfo();
@@ -127,8 +144,20 @@ class LIBFM_QT_API Folder : public QObject {
     void onDirChanged(GFileMonitorEvent event_type);
 
     void queueUpdate();
+    void startUpdateTimer();
     void queueReload();
 
+    void startDirListJob(bool revalidate);
+
+    // Called when the last user of the folder is gone; keeps or destroys it.
+    static void release(std::shared_ptr<Folder> folder);
+    static void trimRetained(std::vector<std::shared_ptr<Folder>>& evicted);
+    void retain();
+    void reuse();
+
+    // Merges freshly listed infos into files_ and announces them as added or changed.
+    void mergeListedFiles(const FileInfoList& infos);
+
     bool eventFileAdded(const FilePath& path);
     bool eventFileChanged(const FilePath& path);
     void eventFileDeleted(const FilePath& path);
@@ -141,6 +170,10 @@ class LIBFM_QT_API Folder : public QObject {
 
     void onDirListFinished();
 
+    void onDirListFilesFound(FileInfoList& files);
+
+    void onDirListSnapshotLoaded(FileInfoList& files);
+
     void onFileSystemInfoFinished();
 
     void onFileInfoFinished();
@@ -163,11 +196,13 @@ class LIBFM_QT_API Folder : public QObject {
     std::shared_ptr<VolumeManager> volumeManager_;
 
     /* for file monitor */
+    enum PendingChange { PendingAdd = 1 << 0, PendingUpdate = 1 << 1, PendingDelete = 1 << 2 };
     bool has_idle_reload_handler;
     bool has_idle_update_handler;
-    FilePathList paths_to_add;
-    FilePathList paths_to_update;
-    FilePathList paths_to_del;
+    // the changes reported by the file monitor since the last update, collapsed per path
+    std::unordered_map<FilePath, int, FilePathHash> pending_changes;
+    QTimer* updateTimer_;         // collects bursts of changes before processing them
+    QElapsedTimer pendingSince_;  // the oldest unprocessed change
     // GSList* pending_jobs;
     bool pending_change_notify;
     bool filesystem_info_pending;
@@ -178,6 +213,12 @@ class LIBFM_QT_API Folder : public QObject {
     // NOTE: Here, FileInfo::path().baseName().get() should be used as the key value, not FileInfo::name(),
     // because the latter is not always the same as the former and the former will be used for comparison.
     std::unordered_map<std::string, std::shared_ptr<const FileInfo>> files_;
+    // shown before the running listing (from a saved snapshot, or from before the folder was
+    // retained) but not found by it yet; removed when it finishes
+    std::unordered_set<std::shared_ptr<const FileInfo>> unconfirmedFiles_;
+    bool revalidating_;  // the listing only checks the files that are already there
+    bool retained_;      // nobody uses the folder, see setRetentionBudget()
+    bool dirty_;         // something changed while retained
 
     /* filesystem info - set in query thread, read in main */
     uint64_t fs_total_size;
@@ -187,7 +228,10 @@ class LIBFM_QT_API Folder : public QObject {
     bool has_fs_info : 1;
     bool defer_content_test : 1;
 
+    // the references handed out to users; the folders themselves are owned by those and retainedFolders_
     static std::unordered_map<FilePath, std::weak_ptr<Folder>, FilePathHash> cache_;
+    static std::list<std::shared_ptr<Folder>> retainedFolders_;  // most recently used first
+    static std::size_t retentionBudget_;
     static std::mutex mutex_;
 };
 
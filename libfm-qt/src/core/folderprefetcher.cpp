@@ -0,0 +1,183 @@
+/*
+ * Prefetching of the folders likely to be opened next
+ * libfm-qt/src/core/folderprefetcher.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "folderprefetcher.h"
+#include "folder.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <algorithm>
+
+namespace Fm {
+
+namespace {
+
+// requests are started once none came for this long, so that moving the mouse over a row of
+// folders does not list all of them (ms)
+constexpr int kStartDelay = 300;
+constexpr int kDefaultMaxConcurrent = 2;
+// older requests are dropped beyond this
+constexpr std::size_t kMaxQueued = 8;
+// a prefetched folder may take this part of the retention budget at most
+constexpr std::size_t kBudgetShare = 4;
+// prefetched folders remembered for the hit rate
+constexpr std::size_t kMaxRemembered = 64;
+
+}  // namespace
+
+FolderPrefetcher* FolderPrefetcher::globalInstance_ = nullptr;
+
+FolderPrefetcher::FolderPrefetcher(QObject* parent)
+    : QObject(parent), startTimer_{new QTimer(this)}, maxConcurrent_{kDefaultMaxConcurrent} {
+    startTimer_->setSingleShot(true);
+    connect(startTimer_, &QTimer::timeout, this, &FolderPrefetcher::startQueued);
+}
+
+FolderPrefetcher::~FolderPrefetcher() {
+    for (auto& item : running_) {
+        item.second.folder->disconnect(this);
+    }
+}
+
+// static
+FolderPrefetcher* FolderPrefetcher::globalInstance() {
+    if (!globalInstance_) {
+        // the folders in progress go with the application, like those Folder keeps
+        globalInstance_ = new FolderPrefetcher(QCoreApplication::instance());
+    }
+    return globalInstance_;
+}
+
+void FolderPrefetcher::setMaxConcurrent(int count) {
+    maxConcurrent_ = std::max(count, 0);
+    startQueued();
+}
+
+void FolderPrefetcher::prefetch(const FilePath& path) {
+    if (!path || !path.isNative() || maxConcurrent_ == 0 || Folder::retentionBudget() == 0 || isRunning(path)) {
+        return;
+    }
+    auto it = std::find(queue_.begin(), queue_.end(), path);
+    if (it != queue_.end()) {
+        queue_.erase(it);
+    }
+    else if (Folder::isWarm(path)) {
+        return;
+    }
+    else {
+        ++stats_.requested;
+    }
+    queue_.push_front(path);
+    if (queue_.size() > kMaxQueued) {
+        queue_.pop_back();
+        ++stats_.cancelled;
+    }
+    startTimer_->start(kStartDelay);
+}
+
+void FolderPrefetcher::startQueued() {
+    if (startTimer_->isActive()) {
+        return;  // more requests are coming
+    }
+    while (running_.size() < static_cast<std::size_t>(maxConcurrent_) && !queue_.empty()) {
+        FilePath path = std::move(queue_.front());
+        queue_.pop_front();
+        if (Folder::isWarm(path)) {
+            continue;  // opened in the meantime
+        }
+        ++stats_.started;
+        auto folder = Folder::fromPath(path);
+        if (folder->isLoaded()) {  // a kept folder that is now checked again
+            ++stats_.completed;
+            remember(path);
+            continue;
+        }
+        connect(folder.get(), &Folder::filesAdded, this,
+                [this, path](FileInfoList& files) { onFilesAdded(path, files.size()); });
+        connect(folder.get(), &Folder::finishLoading, this, [this, path] { finish(path, true); });
+        running_[path].folder = std::move(folder);
+    }
+}
+
+void FolderPrefetcher::onFilesAdded(const FilePath& path, std::size_t count) {
+    auto it = running_.find(path);
+    if (it == running_.end()) {
+        return;
+    }
+    it->second.fileCount += count;
+    if (it->second.fileCount > Folder::retentionBudget() / kBudgetShare) {
+        finish(path, false);  // it would push most other folders out of the budget
+    }
+}
+
+void FolderPrefetcher::finish(const FilePath& path, bool completed) {
+    auto it = running_.find(path);
+    if (it == running_.end()) {
+        return;
+    }
+    auto folder = std::move(it->second.folder);
+    running_.erase(it);
+    folder->disconnect(this);
+    if (completed) {
+        ++stats_.completed;
+        remember(path);
+    }
+    else {
+        ++stats_.cancelled;
+    }
+    // the folder may be emitting the signal that got us here, so it is released later; a listed
+    // folder is then kept by Folder, others are destroyed and their listing is cancelled
+    QTimer::singleShot(0, this, [folder = std::move(folder)] {});
+    startQueued();
+}
+
+void FolderPrefetcher::cancelAll() {
+    stats_.cancelled += queue_.size();
+    queue_.clear();
+    startTimer_->stop();
+    while (!running_.empty()) {
+        FilePath path = running_.begin()->first;
+        finish(path, false);
+    }
+}
+
+void FolderPrefetcher::noteOpened(const FilePath& path) {
+    auto it = std::find(prefetched_.begin(), prefetched_.end(), path);
+    if (it != prefetched_.end()) {
+        prefetched_.erase(it);
+        ++stats_.hits;
+    }
+    else if (isRunning(path)) {
+        ++stats_.hits;  // partly listed already
+    }
+    else {
+        ++stats_.misses;
+    }
+}
+
+void FolderPrefetcher::remember(const FilePath& path) {
+    prefetched_.push_front(path);
+    if (prefetched_.size() > kMaxRemembered) {
+        prefetched_.pop_back();
+    }
+}
+
+}  // namespace Fm
@@ -0,0 +1,109 @@
+/*
+ * Prefetching of the folders likely to be opened next
+ * libfm-qt/src/core/folderprefetcher.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef FM2_FOLDERPREFETCHER_H
+#define FM2_FOLDERPREFETCHER_H
+
+#include "../libfmqtglobals.h"
+#include <QObject>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#include "filepath.h"
+
+class QTimer;
+
+namespace Fm {
+
+class Folder;
+
+// Lists the folders the user is likely to open next, such as the one under the mouse or the
+// keyboard focus, the parent and the neighbours in the browse history, before they are opened.
+// Once listed, a folder is dropped and Folder keeps it under its retention budget, so opening it
+// is instant. Only local folders are prefetched, a few at a time and after the requests stopped
+// coming for a moment; folders that would take a large part of the budget are given up.
+class LIBFM_QT_API FolderPrefetcher : public QObject {
+    Q_OBJECT
+   public:
+    struct Stats {
+        quint64 requested = 0;  // folders queued that were not listed already
+        quint64 started = 0;
+        quint64 completed = 0;
+        quint64 cancelled = 0;  // dropped from the queue or given up before being listed
+        quint64 hits = 0;       // folders opened after being prefetched
+        quint64 misses = 0;     // folders opened that were not
+
+        double hitRate() const { return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+    };
+
+    explicit FolderPrefetcher(QObject* parent = nullptr);
+
+    ~FolderPrefetcher() override;
+
+    static FolderPrefetcher* globalInstance();
+
+    // Queues |path| ahead of the earlier requests. Folders that need no listing are ignored.
+    void prefetch(const FilePath& path);
+
+    // Drops the queued requests and gives up the prefetches in progress, e.g., when the user went
+    // elsewhere and they are not likely any more. Call it after opening the new folder, which may
+    // be one of them.
+    void cancelAll();
+
+    // Tells that the user opens |path|, which counts as a hit if it was prefetched.
+    void noteOpened(const FilePath& path);
+
+    const Stats& stats() const { return stats_; }
+
+    int maxConcurrent() const { return maxConcurrent_; }
+
+    void setMaxConcurrent(int count);
+
+   private Q_SLOTS:
+    void startQueued();
+
+   private:
+    void onFilesAdded(const FilePath& path, std::size_t count);
+    void finish(const FilePath& path, bool completed);
+    void remember(const FilePath& path);
+    bool isRunning(const FilePath& path) const { return running_.find(path) != running_.end(); }
+
+    struct Prefetch {
+        std::shared_ptr<Folder> folder;
+        std::size_t fileCount = 0;
+    };
+
+    QTimer* startTimer_;
+    int maxConcurrent_;
+    std::deque<FilePath> queue_;  // the most recent request first
+    std::unordered_map<FilePath, Prefetch, FilePathHash> running_;
+    std::deque<FilePath> prefetched_;  // the last folders listed, for the hit rate
+    Stats stats_;
+
+    static FolderPrefetcher* globalInstance_;
+};
+
+}  // namespace Fm
+
+#endif  // FM2_FOLDERPREFETCHER_H
@@ -0,0 +1,356 @@
+/*
+ * Saved listing snapshots of local folders
+ * libfm-qt/src/core/foldersnapshot.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "foldersnapshot_p.h"
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+namespace Fm {
+
+namespace {
+
+constexpr quint32 kMagic = 0x53514c46;  // "FLQS", also tells the byte order apart
+constexpr quint32 kVersion = 1;
+
+// magic, version, the stamp, count, padding and hash
+constexpr qint64 kHeaderSize = 4 + 4 + 6 * 8 + 4 + 4 + 8;
+
+// flags, mode, uid, gid, blksize, size, blocks, dev, ino, three times, four empty strings and atime
+constexpr qint64 kMinRecordSize = 2 + 4 * 4 + 4 * 8 + 3 * 8 + 4 * 4 + 8;
+
+// Folders listed faster than this with fewer entries are not worth a snapshot (ms).
+constexpr qint64 kMinListingTime = 200;
+constexpr quint32 kMinEntries = 1000;
+
+// records of a listing that has no saved snapshot to match go to the file in pieces of this size
+constexpr qsizetype kFlushSize = 1024 * 1024;
+
+// snapshots beyond this total size are removed, the least recently used first
+constexpr qint64 kMaxCacheSize = 64 * 1024 * 1024;
+
+enum RecordFlags : quint16 {
+    IsSymlink = 1 << 0,
+    CanRead = 1 << 1,
+    CanWrite = 1 << 2,
+    CanDelete = 1 << 3,
+    CanRename = 1 << 4,
+    IsHidden = 1 << 5,
+    CanSniff = 1 << 6,
+};
+
+// The snapshot is only read by the machine that wrote it, so values are stored as they are in memory.
+template <typename T>
+void put(QByteArray& buf, T value) {
+    buf.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(QByteArray& buf, const char* str, std::size_t len) {
+    put<quint32>(buf, len);
+    buf.append(str, len);
+}
+
+class Reader {
+   public:
+    Reader(const uchar* data, qint64 size) : pos_{data}, end_{data + size} {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (end_ - pos_ < static_cast<qint64>(sizeof(T))) {
+            return false;
+        }
+        memcpy(&value, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string& str) {
+        quint32 len;
+        if (!get(len) || end_ - pos_ < static_cast<qint64>(len)) {
+            return false;
+        }
+        str.assign(reinterpret_cast<const char*>(pos_), len);
+        pos_ += len;
+        return true;
+    }
+
+   private:
+    const uchar* pos_;
+    const uchar* end_;
+};
+
+}  // namespace
+
+FolderSnapshot::FolderSnapshot(const FilePath& dirPath)
+    : dirPath_{dirPath},
+      loaded_{false},
+      stale_{false},
+      loadedCount_{0},
+      loadedHash_{0},
+      count_{0},
+      hash_{0},
+      failed_{false} {}
+
+FolderSnapshot::~FolderSnapshot() = default;  // an uncommitted QSaveFile discards what was written
+
+bool FolderSnapshot::open() {
+    localPath_ = dirPath_.localPath();
+    if (!localPath_ || !stampOf(stamp_)) {
+        return false;
+    }
+    CStrPtr name{g_compute_checksum_for_string(G_CHECKSUM_MD5, localPath_.get(), -1)};
+    cachePath_ = CStrPtr{g_build_filename(g_get_user_cache_dir(), "libfm-qt", "folders", name.get(), nullptr)};
+    return true;
+}
+
+bool FolderSnapshot::stampOf(Stamp& stamp) const {
+    struct stat st;
+    if (stat(localPath_.get(), &st) != 0) {
+        return false;
+    }
+    stamp.dev = st.st_dev;
+    stamp.ino = st.st_ino;
+    stamp.mtimeSec = st.st_mtim.tv_sec;
+    stamp.mtimeNsec = st.st_mtim.tv_nsec;
+    stamp.ctimeSec = st.st_ctim.tv_sec;
+    stamp.ctimeNsec = st.st_ctim.tv_nsec;
+    return true;
+}
+
+bool FolderSnapshot::load(FileInfoList& files) {
+    QFile file{QString::fromUtf8(cachePath_.get())};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    stale_ = true;
+    const qint64 size = file.size();
+    const uchar* data = size >= kHeaderSize ? file.map(0, size) : nullptr;
+    if (!data) {
+        return false;
+    }
+    Reader reader{data, size};
+    quint32 magic, version, count, padding;
+    quint64 hash;
+    Stamp stamp;
+    if (!reader.get(magic) || magic != kMagic || !reader.get(version) || version != kVersion ||
+        !reader.get(stamp.dev) || !reader.get(stamp.ino) || !reader.get(stamp.mtimeSec) ||
+        !reader.get(stamp.mtimeNsec) || !reader.get(stamp.ctimeSec) || !reader.get(stamp.ctimeNsec) ||
+        !reader.get(count) || !reader.get(padding) || !reader.get(hash) || !(stamp == stamp_)) {
+        return false;
+    }
+    // a damaged count must not make the reservation below fail
+    if (count > (size - kHeaderSize) / kMinRecordSize) {
+        return false;
+    }
+
+    files.reserve(files.size() + count);
+    NativeFileAttrs attrs;
+    std::string name, contentType, iconStr;
+    std::unordered_map<std::string, std::shared_ptr<const IconInfo>> icons;
+    for (quint32 i = 0; i < count; ++i) {
+        quint16 flags;
+        quint32 mode, uid, gid, blksize;
+        quint64 fileSize, blocks, dev, ino;
+        qint64 mtime, ctime, btime, atime;
+        if (!reader.get(flags) || !reader.get(mode) || !reader.get(uid) || !reader.get(gid) ||
+            !reader.get(blksize) || !reader.get(fileSize) || !reader.get(blocks) || !reader.get(dev) ||
+            !reader.get(ino) || !reader.get(mtime) || !reader.get(ctime) || !reader.get(btime) ||
+            !reader.getString(name) || !reader.getString(attrs.linkTarget) || !reader.getString(contentType) ||
+            !reader.getString(iconStr) || !reader.get(atime)) {
+            files.clear();
+            return false;
+        }
+        struct stat& st = attrs.st;
+        st = {};
+        st.st_mode = mode;
+        st.st_uid = uid;
+        st.st_gid = gid;
+        st.st_blksize = blksize;
+        st.st_size = fileSize;
+        st.st_blocks = blocks;
+        st.st_dev = dev;
+        st.st_ino = ino;
+        st.st_mtime = mtime;
+        st.st_ctime = ctime;
+        st.st_atime = atime;
+        attrs.btime = btime;
+        attrs.name = name.c_str();
+        attrs.isSymlink = flags & IsSymlink;
+        attrs.canRead = flags & CanRead;
+        attrs.canWrite = flags & CanWrite;
+        attrs.canDelete = flags & CanDelete;
+        attrs.canRename = flags & CanRename;
+        attrs.isHidden = flags & IsHidden;
+        attrs.canSniff = flags & CanSniff;
+        attrs.contentType = contentType.empty() ? nullptr : contentType.c_str();
+        attrs.icon.reset();
+        if (!iconStr.empty()) {
+            auto& icon = icons[iconStr];
+            if (!icon) {
+                GIconPtr gicon{g_icon_new_for_string(iconStr.c_str(), nullptr), false};
+                if (gicon) {
+                    icon = IconInfo::fromGIcon(gicon);
+                }
+            }
+            attrs.icon = icon;
+        }
+        auto fileInfo = std::make_shared<FileInfo>();
+        fileInfo->setFromNative(attrs, dirPath_);
+        files.push_back(std::move(fileInfo));
+    }
+    loaded_ = true;
+    stale_ = false;
+    loadedCount_ = count;
+    loadedHash_ = hash;
+    futimens(file.handle(), nullptr);  // the modification time orders the snapshots for eviction
+    return true;
+}
+
+void FolderSnapshot::add(const NativeFileAttrs& attrs) {
+    if (failed_) {
+        return;
+    }
+    const qsizetype start = buf_.size();
+    const struct stat& st = attrs.st;
+    quint16 flags = (attrs.isSymlink ? IsSymlink : 0) | (attrs.canRead ? CanRead : 0) |
+                    (attrs.canWrite ? CanWrite : 0) | (attrs.canDelete ? CanDelete : 0) |
+                    (attrs.canRename ? CanRename : 0) | (attrs.isHidden ? IsHidden : 0) |
+                    (attrs.canSniff ? CanSniff : 0);
+    put<quint16>(buf_, flags);
+    put<quint32>(buf_, st.st_mode);
+    put<quint32>(buf_, st.st_uid);
+    put<quint32>(buf_, st.st_gid);
+    put<quint32>(buf_, st.st_blksize);
+    put<quint64>(buf_, st.st_size);
+    put<quint64>(buf_, st.st_blocks);
+    put<quint64>(buf_, st.st_dev);
+    put<quint64>(buf_, st.st_ino);
+    put<qint64>(buf_, st.st_mtime);
+    put<qint64>(buf_, st.st_ctime);
+    put<qint64>(buf_, attrs.btime);
+    putString(buf_, attrs.name, strlen(attrs.name));
+    putString(buf_, attrs.linkTarget.data(), attrs.linkTarget.size());
+    putString(buf_, attrs.contentType ? attrs.contentType : "", attrs.contentType ? strlen(attrs.contentType) : 0);
+    CStrPtr iconStr;
+    if (attrs.icon && attrs.icon->gicon()) {
+        iconStr = CStrPtr{g_icon_to_string(attrs.icon->gicon().get())};
+    }
+    putString(buf_, iconStr ? iconStr.get() : "", iconStr ? strlen(iconStr.get()) : 0);
+    // the access time is left out of the hash: reading files should not make the snapshot be rewritten
+    hash_ = qHashBits(buf_.constData() + start, buf_.size() - start, hash_);
+    put<qint64>(buf_, st.st_atime);
+    ++count_;
+
+    if (buf_.size() + (file_ ? file_->pos() : 0) > kMaxCacheSize) {
+        // could never be kept: stop recording
+        failed_ = true;
+        file_.reset();
+        buf_ = QByteArray();
+        return;
+    }
+
+    // while the saved snapshot may still turn out to be current, nothing is written: most listings
+    // find what it has, and save() then drops the records
+    if (!loaded_ && buf_.size() >= kFlushSize) {
+        flush();
+    }
+}
+
+bool FolderSnapshot::openFile() {
+    CStrPtr dir{g_path_get_dirname(cachePath_.get())};
+    if (g_mkdir_with_parents(dir.get(), 0700) != 0) {
+        return false;
+    }
+    file_ = std::make_unique<QSaveFile>(QString::fromUtf8(cachePath_.get()));
+    if (!file_->open(QIODevice::WriteOnly)) {
+        file_.reset();
+        return false;
+    }
+    // the header is written last, when the count and the hash are known
+    return file_->write(QByteArray(kHeaderSize, '\0')) == kHeaderSize;
+}
+
+void FolderSnapshot::flush() {
+    if ((!file_ && !openFile()) || file_->write(buf_) != buf_.size()) {
+        failed_ = true;
+        file_.reset();
+    }
+    buf_.clear();
+}
+
+void FolderSnapshot::save(qint64 listingTime) {
+    if (failed_ || !cachePath_) {
+        return;
+    }
+    if (count_ < kMinEntries && listingTime < kMinListingTime) {
+        if (stale_) {
+            g_unlink(cachePath_.get());
+        }
+        return;
+    }
+    Stamp stamp;
+    if ((loaded_ && count_ == loadedCount_ && hash_ == loadedHash_) || !stampOf(stamp) || !(stamp == stamp_)) {
+        return;  // nothing new, or another listing will tell what the directory holds now
+    }
+    flush();
+    if (failed_) {
+        return;
+    }
+    QByteArray header;
+    put<quint32>(header, kMagic);
+    put<quint32>(header, kVersion);
+    put<quint64>(header, stamp_.dev);
+    put<quint64>(header, stamp_.ino);
+    put<qint64>(header, stamp_.mtimeSec);
+    put<qint64>(header, stamp_.mtimeNsec);
+    put<qint64>(header, stamp_.ctimeSec);
+    put<qint64>(header, stamp_.ctimeNsec);
+    put<quint32>(header, count_);
+    put<quint32>(header, 0);
+    put<quint64>(header, hash_);
+    if (file_->seek(0) && file_->write(header) == header.size() && file_->commit()) {
+        evictOldSnapshots();
+    }
+    file_.reset();
+}
+
+void FolderSnapshot::evictOldSnapshots() const {
+    CStrPtr dirName{g_path_get_dirname(cachePath_.get())};
+    const QFileInfoList entries =
+        QDir{QString::fromUtf8(dirName.get())}.entryInfoList(QDir::Files | QDir::Hidden, QDir::Time);
+    qint64 total = 0;
+    for (const QFileInfo& entry : entries) {  // the most recently used first
+        total += entry.size();
+        if (total > kMaxCacheSize) {
+            QFile::remove(entry.filePath());
+        }
+    }
+}
+
+}  // namespace Fm
@@ -0,0 +1,103 @@
+/*
+ * Saved listing snapshots of local folders
+ * libfm-qt/src/core/foldersnapshot_p.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef FOLDERSNAPSHOT_P_H
+#define FOLDERSNAPSHOT_P_H
+
+#include <memory>
+#include <QByteArray>
+#include <sys/types.h>
+
+#include "gioptrs.h"
+#include "filepath.h"
+#include "fileinfo.h"
+
+class QSaveFile;
+
+namespace Fm {
+
+// The listing of a local directory, saved in the user's cache directory by DirListJob so that the
+// directory can be shown at once the next time it is opened, while it is listed again. It holds
+// what NativeDirLister found for each entry and is only used while the mtime and ctime of the
+// directory are unchanged, that is, while no entry was added, removed or renamed. Snapshots are
+// only rewritten when a listing finds something else, and the least recently used ones are
+// removed when they take more than a fixed amount of space.
+class FolderSnapshot {
+   public:
+    explicit FolderSnapshot(const FilePath& dirPath);
+
+    ~FolderSnapshot();
+
+    FolderSnapshot(const FolderSnapshot&) = delete;
+    FolderSnapshot& operator=(const FolderSnapshot&) = delete;
+
+    // Takes the state of the directory before it is listed. Fails if it is not a local directory.
+    bool open();
+
+    // Fills |files| from the saved snapshot if it was taken of the directory as it is now.
+    bool load(FileInfoList& files);
+
+    // Records an entry of the new listing.
+    void add(const NativeFileAttrs& attrs);
+
+    // Replaces the saved snapshot with the recorded entries, unless the listing was too quick to
+    // need one, found what the saved snapshot has, or the directory changed while being listed.
+    void save(qint64 listingTime);
+
+   private:
+    struct Stamp {
+        quint64 dev = 0;
+        quint64 ino = 0;
+        qint64 mtimeSec = 0;
+        qint64 mtimeNsec = 0;
+        qint64 ctimeSec = 0;
+        qint64 ctimeNsec = 0;
+
+        bool operator==(const Stamp& other) const {
+            return dev == other.dev && ino == other.ino && mtimeSec == other.mtimeSec &&
+                   mtimeNsec == other.mtimeNsec && ctimeSec == other.ctimeSec && ctimeNsec == other.ctimeNsec;
+        }
+    };
+
+    bool stampOf(Stamp& stamp) const;
+    bool openFile();
+    void flush();
+    void evictOldSnapshots() const;
+
+    FilePath dirPath_;
+    CStrPtr localPath_;
+    CStrPtr cachePath_;
+    Stamp stamp_;
+    bool loaded_;  // the saved snapshot was taken of the directory as it is
+    bool stale_;   // a saved snapshot exists but was taken of another state
+    quint32 loadedCount_;
+    quint64 loadedHash_;
+    QByteArray buf_;  // records not written to file_ yet, all of them while loaded_
+    std::unique_ptr<QSaveFile> file_;
+    quint32 count_;
+    quint64 hash_;
+    bool failed_;
+};
+
+}  // namespace Fm
+
+#endif  // FOLDERSNAPSHOT_P_H
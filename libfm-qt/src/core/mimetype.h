@@ -58,8 +58,13 @@ class LIBFM_QT_API MimeType {
     }
 
     void forEachThumbnailer(std::function<bool(const std::shared_ptr<const Thumbnailer>&)> func) const {
-        std::lock_guard<std::mutex> lock{mutex_};
-        for (auto& thumbnailer : thumbnailers_) {
+        // not called under the lock, which is shared by all types: thumbnailers run for seconds
+        std::forward_list<std::shared_ptr<const Thumbnailer>> thumbnailers;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            thumbnailers = thumbnailers_;
+        }
+        for (auto& thumbnailer : thumbnailers) {
             if (func(thumbnailer)) {
                 break;
             }
@@ -0,0 +1,374 @@
+/*
+ * Native getdents64/statx directory lister
+ * libfm-qt/src/core/nativedirlister.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "nativedirlister_p.h"
+#include "foldersnapshot_p.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace Fm {
+
+namespace {
+
+constexpr std::size_t kDirentBufferSize = 64 * 1024;
+
+#ifdef __linux__
+// getdents64() is only wrapped by recent glibc versions
+struct LinuxDirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+// Fills |st| (and |btime| when the kernel knows it) for |name| inside |dirFd|.
+bool statAt(int dirFd, const char* name, bool followLinks, struct stat& st, quint64& btime) {
+    btime = 0;
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    struct statx stx;
+    int flags = AT_NO_AUTOMOUNT | (followLinks ? 0 : AT_SYMLINK_NOFOLLOW);
+    if (statx(dirFd, name, flags, STATX_BASIC_STATS | STATX_BTIME, &stx) == 0) {
+        st = {};
+        st.st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        st.st_rdev = makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+        st.st_ino = stx.stx_ino;
+        st.st_mode = stx.stx_mode;
+        st.st_nlink = stx.stx_nlink;
+        st.st_uid = stx.stx_uid;
+        st.st_gid = stx.stx_gid;
+        st.st_size = stx.stx_size;
+        st.st_blksize = stx.stx_blksize;
+        st.st_blocks = stx.stx_blocks;
+        st.st_atim.tv_sec = stx.stx_atime.tv_sec;
+        st.st_atim.tv_nsec = stx.stx_atime.tv_nsec;
+        st.st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+        st.st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+        st.st_ctim.tv_sec = stx.stx_ctime.tv_sec;
+        st.st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+        if (stx.stx_mask & STATX_BTIME) {
+            btime = stx.stx_btime.tv_sec;
+        }
+        return true;
+    }
+    if (errno != ENOSYS) {
+        return false;
+    }
+#endif
+    return fstatat(dirFd, name, &st, followLinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0;
+}
+
+}  // namespace
+
+NativeDirLister::Context::Context() : uid{getuid()} {
+    int n_groups = getgroups(0, nullptr);
+    if (n_groups > 0) {
+        groups.resize(n_groups);
+        n_groups = getgroups(n_groups, groups.data());
+        groups.resize(n_groups > 0 ? n_groups : 0);
+    }
+    groups.push_back(getgid());
+
+    // the icons GIO's local backend gives to the home and XDG user directories
+    static const struct {
+        GUserDirectory dir;
+        const char* icon;
+    } specialDirs[] = {
+        {G_USER_DIRECTORY_DESKTOP, "user-desktop"},
+        {G_USER_DIRECTORY_DOCUMENTS, "folder-documents"},
+        {G_USER_DIRECTORY_DOWNLOAD, "folder-download"},
+        {G_USER_DIRECTORY_MUSIC, "folder-music"},
+        {G_USER_DIRECTORY_PICTURES, "folder-pictures"},
+        {G_USER_DIRECTORY_PUBLIC_SHARE, "folder-publicshare"},
+        {G_USER_DIRECTORY_TEMPLATES, "folder-templates"},
+        {G_USER_DIRECTORY_VIDEOS, "folder-videos"},
+    };
+    auto addIcon = [this](const char* path, const char* iconName) {
+        if (!path) {
+            return;
+        }
+        CStrPtr parent{g_path_get_dirname(path)};
+        CStrPtr base{g_path_get_basename(path)};
+        const char* names[] = {iconName, "folder", nullptr};
+        GIconPtr gicon{g_themed_icon_new_from_names(const_cast<char**>(names), -1), false};
+        specialDirIcons[parent.get()].emplace(base.get(), IconInfo::fromGIcon(gicon));
+    };
+    addIcon(g_get_home_dir(), "user-home");
+    for (const auto& special : specialDirs) {
+        const char* path = g_get_user_special_dir(special.dir);
+        // GIO ignores XDG dirs that point to home
+        if (path && strcmp(path, g_get_home_dir()) != 0) {
+            addIcon(path, special.icon);
+        }
+    }
+}
+
+NativeDirLister::NativeDirLister(const FilePath& dirPath, bool sniffContent, std::shared_ptr<const Context> context)
+    : dirPath_{dirPath},
+      sniffContent_{sniffContent},
+      fd_{-1},
+      bufPos_{0},
+      bufLen_{0},
+      context_{std::move(context)},
+      dirDev_{0},
+      dirWritable_{false},
+      dirSticky_{false},
+      dirOwned_{false},
+      readOnlyFs_{false},
+      specialDirIcons_{nullptr},
+      snapshot_{nullptr} {}
+
+NativeDirLister::~NativeDirLister() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool NativeDirLister::open(GErrorPtr& err) {
+#ifdef __linux__
+    localPath_ = dirPath_.localPath();
+    if (!localPath_) {
+        err = GErrorPtr{G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Not a local path"};
+        return false;
+    }
+    fd_ = ::open(localPath_.get(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct stat st;
+    if (fd_ < 0 || fstat(fd_, &st) != 0) {
+        int errsv = errno;
+        err = GErrorPtr{G_IO_ERROR, static_cast<unsigned int>(g_io_error_from_errno(errsv)), g_strerror(errsv)};
+        return false;
+    }
+    buf_.resize(kDirentBufferSize);
+
+    // everything that only depends on the directory is computed once, not per entry
+    dirDev_ = st.st_dev;
+    dirSticky_ = (st.st_mode & S_ISVTX) != 0;
+    dirWritable_ = faccessat(fd_, ".", W_OK | X_OK, 0) == 0;
+    readOnlyFs_ = !dirWritable_ && errno == EROFS;
+
+    if (!context_) {
+        context_ = std::make_shared<const Context>();
+    }
+    dirOwned_ = (st.st_uid == context_->uid);
+    auto icons = context_->specialDirIcons.find(localPath_.get());
+    if (icons != context_->specialDirIcons.end()) {
+        specialDirIcons_ = &icons->second;
+    }
+
+    loadHiddenList();
+    return true;
+#else
+    err = GErrorPtr{G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Native listing is not supported on this platform"};
+    return false;
+#endif
+}
+
+void NativeDirLister::loadHiddenList() {
+    // same as GIO: names listed in the ".hidden" file of a folder are hidden
+    int fd = openat(fd_, ".hidden", O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return;  // most folders have none, which costs this one call
+    }
+    std::string contents;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        contents.resize(st.st_size);
+        ssize_t n = read(fd, &contents[0], contents.size());
+        contents.resize(n > 0 ? n : 0);
+    }
+    ::close(fd);
+    for (std::size_t pos = 0; pos < contents.size();) {
+        std::size_t end = contents.find('\n', pos);
+        if (end == std::string::npos) {
+            end = contents.size();
+        }
+        if (end > pos) {
+            hiddenNames_.emplace(contents, pos, end - pos);
+        }
+        pos = end + 1;
+    }
+}
+
+bool NativeDirLister::nextBatch(FileInfoList& files, GErrorPtr& err, std::size_t maxEntries) {
+#ifdef __linux__
+    if (bufPos_ >= bufLen_) {
+        long nread = syscall(SYS_getdents64, fd_, buf_.data(), buf_.size());
+        if (nread < 0) {
+            int errsv = errno;
+            err = GErrorPtr{G_IO_ERROR, static_cast<unsigned int>(g_io_error_from_errno(errsv)), g_strerror(errsv)};
+            return false;
+        }
+        if (nread == 0) {
+            return false;
+        }
+        bufPos_ = 0;
+        bufLen_ = nread;
+    }
+    NativeFileAttrs attrs;
+    for (std::size_t added = 0; bufPos_ < bufLen_ && added < maxEntries;) {
+        auto ent = reinterpret_cast<const LinuxDirent64*>(buf_.data() + bufPos_);
+        bufPos_ += ent->d_reclen;
+        const char* name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        if (!fillAttrs(name, attrs)) {
+            continue;  // gone since getdents64() returned it
+        }
+        if (snapshot_) {
+            snapshot_->add(attrs);
+        }
+        if (filter_ && !filter_(attrs)) {
+            continue;
+        }
+        auto fileInfo = std::make_shared<FileInfo>();
+        fileInfo->setFromNative(attrs, dirPath_);
+        files.push_back(std::move(fileInfo));
+        ++added;
+    }
+    return true;
+#else
+    Q_UNUSED(files);
+    Q_UNUSED(err);
+    Q_UNUSED(maxEntries);
+    return false;
+#endif
+}
+
+bool NativeDirLister::fillAttrs(const char* name, NativeFileAttrs& attrs) {
+    attrs.name = name;
+    attrs.isSymlink = false;
+    attrs.linkTarget.clear();
+    attrs.icon.reset();
+    if (!statAt(fd_, name, false, attrs.st, attrs.btime)) {
+        return false;
+    }
+
+    bool isDanglingLink = false;
+    if (S_ISLNK(attrs.st.st_mode)) {
+        attrs.isSymlink = true;
+        std::vector<char> target(attrs.st.st_size > 0 ? attrs.st.st_size + 1 : PATH_MAX);
+        ssize_t len = readlinkat(fd_, name, target.data(), target.size() - 1);
+        if (len >= 0) {
+            attrs.linkTarget.assign(target.data(), len);
+        }
+        struct stat target_st;
+        quint64 target_btime;
+        if (statAt(fd_, name, true, target_st, target_btime)) {
+            attrs.st = target_st;
+            attrs.btime = target_btime;
+        }
+        else {
+            isDanglingLink = true;
+        }
+    }
+
+    const struct stat& st = attrs.st;
+    attrs.canRead = canAccess(st, R_OK);
+    attrs.canWrite = canAccess(st, W_OK);
+    const uid_t uid = context_->uid;
+    attrs.canDelete = dirWritable_ && (!dirSticky_ || uid == 0 || dirOwned_ || st.st_uid == uid);
+    attrs.canRename = attrs.canDelete;
+    attrs.isHidden = name[0] == '.' || (!hiddenNames_.empty() && hiddenNames_.count(name) > 0);
+
+    attrs.contentType = contentTypeOf(st, isDanglingLink);
+    attrs.canSniff = sniffContent_ && S_ISREG(st.st_mode);
+
+    if (S_ISDIR(st.st_mode) && specialDirIcons_) {
+        auto it = specialDirIcons_->find(name);
+        if (it != specialDirIcons_->end()) {
+            attrs.icon = it->second;
+        }
+    }
+    return true;
+}
+
+bool NativeDirLister::isMemberOf(gid_t gid) const {
+    for (gid_t group : context_->groups) {
+        if (group == gid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool NativeDirLister::canAccess(const struct stat& st, int mode) const {
+    if ((mode & W_OK) && readOnlyFs_ && st.st_dev == dirDev_) {
+        return false;
+    }
+    if (context_->uid == 0) {
+        return true;
+    }
+    mode_t bits;
+    if (st.st_uid == context_->uid) {
+        bits = (st.st_mode >> 6) & 7;
+    }
+    else if (isMemberOf(st.st_gid)) {
+        bits = (st.st_mode >> 3) & 7;
+    }
+    else {
+        bits = st.st_mode & 7;
+    }
+    // ACLs may grant more than the mode bits say; FileInfo asks the kernel when it resolves its details
+    return (bits & mode) == static_cast<mode_t>(mode);
+}
+
+const char* NativeDirLister::contentTypeOf(const struct stat& st, bool isDanglingLink) const {
+    // mirrors the content type rules of GIO's local backend for what the stat tells
+    if (isDanglingLink) {
+        return "inode/symlink";
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return "inode/directory";
+    }
+    if (S_ISCHR(st.st_mode)) {
+        return "inode/chardevice";
+    }
+    if (S_ISBLK(st.st_mode)) {
+        return "inode/blockdevice";
+    }
+    if (S_ISFIFO(st.st_mode)) {
+        return "inode/fifo";
+    }
+    if (S_ISSOCK(st.st_mode)) {
+        return "inode/socket";
+    }
+    if (S_ISREG(st.st_mode) && st.st_size == 0) {
+        // don't sniff empty files, they may be special files in /proc or /sys
+        return "application/x-zerosize";
+    }
+    // guessed from the name (and sniffed if needed) when FileInfo resolves its details
+    return nullptr;
+}
+
+}  // namespace Fm
@@ -0,0 +1,115 @@
+/*
+ * Native getdents64/statx directory lister
+ * libfm-qt/src/core/nativedirlister_p.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef NATIVEDIRLISTER_P_H
+#define NATIVEDIRLISTER_P_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sys/types.h>
+
+#include "gioptrs.h"
+#include "filepath.h"
+#include "fileinfo.h"
+
+namespace Fm {
+
+class FolderSnapshot;
+
+// Lists a local directory with getdents64() and statx() and fills FileInfo objects directly,
+// without going through GIO's enumerator and a GFileInfo per entry. Used by DirListJob for
+// native paths; everything else keeps using GIO.
+class NativeDirLister {
+   public:
+    // What does not depend on the listed directory: the user, its groups and the special folders.
+    // Whoever lists many directories, like a search, makes it once and gives it to every lister.
+    struct Context {
+        Context();
+
+        uid_t uid;
+        std::vector<gid_t> groups;
+        // the icons of the home and XDG user folders, by parent directory and then by name
+        std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<const IconInfo>>>
+            specialDirIcons;
+    };
+
+    // With |sniffContent|, files whose content type cannot be told from their name get their first
+    // bytes read when FileInfo resolves its details, like GIO does for "standard::content-type".
+    // Without a |context|, open() makes one.
+    explicit NativeDirLister(const FilePath& dirPath,
+                             bool sniffContent,
+                             std::shared_ptr<const Context> context = nullptr);
+
+    ~NativeDirLister();
+
+    NativeDirLister(const NativeDirLister&) = delete;
+    NativeDirLister& operator=(const NativeDirLister&) = delete;
+
+    // Fails when the directory cannot be opened natively; the caller should then fall back to GIO.
+    bool open(GErrorPtr& err);
+
+    // Appends the entries of the next getdents64() batch to |files|, or only up to |maxEntries| of
+    // them; the rest of the batch is returned by the next call.
+    // Returns false at the end of the directory or on error, in which case |err| is set.
+    bool nextBatch(FileInfoList& files, GErrorPtr& err, std::size_t maxEntries = SIZE_MAX);
+
+    // Records every listed entry in |snapshot|, see DirListJob::setSnapshotEnabled().
+    void setSnapshot(FolderSnapshot* snapshot) { snapshot_ = snapshot; }
+
+    // Only entries |filter| accepts get a FileInfo; the others are dropped before it is allocated.
+    void setFilter(std::function<bool(const NativeFileAttrs&)> filter) { filter_ = std::move(filter); }
+
+   private:
+    void loadHiddenList();
+    bool fillAttrs(const char* name, NativeFileAttrs& attrs);
+    bool isMemberOf(gid_t gid) const;
+    bool canAccess(const struct stat& st, int mode) const;
+    const char* contentTypeOf(const struct stat& st, bool isDanglingLink) const;
+
+    FilePath dirPath_;
+    CStrPtr localPath_;
+    bool sniffContent_;
+    int fd_;
+    std::vector<char> buf_;
+    long bufPos_;  // the part of |buf_| not returned yet
+    long bufLen_;
+    std::shared_ptr<const Context> context_;
+    dev_t dirDev_;
+    bool dirWritable_;     // entries can be deleted or renamed...
+    bool dirSticky_;       // ...but only by their owner if the sticky bit is set
+    bool dirOwned_;        // the directory belongs to us (sticky rule)
+    bool readOnlyFs_;      // EROFS on the directory itself
+    std::unordered_set<std::string> hiddenNames_;
+    // the special folders in this directory, from |context_|
+    const std::unordered_map<std::string, std::shared_ptr<const IconInfo>>* specialDirIcons_;
+    FolderSnapshot* snapshot_;
+    std::function<bool(const NativeFileAttrs&)> filter_;
+};
+
+}  // namespace Fm
+
+#endif  // NATIVEDIRLISTER_P_H
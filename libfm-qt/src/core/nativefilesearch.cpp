@@ -0,0 +1,566 @@
+/*
+ * Parallel search of local folders
+ * libfm-qt/src/core/nativefilesearch.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "nativefilesearch_p.h"
+#include "mimetype.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace Fm {
+
+namespace {
+
+constexpr unsigned int kMaxWalkThreads = 8;
+// content reads compete for the same disk, more of them rarely help
+constexpr unsigned int kMaxContentThreads = 4;
+constexpr std::size_t kReadSize = 64 * 1024;
+// the files the walk may queue ahead of the content threads
+constexpr std::size_t kMaxCandidates = 4096;
+
+// a date in YYYY-MM-DD form, like parse_date_str() in vfs/vfs-search.c
+std::time_t parseDate(const char* str) {
+    if (strlen(str) >= 8) {
+        struct tm timeinfo = {};
+        if (sscanf(str, "%04d-%02d-%02d", &timeinfo.tm_year, &timeinfo.tm_mon, &timeinfo.tm_mday) == 3) {
+            timeinfo.tm_year -= 1900;
+            --timeinfo.tm_mon;
+            return mktime(&timeinfo);
+        }
+    }
+    return 0;
+}
+
+bool isSet(const char* value) {
+    return value && value[0] == '1';
+}
+
+ssize_t readSome(int fd, char* buf, std::size_t size) {
+    ssize_t n;
+    do {
+        n = read(fd, buf, size);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+// the raw pattern is used for names and lines that are not valid UTF-8
+bool regexMatches(GRegex* regex, GRegex* regexUtf8, const char* str) {
+    GRegex* used = regexUtf8 && g_utf8_validate(str, -1, nullptr) ? regexUtf8 : regex;
+    return used && g_regex_match(used, str, GRegexMatchFlags(0), nullptr);
+}
+
+}  // namespace
+
+NativeFileSearch::NativeFileSearch(GCancellable* cancellable, bool sniffContent)
+    : cancellable_{cancellable},
+      sniffContent_{sniffContent},
+      recursive_{false},
+      showHidden_{false},
+      nameCaseInsensitive_{false},
+      contentCaseInsensitive_{false},
+      minSize_{0},
+      maxSize_{0},
+      minMtime_{0},
+      maxMtime_{0},
+      stopping_{false},
+      pendingDirs_{0},
+      walkDone_{false},
+      runningThreads_{0} {}
+
+NativeFileSearch::~NativeFileSearch() {
+    // the threads skip what is left once they see this, so that they are joined quickly
+    stopping_ = true;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        walkCond_.notify_all();
+        contentCond_.notify_all();
+        spaceCond_.notify_all();
+    }
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+bool NativeFileSearch::start(const char* uri) {
+    if (!parse(uri)) {
+        return false;
+    }
+    listerContext_ = std::make_shared<const NativeDirLister::Context>();
+    dirs_.assign(folders_.begin(), folders_.end());
+    pendingDirs_ = dirs_.size();
+    walkDone_ = dirs_.empty();
+
+    const unsigned int cores = std::thread::hardware_concurrency();
+    const unsigned int walkThreads = std::clamp(cores, 1u, kMaxWalkThreads);
+    const bool matchContent = contentPattern_ || contentRegex_;
+    const unsigned int contentThreads = matchContent ? std::clamp(cores / 2, 1u, kMaxContentThreads) : 0;
+    runningThreads_ = walkThreads + contentThreads;
+    for (unsigned int i = 0; i < walkThreads; ++i) {
+        threads_.emplace_back(&NativeFileSearch::walk, this);
+    }
+    for (unsigned int i = 0; i < contentThreads; ++i) {
+        threads_.emplace_back(&NativeFileSearch::matchContents, this);
+    }
+    return true;
+}
+
+bool NativeFileSearch::parse(const char* uri) {
+    // the format is described at parse_search_uri() in vfs/vfs-search.c
+    static const char scheme[] = "search://";
+    if (g_ascii_strncasecmp(uri, scheme, sizeof(scheme) - 1) != 0) {
+        return false;
+    }
+    const char* p = uri + sizeof(scheme) - 1;
+    const char* params = strchr(p, '?');
+
+    while (p) {
+        const char* sep = strchr(p, ',');
+        CStrPtr path;
+        if (sep && (params == nullptr || sep < params)) {
+            path = CStrPtr{g_uri_unescape_segment(p, sep, nullptr)};
+        }
+        else if (params != nullptr) {
+            path = CStrPtr{g_uri_unescape_segment(p, params, nullptr)};
+            sep = nullptr;
+        }
+        else {
+            path = CStrPtr{g_uri_unescape_string(p, nullptr)};
+        }
+        if (!path) {
+            return false;
+        }
+        GFilePtr file{g_file_new_for_commandline_arg(path.get()), false};
+        CStrPtr localPath{g_file_is_native(file.get()) ? g_file_get_path(file.get()) : nullptr};
+        if (!localPath) {
+            return false;
+        }
+        folders_.emplace_back(localPath.get());
+        p = sep ? sep + 1 : nullptr;
+    }
+
+    CStrPtr nameRegex;
+    CStrPtr contentRegex;
+    while (params && *++params) {
+        const char* sep = strchr(params, '&');
+        const char* eq = strchr(params, '=');
+        CStrPtr name;
+        CStrPtr value;
+        if (eq && (sep == nullptr || eq < sep)) {
+            name = CStrPtr{g_strndup(params, eq - params)};
+            value = CStrPtr{sep ? g_uri_unescape_segment(eq + 1, sep, nullptr) : g_uri_unescape_string(eq + 1, nullptr)};
+        }
+        else {
+            name = CStrPtr{sep ? g_strndup(params, sep - params) : g_strdup(params)};
+        }
+
+        const char* key = name.get();
+        if (strcmp(key, "show_hidden") == 0) {
+            showHidden_ = isSet(value.get());
+        }
+        else if (strcmp(key, "recursive") == 0) {
+            recursive_ = isSet(value.get());
+        }
+        else if (strcmp(key, "name_ci") == 0) {
+            nameCaseInsensitive_ = isSet(value.get());
+        }
+        else if (strcmp(key, "content_ci") == 0) {
+            contentCaseInsensitive_ = isSet(value.get());
+        }
+        else if (!value) {
+            // the rest need a value
+        }
+        else if (strcmp(key, "name") == 0) {
+            gchar** patterns = g_strsplit(value.get(), ",", 0);
+            namePatterns_.assign(patterns, patterns + g_strv_length(patterns));
+            g_strfreev(patterns);
+        }
+        else if (strcmp(key, "name_regex") == 0) {
+            nameRegex = std::move(value);
+        }
+        else if (strcmp(key, "content") == 0) {
+            contentPattern_ = std::move(value);
+        }
+        else if (strcmp(key, "content_regex") == 0) {
+            contentRegex = std::move(value);
+        }
+        else if (strcmp(key, "mime_types") == 0) {
+            gchar** types = g_strsplit(value.get(), ";", -1);
+            for (gchar** type = types; *type; ++type) {
+                std::string mimeType{*type};
+                // "image/*" is kept as "*image/" so that it is told from a full name by its first char
+                if (mimeType.size() > 2 && mimeType.back() == '*') {
+                    mimeType.pop_back();
+                    mimeType.insert(0, 1, '*');
+                }
+                mimeTypes_.push_back(std::move(mimeType));
+            }
+            g_strfreev(types);
+        }
+        else if (strcmp(key, "min_size") == 0) {
+            minSize_ = atoll(value.get());
+        }
+        else if (strcmp(key, "max_size") == 0) {
+            maxSize_ = atoll(value.get());
+        }
+        else if (strcmp(key, "min_mtime") == 0) {
+            minMtime_ = parseDate(value.get());
+        }
+        else if (strcmp(key, "max_mtime") == 0) {
+            maxMtime_ = parseDate(value.get());
+        }
+        params = sep;
+    }
+
+    // G_REGEX_RAW for names and contents that are not valid UTF-8
+    if (nameRegex) {
+        const int caseless = nameCaseInsensitive_ ? G_REGEX_CASELESS : 0;
+        nameRegex_.reset(g_regex_new(nameRegex.get(), GRegexCompileFlags(G_REGEX_RAW | caseless),
+                                     GRegexMatchFlags(0), nullptr));
+        nameRegexUtf8_.reset(
+            g_regex_new(nameRegex.get(), GRegexCompileFlags(caseless), GRegexMatchFlags(0), nullptr));
+    }
+    if (contentRegex) {
+        const int caseless = contentCaseInsensitive_ ? G_REGEX_CASELESS : 0;
+        contentRegex_.reset(g_regex_new(contentRegex.get(), GRegexCompileFlags(G_REGEX_RAW | caseless),
+                                        GRegexMatchFlags(0), nullptr));
+        contentRegexUtf8_.reset(
+            g_regex_new(contentRegex.get(), GRegexCompileFlags(caseless), GRegexMatchFlags(0), nullptr));
+    }
+    if (contentPattern_ && contentCaseInsensitive_) {
+        contentPattern_ = CStrPtr{g_utf8_strdown(contentPattern_.get(), -1)};
+    }
+    return true;
+}
+
+bool NativeFileSearch::waitForMatches(FileInfoList& files, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    matchesCond_.wait_for(lock, timeout, [this] { return !matches_.empty() || runningThreads_ == 0; });
+    if (!matches_.empty()) {
+        files.insert(files.end(), std::make_move_iterator(matches_.begin()), std::make_move_iterator(matches_.end()));
+        matches_.clear();
+        return true;
+    }
+    return runningThreads_ != 0;
+}
+
+std::vector<GErrorPtr> NativeFileSearch::takeErrors() {
+    std::vector<GErrorPtr> errors;
+    std::lock_guard<std::mutex> lock{mutex_};
+    errors.swap(errors_);
+    return errors;
+}
+
+bool NativeFileSearch::isStopped() const {
+    return stopping_ || g_cancellable_is_cancelled(cancellable_);
+}
+
+void NativeFileSearch::walk() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+        walkCond_.wait(lock, [this] { return !dirs_.empty() || pendingDirs_ == 0; });
+        if (dirs_.empty()) {
+            break;  // nothing is being read any more, so nothing will be queued
+        }
+        // the last one queued, so that the walk goes deep first and the queue stays short
+        std::string path = std::move(dirs_.back());
+        dirs_.pop_back();
+        lock.unlock();
+        if (!isStopped()) {
+            readDir(path);
+        }
+        lock.lock();
+        if (--pendingDirs_ == 0) {
+            walkDone_ = true;
+            walkCond_.notify_all();
+            contentCond_.notify_all();
+        }
+    }
+    lock.unlock();
+    threadDone();
+}
+
+void NativeFileSearch::readDir(const std::string& path) {
+    NativeDirLister lister{FilePath::fromLocalPath(path.c_str()), sniffContent_, listerContext_};
+    std::vector<std::string> subdirs;
+    lister.setFilter([this, &subdirs](const NativeFileAttrs& attrs) {
+        // links to folders are not followed, or the same files could be found several times
+        if (recursive_ && !attrs.isSymlink && S_ISDIR(attrs.st.st_mode) && (showHidden_ || !attrs.isHidden)) {
+            subdirs.emplace_back(attrs.name);
+        }
+        return matchesAttrs(attrs);
+    });
+
+    FileInfoList files;
+    GErrorPtr err;
+    if (lister.open(err)) {
+        while (!isStopped()) {
+            err.reset();
+            if (!lister.nextBatch(files, err)) {
+                break;
+            }
+        }
+    }
+    // the GIO search skips what cannot be read as well, and folders removed since they were listed
+    if (err && !(err.domain() == G_IO_ERROR &&
+                 (err.code() == G_IO_ERROR_PERMISSION_DENIED ||
+                  (err.code() == G_IO_ERROR_NOT_FOUND &&
+                   std::find(folders_.cbegin(), folders_.cend(), path) == folders_.cend())))) {
+        CStrPtr dispName{g_filename_display_name(path.c_str())};
+        std::lock_guard<std::mutex> lock{mutex_};
+        errors_.emplace_back(G_IO_ERROR, err.code(),
+                             QStringLiteral("%1: %2").arg(QString::fromUtf8(dispName.get()), err.message()));
+    }
+
+    const std::string prefix = path.back() == '/' ? path : path + '/';
+    FileInfoList matches;
+    std::vector<Candidate> candidates;
+    const bool matchContent = contentPattern_ || contentRegex_;
+    for (auto& file : files) {
+        if (!matchesMimeType(*file)) {
+            continue;
+        }
+        if (matchContent) {
+            candidates.push_back(Candidate{prefix + file->name(), std::move(file)});
+        }
+        else {
+            matches.push_back(std::move(file));
+        }
+    }
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (!subdirs.empty()) {
+        for (auto& name : subdirs) {
+            dirs_.push_back(prefix + name);
+        }
+        pendingDirs_ += subdirs.size();
+        walkCond_.notify_all();
+    }
+    if (!matches.empty()) {
+        matches_.insert(matches_.end(), std::make_move_iterator(matches.begin()),
+                        std::make_move_iterator(matches.end()));
+        matchesCond_.notify_all();
+    }
+    // the content threads keep taking files until the walk is done, so waiting for them cannot block
+    for (auto it = candidates.begin(); it != candidates.end();) {
+        spaceCond_.wait(lock, [this] { return candidates_.size() < kMaxCandidates || stopping_; });
+        if (stopping_) {
+            break;
+        }
+        const auto count = std::min<std::ptrdiff_t>(kMaxCandidates - candidates_.size(), candidates.end() - it);
+        std::move(it, it + count, std::back_inserter(candidates_));
+        it += count;
+        contentCond_.notify_all();
+    }
+}
+
+bool NativeFileSearch::matchesAttrs(const NativeFileAttrs& attrs) const {
+    if (!showHidden_ && attrs.isHidden) {
+        return false;
+    }
+
+    const char* name = attrs.name;
+    if (nameRegex_ || nameRegexUtf8_) {
+        if (!regexMatches(nameRegex_.get(), nameRegexUtf8_.get(), name)) {
+            return false;
+        }
+    }
+    else if (!namePatterns_.empty()) {
+        const int flags = FNM_PERIOD | (nameCaseInsensitive_ ? FNM_CASEFOLD : 0);
+        if (std::none_of(namePatterns_.cbegin(), namePatterns_.cend(), [name, flags](const std::string& pattern) {
+                return fnmatch(pattern.c_str(), name, flags) == 0;
+            })) {
+            return false;
+        }
+    }
+
+    // symlinks are matched by their targets, like GIO reports them
+    const struct stat& st = attrs.st;
+    const std::uint64_t size = st.st_size;
+    if ((minSize_ > 0 && size < minSize_) || (maxSize_ > 0 && size > maxSize_) ||
+        ((minSize_ > 0 || maxSize_ > 0) && S_ISDIR(st.st_mode))) {
+        return false;
+    }
+    if ((minMtime_ > 0 && st.st_mtime < minMtime_) || (maxMtime_ > 0 && st.st_mtime > maxMtime_)) {
+        return false;
+    }
+    // only non-empty regular files can have the content looked for
+    if ((contentPattern_ || contentRegex_) && (!S_ISREG(st.st_mode) || size == 0)) {
+        return false;
+    }
+    return true;
+}
+
+bool NativeFileSearch::matchesMimeType(const FileInfo& info) const {
+    if (mimeTypes_.empty()) {
+        return true;
+    }
+    // may read the beginning of the file, on the walking thread
+    const auto& mimeType = info.mimeType();
+    const char* fileType = mimeType ? mimeType->name() : nullptr;
+    if (!fileType) {
+        return false;
+    }
+    for (const auto& type : mimeTypes_) {
+        if (type[0] == '*' ? g_str_has_prefix(fileType, type.c_str() + 1)
+                           : g_content_type_is_a(fileType, type.c_str())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void NativeFileSearch::matchContents() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+        contentCond_.wait(lock, [this] { return !candidates_.empty() || walkDone_ || stopping_; });
+        if (candidates_.empty() || stopping_) {
+            break;
+        }
+        Candidate candidate = std::move(candidates_.front());
+        candidates_.pop_front();
+        if (candidates_.size() == kMaxCandidates - 1) {
+            spaceCond_.notify_all();
+        }
+        lock.unlock();
+        if (!isStopped() && matchesContent(candidate.localPath)) {
+            lock.lock();
+            matches_.push_back(std::move(candidate.info));
+            matchesCond_.notify_all();
+        }
+        else {
+            lock.lock();
+        }
+    }
+    lock.unlock();
+    threadDone();
+}
+
+bool NativeFileSearch::matchesContent(const std::string& localPath) const {
+    // O_NONBLOCK in case it was replaced by a FIFO since it was listed
+    int fd = open(localPath.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return false;
+    }
+    bool ret = false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        ret = matchesContentLines(fd);
+    }
+    close(fd);
+    return ret;
+}
+
+bool NativeFileSearch::matchesContentLines(int fd) const {
+    // Every kind of pattern is matched line by line, the exact ones too, so that a match never spans
+    // a line break or a NUL byte. One more byte to terminate the last line of a read in place.
+    std::vector<char> buf(kReadSize + 1);
+    std::string partial;  // a line that goes on in the next read
+    bool cut = false;     // the line reached a NUL, the rest of it is not matched
+    while (!isStopped()) {
+        const ssize_t n = readSome(fd, buf.data(), kReadSize);
+        if (n <= 0) {
+            return !partial.empty() && matchesLine(&partial[0], partial.size());
+        }
+        char* p = buf.data();
+        char* const end = p + n;
+        while (p < end) {
+            auto newline = static_cast<char*>(memchr(p, '\n', end - p));
+            char* textEnd = newline ? newline : end;
+            // a line ends at its first NUL, as it does for the GIO search
+            if (cut) {
+                textEnd = p;
+            }
+            else if (auto nul = static_cast<char*>(memchr(p, '\0', textEnd - p))) {
+                textEnd = nul;
+                cut = true;
+            }
+            if (!newline) {
+                partial.append(p, textEnd);
+                break;
+            }
+            bool found;
+            if (!partial.empty()) {
+                partial.append(p, textEnd);
+                found = matchesLine(&partial[0], partial.size());
+                partial.clear();
+            }
+            else {
+                *textEnd = '\0';
+                found = matchesLine(p, textEnd - p);
+            }
+            if (found) {
+                return true;
+            }
+            cut = false;
+            p = newline + 1;
+        }
+    }
+    return false;
+}
+
+bool NativeFileSearch::matchesLine(char* line, std::size_t len) const {
+    if (contentRegex_ || contentRegexUtf8_) {
+        return regexMatches(contentRegex_.get(), contentRegexUtf8_.get(), line);
+    }
+    if (!contentPattern_) {
+        return false;
+    }
+    if (!contentCaseInsensitive_) {
+        return strstr(line, contentPattern_.get()) != nullptr;
+    }
+    // most lines are ASCII, which is lowered in place without a copy
+    char* const end = line + len;
+    char* p = line;
+    for (; p < end && (*p & 0x80) == 0; ++p) {
+        if (*p >= 'A' && *p <= 'Z') {
+            *p += 'a' - 'A';
+        }
+    }
+    if (p < end) {
+        if (g_utf8_validate(line, -1, nullptr)) {
+            CStrPtr down{g_utf8_strdown(line, -1)};
+            return strstr(down.get(), contentPattern_.get()) != nullptr;
+        }
+        std::transform(p, end, p, [](char c) { return g_ascii_tolower(c); });
+    }
+    return strstr(line, contentPattern_.get()) != nullptr;
+}
+
+void NativeFileSearch::threadDone() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (--runningThreads_ == 0) {
+        matchesCond_.notify_all();
+    }
+}
+
+}  // namespace Fm
@@ -0,0 +1,144 @@
+/*
+ * Parallel search of local folders
+ * libfm-qt/src/core/nativefilesearch_p.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef NATIVEFILESEARCH_P_H
+#define NATIVEFILESEARCH_P_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gioptrs.h"
+#include "fileinfo.h"
+#include "nativedirlister_p.h"
+
+namespace Fm {
+
+// Runs a search:// query over local folders in parallel: several threads list the queued folders
+// with NativeDirLister and check names, types, sizes and times while they read them, and the files
+// that are left for a content match are read by a separate, smaller pool so that slow reads do
+// not hold the walk back; the walk waits for them when too many files are queued. Matches are
+// handed out as they are found, in no particular order.
+// Used by DirListJob when every folder of the query is local; everything else keeps using the
+// GIO implementation in vfs/vfs-search.c, whose URI format and matching rules this follows.
+class NativeFileSearch {
+   public:
+    // With |sniffContent|, MIME types are told from the content of files when the name is not
+    // conclusive, like NativeDirLister does.
+    NativeFileSearch(GCancellable* cancellable, bool sniffContent);
+
+    ~NativeFileSearch();
+
+    NativeFileSearch(const NativeFileSearch&) = delete;
+    NativeFileSearch& operator=(const NativeFileSearch&) = delete;
+
+    // Parses |uri| and starts the search. Fails, without starting anything, when the URI is not
+    // a search:// URI or one of its folders is not local; the caller should then fall back to GIO.
+    bool start(const char* uri);
+
+    // Waits up to |timeout| for matches and appends them to |files|. Returns false once the search
+    // is over and everything was handed out.
+    bool waitForMatches(FileInfoList& files, std::chrono::milliseconds timeout);
+
+    // The errors met since the last call, other than folders that cannot be read by the user.
+    std::vector<GErrorPtr> takeErrors();
+
+   private:
+    struct RegexUnref {
+        void operator()(GRegex* regex) const { g_regex_unref(regex); }
+    };
+    using RegexPtr = std::unique_ptr<GRegex, RegexUnref>;
+
+    // a file left for its content to be matched
+    struct Candidate {
+        std::string localPath;
+        std::shared_ptr<const FileInfo> info;
+    };
+
+    bool parse(const char* uri);
+    bool isStopped() const;
+    void walk();
+    void readDir(const std::string& path);
+    bool matchesAttrs(const NativeFileAttrs& attrs) const;
+    bool matchesMimeType(const FileInfo& info) const;
+    void matchContents();
+    bool matchesContent(const std::string& localPath) const;
+    bool matchesContentLines(int fd) const;
+    bool matchesLine(char* line, std::size_t len) const;  // |line| ends at its first NUL
+    void threadDone();
+
+    GCancellable* cancellable_;
+    bool sniffContent_;
+    std::shared_ptr<const NativeDirLister::Context> listerContext_;  // the same for every folder
+
+    // the query
+    std::vector<std::string> folders_;
+    bool recursive_;
+    bool showHidden_;
+    std::vector<std::string> namePatterns_;
+    bool nameCaseInsensitive_;
+    RegexPtr nameRegex_;
+    RegexPtr nameRegexUtf8_;
+    CStrPtr contentPattern_;  // lower case if |contentCaseInsensitive_|
+    bool contentCaseInsensitive_;
+    RegexPtr contentRegex_;
+    RegexPtr contentRegexUtf8_;
+    std::vector<std::string> mimeTypes_;  // "*image/" for "image/*"
+    std::uint64_t minSize_;
+    std::uint64_t maxSize_;
+    std::time_t minMtime_;
+    std::time_t maxMtime_;
+
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stopping_;
+
+    // the folders to read
+    std::mutex mutex_;
+    std::condition_variable walkCond_;
+    std::deque<std::string> dirs_;
+    std::size_t pendingDirs_;  // queued or being read
+    bool walkDone_;
+
+    // the files to read
+    std::condition_variable contentCond_;
+    std::condition_variable spaceCond_;  // |candidates_| is no longer full
+    std::deque<Candidate> candidates_;
+
+    // what is handed out
+    std::condition_variable matchesCond_;
+    FileInfoList matches_;
+    std::vector<GErrorPtr> errors_;
+    unsigned int runningThreads_;
+};
+
+}  // namespace Fm
+
+#endif  // NATIVEFILESEARCH_P_H
@@ -0,0 +1,231 @@
+/*
+ * Parallel size walker for local trees
+ * libfm-qt/src/core/nativesizewalker.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "nativesizewalker_p.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+namespace Fm {
+
+namespace {
+
+constexpr unsigned int kMaxThreads = 8;
+// the largest files of a directory that are remembered
+constexpr std::size_t kLargestFiles = 5;
+
+// Fills what is counted of |st| for |name| inside |dirFd|, without following links.
+bool statAt(int dirFd, const char* name, struct stat& st) {
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    struct statx stx;
+    if (statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC,
+              STATX_TYPE | STATX_NLINK | STATX_INO | STATX_SIZE | STATX_BLOCKS, &stx) == 0) {
+        st.st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        st.st_ino = stx.stx_ino;
+        st.st_mode = stx.stx_mode;
+        st.st_nlink = stx.stx_nlink;
+        st.st_size = stx.stx_size;
+        st.st_blocks = stx.stx_blocks;
+        return true;
+    }
+    if (errno != ENOSYS) {
+        return false;
+    }
+#endif
+    return fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0;
+}
+
+// what GIO reports as "standard::allocated-size"
+inline std::uint64_t onDiskSizeOf(const struct stat& st) {
+    return static_cast<std::uint64_t>(st.st_blocks) * 512;
+}
+
+// Keeps |name| in |largestFiles| if it is one of the largest files by size on disk.
+void addLargestFile(std::vector<NativeSizeWalker::File>& largestFiles, const char* name, const struct stat& st) {
+    const std::uint64_t onDiskSize = onDiskSizeOf(st);
+    if (largestFiles.size() == kLargestFiles && largestFiles.back().onDiskSize >= onDiskSize) {
+        return;
+    }
+    auto it = std::find_if(largestFiles.begin(), largestFiles.end(),
+                           [onDiskSize](const NativeSizeWalker::File& file) { return file.onDiskSize < onDiskSize; });
+    largestFiles.insert(it, NativeSizeWalker::File{name, static_cast<std::uint64_t>(st.st_size), onDiskSize});
+    if (largestFiles.size() > kLargestFiles) {
+        largestFiles.pop_back();
+    }
+}
+
+}  // namespace
+
+NativeSizeWalker::NativeSizeWalker(bool sameFs, GCancellable* cancellable, std::function<void(const Counts&)> progress)
+    : sameFs_{sameFs}, rootDev_{0}, cancellable_{cancellable}, progress_{std::move(progress)}, pending_{0} {}
+
+bool NativeSizeWalker::walk(const char* localPath, bool followLinks) {
+    struct stat st;
+    if ((followLinks ? stat(localPath, &st) : lstat(localPath, &st)) != 0) {
+        return false;
+    }
+    Counts counts;
+    counts.fileCount = 1;
+    if (!S_ISDIR(st.st_mode)) {
+        counts.size = st.st_size;
+    }
+    if (S_ISDIR(st.st_mode) || st.st_nlink <= 1 || isFirstLink(st.st_dev, st.st_ino)) {
+        counts.onDiskSize = onDiskSizeOf(st);
+    }
+    if (progress_) {
+        progress_(counts);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return true;
+    }
+
+    rootDev_ = st.st_dev;
+    queue_.emplace_back(localPath);
+    pending_ = 1;
+    std::vector<std::thread> threads;
+    const unsigned int threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, kMaxThreads);
+    for (unsigned int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(&NativeSizeWalker::work, this);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return true;
+}
+
+std::vector<std::pair<std::string, int>> NativeSizeWalker::takeErrors() {
+    std::vector<std::pair<std::string, int>> errors;
+    std::lock_guard<std::mutex> lock{mutex_};
+    errors.swap(errors_);
+    return errors;
+}
+
+void NativeSizeWalker::work() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+        cond_.wait(lock, [this] { return !queue_.empty() || pending_ == 0; });
+        if (queue_.empty()) {
+            return;  // nothing is being read any more, so nothing will be queued
+        }
+        // the last one queued, so that the walk goes deep first and the queue stays short
+        std::string path = std::move(queue_.back());
+        queue_.pop_back();
+        lock.unlock();
+        if (!g_cancellable_is_cancelled(cancellable_)) {
+            readDir(path);
+        }
+        lock.lock();
+        if (--pending_ == 0) {
+            cond_.notify_all();
+        }
+    }
+}
+
+void NativeSizeWalker::readDir(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        int errsv = errno;
+        std::lock_guard<std::mutex> lock{mutex_};
+        errors_.emplace_back(path, errsv);
+        return;
+    }
+    Counts counts;
+    std::vector<std::string> subdirs;
+    std::vector<File> largestFiles;  // the largest first
+    int errsv = 0;
+    for (;;) {
+        if (g_cancellable_is_cancelled(cancellable_)) {
+            closedir(dir);
+            return;  // incomplete, not worth counting
+        }
+        errno = 0;
+        struct dirent* ent = readdir(dir);
+        if (!ent) {
+            errsv = errno;
+            break;
+        }
+        const char* name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        struct stat st;
+        if (!statAt(dirfd(dir), name, st)) {
+            continue;  // deleted meanwhile
+        }
+        ++counts.fileCount;
+        if (S_ISDIR(st.st_mode)) {
+            counts.onDiskSize += onDiskSizeOf(st);
+            if (!sameFs_ || st.st_dev == rootDev_) {
+                subdirs.emplace_back(name);
+            }
+            continue;
+        }
+        counts.size += st.st_size;
+        addLargestFile(largestFiles, name, st);
+        if (st.st_nlink <= 1 || isFirstLink(st.st_dev, st.st_ino)) {
+            counts.onDiskSize += onDiskSizeOf(st);
+        }
+    }
+    closedir(dir);
+    if (errsv != 0) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        errors_.emplace_back(path, errsv);
+    }
+
+    if (progress_) {
+        progress_(counts);
+    }
+    if (dirRead_) {
+        dirRead_(Dir{path, counts, subdirs, std::move(largestFiles)});
+    }
+
+    const std::string prefix = path.back() == '/' ? path : path + '/';
+    const std::size_t queued = subdirs.size();
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (auto& name : subdirs) {
+        queue_.push_back(prefix + name);
+    }
+    pending_ += queued;
+    if (queued > 1) {
+        cond_.notify_all();
+    }
+    else if (queued == 1) {
+        cond_.notify_one();
+    }
+}
+
+bool NativeSizeWalker::isFirstLink(dev_t dev, ino_t ino) {
+    std::lock_guard<std::mutex> lock{linksMutex_};
+    return links_.insert(FileId{dev, ino}).second;
+}
+
+}  // namespace Fm
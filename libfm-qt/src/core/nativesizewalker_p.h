@@ -0,0 +1,119 @@
+/*
+ * Parallel size walker for local trees
+ * libfm-qt/src/core/nativesizewalker_p.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef NATIVESIZEWALKER_P_H
+#define NATIVESIZEWALKER_P_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include <gio/gio.h>
+
+namespace Fm {
+
+// Adds up the sizes of local trees with statx() alone, on several threads that each read the next
+// queued directory. Files with several hard links count once towards the size on disk, as with du,
+// but every link counts towards the size. Used by TotalSizeJob for native paths; everything else
+// keeps using GIO.
+class NativeSizeWalker {
+   public:
+    struct Counts {
+        std::uint64_t size = 0;  // of the files, not of the directories
+        std::uint64_t onDiskSize = 0;
+        unsigned int fileCount = 0;  // the directories included
+    };
+
+    struct File {
+        std::string name;
+        std::uint64_t size;
+        std::uint64_t onDiskSize;
+    };
+
+    // What a directory directly contains, for building a tree of the sizes.
+    struct Dir {
+        std::string path;
+        Counts counts;  // of the entries, with those of the subdirectories but not of their contents
+        std::vector<std::string> subdirs;  // the ones that are read too
+        std::vector<File> largestFiles;    // by size on disk, the largest first
+    };
+
+    // |progress| gets the counts of every directory once it is read, on any of the threads.
+    // With |sameFs|, directories on another filesystem than the path given to walk() are counted but
+    // not read.
+    NativeSizeWalker(bool sameFs, GCancellable* cancellable, std::function<void(const Counts&)> progress);
+
+    NativeSizeWalker(const NativeSizeWalker&) = delete;
+    NativeSizeWalker& operator=(const NativeSizeWalker&) = delete;
+
+    // Counts |localPath| and everything below it, and returns when done. Fails with errno set,
+    // without counting anything, if |localPath| itself cannot be stat'ed.
+    bool walk(const char* localPath, bool followLinks);
+
+    // Also passes every directory read to |dirRead|, on any of the threads, before its subdirectories
+    // are read. Call it before walk().
+    void setDirRead(std::function<void(Dir&&)> dirRead) { dirRead_ = std::move(dirRead); }
+
+    // The directories that could not be read since the last call, with their errno.
+    std::vector<std::pair<std::string, int>> takeErrors();
+
+   private:
+    struct FileId {
+        dev_t dev;
+        ino_t ino;
+
+        bool operator==(const FileId& other) const { return dev == other.dev && ino == other.ino; }
+    };
+
+    struct FileIdHash {
+        std::size_t operator()(const FileId& id) const { return std::hash<ino_t>()(id.ino) ^ id.dev; }
+    };
+
+    void work();
+    void readDir(const std::string& path);
+    bool isFirstLink(dev_t dev, ino_t ino);
+
+    bool sameFs_;
+    dev_t rootDev_;
+    GCancellable* cancellable_;
+    std::function<void(const Counts&)> progress_;
+    std::function<void(Dir&&)> dirRead_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::string> queue_;  // directories to read
+    std::size_t pending_;            // directories queued or being read
+    std::vector<std::pair<std::string, int>> errors_;
+
+    std::mutex linksMutex_;
+    std::unordered_set<FileId, FileIdHash> links_;  // the files with several links counted already
+};
+
+}  // namespace Fm
+
+#endif  // NATIVESIZEWALKER_P_H
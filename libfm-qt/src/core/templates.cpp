@@ -60,7 +60,8 @@ void Templates::addTemplateDir(const char* dirPathName) {
     auto dir_path = FilePath::fromLocalPath(dirPathName);
     if (dir_path.isValid()) {
         auto folder = Folder::fromPath(dir_path);
-        if (folder->isLoaded()) {
+        // an incremental folder that is still loading already holds the batches listed so far
+        if (folder->isLoaded() || folder->isIncremental()) {
             bool typeOnce(fm_config && fm_config->template_type_once);
             const auto files = folder->files();
             for (auto& file : files) {
@@ -0,0 +1,111 @@
+/*
+ * Process-wide cache of loaded thumbnails
+ * libfm-qt/src/core/thumbnailcache.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "thumbnailcache.h"
+#include <algorithm>
+#include <iterator>
+
+namespace Fm {
+
+namespace {
+
+constexpr qint64 kDefaultMaxBytes = 128 * 1024 * 1024;
+// what an entry costs besides its pixels: the list node, the index and the path
+constexpr qint64 kEntryOverhead = 256;
+
+}  // namespace
+
+ThumbnailCache* ThumbnailCache::globalInstance_ = nullptr;
+std::mutex ThumbnailCache::globalMutex_;
+
+ThumbnailCache::ThumbnailCache() : maxBytes_{kDefaultMaxBytes}, usedBytes_{0} {}
+
+// static
+ThumbnailCache* ThumbnailCache::globalInstance() {
+    std::lock_guard<std::mutex> lock{globalMutex_};
+    if (!globalInstance_) {
+        globalInstance_ = new ThumbnailCache();
+    }
+    return globalInstance_;
+}
+
+bool ThumbnailCache::find(const FileInfo& file, int size, QImage& image) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto it = index_.find(Key{file.path(), size});
+    if (it == index_.end()) {
+        return false;
+    }
+    if (it->second->mtime != file.mtime()) {  // the file changed since
+        erase(it->second);
+        return false;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    image = it->second->image;
+    return true;
+}
+
+void ThumbnailCache::insert(const FileInfo& file, int size, const QImage& image) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    Key key{file.path(), size};
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        erase(it->second);
+    }
+    const qint64 bytes = image.sizeInBytes() + kEntryOverhead;
+    if (bytes > maxBytes_) {
+        return;
+    }
+    entries_.push_front(Entry{key, file.mtime(), image, bytes});
+    index_.emplace(std::move(key), entries_.begin());
+    usedBytes_ += bytes;
+    trim();
+}
+
+qint64 ThumbnailCache::maxBytes() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return maxBytes_;
+}
+
+void ThumbnailCache::setMaxBytes(qint64 bytes) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    maxBytes_ = std::max(bytes, qint64{0});
+    trim();
+}
+
+qint64 ThumbnailCache::usedBytes() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return usedBytes_;
+}
+
+void ThumbnailCache::erase(EntryList::iterator it) {
+    usedBytes_ -= it->bytes;
+    index_.erase(it->key);
+    entries_.erase(it);
+}
+
+void ThumbnailCache::trim() {
+    while (usedBytes_ > maxBytes_ && !entries_.empty()) {
+        erase(std::prev(entries_.end()));
+    }
+}
+
+}  // namespace Fm
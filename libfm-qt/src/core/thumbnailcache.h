@@ -0,0 +1,98 @@
+/*
+ * Process-wide cache of loaded thumbnails
+ * libfm-qt/src/core/thumbnailcache.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef FM2_THUMBNAILCACHE_H
+#define FM2_THUMBNAILCACHE_H
+
+#include "../libfmqtglobals.h"
+#include <QImage>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "filepath.h"
+#include "fileinfo.h"
+
+namespace Fm {
+
+// The thumbnails loaded in this process, shared by all folder models so that they survive the
+// models and are not loaded twice for two views of a folder. An entry is only found for the
+// modification time it was made for. The least recently used ones are dropped once the images
+// take more than the byte budget. Failures are remembered too, they cost almost nothing.
+class LIBFM_QT_API ThumbnailCache {
+   public:
+    explicit ThumbnailCache();
+
+    ThumbnailCache(const ThumbnailCache&) = delete;
+    ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+    static ThumbnailCache* globalInstance();
+
+    // Sets |image| to the thumbnail of |file| at |size|, null if it could not be made.
+    // Returns false if there is no entry for the file as it is now.
+    bool find(const FileInfo& file, int size, QImage& image);
+
+    void insert(const FileInfo& file, int size, const QImage& image);
+
+    qint64 maxBytes() const;
+
+    void setMaxBytes(qint64 bytes);
+
+    qint64 usedBytes() const;
+
+   private:
+    struct Key {
+        FilePath path;
+        int size;
+
+        bool operator==(const Key& other) const { return size == other.size && path == other.path; }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const { return key.path.hash() ^ static_cast<std::size_t>(key.size); }
+    };
+
+    struct Entry {
+        Key key;
+        quint64 mtime;
+        QImage image;
+        qint64 bytes;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void erase(EntryList::iterator it);
+    void trim();
+
+    EntryList entries_;  // the most recently used first
+    std::unordered_map<Key, EntryList::iterator, KeyHash> index_;
+    qint64 maxBytes_;
+    qint64 usedBytes_;
+    mutable std::mutex mutex_;
+
+    static ThumbnailCache* globalInstance_;
+    static std::mutex globalMutex_;
+};
+
+}  // namespace Fm
+
+#endif  // FM2_THUMBNAILCACHE_H
@@ -1,14 +1,91 @@
 #include "thumbnailer.h"
 #include "mimetype.h"
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <QDebug>
+#include <QThread>
+#include <cerrno>
+#include <csignal>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 namespace Fm {
 
+namespace {
+
+constexpr int kDefaultTimeout = 10000;  // ms
+// thumbnailers are decoders of untrusted files, and some of them start helpers of their own
+constexpr int kNiceness = 10;
+constexpr rlim_t kMaxMemory = rlim_t{2} * 1024 * 1024 * 1024;
+constexpr rlim_t kMaxCpuTime = 30;  // s, the timeout usually comes first
+// the exit of a thumbnailer is polled, first often since most are quick
+constexpr gulong kMinPollInterval = 2000;  // us
+constexpr gulong kMaxPollInterval = 50000;
+
+std::mutex processMutex;
+std::condition_variable processFinished;
+int runningProcesses = 0;
+int processLimit = std::max(QThread::idealThreadCount() / 2, 1);
+
+// Runs in the forked child before exec, so only async-signal-safe calls are allowed here.
+void limitChild(gpointer /*user_data*/) {
+    setpgid(0, 0);  // a group of its own, so that its helpers are killed with it
+    setpriority(PRIO_PROCESS, 0, kNiceness);
+#ifdef __linux__
+    // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+    syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+    struct rlimit limit;
+    limit.rlim_cur = limit.rlim_max = kMaxMemory;
+    setrlimit(RLIMIT_AS, &limit);
+    limit.rlim_cur = limit.rlim_max = kMaxCpuTime;
+    setrlimit(RLIMIT_CPU, &limit);
+    limit.rlim_cur = limit.rlim_max = 0;
+    setrlimit(RLIMIT_CORE, &limit);
+}
+
+// Holds one of the process slots; waiting for it ends on cancellation too.
+class ProcessSlot {
+   public:
+    explicit ProcessSlot(GCancellable* cancellable) : acquired_{false} {
+        std::unique_lock<std::mutex> lock{processMutex};
+        while (runningProcesses >= processLimit) {
+            if (g_cancellable_is_cancelled(cancellable)) {
+                return;
+            }
+            processFinished.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        ++runningProcesses;
+        acquired_ = true;
+    }
+
+    ~ProcessSlot() {
+        if (acquired_) {
+            std::lock_guard<std::mutex> lock{processMutex};
+            --runningProcesses;
+            processFinished.notify_one();
+        }
+    }
+
+    bool acquired() const { return acquired_; }
+
+   private:
+    bool acquired_;
+};
+
+}  // namespace
+
 std::mutex Thumbnailer::mutex_;
 std::vector<std::shared_ptr<Thumbnailer>> Thumbnailer::allThumbnailers_;
+std::atomic<int> Thumbnailer::timeout_{kDefaultTimeout};
 
 Thumbnailer::Thumbnailer(const char* id, GKeyFile* kf)
     : id_{g_strdup(id)},
@@ -73,15 +150,71 @@ CStrPtr Thumbnailer::commandForUri(const char* uri, const char* output_file, gui
     return nullptr;
 }
 
-bool Thumbnailer::run(const char* uri, const char* output_file, int size) const {
+bool Thumbnailer::run(const char* uri, const char* output_file, int size, GCancellable* cancellable) const {
     auto cmd = commandForUri(uri, output_file, size);
     if (cmd == nullptr) {
         return false;
     }
     // qDebug() << cmd.get();
-    int status;
-    bool ret = g_spawn_command_line_sync(cmd.get(), nullptr, nullptr, &status, nullptr);
-    return ret && status == 0;
+    char** argv = nullptr;
+    if (!g_shell_parse_argv(cmd.get(), nullptr, &argv, nullptr)) {
+        return false;
+    }
+    ProcessSlot slot{cancellable};
+    GPid pid;
+    bool spawned = slot.acquired() &&
+                   g_spawn_async(nullptr, argv, nullptr,
+                                 GSpawnFlags(G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                                             G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL),
+                                 limitChild, nullptr, &pid, nullptr);
+    g_strfreev(argv);
+    if (!spawned) {
+        return false;
+    }
+
+    const gint64 deadline = g_get_monotonic_time() + gint64{timeout_.load()} * 1000;
+    gulong interval = kMinPollInterval;
+    int status = 0;
+    bool exited = false;
+    for (;;) {
+        pid_t ret = waitpid(pid, &status, WNOHANG);
+        if (ret == pid) {
+            exited = true;
+            break;
+        }
+        if (ret < 0 && errno != EINTR) {
+            break;
+        }
+        if (g_get_monotonic_time() >= deadline || g_cancellable_is_cancelled(cancellable)) {
+            kill(-pid, SIGKILL);
+            kill(pid, SIGKILL);  // in case it could not get a group of its own
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            break;
+        }
+        g_usleep(interval);
+        interval = std::min(interval * 2, kMaxPollInterval);
+    }
+    g_spawn_close_pid(pid);
+    return exited && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// static
+int Thumbnailer::maxProcesses() {
+    std::lock_guard<std::mutex> lock{processMutex};
+    return processLimit;
+}
+
+// static
+void Thumbnailer::setMaxProcesses(int count) {
+    std::lock_guard<std::mutex> lock{processMutex};
+    processLimit = std::max(count, 1);
+    processFinished.notify_all();
+}
+
+// static
+void Thumbnailer::setTimeout(int msec) {
+    timeout_ = std::max(msec, 0);
 }
 
 static void find_thumbnailers_in_data_dir(std::unordered_map<std::string, const char*>& hash, const char* data_dir) {
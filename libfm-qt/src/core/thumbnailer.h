@@ -3,10 +3,12 @@
 
 #include "../libfmqtglobals.h"
 #include "cstrptr.h"
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <gio/gio.h>
 
 namespace Fm {
 
@@ -18,10 +20,21 @@ class LIBFM_QT_API Thumbnailer {
 
     CStrPtr commandForUri(const char* uri, const char* output_file, guint size) const;
 
-    bool run(const char* uri, const char* output_file, int size) const;
+    // Runs the thumbnailer in a process of low priority and limited resources, once fewer than
+    // maxProcesses() others run. It is killed, with its own children, after timeout() ms or when
+    // |cancellable| is cancelled. Returns true if it exited successfully.
+    bool run(const char* uri, const char* output_file, int size, GCancellable* cancellable = nullptr) const;
 
     static void loadAll();
 
+    static int maxProcesses();
+
+    static void setMaxProcesses(int count);
+
+    static int timeout() { return timeout_.load(); }
+
+    static void setTimeout(int msec);
+
    private:
     CStrPtr id_;
     CStrPtr try_exec_; /* FIXME: is this useful? */
@@ -30,6 +43,7 @@ class LIBFM_QT_API Thumbnailer {
 
     static std::mutex mutex_;
     static std::vector<std::shared_ptr<Thumbnailer>> allThumbnailers_;
+    static std::atomic<int> timeout_;
 };
 
 }  // namespace Fm
@@ -4,8 +4,11 @@
 #include <algorithm>
 #include <libexif/exif-loader.h>
 #include <QImageReader>
+#include <QBuffer>
 #include <QDir>
+#include <QThread>
 #include "thumbnailer.h"
+#include "thumbnailstore.h"
 
 #include <algorithm>
 
@@ -13,14 +16,88 @@
 
 namespace Fm {
 
+namespace {
+
+// Where failures of external thumbnailers are recorded, as the thumbnail specification suggests,
+// so that they are not run again for the file until it changes.
+QString failureFilename(const QString& thumbnailFilename) {
+    QString filename{QString::fromUtf8(g_get_user_cache_dir())};
+    filename += QLatin1StringView("/thumbnails/fail/libfm-qt/");
+    filename += QStringView{thumbnailFilename}.mid(thumbnailFilename.lastIndexOf(QLatin1Char('/')) + 1);
+    return filename;
+}
+
+// Shrinks |image| by an integer |factor|, each pixel being the average of a |factor| x |factor|
+// block, or of a larger one at the right and bottom edges, which take what is left over. The inner
+// loops run over the bytes of whole rows, so that compilers vectorize them.
+QImage boxShrink(const QImage& image, int factor) {
+    const QImage src = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                                     : QImage::Format_RGB32);
+    QImage dst{std::max(src.width() / factor, 1), std::max(src.height() / factor, 1), src.format()};
+    if (dst.isNull() || src.isNull()) {
+        return QImage();
+    }
+    const int rowBytes = src.width() * 4;
+    std::vector<quint32> sums(rowBytes);
+    for (int y = 0; y < dst.height(); ++y) {
+        const int top = y * factor;
+        const int bottom = y == dst.height() - 1 ? src.height() : top + factor;
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int i = top; i < bottom; ++i) {
+            const uchar* line = src.constScanLine(i);
+            for (int x = 0; x < rowBytes; ++x) {
+                sums[x] += line[x];
+            }
+        }
+        uchar* out = dst.scanLine(y);
+        for (int x = 0; x < dst.width(); ++x) {
+            const int left = x * factor;
+            const int right = x == dst.width() - 1 ? src.width() : left + factor;
+            const quint64 area = quint64(bottom - top) * (right - left);
+            quint64 pixel[4] = {0, 0, 0, 0};
+            for (int j = left * 4; j < right * 4; j += 4) {
+                for (int c = 0; c < 4; ++c) {
+                    pixel[c] += sums[j + c];
+                }
+            }
+            for (int c = 0; c < 4; ++c) {
+                out[x * 4 + c] = static_cast<uchar>((pixel[c] + area / 2) / area);
+            }
+        }
+    }
+    return dst;
+}
+
+// Scales |image| down to fit in |size| x |size|: by box filtering while it is at least twice too
+// large, which is fast and does not alias, then smoothly for the rest.
+QImage scaleDown(const QImage& image, int size) {
+    if (image.width() <= size && image.height() <= size) {
+        return image;
+    }
+    const int factor = std::max(image.width(), image.height()) / size;
+    QImage result = factor >= 2 ? boxShrink(image, factor) : image;
+    if (result.width() > size || result.height() > size) {
+        result = result.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return result;
+}
+
+}  // namespace
+
 QThreadPool* ThumbnailJob::threadPool_ = nullptr;
+QThreadPool* ThumbnailJob::externalThreadPool_ = nullptr;
 
 bool ThumbnailJob::localFilesOnly_ = true;
 int ThumbnailJob::maxThumbnailFileSize_ = 4096;  // in KiB
 int ThumbnailJob::maxExternalThumbnailFileSize_ = -1;
+bool ThumbnailJob::packedStoreEnabled_ = false;
 
 ThumbnailJob::ThumbnailJob(FileInfoList files, int size, bool isRemote)
-    : files_{std::move(files)}, size_{size}, isRemote_{isRemote}, md5Calc_{g_checksum_new(G_CHECKSUM_MD5)} {}
+    : files_{std::move(files)},
+      size_{size},
+      isRemote_{isRemote},
+      externalDeferred_{false},
+      md5Calc_{g_checksum_new(G_CHECKSUM_MD5)} {}
 
 ThumbnailJob::~ThumbnailJob() {
     g_checksum_free(md5Calc_);
@@ -33,12 +110,15 @@ void ThumbnailJob::exec() {
             break;
         }
         auto image = loadForFile(file);
+        if (!deferredFiles_.empty() && deferredFiles_.back() == file) {
+            continue;
+        }
         Q_EMIT thumbnailLoaded(file, size_, image);
         results_.emplace_back(std::move(image));
     }
 }
 
-QImage ThumbnailJob::readImageFromStream(GInputStream* stream, size_t len) {
+QImage ThumbnailJob::readImageFromStream(GInputStream* stream, size_t len, int targetSize) {
     // The size limit has been set in generateThumbnail().
     std::unique_ptr<unsigned char[]> buffer{new unsigned char[len]};  // allocate enough buffer
     unsigned char* pbuffer = buffer.get();
@@ -55,8 +135,18 @@ QImage ThumbnailJob::readImageFromStream(GInputStream* stream, size_t len) {
         totalReadSize += readSize;
         pbuffer += readSize;
     }
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(buffer.get()), totalReadSize);
+    QBuffer device{&data};
+    QImageReader reader{&device};
+    // Decoders that support it produce a smaller image directly, JPEG by scaling the DCT: a 50
+    // megapixel photo then never takes 200 MB of pixels.
+    const QSize fullSize = reader.size();
+    if (fullSize.isValid() && (fullSize.width() > targetSize || fullSize.height() > targetSize) &&
+        reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(fullSize.scaled(targetSize, targetSize, Qt::KeepAspectRatio));
+    }
     QImage image;
-    image.loadFromData(buffer.get(), totalReadSize);
+    reader.read(&image);
     return image;
 }
 
@@ -111,6 +201,9 @@ QImage ThumbnailJob::loadForFile(const std::shared_ptr<const FileInfo>& file) {
     g_checksum_update(md5Calc_, reinterpret_cast<const unsigned char*>(uri.get()), -1);
     memcpy(thumbnailName, g_checksum_get_string(md5Calc_), 32);
     memcpy(thumbnailName + 32, ".png", 5);
+    ThumbnailStore::Digest digest;
+    gsize digestLength = digest.size();
+    g_checksum_get_digest(md5Calc_, digest.data(), &digestLength);
     g_checksum_reset(md5Calc_);  // reset the checksum calculator for next use
 
     QString thumbnailFilename = thumbnailDir;
@@ -118,15 +211,23 @@ QImage ThumbnailJob::loadForFile(const std::shared_ptr<const FileInfo>& file) {
     thumbnailFilename += QString::fromUtf8(thumbnailName);
     // qDebug() << "thumbnail:" << file->getName().c_str() << thumbnailFilename;
 
-    // try to load the thumbnail file if it exists
-    QImage thumbnail{thumbnailFilename};
-    if (thumbnail.isNull() || isThumbnailOutdated(file, thumbnail)) {
-        // the existing thumbnail cannot be loaded, generate a new one
+    QImage thumbnail;
+    ThumbnailStore* store = packedStoreEnabled_ ? ThumbnailStore::forName(subdir.latin1()) : nullptr;
+    if (!store || !store->find(digest, file->mtime(), thumbnail)) {
+        // try to load the thumbnail file if it exists
+        thumbnail = QImage{thumbnailFilename};
+        if (thumbnail.isNull() || isThumbnailOutdated(file, thumbnail)) {
+            // the existing thumbnail cannot be loaded, generate a new one
 
-        // create the thumbnail dir as needd (FIXME: Qt file I/O is slow)
-        QDir().mkpath(thumbnailDir);
+            // create the thumbnail dir as needd (FIXME: Qt file I/O is slow)
+            QDir().mkpath(thumbnailDir);
 
-        thumbnail = generateThumbnail(file, origPath, uri.get(), thumbnailFilename);
+            thumbnail = generateThumbnail(file, origPath, uri.get(), thumbnailFilename);
+        }
+        // the PNG file stays the reference for other applications, the store is written through
+        if (store && !thumbnail.isNull()) {
+            store->insert(digest, file->mtime(), uri.get(), thumbnail);
+        }
     }
     // resize to the size we need
     if (thumbnail.width() > size_ || thumbnail.height() > size_) {
@@ -135,7 +236,8 @@ QImage ThumbnailJob::loadForFile(const std::shared_ptr<const FileInfo>& file) {
     return thumbnail;
 }
 
-bool ThumbnailJob::isSupportedImageType(const std::shared_ptr<const MimeType>& mimeType) const {
+// static
+bool ThumbnailJob::isSupportedImageType(const std::shared_ptr<const MimeType>& mimeType) {
     if (mimeType->isImage()) {
         auto supportedTypes = QImageReader::supportedMimeTypes();
         auto found = std::find(supportedTypes.cbegin(), supportedTypes.cend(), mimeType->name());
@@ -225,29 +327,30 @@ QImage ThumbnailJob::generateThumbnail(const std::shared_ptr<const FileInfo>& fi
         if (!ins) {
             return result;
         }
+        const int target_size = size_ > 256 ? 512 : size_ > 128 ? 256 : 128;
         bool fromExif = false;
         QTransform matrix;
         if (strcmp(mime_type->name(), "image/jpeg") == 0) {  // if this is a jpeg file
-            // try to get the thumbnail embedded in EXIF data
-            if (readJpegExif(G_INPUT_STREAM(ins.get()), result, matrix)) {
+            // try to get the thumbnail embedded in EXIF data, usually 160x120: it is used if it is not
+            // smaller than the thumbnail, which in practice means only for normal (128) thumbnails
+            if (readJpegExif(G_INPUT_STREAM(ins.get()), result, matrix) &&
+                std::max(result.width(), result.height()) >= target_size) {
                 fromExif = true;
             }
+            else {
+                result = QImage();
+            }
         }
         if (!fromExif) {  // not able to generate a thumbnail from the EXIF data
-            // load the original file and do the scaling ourselves
+            // load the original file, at a reduced size if its format allows that
             g_seekable_seek(G_SEEKABLE(ins.get()), 0, G_SEEK_SET, cancellable_.get(), nullptr);
-            result = readImageFromStream(G_INPUT_STREAM(ins.get()), file->size());
+            result = readImageFromStream(G_INPUT_STREAM(ins.get()), file->size(), target_size);
         }
         g_input_stream_close(G_INPUT_STREAM(ins.get()), nullptr, nullptr);
 
         if (!result.isNull()) {  // the image is successfully loaded
-            // scale the image as needed
-            int target_size = size_ > 256 ? 512 : size_ > 128 ? 256 : 128;
-
             // only scale the original image if it's too large
-            if (result.width() > target_size || result.height() > target_size) {
-                result = result.scaled(target_size, target_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            }
+            result = scaleDown(result, target_size);
 
             if (!matrix.isIdentity()) {  // transform the image if needed
                 result = result.transformed(matrix);
@@ -264,20 +367,42 @@ QImage ThumbnailJob::generateThumbnail(const std::shared_ptr<const FileInfo>& fi
         }
     }
     else {  // the image format is not supported, try to find an external thumbnailer
+        if (externalDeferred_) {
+            deferredFiles_.push_back(file);
+            return result;
+        }
         if (maxExternalThumbnailFileSize_ >= 0 &&
             file->size() > static_cast<uint64_t>(maxExternalThumbnailFileSize_) * 1024) {
             return result;
         }
+        const QString failedFilename = failureFilename(thumbnailFilename);
+        QImage failed{failedFilename};
+        if (!failed.isNull() && !isThumbnailOutdated(file, failed)) {
+            return result;
+        }
         // try all available external thumbnailers for it until success
         int target_size = size_ > 256 ? 512 : size_ > 128 ? 256 : 128;
+        bool hasThumbnailer = false;
         file->mimeType()->forEachThumbnailer([&](const std::shared_ptr<const Thumbnailer>& thumbnailer) {
-            if (thumbnailer->run(uri, thumbnailFilename.toLocal8Bit().constData(), target_size)) {
+            hasThumbnailer = true;
+            if (thumbnailer->run(uri, thumbnailFilename.toLocal8Bit().constData(), target_size,
+                                 cancellable().get())) {
                 result = QImage(thumbnailFilename);
             }
-            return !result.isNull();  // return true on success, and forEachThumbnailer() will stop.
+            return !result.isNull() || isCancelled();  // return true on success, and forEachThumbnailer() will stop.
         });
 
-        if (!result.isNull()) {
+        if (result.isNull()) {
+            if (hasThumbnailer && !isCancelled()) {
+                failed = QImage{1, 1, QImage::Format_ARGB32};
+                failed.fill(Qt::transparent);
+                failed.setText(QStringLiteral("Thumb::MTime"), QString::number(file->mtime()));
+                failed.setText(QStringLiteral("Thumb::URI"), QString::fromUtf8(uri));
+                QDir().mkpath(failedFilename.left(failedFilename.lastIndexOf(QLatin1Char('/'))));
+                failed.save(failedFilename, "PNG");
+            }
+        }
+        else {
             // Some thumbnailers did not write the proper metadata required by the xdg spec to the output (such as
             // evince-thumbnailer) Here we waste some time to fix them so next time we don't need to re-generate these
             // thumbnails. :-(
@@ -301,12 +426,27 @@ QImage ThumbnailJob::generateThumbnail(const std::shared_ptr<const FileInfo>& fi
 
 QThreadPool* ThumbnailJob::threadPool() {
     if (Q_UNLIKELY(threadPool_ == nullptr)) {
+        // decoding is bound by the CPU, so one thread per core
         threadPool_ = new QThreadPool();
-        threadPool_->setMaxThreadCount(1);
+        threadPool_->setMaxThreadCount(std::max(QThread::idealThreadCount(), 1));
     }
     return threadPool_;
 }
 
+QThreadPool* ThumbnailJob::externalThreadPool() {
+    if (Q_UNLIKELY(externalThreadPool_ == nullptr)) {
+        externalThreadPool_ = new QThreadPool();
+    }
+    externalThreadPool_->setMaxThreadCount(Thumbnailer::maxProcesses());
+    return externalThreadPool_;
+}
+
+// static
+bool ThumbnailJob::usesExternalThumbnailer(const FileInfo& file) {
+    // the type is not looked up here if it is not known yet, it may need I/O
+    return file.typeResolved() && file.canThumbnail() && !isSupportedImageType(file.mimeType());
+}
+
 void ThumbnailJob::setLocalFilesOnly(bool value) {
     localFilesOnly_ = value;
     if (fm_config) {
@@ -18,8 +18,23 @@ class LIBFM_QT_API ThumbnailJob : public Job {
 
     int size() const { return size_; }
 
+    // Decodes images in process, with a thread per core.
     static QThreadPool* threadPool();
 
+    // Waits for external thumbnailers, which may take long, so that images are decoded meanwhile.
+    // It has as many threads as Thumbnailer::maxProcesses().
+    static QThreadPool* externalThreadPool();
+
+    // True if the thumbnail of |file| is made by an external thumbnailer rather than decoded here.
+    // Files whose type is not resolved yet count as images, see setExternalDeferred().
+    static bool usesExternalThumbnailer(const FileInfo& file);
+
+    // Files that turn out to need an external thumbnailer are not thumbnailed by this job, so that
+    // it does not wait for one; they are left in deferredFiles() for a job on externalThreadPool().
+    void setExternalDeferred(bool value) { externalDeferred_ = value; }
+
+    const FileInfoList& deferredFiles() const { return deferredFiles_; }
+
     static void setLocalFilesOnly(bool value);
 
     static bool localFilesOnly() { return localFilesOnly_; }
@@ -32,6 +47,11 @@ class LIBFM_QT_API ThumbnailJob : public Job {
 
     static void setMaxExternalThumbnailFileSize(int size);
 
+    // Also keeps the thumbnails in a ThumbnailStore, which is looked up before the PNG files.
+    static bool packedStoreEnabled() { return packedStoreEnabled_; }
+
+    static void setPackedStoreEnabled(bool value) { packedStoreEnabled_ = value; }
+
     const std::vector<QImage>& results() const { return results_; }
 
    Q_SIGNALS:
@@ -41,7 +61,7 @@ class LIBFM_QT_API ThumbnailJob : public Job {
     void exec() override;
 
    private:
-    bool isSupportedImageType(const std::shared_ptr<const MimeType>& mimeType) const;
+    static bool isSupportedImageType(const std::shared_ptr<const MimeType>& mimeType);
 
     bool isThumbnailOutdated(const std::shared_ptr<const FileInfo>& file, const QImage& thumbnail) const;
 
@@ -50,7 +70,7 @@ class LIBFM_QT_API ThumbnailJob : public Job {
                              const char* uri,
                              const QString& thumbnailFilename);
 
-    QImage readImageFromStream(GInputStream* stream, size_t len);
+    QImage readImageFromStream(GInputStream* stream, size_t len, int targetSize);
 
     QImage loadForFile(const std::shared_ptr<const FileInfo>& file);
 
@@ -61,14 +81,18 @@ class LIBFM_QT_API ThumbnailJob : public Job {
     int size_;
     bool isRemote_;
     std::vector<QImage> results_;
+    bool externalDeferred_;
+    FileInfoList deferredFiles_;
     GCancellablePtr cancellable_;
     GChecksum* md5Calc_;
 
     static QThreadPool* threadPool_;
+    static QThreadPool* externalThreadPool_;
 
     static bool localFilesOnly_;
     static int maxThumbnailFileSize_;
     static int maxExternalThumbnailFileSize_;
+    static bool packedStoreEnabled_;
 };
 
 }  // namespace Fm
@@ -0,0 +1,666 @@
+/*
+ * Packed thumbnail store
+ * libfm-qt/src/core/thumbnailstore.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "thumbnailstore.h"
+#include "cstrptr.h"
+#include <QByteArray>
+#include <QFile>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <glib.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Fm {
+
+struct ThumbnailStore::IndexHeader {
+    char magic[8];
+    quint32 capacity;  // slots, a power of two
+    quint32 count;     // slots in use
+    quint64 liveBytes;  // of the records the slots point to, the rest of the data file is garbage
+    quint32 retired;    // set once a compaction replaced the files
+    quint32 reserved[9];
+};
+
+struct ThumbnailStore::Slot {
+    unsigned char digest[16];
+    quint64 mtime;
+    quint64 offset;  // of the record in the data file plus one, zero for a free slot
+    quint32 size;
+    quint32 reserved;
+};
+
+namespace {
+
+constexpr char kIndexMagic[8] = {'F', 'M', 'Q', 'T', 'T', 'H', 'I', '1'};
+constexpr quint32 kRecordMagic = 0x31524854;  // "THR1"
+constexpr quint32 kMinCapacity = 4096;
+// compaction is not worth it for less garbage than this
+constexpr qint64 kMinCompactBytes = 16 * 1024 * 1024;
+constexpr qint64 kMaxDataBytes = qint64{1024} * 1024 * 1024;
+// a compaction of a full store drops the oldest thumbnails down to this, so that the next one is far
+constexpr qint64 kMaxKeptBytes = kMaxDataBytes / 2;
+constexpr int kMaxDimension = 1024;
+
+// precedes the URI and the QOI chunks of a thumbnail in the data file
+struct RecordHeader {
+    quint32 magic;
+    quint32 payloadSize;
+    unsigned char digest[16];
+    quint64 mtime;
+    quint16 width;
+    quint16 height;
+    quint16 uriLength;
+    quint8 channels;  // 3 or 4, as in QOI
+    quint8 reserved;
+};
+
+constexpr quint32 kMaxRecordSize = sizeof(RecordHeader) + 0xffff + kMaxDimension * kMaxDimension * 5 + 8;
+
+int openFile(const QString& dirPath, const char* name, int flags) {
+    const QByteArray path = QFile::encodeName(dirPath) + '/' + name;
+    return ::open(path.constData(), flags | O_CLOEXEC, 0600);
+}
+
+void removeFile(const QString& dirPath, const char* name) {
+    const QByteArray path = QFile::encodeName(dirPath) + '/' + name;
+    ::unlink(path.constData());
+}
+
+bool renameFile(const QString& dirPath, const char* from, const char* to) {
+    const QByteArray dir = QFile::encodeName(dirPath);
+    return ::rename((dir + '/' + from).constData(), (dir + '/' + to).constData()) == 0;
+}
+
+qint64 fileSize(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 ? st.st_size : -1;
+}
+
+bool readFully(int fd, void* buffer, std::size_t size, qint64 offset) {
+    auto p = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool writeFully(int fd, const void* buffer, std::size_t size, qint64 offset) {
+    auto p = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// Reads the record of |size| bytes at |offset| into |record| and |rest|, the URI then the
+// payload. False if it is not a valid record for |digest|, e.g., after a crash while writing.
+bool readRecord(int fd, quint64 offset, quint32 size, const unsigned char* digest, RecordHeader& record,
+                QByteArray& rest) {
+    if (size < sizeof(RecordHeader) || size > kMaxRecordSize || !readFully(fd, &record, sizeof(record), offset)) {
+        return false;
+    }
+    if (record.magic != kRecordMagic || memcmp(record.digest, digest, sizeof(record.digest)) != 0 ||
+        sizeof(RecordHeader) + record.uriLength + record.payloadSize != size) {
+        return false;
+    }
+    rest.resize(size - sizeof(RecordHeader));
+    return readFully(fd, rest.data(), rest.size(), offset + sizeof(RecordHeader));
+}
+
+// True unless |filename| is gone or changed since its thumbnail was made.
+bool isSourceCurrent(const char* filename, quint64 mtime) {
+    struct stat st;
+    return stat(filename, &st) == 0 && static_cast<quint64>(st.st_mtime) == mtime;
+}
+
+// The QOI format (https://qoiformat.org), without its header that the record replaces. It
+// compresses thumbnails about as well as PNG and decodes several times faster.
+
+inline int qoiHash(QRgb px) {
+    return (qRed(px) * 3 + qGreen(px) * 5 + qBlue(px) * 7 + qAlpha(px) * 11) % 64;
+}
+
+inline QRgb qoiPixel(int r, int g, int b, int a) {
+    return qRgba(r & 0xff, g & 0xff, b & 0xff, a & 0xff);
+}
+
+QByteArray encodeQoi(const QImage& image, quint8& channels) {
+    channels = image.hasAlphaChannel() ? 4 : 3;
+    const QImage src = image.convertToFormat(channels == 4 ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    const qsizetype pixelCount = qsizetype{src.width()} * src.height();
+    QByteArray bytes{pixelCount * 5 + 8, Qt::Uninitialized};  // the worst case
+    auto out = reinterpret_cast<uchar*>(bytes.data());
+    QRgb index[64] = {};
+    QRgb prev = qRgba(0, 0, 0, 255);
+    int run = 0;
+    qsizetype pos = 0;
+    for (int y = 0; y < src.height(); ++y) {
+        auto line = reinterpret_cast<const QRgb*>(src.constScanLine(y));
+        for (int x = 0; x < src.width(); ++x, ++pos) {
+            const QRgb px = line[x];
+            if (px == prev) {
+                if (++run == 62 || pos == pixelCount - 1) {
+                    *out++ = 0xc0 | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                *out++ = 0xc0 | (run - 1);
+                run = 0;
+            }
+            const int hash = qoiHash(px);
+            if (index[hash] == px) {
+                *out++ = hash;
+            }
+            else {
+                index[hash] = px;
+                if (qAlpha(px) == qAlpha(prev)) {
+                    const auto vr = static_cast<signed char>(qRed(px) - qRed(prev));
+                    const auto vg = static_cast<signed char>(qGreen(px) - qGreen(prev));
+                    const auto vb = static_cast<signed char>(qBlue(px) - qBlue(prev));
+                    const auto vgR = static_cast<signed char>(vr - vg);
+                    const auto vgB = static_cast<signed char>(vb - vg);
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        *out++ = 0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                    }
+                    else if (vgR > -9 && vgR < 8 && vg > -33 && vg < 32 && vgB > -9 && vgB < 8) {
+                        *out++ = 0x80 | (vg + 32);
+                        *out++ = (vgR + 8) << 4 | (vgB + 8);
+                    }
+                    else {
+                        *out++ = 0xfe;
+                        *out++ = qRed(px);
+                        *out++ = qGreen(px);
+                        *out++ = qBlue(px);
+                    }
+                }
+                else {
+                    *out++ = 0xff;
+                    *out++ = qRed(px);
+                    *out++ = qGreen(px);
+                    *out++ = qBlue(px);
+                    *out++ = qAlpha(px);
+                }
+            }
+            prev = px;
+        }
+    }
+    static const uchar endMarker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    out = std::copy(std::begin(endMarker), std::end(endMarker), out);
+    bytes.truncate(out - reinterpret_cast<uchar*>(bytes.data()));
+    return bytes;
+}
+
+QImage decodeQoi(const uchar* data, qsizetype size, int width, int height, int channels) {
+    // nothing larger is stored, so a larger size comes from a damaged record
+    if (width <= 0 || height <= 0 || width > kMaxDimension || height > kMaxDimension ||
+        (channels != 3 && channels != 4)) {
+        return QImage();
+    }
+    QImage image{width, height, channels == 4 ? QImage::Format_ARGB32 : QImage::Format_RGB32};
+    const qsizetype chunksEnd = size - 8;
+    if (image.isNull() || chunksEnd < 0) {
+        return QImage();
+    }
+    QRgb index[64] = {};
+    QRgb px = qRgba(0, 0, 0, 255);
+    int run = 0;
+    qsizetype p = 0;
+    for (int y = 0; y < height; ++y) {
+        auto line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            if (run > 0) {
+                --run;
+            }
+            else if (p < chunksEnd) {
+                const uchar b1 = data[p++];
+                if (b1 == 0xfe) {
+                    if (chunksEnd - p < 3) {
+                        return QImage();
+                    }
+                    px = qRgba(data[p], data[p + 1], data[p + 2], qAlpha(px));
+                    p += 3;
+                }
+                else if (b1 == 0xff) {
+                    if (chunksEnd - p < 4) {
+                        return QImage();
+                    }
+                    px = qRgba(data[p], data[p + 1], data[p + 2], data[p + 3]);
+                    p += 4;
+                }
+                else if ((b1 & 0xc0) == 0x00) {
+                    px = index[b1];
+                }
+                else if ((b1 & 0xc0) == 0x40) {
+                    px = qoiPixel(qRed(px) + ((b1 >> 4) & 0x03) - 2, qGreen(px) + ((b1 >> 2) & 0x03) - 2,
+                                  qBlue(px) + (b1 & 0x03) - 2, qAlpha(px));
+                }
+                else if ((b1 & 0xc0) == 0x80) {
+                    if (p >= chunksEnd) {
+                        return QImage();
+                    }
+                    const uchar b2 = data[p++];
+                    const int vg = (b1 & 0x3f) - 32;
+                    px = qoiPixel(qRed(px) + vg - 8 + ((b2 >> 4) & 0x0f), qGreen(px) + vg,
+                                  qBlue(px) + vg - 8 + (b2 & 0x0f), qAlpha(px));
+                }
+                else {
+                    run = b1 & 0x3f;
+                }
+                index[qoiHash(px)] = px;
+            }
+            else {
+                return QImage();  // truncated
+            }
+            line[x] = px;
+        }
+    }
+    return image;
+}
+
+}  // namespace
+
+ThumbnailStore::ThumbnailStore(const QString& dirPath)
+    : dirPath_{dirPath}, lockFd_{-1}, dataFd_{-1}, indexFd_{-1}, index_{nullptr}, indexSize_{0} {
+    if (g_mkdir_with_parents(QFile::encodeName(dirPath_).constData(), 0700) == 0) {
+        lockFd_ = openFile(dirPath_, "lock", O_RDWR | O_CREAT);
+    }
+    if (lock()) {
+        unlock();
+    }
+}
+
+ThumbnailStore::~ThumbnailStore() {
+    close();
+    if (lockFd_ >= 0) {
+        ::close(lockFd_);
+    }
+}
+
+// static
+ThumbnailStore* ThumbnailStore::forName(const char* name) {
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<ThumbnailStore>> stores;
+    std::lock_guard<std::mutex> lock{mutex};
+    auto& store = stores[name];
+    if (!store) {
+        QString dirPath = QString::fromUtf8(g_get_user_cache_dir());
+        dirPath += QLatin1StringView("/libfm-qt/thumbnails/");
+        dirPath += QString::fromUtf8(name);
+        store = std::make_unique<ThumbnailStore>(dirPath);
+    }
+    return store.get();
+}
+
+ThumbnailStore::IndexHeader* ThumbnailStore::header() const {
+    return reinterpret_cast<IndexHeader*>(index_);
+}
+
+ThumbnailStore::Slot* ThumbnailStore::slotTable() const {
+    return reinterpret_cast<Slot*>(index_ + sizeof(IndexHeader));
+}
+
+bool ThumbnailStore::open() {
+    dataFd_ = openFile(dirPath_, "data", O_RDWR | O_CREAT);
+    indexFd_ = openFile(dirPath_, "index", O_RDWR | O_CREAT);
+    if (dataFd_ < 0 || indexFd_ < 0) {
+        close();
+        return false;
+    }
+    IndexHeader header{};
+    const qint64 size = fileSize(indexFd_);
+    bool valid = size >= static_cast<qint64>(sizeof(header)) && readFully(indexFd_, &header, sizeof(header), 0) &&
+                 memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) == 0 && header.capacity >= kMinCapacity &&
+                 (header.capacity & (header.capacity - 1)) == 0 && !header.retired &&
+                 size == static_cast<qint64>(sizeof(IndexHeader) + header.capacity * sizeof(Slot));
+    if (!valid) {
+        // a new store, or one of another version: start over
+        header = IndexHeader{};
+        memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+        header.capacity = kMinCapacity;
+        if (ftruncate(dataFd_, 0) != 0 || ftruncate(indexFd_, 0) != 0 ||
+            ftruncate(indexFd_, sizeof(IndexHeader) + header.capacity * sizeof(Slot)) != 0 ||
+            !writeFully(indexFd_, &header, sizeof(header), 0)) {
+            close();
+            return false;
+        }
+    }
+    indexSize_ = sizeof(IndexHeader) + header.capacity * sizeof(Slot);
+    void* map = mmap(nullptr, indexSize_, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd_, 0);
+    if (map == MAP_FAILED) {
+        close();
+        return false;
+    }
+    index_ = static_cast<unsigned char*>(map);
+    return true;
+}
+
+void ThumbnailStore::close() {
+    if (index_) {
+        munmap(index_, indexSize_);
+        index_ = nullptr;
+    }
+    if (dataFd_ >= 0) {
+        ::close(dataFd_);
+        dataFd_ = -1;
+    }
+    if (indexFd_ >= 0) {
+        ::close(indexFd_);
+        indexFd_ = -1;
+    }
+}
+
+// Takes the lock shared with other processes, and opens the store again if one of them compacted it.
+bool ThumbnailStore::lock() {
+    if (lockFd_ < 0) {
+        return false;
+    }
+    int ret;
+    while ((ret = flock(lockFd_, LOCK_EX)) != 0 && errno == EINTR) {
+    }
+    if (ret != 0) {
+        return false;
+    }
+    if (index_ && header()->retired) {
+        close();
+    }
+    if (!index_ && !open()) {
+        unlock();
+        return false;
+    }
+    return true;
+}
+
+void ThumbnailStore::unlock() {
+    flock(lockFd_, LOCK_UN);
+}
+
+// The slot of |digest|, or the free slot where it goes.
+ThumbnailStore::Slot* ThumbnailStore::findSlot(const Digest& digest) const {
+    const quint32 capacity = header()->capacity;
+    quint64 hash;
+    memcpy(&hash, digest.data(), sizeof(hash));
+    for (quint32 n = 0, i = hash & (capacity - 1); n < capacity; ++n, i = (i + 1) & (capacity - 1)) {
+        Slot* slot = slotTable() + i;
+        if (slot->offset == 0 || memcmp(slot->digest, digest.data(), sizeof(slot->digest)) == 0) {
+            return slot;
+        }
+    }
+    return nullptr;  // only if the index is damaged
+}
+
+bool ThumbnailStore::find(const Digest& digest, quint64 mtime, QImage& image) {
+    RecordHeader record;
+    QByteArray rest;
+    {
+        std::lock_guard<std::mutex> guard{mutex_};
+        if (!lock()) {
+            return false;
+        }
+        const Slot* slot = findSlot(digest);
+        const bool found = slot && slot->offset != 0 && slot->mtime == mtime &&
+                           readRecord(dataFd_, slot->offset - 1, slot->size, digest.data(), record, rest) &&
+                           record.mtime == mtime;
+        unlock();
+        if (!found) {
+            return false;
+        }
+    }
+    image = decodeQoi(reinterpret_cast<const uchar*>(rest.constData()) + record.uriLength, record.payloadSize,
+                      record.width, record.height, record.channels);
+    return !image.isNull();
+}
+
+void ThumbnailStore::insert(const Digest& digest, quint64 mtime, const char* uri, const QImage& image) {
+    const std::size_t uriLength = strlen(uri);
+    if (image.isNull() || image.width() > kMaxDimension || image.height() > kMaxDimension || uriLength > 0xffff) {
+        return;
+    }
+    RecordHeader record{};
+    const QByteArray payload = encodeQoi(image, record.channels);
+    record.magic = kRecordMagic;
+    record.payloadSize = payload.size();
+    memcpy(record.digest, digest.data(), sizeof(record.digest));
+    record.mtime = mtime;
+    record.width = image.width();
+    record.height = image.height();
+    record.uriLength = uriLength;
+    const quint32 size = sizeof(record) + uriLength + payload.size();
+
+    std::unique_lock<std::mutex> guard{mutex_};
+    if (!lock()) {
+        return;
+    }
+    if (needsCompaction(digest, size)) {
+        // the sources are checked without holding the store, then it is compacted if that is still needed
+        const auto sources = localSources();
+        unlock();
+        guard.unlock();
+        const auto stale = staleSources(sources);
+        guard.lock();
+        if (!lock()) {
+            return;
+        }
+        if (needsCompaction(digest, size) && !compactLocked(header()->count + 1, stale)) {
+            unlock();
+            return;
+        }
+    }
+    Slot* slot = findSlot(digest);
+    const qint64 end = fileSize(dataFd_);
+    // the record is complete before a slot points to it, so a crash leaves garbage at worst
+    if (slot && end >= 0 && end + size <= kMaxDataBytes && writeFully(dataFd_, &record, sizeof(record), end) &&
+        writeFully(dataFd_, uri, uriLength, end + sizeof(record)) &&
+        writeFully(dataFd_, payload.constData(), payload.size(), end + sizeof(record) + uriLength)) {
+        IndexHeader* index = header();
+        if (slot->offset != 0) {
+            index->liveBytes -= slot->size;
+        }
+        else {
+            memcpy(slot->digest, digest.data(), sizeof(slot->digest));
+            ++index->count;
+        }
+        slot->mtime = mtime;
+        slot->size = size;
+        slot->offset = end + 1;
+        index->liveBytes += size;
+    }
+    unlock();
+}
+
+void ThumbnailStore::compact() {
+    std::unique_lock<std::mutex> guard{mutex_};
+    if (!lock()) {
+        return;
+    }
+    const auto sources = localSources();
+    unlock();
+    guard.unlock();
+    const auto stale = staleSources(sources);
+    guard.lock();
+    if (lock()) {
+        compactLocked(0, stale);
+        unlock();
+    }
+}
+
+// True if |size| more bytes for |digest| do not fit, or most of the data file is garbage.
+bool ThumbnailStore::needsCompaction(const Digest& digest, quint32 size) const {
+    const Slot* slot = findSlot(digest);
+    const qint64 end = fileSize(dataFd_);
+    const bool isNew = !slot || slot->offset == 0;
+    const qint64 garbage = end - static_cast<qint64>(header()->liveBytes);
+    return (isNew && header()->count + 1 > header()->capacity / 4 * 3) || (end > kMinCompactBytes && garbage > end / 2) ||
+           end + size > kMaxDataBytes;
+}
+
+// The local files that the stored thumbnails were made of. Only the record headers and URIs are read.
+std::vector<ThumbnailStore::Source> ThumbnailStore::localSources() const {
+    std::vector<Source> sources;
+    RecordHeader record;
+    std::string uri;
+    for (quint32 i = 0; i < header()->capacity; ++i) {
+        const Slot& slot = slotTable()[i];
+        if (slot.offset == 0 || !readFully(dataFd_, &record, sizeof(record), slot.offset - 1) ||
+            record.magic != kRecordMagic || sizeof(RecordHeader) + record.uriLength > slot.size) {
+            continue;
+        }
+        uri.resize(record.uriLength);
+        if (!readFully(dataFd_, &uri[0], uri.size(), slot.offset - 1 + sizeof(record))) {
+            continue;
+        }
+        CStrPtr filename{g_filename_from_uri(uri.c_str(), nullptr, nullptr)};
+        if (filename) {
+            Source source;
+            memcpy(source.digest.data(), slot.digest, source.digest.size());
+            source.mtime = slot.mtime;
+            source.filename = filename.get();
+            sources.push_back(std::move(source));
+        }
+    }
+    return sources;
+}
+
+// static
+std::map<ThumbnailStore::Digest, quint64> ThumbnailStore::staleSources(const std::vector<Source>& sources) {
+    std::map<Digest, quint64> stale;
+    for (const auto& source : sources) {
+        if (!isSourceCurrent(source.filename.c_str(), source.mtime)) {
+            stale.emplace(source.digest, source.mtime);
+        }
+    }
+    return stale;
+}
+
+// Copies the records still in use to new files, which then replace the store, and retires the old index.
+// Those in |stale| for the same mtime are dropped, and the oldest ones if they do not fit.
+bool ThumbnailStore::compactLocked(std::size_t minCount, const std::map<Digest, quint64>& stale) {
+    std::vector<const Slot*> kept;
+    for (quint32 i = 0; i < header()->capacity; ++i) {
+        const Slot& slot = slotTable()[i];
+        if (slot.offset == 0) {
+            continue;
+        }
+        Digest digest;
+        memcpy(digest.data(), slot.digest, digest.size());
+        auto it = stale.find(digest);
+        if (it == stale.end() || it->second != slot.mtime) {
+            kept.push_back(&slot);
+        }
+    }
+    // in the order they were written, so that the newest are kept and stay last
+    std::sort(kept.begin(), kept.end(), [](const Slot* a, const Slot* b) { return a->offset < b->offset; });
+    qint64 keptBytes = 0;
+    auto first = kept.end();
+    while (first != kept.begin() && keptBytes + (*(first - 1))->size <= kMaxKeptBytes) {
+        --first;
+        keptBytes += (*first)->size;
+    }
+    kept.erase(kept.begin(), first);
+
+    // the live records take at most a third of the new table
+    quint32 capacity = kMinCapacity;
+    while (capacity / 3 < std::max<std::size_t>(kept.size(), minCount)) {
+        capacity *= 2;
+    }
+    IndexHeader newHeader{};
+    memcpy(newHeader.magic, kIndexMagic, sizeof(kIndexMagic));
+    newHeader.capacity = capacity;
+    std::vector<Slot> newSlots(capacity);
+
+    const int newData = openFile(dirPath_, "data.new", O_RDWR | O_CREAT | O_TRUNC);
+    const int newIndex = openFile(dirPath_, "index.new", O_RDWR | O_CREAT | O_TRUNC);
+    bool ok = newData >= 0 && newIndex >= 0;
+    qint64 end = 0;
+    RecordHeader record;
+    QByteArray rest;
+    for (auto it = kept.cbegin(); ok && it != kept.cend(); ++it) {
+        const Slot& slot = **it;
+        if (!readRecord(dataFd_, slot.offset - 1, slot.size, slot.digest, record, rest)) {
+            continue;
+        }
+        ok = writeFully(newData, &record, sizeof(record), end) &&
+             writeFully(newData, rest.constData(), rest.size(), end + sizeof(record));
+        quint64 hash;
+        memcpy(&hash, slot.digest, sizeof(hash));
+        quint32 j = hash & (capacity - 1);
+        while (newSlots[j].offset != 0) {
+            j = (j + 1) & (capacity - 1);
+        }
+        newSlots[j] = slot;
+        newSlots[j].offset = end + 1;
+        end += slot.size;
+        ++newHeader.count;
+        newHeader.liveBytes += slot.size;
+    }
+    ok = ok && writeFully(newIndex, &newHeader, sizeof(newHeader), 0) &&
+         writeFully(newIndex, newSlots.data(), newSlots.size() * sizeof(Slot), sizeof(newHeader));
+    if (newData >= 0) {
+        ::close(newData);
+    }
+    if (newIndex >= 0) {
+        ::close(newIndex);
+    }
+    // the new data with the old index, after a crash or a failure between the renames, is only
+    // missing thumbnails: the records that slots point to are checked
+    const bool dataReplaced = ok && renameFile(dirPath_, "data.new", "data");
+    if (!dataReplaced || !renameFile(dirPath_, "index.new", "index")) {
+        removeFile(dirPath_, "data.new");
+        removeFile(dirPath_, "index.new");
+        if (!dataReplaced) {
+            return false;
+        }
+    }
+    header()->retired = 1;  // for the other processes
+    close();
+    return open();
+}
+
+}  // namespace Fm
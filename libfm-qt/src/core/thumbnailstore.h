@@ -0,0 +1,103 @@
+/*
+ * Packed thumbnail store
+ * libfm-qt/src/core/thumbnailstore.h
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef FM2_THUMBNAILSTORE_H
+#define FM2_THUMBNAILSTORE_H
+
+#include "../libfmqtglobals.h"
+#include <QImage>
+#include <QString>
+#include <array>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Fm {
+
+// A packed cache of thumbnails beside the freedesktop one, so that showing a folder of cached
+// thumbnails does not open and decode a PNG file per image. The thumbnails of a size are appended,
+// QOI-compressed, to a single data file and found through a hash table in an index file that is
+// mapped in memory, keyed by the MD5 digest of the URI and the modification time of the file.
+// Replaced thumbnails stay in the data file until it is compacted, which happens when most of it
+// is garbage, the table gets full or the data file reaches its limit, and drops the thumbnails of
+// files that are gone; a full store also loses its oldest thumbnails then.
+// Several processes may share a store: they take a lock on it, and a compaction retires the index
+// so that the others open the new files.
+class LIBFM_QT_API ThumbnailStore {
+   public:
+    using Digest = std::array<unsigned char, 16>;
+
+    // Opens or creates the store in |dirPath|. Nothing is found or stored if that fails.
+    explicit ThumbnailStore(const QString& dirPath);
+
+    ~ThumbnailStore();
+
+    ThumbnailStore(const ThumbnailStore&) = delete;
+    ThumbnailStore& operator=(const ThumbnailStore&) = delete;
+
+    // The store in $XDG_CACHE_HOME/libfm-qt/thumbnails/|name|, created on first use.
+    static ThumbnailStore* forName(const char* name);
+
+    // Sets |image| to the thumbnail stored for |digest| if it was made at |mtime|.
+    bool find(const Digest& digest, quint64 mtime, QImage& image);
+
+    // Stores |image| as the thumbnail of |uri| modified at |mtime|, replacing an older one.
+    void insert(const Digest& digest, quint64 mtime, const char* uri, const QImage& image);
+
+    // Rewrites the store without the replaced thumbnails and those of the files that are gone.
+    void compact();
+
+   private:
+    struct IndexHeader;
+    struct Slot;
+    struct Source {
+        Digest digest;
+        quint64 mtime;
+        std::string filename;
+    };
+
+    bool open();
+    void close();
+    bool lock();
+    void unlock();
+    IndexHeader* header() const;
+    Slot* slotTable() const;
+    Slot* findSlot(const Digest& digest) const;
+    bool needsCompaction(const Digest& digest, quint32 size) const;
+    std::vector<Source> localSources() const;
+    static std::map<Digest, quint64> staleSources(const std::vector<Source>& sources);
+    bool compactLocked(std::size_t minCount, const std::map<Digest, quint64>& stale);
+
+    QString dirPath_;
+    int lockFd_;
+    int dataFd_;
+    int indexFd_;
+    unsigned char* index_;  // the mapped index file, null if it is not open
+    std::size_t indexSize_;
+    std::mutex mutex_;  // the file lock does not exclude the threads of this process
+};
+
+}  // namespace Fm
+
+#endif  // FM2_THUMBNAILSTORE_H
@@ -1,4 +1,5 @@
 #include "totalsizejob.h"
+#include "nativesizewalker_p.h"
 
 namespace Fm {
 
@@ -9,6 +10,8 @@ static const char query_str[] = G_FILE_ATTRIBUTE_STANDARD_TYPE
 TotalSizeJob::TotalSizeJob(FilePathList paths, Flags flags)
     : paths_{std::move(paths)}, flags_{flags}, totalSize_{0}, totalOndiskSize_{0}, fileCount_{0}, dest_fs_id{nullptr} {}
 
+TotalSizeJob::~TotalSizeJob() = default;
+
 void TotalSizeJob::exec(FilePath path, GFileInfoPtr inf) {
     GFileType type;
     const char* fs_id;
@@ -71,7 +74,10 @@ _retry_query_info:
             /* only descends into files on the same filesystem */
             if (flags_ & SAME_FS) {
                 fs_id = g_file_info_get_attribute_string(inf.get(), G_FILE_ATTRIBUTE_ID_FILESYSTEM);
-                descend = (g_strcmp0(fs_id, dest_fs_id) == 0);
+                if (!root_fs_id) {
+                    root_fs_id = CStrPtr{g_strdup(fs_id)};  // the path being counted
+                }
+                descend = (g_strcmp0(fs_id, root_fs_id.get()) == 0);
             }
         }
 
@@ -121,8 +127,42 @@ _retry_query_info:
     }
 }
 
+bool TotalSizeJob::execNative(const FilePath& path) {
+    if (!walker_) {
+        walker_ = std::make_unique<NativeSizeWalker>(
+            flags_ & SAME_FS, cancellable().get(), [this](const NativeSizeWalker::Counts& counts) {
+                totalSize_ += counts.size;
+                totalOndiskSize_ += counts.onDiskSize;
+                fileCount_ += counts.fileCount;
+                if (flags_ & PREPARE_MOVE) {
+                    // as in exec() when no destination filesystem is known: an additional 'delete' per file
+                    totalSize_ += counts.fileCount;
+                    totalOndiskSize_ += counts.fileCount;
+                    fileCount_ += counts.fileCount;
+                }
+            });
+    }
+    auto localPath = path.localPath();
+    if (!localPath || !walker_->walk(localPath.get(), flags_ & FOLLOW_LINKS)) {
+        return false;  // GIO reports the error and offers to retry
+    }
+    for (auto& error : walker_->takeErrors()) {
+        CStrPtr msg{g_strdup_printf("%s: %s", error.first.c_str(), g_strerror(error.second))};
+        emitError(GErrorPtr{G_IO_ERROR, static_cast<unsigned int>(g_io_error_from_errno(error.second)), msg.get()},
+                  ErrorSeverity::MILD);
+    }
+    return true;
+}
+
 void TotalSizeJob::exec() {
     for (auto& path : paths_) {
+        if (isCancelled()) {
+            break;
+        }
+        if (path.isNative() && execNative(path)) {
+            continue;
+        }
+        root_fs_id.reset();
         exec(path, GFileInfoPtr{});
     }
 }
@@ -4,11 +4,21 @@
 #include "../libfmqtglobals.h"
 #include "fileoperationjob.h"
 #include "filepath.h"
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include "cstrptr.h"
 #include "gioptrs.h"
 
 namespace Fm {
 
+class NativeSizeWalker;
+
+// Counts the files under the paths and adds up their sizes. The totals grow while it runs and
+// can be read from other threads. Local trees are walked on several threads, with the files that
+// have several hard links counted once in the size on disk; GIO does not tell links apart, so
+// other files count once per link. With SAME_FS, only the directories on the filesystem of the
+// path they are found under are read.
 class LIBFM_QT_API TotalSizeJob : public Fm::FileOperationJob {
     Q_OBJECT
    public:
@@ -16,6 +26,8 @@ class LIBFM_QT_API TotalSizeJob : public Fm::FileOperationJob {
 
     explicit TotalSizeJob(FilePathList paths = FilePathList{}, Flags flags = DEFAULT);
 
+    ~TotalSizeJob() override;
+
     std::uint64_t totalSize() const { return totalSize_; }
 
     std::uint64_t totalOnDiskSize() const { return totalOndiskSize_; }
@@ -28,14 +40,18 @@ class LIBFM_QT_API TotalSizeJob : public Fm::FileOperationJob {
    private:
     void exec(FilePath path, GFileInfoPtr inf);
 
+    bool execNative(const FilePath& path);
+
    private:
     FilePathList paths_;
 
     int flags_;
-    std::uint64_t totalSize_;
-    std::uint64_t totalOndiskSize_;
-    unsigned int fileCount_;
+    std::atomic<std::uint64_t> totalSize_;
+    std::atomic<std::uint64_t> totalOndiskSize_;
+    std::atomic<unsigned int> fileCount_;
     const char* dest_fs_id;
+    CStrPtr root_fs_id;  // of the path being counted, for SAME_FS
+    std::unique_ptr<NativeSizeWalker> walker_;  // shared by the paths so that a hard link counts once
 };
 
 }  // namespace Fm
@@ -0,0 +1,1395 @@
+/*
+ *      vfs-archive.c
+ *
+ *      Read-only browsing of archives as virtual folders (archive:// URIs).
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * URI layout: archive:///<escaped native path of the archive>/<path inside the archive>
+ *
+ * The archive path is fully percent-escaped (including '/') so it occupies exactly one
+ * URI segment. Listing never touches the archive payload: the first access scans the
+ * headers once and builds an entry index (path, size, mtime, mode, stream offset) that
+ * is kept in memory for the last few archives and persisted under
+ * $XDG_CACHE_HOME/libfm-qt/archives keyed by the archive identity (device, inode,
+ * size, mtime). Reopening an unchanged archive only loads that index file.
+ *
+ * Reading a member starts at its header in uncompressed tar archives. Other formats can
+ * only be read from the start, so closed streams park their reader and the next read
+ * of a later member of the same archive continues from there instead of rescanning.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "fm-file.h"
+
+#include <glib/gi18n-lib.h>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ARCHIVE_SCHEME "archive"
+#define ARCHIVE_URI_PREFIX "archive:///"
+
+/* ---- Entry index ---- */
+
+#define FM_ARCHIVE_INDEX_MAGIC "FMAIDX02"
+#define FM_ARCHIVE_INDEX_MEMORY_SLOTS 8
+#define FM_ARCHIVE_READER_SLOTS 4
+#define FM_ARCHIVE_READ_BLOCK (128 * 1024)
+
+/* FmArchiveIndexHeader::flags */
+#define FM_ARCHIVE_INDEX_SEEKABLE 1 /* uncompressed tar: entries can be read from their offset */
+
+/* On-disk and in-memory record; fixed layout without padding. */
+typedef struct _FmArchiveEntry {
+    guint64 size;
+    gint64 mtime;
+    gint64 offset;    /* header position in the decompressed stream, -1 for implied dirs */
+    guint32 mode;     /* st_mode including the file type bits */
+    guint32 path;     /* offset of the NUL-terminated path in FmArchiveIndex::strings */
+    guint32 ordinal;  /* number of headers before this one in the archive */
+    guint32 reserved;
+} FmArchiveEntry;
+
+/* Identity of the archive file the index was built from; also the cache file header. */
+typedef struct _FmArchiveIndexHeader {
+    char magic[8];
+    guint64 dev;
+    guint64 ino;
+    guint64 size;
+    gint64 mtime_sec;
+    gint64 mtime_nsec;
+    guint32 n_entries;
+    guint32 strings_len;
+    guint32 flags;
+    guint32 reserved;
+} FmArchiveIndexHeader;
+
+typedef struct _FmArchiveIndex {
+    gint ref_count;
+    FmArchiveIndexHeader id;
+    GArray* entries;       /* FmArchiveEntry */
+    GString* strings;      /* NUL-separated entry paths */
+    GHashTable* by_path;   /* const char* path -> GUINT_TO_POINTER(entry index + 1) */
+    GHashTable* children;  /* char* dir path ("" for root) -> GArray of guint entry indices */
+} FmArchiveIndex;
+
+G_LOCK_DEFINE_STATIC(archive_index);
+static GHashTable* index_cache = NULL; /* char* identity key -> FmArchiveIndex* */
+static GQueue index_lru = G_QUEUE_INIT; /* identity keys owned by index_cache, most recent first */
+
+static FmArchiveIndex* fm_archive_index_new(const FmArchiveIndexHeader* id) {
+    FmArchiveIndex* index = g_slice_new0(FmArchiveIndex);
+    index->ref_count = 1;
+    index->id = *id;
+    index->entries = g_array_new(FALSE, FALSE, sizeof(FmArchiveEntry));
+    index->strings = g_string_new(NULL);
+    return index;
+}
+
+static FmArchiveIndex* fm_archive_index_ref(FmArchiveIndex* index) {
+    g_atomic_int_inc(&index->ref_count);
+    return index;
+}
+
+static void fm_archive_index_unref(FmArchiveIndex* index) {
+    if (!g_atomic_int_dec_and_test(&index->ref_count))
+        return;
+    if (index->by_path)
+        g_hash_table_destroy(index->by_path);
+    if (index->children)
+        g_hash_table_destroy(index->children);
+    g_array_free(index->entries, TRUE);
+    g_string_free(index->strings, TRUE);
+    g_slice_free(FmArchiveIndex, index);
+}
+
+static inline const FmArchiveEntry* fm_archive_index_entry(const FmArchiveIndex* index, guint i) {
+    return &g_array_index(index->entries, FmArchiveEntry, i);
+}
+
+static inline const char* fm_archive_index_path(const FmArchiveIndex* index, const FmArchiveEntry* e) {
+    return index->strings->str + e->path;
+}
+
+static void fm_archive_index_append(FmArchiveIndex* index, const char* path, FmArchiveEntry* e) {
+    e->path = (guint32)index->strings->len;
+    g_string_append_len(index->strings, path, (gssize)strlen(path) + 1);
+    g_array_append_val(index->entries, *e);
+}
+
+/* must be called once all entries are appended: the tables point into index->strings */
+static void fm_archive_index_build_tables(FmArchiveIndex* index) {
+    guint i;
+
+    index->by_path = g_hash_table_new(g_str_hash, g_str_equal);
+    index->children =
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_array_unref);
+
+    /* later entries win, like when a tar archive is extracted */
+    for (i = 0; i < index->entries->len; ++i) {
+        const char* path = fm_archive_index_path(index, fm_archive_index_entry(index, i));
+        g_hash_table_insert(index->by_path, (gpointer)path, GUINT_TO_POINTER(i + 1));
+    }
+
+    for (i = 0; i < index->entries->len; ++i) {
+        const char* path = fm_archive_index_path(index, fm_archive_index_entry(index, i));
+        const char* slash;
+        char* parent;
+        GArray* list;
+
+        if (GPOINTER_TO_UINT(g_hash_table_lookup(index->by_path, path)) != i + 1)
+            continue; /* shadowed by a later entry with the same path */
+        slash = strrchr(path, '/');
+        parent = slash ? g_strndup(path, (gsize)(slash - path)) : g_strdup("");
+        list = g_hash_table_lookup(index->children, parent);
+        if (list == NULL) {
+            list = g_array_new(FALSE, FALSE, sizeof(guint));
+            g_hash_table_insert(index->children, parent, list);
+        }
+        else
+            g_free(parent);
+        g_array_append_val(list, i);
+    }
+}
+
+static gboolean fm_archive_index_lookup(const FmArchiveIndex* index, const char* path, guint* out) {
+    guint v = GPOINTER_TO_UINT(g_hash_table_lookup(index->by_path, path));
+    if (v == 0)
+        return FALSE;
+    *out = v - 1;
+    return TRUE;
+}
+
+/*
+ * Normalizes @rel relative to @base (both '/' separated, no leading slash required).
+ * Empty and "." components are dropped. With @strict, ".." makes the path invalid
+ * (entries read from archives); otherwise it pops a component and stops at the root.
+ * Returns a newly allocated string ("" for the root) or NULL.
+ */
+static char* fm_archive_join_path(const char* base, const char* rel, gboolean strict) {
+    GPtrArray* parts = g_ptr_array_new();
+    const char* sources[2] = {base, rel};
+    GString* out;
+    char** split;
+    guint i, s;
+
+    for (s = 0; s < G_N_ELEMENTS(sources); ++s) {
+        if (sources[s] == NULL)
+            continue;
+        split = g_strsplit(sources[s], "/", -1);
+        for (i = 0; split[i]; ++i) {
+            const char* c = split[i];
+            if (c[0] == '\0' || strcmp(c, ".") == 0)
+                continue;
+            if (strcmp(c, "..") == 0) {
+                if (strict) {
+                    g_strfreev(split);
+                    g_ptr_array_free(parts, TRUE);
+                    return NULL;
+                }
+                if (parts->len > 0)
+                    g_ptr_array_remove_index(parts, parts->len - 1);
+                continue;
+            }
+            g_ptr_array_add(parts, g_strdup(c));
+        }
+        g_strfreev(split);
+    }
+
+    out = g_string_new(NULL);
+    for (i = 0; i < parts->len; ++i) {
+        if (i > 0)
+            g_string_append_c(out, '/');
+        g_string_append(out, g_ptr_array_index(parts, i));
+        g_free(g_ptr_array_index(parts, i));
+    }
+    g_ptr_array_free(parts, TRUE);
+    return g_string_free(out, FALSE);
+}
+
+static char* fm_archive_index_key(const FmArchiveIndexHeader* id) {
+    return g_strdup_printf("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT
+                           ".%09" G_GINT64_FORMAT,
+                           id->dev, id->ino, id->size, id->mtime_sec, id->mtime_nsec);
+}
+
+static char* fm_archive_index_cache_file(const char* key) {
+    char* digest = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+    char* name = g_strconcat(digest, ".idx", NULL);
+    char* file = g_build_filename(g_get_user_cache_dir(), "libfm-qt", "archives", name, NULL);
+    g_free(name);
+    g_free(digest);
+    return file;
+}
+
+static gboolean fm_archive_index_identity_equal(const FmArchiveIndexHeader* a, const FmArchiveIndexHeader* b) {
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size && a->mtime_sec == b->mtime_sec &&
+           a->mtime_nsec == b->mtime_nsec;
+}
+
+static FmArchiveIndex* fm_archive_index_load(const char* cache_file, const FmArchiveIndexHeader* id) {
+    FmArchiveIndexHeader header;
+    FmArchiveIndex* index;
+    const FmArchiveEntry* records;
+    const char* strings;
+    gchar* data = NULL;
+    gsize len = 0;
+    guint i;
+
+    if (!g_file_get_contents(cache_file, &data, &len, NULL))
+        return NULL;
+    if (len < sizeof(header))
+        goto _invalid;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FM_ARCHIVE_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+        !fm_archive_index_identity_equal(&header, id) || (header.n_entries == 0) != (header.strings_len == 0) ||
+        len != sizeof(header) + (gsize)header.n_entries * sizeof(FmArchiveEntry) + header.strings_len)
+        goto _invalid;
+
+    records = (const FmArchiveEntry*)(data + sizeof(header));
+    strings = data + sizeof(header) + (gsize)header.n_entries * sizeof(FmArchiveEntry);
+    if (header.strings_len > 0 && strings[header.strings_len - 1] != '\0')
+        goto _invalid;
+    for (i = 0; i < header.n_entries; ++i) {
+        if (records[i].path >= header.strings_len)
+            goto _invalid;
+    }
+
+    index = fm_archive_index_new(id);
+    index->id.flags = header.flags;
+    g_array_append_vals(index->entries, records, header.n_entries);
+    g_string_append_len(index->strings, strings, (gssize)header.strings_len);
+    g_free(data);
+    fm_archive_index_build_tables(index);
+    return index;
+
+_invalid:
+    g_free(data);
+    return NULL;
+}
+
+static void fm_archive_index_save(const FmArchiveIndex* index, const char* cache_file) {
+    FmArchiveIndexHeader header = index->id;
+    GByteArray* buf;
+    char* dir;
+
+    /* empty archives are saved too, so that they are not scanned again */
+    if (index->entries->len > G_MAXUINT32 || index->strings->len > G_MAXUINT32)
+        return;
+    dir = g_path_get_dirname(cache_file);
+    if (g_mkdir_with_parents(dir, 0700) != 0) {
+        g_free(dir);
+        return;
+    }
+    g_free(dir);
+
+    header.n_entries = index->entries->len;
+    header.strings_len = (guint32)index->strings->len;
+    buf = g_byte_array_sized_new(sizeof(header) + index->entries->len * sizeof(FmArchiveEntry) +
+                                 index->strings->len);
+    g_byte_array_append(buf, (const guint8*)&header, sizeof(header));
+    g_byte_array_append(buf, (const guint8*)index->entries->data, index->entries->len * sizeof(FmArchiveEntry));
+    g_byte_array_append(buf, (const guint8*)index->strings->str, index->strings->len);
+    /* best effort: a missing cache only costs a rescan */
+    g_file_set_contents(cache_file, (const gchar*)buf->data, (gssize)buf->len, NULL);
+    g_byte_array_unref(buf);
+}
+
+static FmArchiveIndex* fm_archive_index_build(const char* archive_path,
+                                              const FmArchiveIndexHeader* id,
+                                              GCancellable* cancellable,
+                                              GError** error) {
+    struct archive* ar;
+    struct archive_entry* entry;
+    FmArchiveIndex* index;
+    GHashTable* seen;
+    gboolean failed = FALSE;
+    guint32 ordinal = 0;
+    guint i, n;
+    int r;
+
+    ar = archive_read_new();
+    if (ar == NULL) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Failed to allocate archive reader"));
+        return NULL;
+    }
+    archive_read_support_filter_all(ar);
+    archive_read_support_format_all(ar);
+    if (archive_read_open_filename(ar, archive_path, FM_ARCHIVE_READ_BLOCK) != ARCHIVE_OK) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, archive_error_string(ar));
+        archive_read_free(ar);
+        return NULL;
+    }
+
+    index = fm_archive_index_new(id);
+    seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (; (r = archive_read_next_header(ar, &entry)) == ARCHIVE_OK || r == ARCHIVE_WARN; ++ordinal) {
+        FmArchiveEntry e;
+        char* path;
+
+        if (g_cancellable_set_error_if_cancelled(cancellable, error)) {
+            failed = TRUE;
+            break;
+        }
+        path = fm_archive_join_path(NULL, archive_entry_pathname(entry), TRUE);
+        if (path == NULL || path[0] == '\0') {
+            /* unsafe or empty names cannot be placed in the tree */
+            g_free(path);
+            archive_read_data_skip(ar);
+            continue;
+        }
+        e.size = archive_entry_size(entry) > 0 ? (guint64)archive_entry_size(entry) : 0;
+        e.mtime = archive_entry_mtime(entry);
+        e.offset = archive_read_header_position(ar);
+        e.mode = archive_entry_mode(entry);
+        if ((e.mode & S_IFMT) == 0)
+            e.mode |= S_IFREG;
+        e.ordinal = ordinal;
+        e.reserved = 0;
+        fm_archive_index_append(index, path, &e);
+        g_hash_table_add(seen, path);
+        archive_read_data_skip(ar);
+    }
+    if (!failed && r != ARCHIVE_EOF) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, archive_error_string(ar));
+        failed = TRUE;
+    }
+    /* a tar header can be parsed on its own, without the ones before it */
+    if (ordinal > 0 && archive_filter_code(ar, 0) == ARCHIVE_FILTER_NONE &&
+        (archive_format(ar) & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_TAR)
+        index->id.flags |= FM_ARCHIVE_INDEX_SEEKABLE;
+    archive_read_free(ar);
+
+    if (failed) {
+        g_hash_table_destroy(seen);
+        fm_archive_index_unref(index);
+        return NULL;
+    }
+
+    /* many archives omit directory entries; synthesize the missing parents */
+    n = index->entries->len;
+    for (i = 0; i < n; ++i) {
+        const FmArchiveEntry* e = fm_archive_index_entry(index, i);
+        gint64 mtime = e->mtime;
+        char* parent = g_strdup(fm_archive_index_path(index, e));
+        char* slash;
+
+        while ((slash = strrchr(parent, '/')) != NULL) {
+            FmArchiveEntry dir = {0, mtime, -1, S_IFDIR | 0755, 0, G_MAXUINT32, 0};
+            *slash = '\0';
+            if (g_hash_table_contains(seen, parent))
+                break;
+            fm_archive_index_append(index, parent, &dir);
+            g_hash_table_add(seen, g_strdup(parent));
+        }
+        g_free(parent);
+    }
+    g_hash_table_destroy(seen);
+
+    fm_archive_index_build_tables(index);
+    return index;
+}
+
+/* returns a new reference to the index of @archive_path, building it if needed */
+static FmArchiveIndex* fm_archive_index_get(const char* archive_path, GCancellable* cancellable, GError** error) {
+    FmArchiveIndexHeader id;
+    FmArchiveIndex* index = NULL;
+    gpointer cached_key = NULL;
+    struct stat st;
+    char* cache_file;
+    char* key;
+
+    if (archive_path == NULL || archive_path[0] == '\0') {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME, _("Invalid archive location"));
+        return NULL;
+    }
+    if (stat(archive_path, &st) != 0) {
+        int errsv = errno;
+        g_set_error_literal(error, G_IO_ERROR, g_io_error_from_errno(errsv), g_strerror(errsv));
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_REGULAR_FILE, _("Not a regular file"));
+        return NULL;
+    }
+
+    memset(&id, 0, sizeof(id));
+    memcpy(id.magic, FM_ARCHIVE_INDEX_MAGIC, sizeof(id.magic));
+    id.dev = (guint64)st.st_dev;
+    id.ino = (guint64)st.st_ino;
+    id.size = (guint64)st.st_size;
+    id.mtime_sec = (gint64)st.st_mtim.tv_sec;
+    id.mtime_nsec = (gint64)st.st_mtim.tv_nsec;
+    key = fm_archive_index_key(&id);
+
+    G_LOCK(archive_index);
+    if (index_cache && g_hash_table_lookup_extended(index_cache, key, &cached_key, (gpointer*)&index)) {
+        fm_archive_index_ref(index);
+        g_queue_remove(&index_lru, cached_key);
+        g_queue_push_head(&index_lru, cached_key);
+    }
+    G_UNLOCK(archive_index);
+    if (index) {
+        g_free(key);
+        return index;
+    }
+
+    /* not in memory: try the persistent index, then scan the archive */
+    cache_file = fm_archive_index_cache_file(key);
+    index = fm_archive_index_load(cache_file, &id);
+    if (index == NULL) {
+        index = fm_archive_index_build(archive_path, &id, cancellable, error);
+        if (index)
+            fm_archive_index_save(index, cache_file);
+    }
+    g_free(cache_file);
+    if (index == NULL) {
+        g_free(key);
+        return NULL;
+    }
+
+    G_LOCK(archive_index);
+    if (index_cache == NULL)
+        index_cache =
+            g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)fm_archive_index_unref);
+    if (g_hash_table_lookup_extended(index_cache, key, &cached_key, NULL)) {
+        /* another thread built the same index meanwhile */
+        g_free(key);
+        fm_archive_index_unref(index);
+        index = fm_archive_index_ref(g_hash_table_lookup(index_cache, cached_key));
+    }
+    else {
+        g_hash_table_insert(index_cache, key, fm_archive_index_ref(index));
+        g_queue_push_head(&index_lru, key);
+        while (g_queue_get_length(&index_lru) > FM_ARCHIVE_INDEX_MEMORY_SLOTS)
+            g_hash_table_remove(index_cache, g_queue_pop_tail(&index_lru));
+    }
+    G_UNLOCK(archive_index);
+    return index;
+}
+
+/* ---- Entry readers ---- */
+
+typedef struct _FmArchiveReader {
+    struct archive* ar;
+    int fd;          /* owned when the reader was opened at an entry offset, -1 otherwise */
+    char* key;       /* identity of the archive, see fm_archive_index_key() */
+    guint32 next;    /* ordinal of the header archive_read_next_header() returns next */
+    gboolean failed; /* not to be parked again */
+} FmArchiveReader;
+
+G_LOCK_DEFINE_STATIC(archive_reader);
+static GQueue parked_readers = G_QUEUE_INIT; /* FmArchiveReader*, most recently parked first */
+
+static void fm_archive_reader_free(FmArchiveReader* reader) {
+    archive_read_free(reader->ar);
+    if (reader->fd >= 0)
+        close(reader->fd);
+    g_free(reader->key);
+    g_slice_free(FmArchiveReader, reader);
+}
+
+/* opens @archive_path at the start or, for seekable archives, at the header of @e */
+static FmArchiveReader* fm_archive_reader_open(const char* archive_path,
+                                               const FmArchiveIndex* index,
+                                               const FmArchiveEntry* e,
+                                               GError** error) {
+    FmArchiveReader* reader;
+    struct archive* ar;
+    int fd = -1;
+    int r;
+
+    ar = archive_read_new();
+    if (ar == NULL) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Failed to allocate archive reader"));
+        return NULL;
+    }
+    if ((index->id.flags & FM_ARCHIVE_INDEX_SEEKABLE) && e->offset > 0) {
+        fd = open(archive_path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || lseek(fd, (off_t)e->offset, SEEK_SET) != (off_t)e->offset) {
+            int errsv = errno;
+            g_set_error_literal(error, G_IO_ERROR, g_io_error_from_errno(errsv), g_strerror(errsv));
+            if (fd >= 0)
+                close(fd);
+            archive_read_free(ar);
+            return NULL;
+        }
+        archive_read_support_format_tar(ar);
+        r = archive_read_open_fd(ar, fd, FM_ARCHIVE_READ_BLOCK);
+    }
+    else {
+        archive_read_support_filter_all(ar);
+        archive_read_support_format_all(ar);
+        r = archive_read_open_filename(ar, archive_path, FM_ARCHIVE_READ_BLOCK);
+    }
+    if (r != ARCHIVE_OK) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, archive_error_string(ar));
+        archive_read_free(ar);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    reader = g_slice_new0(FmArchiveReader);
+    reader->ar = ar;
+    reader->fd = fd;
+    reader->key = fm_archive_index_key(&index->id);
+    reader->next = fd >= 0 ? e->ordinal : 0;
+    return reader;
+}
+
+/* takes a parked reader of the archive @key that has not gone past the header @ordinal yet */
+static FmArchiveReader* fm_archive_reader_unpark(const char* key, guint32 ordinal, gboolean seekable) {
+    FmArchiveReader* reader = NULL;
+    GList* l;
+
+    G_LOCK(archive_reader);
+    for (l = parked_readers.head; l; l = l->next) {
+        FmArchiveReader* r = l->data;
+        /* reading up to a far entry of a tar archive costs more than seeking to it */
+        if (g_str_equal(r->key, key) && (seekable ? r->next == ordinal : r->next <= ordinal)) {
+            reader = r;
+            g_queue_delete_link(&parked_readers, l);
+            break;
+        }
+    }
+    G_UNLOCK(archive_reader);
+    return reader;
+}
+
+static void fm_archive_reader_park(FmArchiveReader* reader) {
+    FmArchiveReader* dropped = NULL;
+
+    if (reader->failed) {
+        fm_archive_reader_free(reader);
+        return;
+    }
+    G_LOCK(archive_reader);
+    g_queue_push_head(&parked_readers, reader);
+    if (g_queue_get_length(&parked_readers) > FM_ARCHIVE_READER_SLOTS)
+        dropped = g_queue_pop_tail(&parked_readers);
+    G_UNLOCK(archive_reader);
+    if (dropped)
+        fm_archive_reader_free(dropped);
+}
+
+/* moves @reader to the data of the entry with @ordinal, which must be @path */
+static gboolean fm_archive_reader_seek(FmArchiveReader* reader,
+                                       guint32 ordinal,
+                                       const char* path,
+                                       GCancellable* cancellable,
+                                       GError** error) {
+    struct archive_entry* entry;
+    int r;
+
+    while (reader->next <= ordinal) {
+        if (g_cancellable_set_error_if_cancelled(cancellable, error)) {
+            reader->failed = TRUE;
+            return FALSE;
+        }
+        r = archive_read_next_header(reader->ar, &entry);
+        if (r != ARCHIVE_OK && r != ARCHIVE_WARN) {
+            if (r == ARCHIVE_EOF)
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("No such file or directory"));
+            else
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, archive_error_string(reader->ar));
+            reader->failed = TRUE;
+            return FALSE;
+        }
+        if (reader->next++ == ordinal) {
+            /* the archive may have been rewritten without changing its identity */
+            char* entry_path = fm_archive_join_path(NULL, archive_entry_pathname(entry), TRUE);
+            gboolean match = entry_path && g_str_equal(entry_path, path);
+            g_free(entry_path);
+            if (!match) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("No such file or directory"));
+                reader->failed = TRUE;
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/* ---- Class structures ---- */
+
+#define FM_TYPE_ARCHIVE_VFILE (fm_vfs_archive_file_get_type())
+#define FM_ARCHIVE_VFILE(o) (G_TYPE_CHECK_INSTANCE_CAST((o), FM_TYPE_ARCHIVE_VFILE, FmArchiveVFile))
+
+typedef struct _FmArchiveVFile FmArchiveVFile;
+typedef struct _FmArchiveVFileClass FmArchiveVFileClass;
+
+static GType fm_vfs_archive_file_get_type(void);
+
+struct _FmArchiveVFile {
+    GObject parent_object;
+
+    char* archive; /* native path of the archive file */
+    char* inner;   /* normalized path inside the archive, "" for its root */
+};
+
+struct _FmArchiveVFileClass {
+    GObjectClass parent_class;
+};
+
+#define FM_TYPE_VFS_ARCHIVE_ENUMERATOR (fm_vfs_archive_enumerator_get_type())
+#define FM_VFS_ARCHIVE_ENUMERATOR(o) \
+    (G_TYPE_CHECK_INSTANCE_CAST((o), FM_TYPE_VFS_ARCHIVE_ENUMERATOR, FmVfsArchiveEnumerator))
+
+typedef struct _FmVfsArchiveEnumerator FmVfsArchiveEnumerator;
+typedef struct _FmVfsArchiveEnumeratorClass FmVfsArchiveEnumeratorClass;
+
+struct _FmVfsArchiveEnumerator {
+    GFileEnumerator parent;
+
+    FmArchiveIndex* index;
+    GArray* children; /* owned by index, may be NULL for an empty folder */
+    guint pos;
+};
+
+struct _FmVfsArchiveEnumeratorClass {
+    GFileEnumeratorClass parent_class;
+};
+
+#define FM_TYPE_ARCHIVE_INPUT_STREAM (fm_archive_input_stream_get_type())
+#define FM_ARCHIVE_INPUT_STREAM(o) \
+    (G_TYPE_CHECK_INSTANCE_CAST((o), FM_TYPE_ARCHIVE_INPUT_STREAM, FmArchiveInputStream))
+
+typedef struct _FmArchiveInputStream FmArchiveInputStream;
+typedef struct _FmArchiveInputStreamClass FmArchiveInputStreamClass;
+
+struct _FmArchiveInputStream {
+    GFileInputStream parent;
+
+    FmArchiveReader* reader; /* positioned at the data of the opened entry */
+};
+
+struct _FmArchiveInputStreamClass {
+    GFileInputStreamClass parent_class;
+};
+
+/* ---- File info helpers ---- */
+
+static GFileInfo* _fm_archive_make_info(const char* name, guint32 mode, guint64 size, gint64 mtime) {
+    GFileInfo* info = g_file_info_new();
+    GFileType type;
+    char* content_type;
+    char* display_name;
+    GIcon* icon;
+
+    switch (mode & S_IFMT) {
+        case S_IFDIR:
+            type = G_FILE_TYPE_DIRECTORY;
+            content_type = g_strdup("inode/directory");
+            break;
+        case S_IFLNK:
+            type = G_FILE_TYPE_SYMBOLIC_LINK;
+            content_type = g_content_type_guess(name, NULL, 0, NULL);
+            break;
+        case S_IFREG:
+            type = G_FILE_TYPE_REGULAR;
+            content_type = g_content_type_guess(name, NULL, 0, NULL);
+            break;
+        default:
+            type = G_FILE_TYPE_SPECIAL;
+            content_type = g_strdup("application/octet-stream");
+            break;
+    }
+
+    display_name = g_filename_display_name(name);
+    g_file_info_set_name(info, name);
+    g_file_info_set_display_name(info, display_name);
+    g_free(display_name);
+    g_file_info_set_file_type(info, type);
+    g_file_info_set_size(info, (goffset)size);
+    g_file_info_set_content_type(info, content_type);
+    icon = g_content_type_get_icon(content_type);
+    g_file_info_set_icon(info, icon);
+    g_object_unref(icon);
+    g_free(content_type);
+    g_file_info_set_is_hidden(info, name[0] == '.');
+    if (type == G_FILE_TYPE_SYMBOLIC_LINK)
+        g_file_info_set_is_symlink(info, TRUE);
+
+    g_file_info_set_attribute_uint32(info, G_FILE_ATTRIBUTE_UNIX_MODE, mode);
+    g_file_info_set_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime > 0 ? (guint64)mtime : 0);
+    /* archives are browsed read-only */
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_ACCESS_CAN_READ, TRUE);
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE, FALSE);
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE, FALSE);
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_ACCESS_CAN_TRASH, FALSE);
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME, FALSE);
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY, TRUE);
+    return info;
+}
+
+static GFileInfo* _fm_archive_entry_info(const FmArchiveIndex* index, guint i) {
+    const FmArchiveEntry* e = fm_archive_index_entry(index, i);
+    const char* path = fm_archive_index_path(index, e);
+    const char* name = strrchr(path, '/');
+
+    return _fm_archive_make_info(name ? name + 1 : path, e->mode, e->size, e->mtime);
+}
+
+/* ---- archive enumerator class ---- */
+static GType fm_vfs_archive_enumerator_get_type(void);
+
+G_DEFINE_TYPE(FmVfsArchiveEnumerator, fm_vfs_archive_enumerator, G_TYPE_FILE_ENUMERATOR)
+
+static void _fm_vfs_archive_enumerator_dispose(GObject* object) {
+    FmVfsArchiveEnumerator* enu = FM_VFS_ARCHIVE_ENUMERATOR(object);
+
+    if (enu->index) {
+        fm_archive_index_unref(enu->index);
+        enu->index = NULL;
+        enu->children = NULL;
+    }
+
+    G_OBJECT_CLASS(fm_vfs_archive_enumerator_parent_class)->dispose(object);
+}
+
+static GFileInfo* _fm_vfs_archive_enumerator_next_file(GFileEnumerator* enumerator,
+                                                       GCancellable* cancellable,
+                                                       GError** error) {
+    FmVfsArchiveEnumerator* enu = FM_VFS_ARCHIVE_ENUMERATOR(enumerator);
+
+    if (g_cancellable_set_error_if_cancelled(cancellable, error))
+        return NULL;
+    if (enu->children == NULL || enu->pos >= enu->children->len)
+        return NULL;
+    return _fm_archive_entry_info(enu->index, g_array_index(enu->children, guint, enu->pos++));
+}
+
+static gboolean _fm_vfs_archive_enumerator_close(GFileEnumerator* enumerator,
+                                                 GCancellable* cancellable,
+                                                 GError** error) {
+    return TRUE;
+}
+
+static void fm_vfs_archive_enumerator_class_init(FmVfsArchiveEnumeratorClass* klass) {
+    GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+    GFileEnumeratorClass* enumerator_class = G_FILE_ENUMERATOR_CLASS(klass);
+
+    gobject_class->dispose = _fm_vfs_archive_enumerator_dispose;
+
+    enumerator_class->next_file = _fm_vfs_archive_enumerator_next_file;
+    enumerator_class->close_fn = _fm_vfs_archive_enumerator_close;
+}
+
+static void fm_vfs_archive_enumerator_init(FmVfsArchiveEnumerator* enumerator) {
+    /* nothing */
+}
+
+/* ---- archive input stream class ---- */
+static GType fm_archive_input_stream_get_type(void);
+
+G_DEFINE_TYPE(FmArchiveInputStream, fm_archive_input_stream, G_TYPE_FILE_INPUT_STREAM)
+
+static void fm_archive_input_stream_finalize(GObject* object) {
+    FmArchiveInputStream* stream = FM_ARCHIVE_INPUT_STREAM(object);
+
+    if (stream->reader)
+        fm_archive_reader_free(stream->reader);
+
+    G_OBJECT_CLASS(fm_archive_input_stream_parent_class)->finalize(object);
+}
+
+static gssize _fm_archive_input_stream_read(GInputStream* stream,
+                                            void* buffer,
+                                            gsize count,
+                                            GCancellable* cancellable,
+                                            GError** error) {
+    FmArchiveInputStream* self = FM_ARCHIVE_INPUT_STREAM(stream);
+    la_ssize_t n;
+
+    if (g_cancellable_set_error_if_cancelled(cancellable, error))
+        return -1;
+    n = archive_read_data(self->reader->ar, buffer, count);
+    if (n < 0) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, archive_error_string(self->reader->ar));
+        self->reader->failed = TRUE;
+        return -1;
+    }
+    return (gssize)n;
+}
+
+static gboolean _fm_archive_input_stream_close(GInputStream* stream, GCancellable* cancellable, GError** error) {
+    FmArchiveInputStream* self = FM_ARCHIVE_INPUT_STREAM(stream);
+
+    if (self->reader) {
+        /* the next header skips what is left of the data */
+        fm_archive_reader_park(self->reader);
+        self->reader = NULL;
+    }
+    return TRUE;
+}
+
+static void fm_archive_input_stream_class_init(FmArchiveInputStreamClass* klass) {
+    GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+    GInputStreamClass* stream_class = G_INPUT_STREAM_CLASS(klass);
+
+    gobject_class->finalize = fm_archive_input_stream_finalize;
+
+    stream_class->read_fn = _fm_archive_input_stream_read;
+    stream_class->close_fn = _fm_archive_input_stream_close;
+}
+
+static void fm_archive_input_stream_init(FmArchiveInputStream* stream) {
+    /* nothing */
+}
+
+/* ---- FmArchiveVFile class ---- */
+static void fm_archive_g_file_init(GFileIface* iface);
+static void fm_archive_fm_file_init(FmFileInterface* iface);
+
+G_DEFINE_TYPE_WITH_CODE(FmArchiveVFile,
+                        fm_vfs_archive_file,
+                        G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_FILE, fm_archive_g_file_init)
+                            G_IMPLEMENT_INTERFACE(FM_TYPE_FILE, fm_archive_fm_file_init))
+
+static void fm_vfs_archive_file_finalize(GObject* object) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(object);
+
+    g_free(item->archive);
+    g_free(item->inner);
+
+    G_OBJECT_CLASS(fm_vfs_archive_file_parent_class)->finalize(object);
+}
+
+static void fm_vfs_archive_file_class_init(FmArchiveVFileClass* klass) {
+    GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->finalize = fm_vfs_archive_file_finalize;
+}
+
+static void fm_vfs_archive_file_init(FmArchiveVFile* item) {
+    /* nothing */
+}
+
+/* takes ownership of @archive and @inner */
+static FmArchiveVFile* _fm_archive_vfile_new(char* archive, char* inner) {
+    FmArchiveVFile* item = (FmArchiveVFile*)g_object_new(FM_TYPE_ARCHIVE_VFILE, NULL);
+    item->archive = archive;
+    item->inner = inner;
+    return item;
+}
+
+/* ---- GFile implementation ---- */
+#define ERROR_UNSUPPORTED(err) \
+    g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, _("Operation not supported"))
+
+#define ERROR_READ_ONLY(err) \
+    g_set_error_literal(err, G_IO_ERROR, G_IO_ERROR_READ_ONLY, _("Archives are browsed read-only"))
+
+static GFile* _fm_vfs_archive_dup(GFile* file) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+
+    return (GFile*)_fm_archive_vfile_new(g_strdup(item->archive), g_strdup(item->inner));
+}
+
+static guint _fm_vfs_archive_hash(GFile* file) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+
+    return g_str_hash(item->archive) * 31 + g_str_hash(item->inner);
+}
+
+static gboolean _fm_vfs_archive_equal(GFile* file1, GFile* file2) {
+    FmArchiveVFile* item1 = FM_ARCHIVE_VFILE(file1);
+    FmArchiveVFile* item2 = FM_ARCHIVE_VFILE(file2);
+
+    return g_str_equal(item1->archive, item2->archive) && g_str_equal(item1->inner, item2->inner);
+}
+
+static gboolean _fm_vfs_archive_is_native(GFile* file) {
+    return FALSE;
+}
+
+static gboolean _fm_vfs_archive_has_uri_scheme(GFile* file, const char* uri_scheme) {
+    return g_ascii_strcasecmp(uri_scheme, ARCHIVE_SCHEME) == 0;
+}
+
+static char* _fm_vfs_archive_get_uri_scheme(GFile* file) {
+    return g_strdup(ARCHIVE_SCHEME);
+}
+
+static char* _fm_vfs_archive_get_basename(GFile* file) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    const char* slash;
+
+    if (item->inner[0] == '\0')
+        return g_path_get_basename(item->archive);
+    slash = strrchr(item->inner, '/');
+    return g_strdup(slash ? slash + 1 : item->inner);
+}
+
+static char* _fm_vfs_archive_get_path(GFile* file) {
+    return NULL;
+}
+
+static char* _fm_vfs_archive_get_uri(GFile* file) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    char* archive = g_uri_escape_string(item->archive, NULL, FALSE);
+    char* inner = g_uri_escape_string(item->inner, "/", FALSE);
+    char* uri = g_strconcat(ARCHIVE_URI_PREFIX, archive, "/", inner, NULL);
+
+    g_free(archive);
+    g_free(inner);
+    return uri;
+}
+
+static char* _fm_vfs_archive_get_parse_name(GFile* file) {
+    return _fm_vfs_archive_get_uri(file);
+}
+
+static GFile* _fm_vfs_archive_get_parent(GFile* file) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    const char* slash;
+
+    if (item->inner[0] == '\0') {
+        /* going up from the archive root leads to the folder containing the archive */
+        char* dir = g_path_get_dirname(item->archive);
+        GFile* parent = g_file_new_for_path(dir);
+        g_free(dir);
+        return parent;
+    }
+    slash = strrchr(item->inner, '/');
+    return (GFile*)_fm_archive_vfile_new(g_strdup(item->archive),
+                                         slash ? g_strndup(item->inner, (gsize)(slash - item->inner)) : g_strdup(""));
+}
+
+static gboolean _fm_vfs_archive_prefix_matches(GFile* prefix, GFile* file) {
+    FmArchiveVFile* parent = FM_ARCHIVE_VFILE(prefix);
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    gsize len;
+
+    if (!g_str_equal(parent->archive, item->archive) || item->inner[0] == '\0')
+        return FALSE;
+    len = strlen(parent->inner);
+    if (len == 0)
+        return TRUE;
+    return strncmp(parent->inner, item->inner, len) == 0 && item->inner[len] == '/';
+}
+
+static char* _fm_vfs_archive_get_relative_path(GFile* parent, GFile* descendant) {
+    gsize len;
+
+    if (!_fm_vfs_archive_prefix_matches(parent, descendant))
+        return NULL;
+    len = strlen(FM_ARCHIVE_VFILE(parent)->inner);
+    return g_strdup(FM_ARCHIVE_VFILE(descendant)->inner + (len ? len + 1 : 0));
+}
+
+static GFile* _fm_vfs_archive_resolve_relative_path(GFile* file, const char* relative_path) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    const char* base = (relative_path && relative_path[0] == '/') ? NULL : item->inner;
+
+    return (GFile*)_fm_archive_vfile_new(g_strdup(item->archive),
+                                         fm_archive_join_path(base, relative_path, FALSE));
+}
+
+static GFile* _fm_vfs_archive_get_child_for_display_name(GFile* file, const char* display_name, GError** error) {
+    char* name;
+    GFile* child;
+
+    g_return_val_if_fail(file != NULL, NULL);
+
+    if (display_name == NULL || *display_name == '\0')
+        return g_object_ref(file);
+    name = g_filename_from_utf8(display_name, -1, NULL, NULL, NULL);
+    if (name == NULL) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME, _("Invalid filename %s"), display_name);
+        return NULL;
+    }
+    child = _fm_vfs_archive_resolve_relative_path(file, name);
+    g_free(name);
+    return child;
+}
+
+static GFileEnumerator* _fm_vfs_archive_enumerate_children(GFile* file,
+                                                           const char* attributes,
+                                                           GFileQueryInfoFlags flags,
+                                                           GCancellable* cancellable,
+                                                           GError** error) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    FmVfsArchiveEnumerator* enumerator;
+    FmArchiveIndex* index;
+    guint i;
+
+    index = fm_archive_index_get(item->archive, cancellable, error);
+    if (index == NULL)
+        return NULL;
+    if (item->inner[0] != '\0') {
+        if (!fm_archive_index_lookup(index, item->inner, &i)) {
+            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("No such file or directory"));
+            fm_archive_index_unref(index);
+            return NULL;
+        }
+        if (!S_ISDIR(fm_archive_index_entry(index, i)->mode)) {
+            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_DIRECTORY, _("Not a directory"));
+            fm_archive_index_unref(index);
+            return NULL;
+        }
+    }
+
+    enumerator = g_object_new(FM_TYPE_VFS_ARCHIVE_ENUMERATOR, "container", file, NULL);
+    enumerator->index = index; /* takes the reference */
+    enumerator->children = g_hash_table_lookup(index->children, item->inner);
+    enumerator->pos = 0;
+    return G_FILE_ENUMERATOR(enumerator);
+}
+
+static GFileInfo* _fm_vfs_archive_query_info(GFile* file,
+                                             const char* attributes,
+                                             GFileQueryInfoFlags flags,
+                                             GCancellable* cancellable,
+                                             GError** error) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    FmArchiveIndex* index;
+    GFileInfo* info = NULL;
+    guint i;
+
+    /* all attributes come from the index, so they are set whatever @attributes asks for */
+    index = fm_archive_index_get(item->archive, cancellable, error);
+    if (index == NULL)
+        return NULL;
+    if (item->inner[0] == '\0') {
+        char* name = g_path_get_basename(item->archive);
+        info = _fm_archive_make_info(name, S_IFDIR | 0555, 0, index->id.mtime_sec);
+        g_free(name);
+    }
+    else if (fm_archive_index_lookup(index, item->inner, &i))
+        info = _fm_archive_entry_info(index, i);
+    else
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("No such file or directory"));
+    fm_archive_index_unref(index);
+    return info;
+}
+
+static GFileInfo* _fm_vfs_archive_query_filesystem_info(GFile* file,
+                                                        const char* attributes,
+                                                        GCancellable* cancellable,
+                                                        GError** error) {
+    GFileInfo* info = g_file_info_new();
+
+    g_file_info_set_attribute_string(info, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE, ARCHIVE_SCHEME);
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_FILESYSTEM_READONLY, TRUE);
+    g_file_info_set_attribute_boolean(info, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE, FALSE);
+    return info;
+}
+
+static GMount* _fm_vfs_archive_find_enclosing_mount(GFile* file, GCancellable* cancellable, GError** error) {
+    ERROR_UNSUPPORTED(error);
+    return NULL;
+}
+
+static GFile* _fm_vfs_archive_set_display_name(GFile* file,
+                                               const char* display_name,
+                                               GCancellable* cancellable,
+                                               GError** error) {
+    ERROR_READ_ONLY(error);
+    return NULL;
+}
+
+static GFileAttributeInfoList* _fm_vfs_archive_query_settable_attributes(GFile* file,
+                                                                         GCancellable* cancellable,
+                                                                         GError** error) {
+    return g_file_attribute_info_list_new();
+}
+
+static GFileAttributeInfoList* _fm_vfs_archive_query_writable_namespaces(GFile* file,
+                                                                         GCancellable* cancellable,
+                                                                         GError** error) {
+    return g_file_attribute_info_list_new();
+}
+
+static gboolean _fm_vfs_archive_set_attribute(GFile* file,
+                                              const char* attribute,
+                                              GFileAttributeType type,
+                                              gpointer value_p,
+                                              GFileQueryInfoFlags flags,
+                                              GCancellable* cancellable,
+                                              GError** error) {
+    ERROR_READ_ONLY(error);
+    return FALSE;
+}
+
+static gboolean _fm_vfs_archive_set_attributes_from_info(GFile* file,
+                                                         GFileInfo* info,
+                                                         GFileQueryInfoFlags flags,
+                                                         GCancellable* cancellable,
+                                                         GError** error) {
+    ERROR_READ_ONLY(error);
+    return FALSE;
+}
+
+static GFileInputStream* _fm_vfs_archive_read_fn(GFile* file, GCancellable* cancellable, GError** error) {
+    FmArchiveVFile* item = FM_ARCHIVE_VFILE(file);
+    FmArchiveInputStream* stream;
+    FmArchiveReader* reader;
+    FmArchiveIndex* index;
+    const FmArchiveEntry* e;
+    char* key;
+    guint i;
+
+    if (item->inner[0] == '\0') {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY, _("Can't open directory"));
+        return NULL;
+    }
+    index = fm_archive_index_get(item->archive, cancellable, error);
+    if (index == NULL)
+        return NULL;
+    if (!fm_archive_index_lookup(index, item->inner, &i)) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, _("No such file or directory"));
+        fm_archive_index_unref(index);
+        return NULL;
+    }
+    e = fm_archive_index_entry(index, i);
+    if (S_ISDIR(e->mode)) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY, _("Can't open directory"));
+        fm_archive_index_unref(index);
+        return NULL;
+    }
+
+    key = fm_archive_index_key(&index->id);
+    reader = fm_archive_reader_unpark(key, e->ordinal, (index->id.flags & FM_ARCHIVE_INDEX_SEEKABLE) != 0);
+    g_free(key);
+    if (reader == NULL)
+        reader = fm_archive_reader_open(item->archive, index, e, error);
+    if (reader && !fm_archive_reader_seek(reader, e->ordinal, item->inner, cancellable, error)) {
+        fm_archive_reader_free(reader);
+        reader = NULL;
+    }
+    fm_archive_index_unref(index);
+    if (reader == NULL)
+        return NULL;
+
+    stream = g_object_new(FM_TYPE_ARCHIVE_INPUT_STREAM, NULL);
+    stream->reader = reader;
+    return G_FILE_INPUT_STREAM(stream);
+}
+
+static GFileOutputStream* _fm_vfs_archive_append_to(GFile* file,
+                                                    GFileCreateFlags flags,
+                                                    GCancellable* cancellable,
+                                                    GError** error) {
+    ERROR_READ_ONLY(error);
+    return NULL;
+}
+
+static GFileOutputStream* _fm_vfs_archive_create(GFile* file,
+                                                 GFileCreateFlags flags,
+                                                 GCancellable* cancellable,
+                                                 GError** error) {
+    ERROR_READ_ONLY(error);
+    return NULL;
+}
+
+static GFileOutputStream* _fm_vfs_archive_replace(GFile* file,
+                                                  const char* etag,
+                                                  gboolean make_backup,
+                                                  GFileCreateFlags flags,
+                                                  GCancellable* cancellable,
+                                                  GError** error) {
+    ERROR_READ_ONLY(error);
+    return NULL;
+}
+
+static gboolean _fm_vfs_archive_delete_file(GFile* file, GCancellable* cancellable, GError** error) {
+    ERROR_READ_ONLY(error);
+    return FALSE;
+}
+
+static gboolean _fm_vfs_archive_trash(GFile* file, GCancellable* cancellable, GError** error) {
+    ERROR_READ_ONLY(error);
+    return FALSE;
+}
+
+static gboolean _fm_vfs_archive_make_directory(GFile* file, GCancellable* cancellable, GError** error) {
+    ERROR_READ_ONLY(error);
+    return FALSE;
+}
+
+static gboolean _fm_vfs_archive_make_symbolic_link(GFile* file,
+                                                   const char* symlink_value,
+                                                   GCancellable* cancellable,
+                                                   GError** error) {
+    ERROR_READ_ONLY(error);
+    return FALSE;
+}
+
+static gboolean _fm_vfs_archive_copy(GFile* source,
+                                     GFile* destination,
+                                     GFileCopyFlags flags,
+                                     GCancellable* cancellable,
+                                     GFileProgressCallback progress_callback,
+                                     gpointer progress_callback_data,
+                                     GError** error) {
+    /* let GIO fall back to read_fn + write */
+    ERROR_UNSUPPORTED(error);
+    return FALSE;
+}
+
+static gboolean _fm_vfs_archive_move(GFile* source,
+                                     GFile* destination,
+                                     GFileCopyFlags flags,
+                                     GCancellable* cancellable,
+                                     GFileProgressCallback progress_callback,
+                                     gpointer progress_callback_data,
+                                     GError** error) {
+    ERROR_UNSUPPORTED(error);
+    return FALSE;
+}
+
+static GFileMonitor* _fm_vfs_archive_monitor_dir(GFile* file,
+                                                 GFileMonitorFlags flags,
+                                                 GCancellable* cancellable,
+                                                 GError** error) {
+    ERROR_UNSUPPORTED(error);
+    return NULL;
+}
+
+static GFileMonitor* _fm_vfs_archive_monitor_file(GFile* file,
+                                                  GFileMonitorFlags flags,
+                                                  GCancellable* cancellable,
+                                                  GError** error) {
+    ERROR_UNSUPPORTED(error);
+    return NULL;
+}
+
+#if GLIB_CHECK_VERSION(2, 22, 0)
+static GFileIOStream* _fm_vfs_archive_open_readwrite(GFile* file, GCancellable* cancellable, GError** error) {
+    ERROR_READ_ONLY(error);
+    return NULL;
+}
+
+static GFileIOStream* _fm_vfs_archive_create_readwrite(GFile* file,
+                                                       GFileCreateFlags flags,
+                                                       GCancellable* cancellable,
+                                                       GError** error) {
+    ERROR_READ_ONLY(error);
+    return NULL;
+}
+
+static GFileIOStream* _fm_vfs_archive_replace_readwrite(GFile* file,
+                                                        const char* etag,
+                                                        gboolean make_backup,
+                                                        GFileCreateFlags flags,
+                                                        GCancellable* cancellable,
+                                                        GError** error) {
+    ERROR_READ_ONLY(error);
+    return NULL;
+}
+#endif /* Glib >= 2.22 */
+
+static void fm_archive_g_file_init(GFileIface* iface) {
+    iface->dup = _fm_vfs_archive_dup;
+    iface->hash = _fm_vfs_archive_hash;
+    iface->equal = _fm_vfs_archive_equal;
+    iface->is_native = _fm_vfs_archive_is_native;
+    iface->has_uri_scheme = _fm_vfs_archive_has_uri_scheme;
+    iface->get_uri_scheme = _fm_vfs_archive_get_uri_scheme;
+    iface->get_basename = _fm_vfs_archive_get_basename;
+    iface->get_path = _fm_vfs_archive_get_path;
+    iface->get_uri = _fm_vfs_archive_get_uri;
+    iface->get_parse_name = _fm_vfs_archive_get_parse_name;
+    iface->get_parent = _fm_vfs_archive_get_parent;
+    iface->prefix_matches = _fm_vfs_archive_prefix_matches;
+    iface->get_relative_path = _fm_vfs_archive_get_relative_path;
+    iface->resolve_relative_path = _fm_vfs_archive_resolve_relative_path;
+    iface->get_child_for_display_name = _fm_vfs_archive_get_child_for_display_name;
+    iface->enumerate_children = _fm_vfs_archive_enumerate_children;
+    iface->query_info = _fm_vfs_archive_query_info;
+    iface->query_filesystem_info = _fm_vfs_archive_query_filesystem_info;
+    iface->find_enclosing_mount = _fm_vfs_archive_find_enclosing_mount;
+    iface->set_display_name = _fm_vfs_archive_set_display_name;
+    iface->query_settable_attributes = _fm_vfs_archive_query_settable_attributes;
+    iface->query_writable_namespaces = _fm_vfs_archive_query_writable_namespaces;
+    iface->set_attribute = _fm_vfs_archive_set_attribute;
+    iface->set_attributes_from_info = _fm_vfs_archive_set_attributes_from_info;
+    iface->read_fn = _fm_vfs_archive_read_fn;
+    iface->append_to = _fm_vfs_archive_append_to;
+    iface->create = _fm_vfs_archive_create;
+    iface->replace = _fm_vfs_archive_replace;
+    iface->delete_file = _fm_vfs_archive_delete_file;
+    iface->trash = _fm_vfs_archive_trash;
+    iface->make_directory = _fm_vfs_archive_make_directory;
+    iface->make_symbolic_link = _fm_vfs_archive_make_symbolic_link;
+    iface->copy = _fm_vfs_archive_copy;
+    iface->move = _fm_vfs_archive_move;
+    iface->monitor_dir = _fm_vfs_archive_monitor_dir;
+    iface->monitor_file = _fm_vfs_archive_monitor_file;
+#if GLIB_CHECK_VERSION(2, 22, 0)
+    iface->open_readwrite = _fm_vfs_archive_open_readwrite;
+    iface->create_readwrite = _fm_vfs_archive_create_readwrite;
+    iface->replace_readwrite = _fm_vfs_archive_replace_readwrite;
+    iface->supports_thread_contexts = TRUE;
+#endif /* Glib >= 2.22 */
+}
+
+/* ---- FmFile implementation ---- */
+static gboolean _fm_vfs_archive_wants_incremental(GFile* file) {
+    return FALSE;
+}
+
+static void fm_archive_fm_file_init(FmFileInterface* iface) {
+    iface->wants_incremental = _fm_vfs_archive_wants_incremental;
+}
+
+/* ---- interface for loading ---- */
+GFile* _fm_vfs_archive_new_for_uri(const char* uri) {
+    const char* p;
+    const char* slash;
+    char* escaped;
+    char* archive;
+    char* inner;
+
+    g_return_val_if_fail(uri != NULL, NULL);
+
+    /* skip "archive:" and any number of slashes before the escaped archive path */
+    p = uri + strlen(ARCHIVE_SCHEME ":");
+    if (g_ascii_strncasecmp(uri, ARCHIVE_SCHEME ":", strlen(ARCHIVE_SCHEME ":")) != 0)
+        p = uri;
+    while (*p == '/')
+        ++p;
+    slash = strchr(p, '/');
+    escaped = slash ? g_strndup(p, (gsize)(slash - p)) : g_strdup(p);
+    archive = g_uri_unescape_string(escaped, NULL);
+    g_free(escaped);
+    if (archive == NULL)
+        archive = g_strdup("");
+
+    if (slash) {
+        char* unescaped = g_uri_unescape_string(slash + 1, NULL);
+        inner = fm_archive_join_path(NULL, unescaped ? unescaped : "", FALSE);
+        g_free(unescaped);
+    }
+    else
+        inner = g_strdup("");
+
+    return (GFile*)_fm_archive_vfile_new(archive, inner);
+}
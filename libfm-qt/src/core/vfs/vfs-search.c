@@ -410,6 +410,10 @@ static time_t parse_date_str(const char* str) {
  * If the folder paths and parameters contain invalid characters for a
  * URI, they should be escaped.
  *
+ * NOTE: DirListJob runs searches of local folders with NativeFileSearch
+ * (core/nativefilesearch.cpp), which parses the same format and follows
+ * the same matching rules; keep the two in step.
+ *
  */
 static void parse_search_uri(FmVfsSearchEnumerator* priv, const char* uri_str) {
     const char scheme[] = "search://"; /* NOTE: sizeof(scheme) includes '\0' */
@@ -109,6 +109,12 @@ void DirTreeModelItem::loadFolder() {
             insertFiles(folder_->files());
             onFolderFinishLoading();
         }
+        else if (folder_->isIncremental()) {  // still loading, pick up the batches listed so far
+            auto listed = folder_->files();
+            if (!listed.empty()) {
+                insertFiles(listed);
+            }
+        }
     }
 }
 
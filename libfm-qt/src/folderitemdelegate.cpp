@@ -113,7 +113,8 @@ void FolderItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& op
     }
     // get file info for the item
     auto file = index.data(fileInfoRole_).value<std::shared_ptr<const Fm::FileInfo>>();
-    const auto& emblems = file ? file->emblems() : icon_emblems;
+    // emblems are resolved with the other lazy details, don't block painting on them
+    const auto& emblems = file && file->detailsResolved() ? file->emblems() : icon_emblems;
 
     QStyleOptionViewItem opt = option;
     initStyleOption(&opt, index);
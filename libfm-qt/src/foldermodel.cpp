@@ -33,17 +33,40 @@
 #include <QClipboard>
 #include "utilities.h"
 #include "fileoperation.h"
+#include "core/thumbnailcache.h"
 
 namespace Fm {
 
+namespace {
+
+// shown until the MIME type of a file is resolved in the background
+QIcon placeholderIcon(const FileInfo& info) {
+    static const auto dirIcon = MimeType::inodeDirectory()->icon();
+    static const auto fileIcon = MimeType::fromName("application/octet-stream")->icon();
+    const auto& icon = S_ISDIR(info.mode()) ? dirIcon : fileIcon;
+    return icon ? icon->qicon() : QIcon{};
+}
+
+}  // namespace
+
 FolderModel::FolderModel()
-    : hasPendingThumbnailHandler_{false}, showFullNames_{false}, isLoaded_{false}, hasCutfile_{false} {
+    : hasPendingThumbnailHandler_{false},
+      hasPendingDetailsHandler_{false},
+      detailsJobPriority_{0},
+      showFullNames_{false},
+      isLoaded_{false},
+      hasCutfile_{false} {
     connect(QApplication::clipboard(), &QClipboard::dataChanged, this, &FolderModel::onClipboardDataChange);
 }
 
 FolderModel::~FolderModel() {
-    // if the thumbnail requests list is not empty, cancel them
-    for (auto job : pendingThumbnailJobs_) {
+    for (auto job : thumbnailJobs_) {
+        job->cancel();
+    }
+    for (auto job : externalThumbnailJobs_) {
+        job->cancel();
+    }
+    for (auto job : pendingDetailsJobs_) {
         job->cancel();
     }
 }
@@ -65,6 +88,13 @@ void FolderModel::setFolder(const std::shared_ptr<Fm::Folder>& new_folder) {
             insertFiles(0, folder_->files());
             onClipboardDataChange();  // files may have been cut
         }
+        else if (folder_->isIncremental()) {
+            // batches delivered before we connected; the rest arrive through filesAdded
+            auto listed = folder_->files();
+            if (!listed.empty()) {
+                insertFiles(0, listed);
+            }
+        }
     }
 }
 
@@ -93,6 +123,7 @@ void FolderModel::onFilesAdded(const Fm::FileInfoList& files) {
             hasCutfile_ = true;
         }
 
+        rowOfInfo_[info.get()] = items.size();
         items.append(item);
     }
     endInsertRows();
@@ -103,6 +134,8 @@ void FolderModel::onFilesAdded(const Fm::FileInfoList& files) {
 }
 
 void FolderModel::onFilesChanged(std::vector<Fm::FileInfoPair>& files) {
+    std::vector<int> rows;
+    std::vector<int> resizedRows;
     for (auto& change : files) {
         int row;
         auto& oldInfo = change.first;
@@ -111,47 +144,170 @@ void FolderModel::onFilesChanged(std::vector<Fm::FileInfoPair>& files) {
         if (it != items.end()) {
             FolderModelItem& item = *it;
             // try to update the item
+            rowOfInfo_.erase(oldInfo.get());
+            rowOfInfo_[newInfo.get()] = row;
             item.info = newInfo;
             item.thumbnails.clear();
-            QModelIndex index = createIndex(row, 0, &item);
-            Q_EMIT dataChanged(index, index);
+            item.detailsQueued = false;
+            item.typeQueued = false;
+            rows.push_back(row);
             if (oldInfo->size() != newInfo->size()) {
-                Q_EMIT fileSizeChanged(index);
+                resizedRows.push_back(row);
             }
         }
     }
+    emitRowsChanged(rows);
+    for (int row : resizedRows) {
+        Q_EMIT fileSizeChanged(index(row, 0));
+    }
 }
 
 void FolderModel::onFilesRemoved(const Fm::FileInfoList& files) {
+    std::vector<int> rows;
+    rows.reserve(files.size());
     for (auto& info : files) {
         int row;
-        QList<FolderModelItem>::iterator it = findItemByName(info->name().c_str(), &row);
-        if (it != items.end()) {
-            beginRemoveRows(QModelIndex(), row, row);
-            items.erase(it);
-            endRemoveRows();
+        if (findItemByFileInfo(info.get(), &row) != items.end()
+            // in case the item missed an update of its info
+            || findItemByName(info->name().c_str(), &row) != items.end()) {
+            rows.push_back(row);
+        }
+    }
+    if (rows.empty()) {
+        return;
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    // one removal per run of consecutive rows, the last run first so that the rows before it stay valid
+    for (size_t end = rows.size(); end > 0;) {
+        size_t begin = end - 1;
+        while (begin > 0 && rows[begin - 1] == rows[begin] - 1) {
+            --begin;
+        }
+        int first = rows[begin];
+        int last = rows[end - 1];
+        beginRemoveRows(QModelIndex(), first, last);
+        for (int row = first; row <= last; ++row) {
+            rowOfInfo_.erase(items[row].info.get());
+        }
+        items.erase(items.begin() + first, items.begin() + last + 1);
+        endRemoveRows();
+        end = begin;
+    }
+    // the items after the first removed row have moved up
+    for (int row = rows.front(); row < items.size(); ++row) {
+        rowOfInfo_[items[row].info.get()] = row;
+    }
+}
+
+void FolderModel::emitRowsChanged(std::vector<int>& rows) {
+    std::sort(rows.begin(), rows.end());
+    for (size_t begin = 0; begin < rows.size();) {
+        size_t end = begin + 1;
+        while (end < rows.size() && rows[end] <= rows[end - 1] + 1) {
+            ++end;
         }
+        Q_EMIT dataChanged(index(rows[begin], 0), index(rows[end - 1], NumOfColumns - 1));
+        begin = end;
     }
 }
 
 void FolderModel::loadPendingThumbnails() {
     hasPendingThumbnailHandler_ = false;
+    // One file per job, so that the requests can be reordered while scrolling, and as many jobs as
+    // each pool has threads. External thumbnailers may take long and have jobs of their own, which
+    // do not hold up the images.
+    const auto maxJobs = static_cast<std::size_t>(Fm::ThumbnailJob::threadPool()->maxThreadCount());
+    const auto maxExternalJobs = static_cast<std::size_t>(Fm::ThumbnailJob::externalThreadPool()->maxThreadCount());
+    const bool isRemote = folder_ != nullptr && folder_->isValid() && folder_->info()->isRemoteDirectory();
     for (auto& item : thumbnailData_) {
-        if (!item.pendingThumbnails_.empty()) {
-            auto job =
-                new Fm::ThumbnailJob(std::move(item.pendingThumbnails_), item.size_,
-                                     folder_ != nullptr && folder_->isValid() && folder_->info()->isRemoteDirectory());
-            pendingThumbnailJobs_.push_back(job);
+        auto& pending = item.pendingThumbnails_;
+        auto it = pending.begin();
+        while (it != pending.end() &&
+               (thumbnailJobs_.size() < maxJobs || externalThumbnailJobs_.size() < maxExternalJobs)) {
+            auto file = *it;
+            // another view of the file may have loaded it in the meantime
+            QImage image;
+            if (Fm::ThumbnailCache::globalInstance()->find(*file, item.size_, image)) {
+                it = pending.erase(it);
+                onThumbnailLoaded(file, item.size_, image);
+                continue;
+            }
+            const bool external = Fm::ThumbnailJob::usesExternalThumbnailer(*file);
+            if (external ? externalThumbnailJobs_.size() >= maxExternalJobs : thumbnailJobs_.size() >= maxJobs) {
+                ++it;
+                continue;
+            }
+            it = pending.erase(it);
+            Fm::FileInfoList files;
+            files.push_back(std::move(file));
+            auto job = new Fm::ThumbnailJob(std::move(files), item.size_, isRemote);
             job->setAutoDelete(true);
             connect(job, &Fm::ThumbnailJob::thumbnailLoaded, this, &FolderModel::onThumbnailLoaded,
                     Qt::BlockingQueuedConnection);
             connect(job, &Fm::ThumbnailJob::finished, this, &FolderModel::onThumbnailJobFinished,
                     Qt::BlockingQueuedConnection);
-            Fm::ThumbnailJob::threadPool()->start(job);
+            if (external) {
+                externalThumbnailJobs_.push_back(job);
+                Fm::ThumbnailJob::externalThreadPool()->start(job);
+            }
+            else {
+                // the type of the file may only be resolved by the job
+                job->setExternalDeferred(true);
+                thumbnailJobs_.push_back(job);
+                Fm::ThumbnailJob::threadPool()->start(job);
+            }
         }
     }
 }
 
+void FolderModel::prioritizeThumbnails(const std::vector<int>& rows) {
+    std::unordered_map<const Fm::FileInfo*, int> order;
+    order.reserve(rows.size());
+    thumbnailsOnScreen_.clear();
+    for (int row : rows) {
+        if (row < 0 || row >= items.size()) {
+            continue;
+        }
+        FolderModelItem& item = items[row];
+        order.emplace(item.info.get(), static_cast<int>(order.size()));
+        // what ThumbnailCache dropped while the row was off screen is loaded again now, as it may
+        // have been painted before this call; later drops are left to thumbnailFromIndex()
+        bool reloaded = false;
+        for (auto& thumbnail : item.thumbnails) {
+            QImage image;
+            if (thumbnail.status == FolderModelItem::ThumbnailLoaded &&
+                !Fm::ThumbnailCache::globalInstance()->find(*item.info, thumbnail.size, image)) {
+                queueLoadThumbnail(item.info, thumbnail.size);
+                thumbnail.status = FolderModelItem::ThumbnailLoading;
+                reloaded = true;
+            }
+        }
+        if (!reloaded) {
+            thumbnailsOnScreen_.insert(item.info.get());
+        }
+    }
+    for (auto& data : thumbnailData_) {
+        auto& pending = data.pendingThumbnails_;
+        auto end = std::remove_if(pending.begin(), pending.end(), [this, &order, &data](const auto& file) {
+            if (order.find(file.get()) != order.end()) {
+                return false;
+            }
+            int row;
+            auto it = findItemByFileInfo(file.get(), &row);
+            if (it != items.end()) {
+                it->findThumbnail(data.size_)->status = FolderModelItem::ThumbnailNotChecked;
+            }
+            return true;
+        });
+        pending.erase(end, pending.end());
+        std::stable_sort(pending.begin(), pending.end(), [&order](const auto& a, const auto& b) {
+            return order[a.get()] < order[b.get()];
+        });
+    }
+}
+
 void FolderModel::queueLoadThumbnail(const std::shared_ptr<const Fm::FileInfo>& file, int size) {
     auto it = std::find_if(thumbnailData_.begin(), thumbnailData_.end(),
                            [size](ThumbnailData& item) { return item.size_ == size; });
@@ -164,11 +320,73 @@ void FolderModel::queueLoadThumbnail(const std::shared_ptr<const Fm::FileInfo>&
     }
 }
 
+void FolderModel::queueResolveDetails(FolderModelItem* item, bool typeOnly) const {
+    // a type is queued even if the rest of the details are, its job goes first
+    if (typeOnly ? item->typeQueued : item->detailsQueued) {
+        return;
+    }
+    if (typeOnly) {
+        item->typeQueued = true;
+        pendingTypes_.push_back(item->info);
+    }
+    else {
+        item->detailsQueued = true;
+        pendingDetails_.push_back(item->info);
+    }
+    if (!hasPendingDetailsHandler_) {
+        QTimer::singleShot(0, const_cast<FolderModel*>(this), &FolderModel::resolvePendingDetails);
+        hasPendingDetailsHandler_ = true;
+    }
+}
+
+void FolderModel::resolvePendingDetails() {
+    hasPendingDetailsHandler_ = false;
+    // the rows asked for last are the ones on screen now, so newer jobs go first, and the types
+    // before the emblems, which need more I/O
+    startDetailsJob(pendingDetails_, false);
+    startDetailsJob(pendingTypes_, true);
+}
+
+void FolderModel::startDetailsJob(Fm::FileInfoList& files, bool typeOnly) {
+    if (files.empty()) {
+        return;
+    }
+    auto job = new Fm::FileDetailsJob(std::move(files), typeOnly);
+    files.clear();
+    pendingDetailsJobs_.push_back(job);
+    job->setAutoDelete(true);
+    connect(job, &Fm::FileDetailsJob::detailsResolved, this, &FolderModel::onDetailsResolved,
+            Qt::BlockingQueuedConnection);
+    connect(job, &Fm::FileDetailsJob::finished, this, &FolderModel::onDetailsJobFinished, Qt::BlockingQueuedConnection);
+    Fm::FileDetailsJob::threadPool()->start(job, ++detailsJobPriority_);
+}
+
+void FolderModel::onDetailsJobFinished() {
+    auto job = static_cast<Fm::FileDetailsJob*>(sender());
+    auto it = std::find(pendingDetailsJobs_.cbegin(), pendingDetailsJobs_.cend(), job);
+    if (it != pendingDetailsJobs_.end()) {
+        pendingDetailsJobs_.erase(it);
+    }
+}
+
+void FolderModel::onDetailsResolved(const Fm::FileInfoList& files) {
+    std::vector<int> rows;
+    rows.reserve(files.size());
+    for (auto& file : files) {
+        int row;
+        if (findItemByFileInfo(file.get(), &row) != items.end()) {
+            rows.push_back(row);
+        }
+    }
+    emitRowsChanged(rows);
+}
+
 void FolderModel::insertFiles(int row, const Fm::FileInfoList& files) {
     int n_files = files.size();
     beginInsertRows(QModelIndex(), row, row + n_files - 1);
     for (auto& info : files) {
         FolderModelItem item(info);
+        rowOfInfo_[info.get()] = items.size();
         items.append(item);
     }
     endInsertRows();
@@ -246,7 +464,7 @@ void FolderModel::onClipboardDataChange() {
                 }
                 ++it;
             }
-            Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0));
+            Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0), {FileIsCutRole});
         }
         else if (hasCutfile_) {
             // this folder contained a cut file before but not anymore;
@@ -258,7 +476,7 @@ void FolderModel::onClipboardDataChange() {
                 item.isCut = false;
                 ++it;
             }
-            Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0));
+            Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0), {FileIsCutRole});
         }
     }
 }
@@ -269,6 +487,11 @@ void FolderModel::removeAll() {
     }
     beginRemoveRows(QModelIndex(), 0, items.size() - 1);
     items.clear();
+    rowOfInfo_.clear();
+    thumbnailsOnScreen_.clear();
+    for (auto& data : thumbnailData_) {
+        data.pendingThumbnails_.clear();
+    }
     endRemoveRows();
 }
 
@@ -286,6 +509,16 @@ int FolderModel::columnCount(const QModelIndex& parent = QModelIndex()) const {
     return NumOfColumns;
 }
 
+void FolderModel::setShowFullName(bool fullName) {
+    if (fullName != showFullNames_) {
+        showFullNames_ = fullName;
+        // the displayed names change, and with them the sort keys of proxy models
+        if (!items.isEmpty()) {
+            Q_EMIT dataChanged(index(0, 0), index(items.size() - 1, NumOfColumns - 1));
+        }
+    }
+}
+
 FolderModelItem* FolderModel::itemFromIndex(const QModelIndex& index) const {
     return reinterpret_cast<FolderModelItem*>(index.internalPointer());
 }
@@ -355,6 +588,10 @@ QVariant FolderModel::data(const QModelIndex& index, int role /* = Qt::DisplayRo
                     return (showFullNames_ && !item->name().empty() ? QString::fromStdString(item->name())
                                                                     : item->displayName());
                 case ColumnFileType:
+                    if (!info->typeResolved()) {
+                        queueResolveDetails(item, true);
+                        return QString();
+                    }
                     return QString::fromUtf8(info->mimeType()->desc());
                 case ColumnFileMTime:
                     return item->displayMtime();
@@ -373,6 +610,13 @@ QVariant FolderModel::data(const QModelIndex& index, int role /* = Qt::DisplayRo
         }
         case Qt::DecorationRole: {
             if (index.column() == 0) {
+                // the emblems drawn over the icon need the rest of the details
+                if (!info->detailsResolved()) {
+                    queueResolveDetails(item);
+                }
+                if (!info->typeResolved()) {
+                    return QVariant(placeholderIcon(*info));
+                }
                 return QVariant(item->icon());
             }
             break;
@@ -486,18 +730,12 @@ QList<FolderModelItem>::iterator FolderModel::findItemByName(const char* name, i
 }
 
 QList<FolderModelItem>::iterator FolderModel::findItemByFileInfo(const Fm::FileInfo* info, int* row) {
-    QList<FolderModelItem>::iterator it = items.begin();
-    int i = 0;
-    while (it != items.end()) {
-        FolderModelItem& item = *it;
-        if (item.info.get() == info) {
-            *row = i;
-            return it;
-        }
-        ++it;
-        ++i;
+    auto it = rowOfInfo_.find(info);
+    if (it == rowOfInfo_.end()) {
+        return items.end();
     }
-    return items.end();
+    *row = it->second;
+    return items.begin() + it->second;
 }
 
 QStringList FolderModel::mimeTypes() const {
@@ -664,11 +902,26 @@ void FolderModel::releaseThumbnails(int size) {
 }
 
 void FolderModel::onThumbnailJobFinished() {
-    Fm::ThumbnailJob* job = static_cast<Fm::ThumbnailJob*>(sender());
-    auto it = std::find(pendingThumbnailJobs_.cbegin(), pendingThumbnailJobs_.cend(), job);
-    if (it != pendingThumbnailJobs_.end()) {
-        pendingThumbnailJobs_.erase(it);
+    auto job = static_cast<Fm::ThumbnailJob*>(sender());
+    auto jobIt = std::find(thumbnailJobs_.cbegin(), thumbnailJobs_.cend(), job);
+    if (jobIt != thumbnailJobs_.cend()) {
+        thumbnailJobs_.erase(jobIt);
+        // files that need an external thumbnailer go first to its pool
+        const auto& deferred = job->deferredFiles();
+        auto it = std::find_if(thumbnailData_.begin(), thumbnailData_.end(),
+                               [job](const ThumbnailData& item) { return item.size_ == job->size(); });
+        if (it != thumbnailData_.end() && !deferred.empty()) {
+            it->pendingThumbnails_.insert(it->pendingThumbnails_.begin(), deferred.cbegin(), deferred.cend());
+        }
+    }
+    else {
+        auto it = std::find(externalThumbnailJobs_.cbegin(), externalThumbnailJobs_.cend(), job);
+        if (it == externalThumbnailJobs_.cend()) {
+            return;
+        }
+        externalThumbnailJobs_.erase(it);
     }
+    loadPendingThumbnails();
 }
 
 void FolderModel::onThumbnailLoaded(const std::shared_ptr<const Fm::FileInfo>& file, int size, const QImage& image) {
@@ -679,16 +932,15 @@ void FolderModel::onThumbnailLoaded(const std::shared_ptr<const Fm::FileInfo>& f
         // the file is found in our model
         FolderModelItem& item = *it;
         QModelIndex index = createIndex(row, 0, (void*)&item);
-        // store the image in the folder model item.
+        // the image goes to the shared cache, where the other models and later ones find it
+        Fm::ThumbnailCache::globalInstance()->insert(*file, size, image);
         FolderModelItem::Thumbnail* thumbnail = item.findThumbnail(size);
-        thumbnail->image = image;
         // qDebug("thumbnail loaded for: %s, size: %d", item.displayName.toUtf8().constData(), size);
         if (image.isNull()) {
             thumbnail->status = FolderModelItem::ThumbnailFailed;
         }
         else {
             thumbnail->status = FolderModelItem::ThumbnailLoaded;
-            thumbnail->image = image;
 
             // tell the world that we have the thumbnail loaded
             Q_EMIT thumbnailLoaded(index, size);
@@ -703,15 +955,31 @@ QImage FolderModel::thumbnailFromIndex(const QModelIndex& index, int size) {
     if (item) {
         FolderModelItem::Thumbnail* thumbnail = item->findThumbnail(size);
         // qDebug("FolderModel::thumbnailFromIndex: %d, %s", thumbnail->status, item->displayName.toUtf8().data());
+        QImage image;
         switch (thumbnail->status) {
             case FolderModelItem::ThumbnailNotChecked: {
+                if (Fm::ThumbnailCache::globalInstance()->find(*item->info, size, image)) {
+                    thumbnail->status =
+                        image.isNull() ? FolderModelItem::ThumbnailFailed : FolderModelItem::ThumbnailLoaded;
+                    return image;
+                }
                 // load the thumbnail
                 queueLoadThumbnail(item->info, size);
                 thumbnail->status = FolderModelItem::ThumbnailLoading;
                 break;
             }
             case FolderModelItem::ThumbnailLoaded:
-                return thumbnail->image;
+                if (Fm::ThumbnailCache::globalInstance()->find(*item->info, size, image) && !image.isNull()) {
+                    return image;
+                }
+                // dropped from the cache to stay in its budget, or the file changed; only loaded
+                // again once while on screen, or items that evict each other would never settle
+                if (thumbnailsOnScreen_.erase(item->info.get()) == 0) {
+                    break;
+                }
+                queueLoadThumbnail(item->info, size);
+                thumbnail->status = FolderModelItem::ThumbnailLoading;
+                break;
             default:;
         }
     }
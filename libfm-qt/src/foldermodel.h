@@ -27,12 +27,15 @@
 #include <QImage>
 #include <QList>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <forward_list>
 #include "foldermodelitem.h"
 
 #include "core/folder.h"
 #include "core/thumbnailjob.h"
+#include "core/filedetailsjob.h"
 
 namespace Fm {
 
@@ -90,7 +93,12 @@ class LIBFM_QT_API FolderModel : public QAbstractListModel {
     void cacheThumbnails(int size);
     void releaseThumbnails(int size);
 
-    void setShowFullName(bool fullName) { showFullNames_ = fullName; }
+    // Tells which rows are on screen, in the order they are shown. Thumbnails are generated one file
+    // at a time in that order; those of other rows that are not being generated yet are dropped and
+    // asked for again when the rows are shown.
+    void prioritizeThumbnails(const std::vector<int>& rows);
+
+    void setShowFullName(bool fullName);
 
    Q_SIGNALS:
     void thumbnailLoaded(const QModelIndex& index, int size);
@@ -109,10 +117,16 @@ class LIBFM_QT_API FolderModel : public QAbstractListModel {
     void onThumbnailJobFinished();
     void loadPendingThumbnails();
 
+    void onDetailsResolved(const Fm::FileInfoList& files);
+    void onDetailsJobFinished();
+    void resolvePendingDetails();
+
     void onClipboardDataChange();
 
    protected:
     void queueLoadThumbnail(const std::shared_ptr<const Fm::FileInfo>& file, int size);
+    // With |typeOnly|, only what FileInfo::typeResolved() covers is queued.
+    void queueResolveDetails(FolderModelItem* item, bool typeOnly = false) const;
     void insertFiles(int row, const Fm::FileInfoList& files);
     void removeAll();
     QList<FolderModelItem>::iterator findItemByName(const char* name, int* row);
@@ -121,6 +135,10 @@ class LIBFM_QT_API FolderModel : public QAbstractListModel {
    private:
     QString makeTooltip(FolderModelItem* item) const;
     void updateCutFilesSet();
+    // emits dataChanged() once per run of consecutive rows; |rows| gets sorted
+    void emitRowsChanged(std::vector<int>& rows);
+    // hands |files| to a FileDetailsJob and clears it
+    void startDetailsJob(Fm::FileInfoList& files, bool typeOnly);
 
    private:
     struct ThumbnailData {
@@ -133,11 +151,24 @@ class LIBFM_QT_API FolderModel : public QAbstractListModel {
 
     std::shared_ptr<Fm::Folder> folder_;
     QList<FolderModelItem> items;
+    // the row of each item; the items share their FileInfo objects with the folder
+    std::unordered_map<const Fm::FileInfo*, int> rowOfInfo_;
 
     bool hasPendingThumbnailHandler_;
-    std::vector<Fm::ThumbnailJob*> pendingThumbnailJobs_;
+    std::vector<Fm::ThumbnailJob*> thumbnailJobs_;          // those decoding images, one per pool thread
+    std::vector<Fm::ThumbnailJob*> externalThumbnailJobs_;  // those waiting for external thumbnailers
+    // the files on screen at the last prioritizeThumbnails(); each may be loaded again once
+    // after ThumbnailCache dropped its image, so that items that evict each other settle
+    std::unordered_set<const Fm::FileInfo*> thumbnailsOnScreen_;
     std::forward_list<ThumbnailData> thumbnailData_;
 
+    // files whose lazy details were asked for by a view (see FileInfo::resolveDetails())
+    mutable bool hasPendingDetailsHandler_;
+    mutable Fm::FileInfoList pendingDetails_;
+    mutable Fm::FileInfoList pendingTypes_;  // only the type is needed, e.g. for the type column
+    std::vector<Fm::FileDetailsJob*> pendingDetailsJobs_;
+    int detailsJobPriority_;
+
     bool showFullNames_;
 
     bool isLoaded_;
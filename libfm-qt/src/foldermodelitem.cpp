@@ -25,12 +25,17 @@
 
 namespace Fm {
 
-FolderModelItem::FolderModelItem(const std::shared_ptr<const Fm::FileInfo>& _info) : info{_info}, isCut{false} {
+FolderModelItem::FolderModelItem(const std::shared_ptr<const Fm::FileInfo>& _info)
+    : info{_info}, isCut{false}, detailsQueued{false}, typeQueued{false} {
     thumbnails.reserve(2);
 }
 
 FolderModelItem::FolderModelItem(const FolderModelItem& other)
-    : info{other.info}, thumbnails{other.thumbnails}, isCut{other.isCut} {}
+    : info{other.info},
+      thumbnails{other.thumbnails},
+      isCut{other.isCut},
+      detailsQueued{other.detailsQueued},
+      typeQueued{other.typeQueued} {}
 
 FolderModelItem::~FolderModelItem() {}
 
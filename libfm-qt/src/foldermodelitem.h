@@ -34,10 +34,10 @@ class LIBFM_QT_API FolderModelItem {
    public:
     enum ThumbnailStatus { ThumbnailNotChecked, ThumbnailLoading, ThumbnailLoaded, ThumbnailFailed };
 
+    // the image itself is kept by ThumbnailCache
     struct Thumbnail {
         int size;
         ThumbnailStatus status;
-        QImage image;
     };
 
    public:
@@ -45,7 +45,7 @@ class LIBFM_QT_API FolderModelItem {
     FolderModelItem(const FolderModelItem& other);
     virtual ~FolderModelItem();
 
-    const QString& displayName() const { return info->displayName(); }
+    QString displayName() const { return info->displayName(); }
 
     const std::string& name() const { return info->name(); }
 
@@ -77,6 +77,8 @@ class LIBFM_QT_API FolderModelItem {
     mutable QString dispSize_;
     QList<Thumbnail> thumbnails;
     bool isCut;
+    bool detailsQueued;  // waiting for a FileDetailsJob
+    bool typeQueued;     // waiting for one that only resolves the type
 };
 
 }  // namespace Fm
@@ -30,6 +30,7 @@
 #include "filelauncher.h"
 #include "fileoperation.h"
 #include "utilities.h"
+#include "core/folderprefetcher.h"
 #include <QTimer>
 #include <QDate>
 #include <QDebug>
@@ -860,10 +861,12 @@ FolderView::FolderView(FolderView::ViewMode _mode, QWidget* parent)
       autoSelectionDelay_(600),
       autoSelectionTimer_(nullptr),
       selChangedTimer_(nullptr),
+      thumbnailPriorityTimer_(nullptr),
       itemDelegateMargins_(QSize(3, 3)),
       shadowHidden_(false),
       scrollPerPixel_(true),
       ctrlRightClick_(false),
+      prefetchFolders_(false),
       smoothWheelRemainderVertical_(0),
       smoothWheelRemainderHorizontal_(0),
       smoothScrollTimer_(nullptr) {
@@ -981,6 +984,9 @@ void FolderView::onItemActivated(QModelIndex index) {
 void FolderView::onSelChangedTimeout() {
     selChangedTimer_->deleteLater();
     selChangedTimer_ = nullptr;
+    if (view && view->selectionModel()) {  // keyboard navigation moves the current item
+        prefetchFolderAt(view->selectionModel()->currentIndex());
+    }
     // qDebug()<<"selected:" << nSel;
     Q_EMIT selChanged();
 }
@@ -997,6 +1003,62 @@ void FolderView::onSelectionChanged(const QItemSelection& /*selected*/, const QI
     }
 }
 
+void FolderView::queueThumbnailPriorities() {
+    if (!thumbnailPriorityTimer_) {
+        thumbnailPriorityTimer_ = new QTimer(this);
+        thumbnailPriorityTimer_->setSingleShot(true);
+        connect(thumbnailPriorityTimer_, &QTimer::timeout, this, &FolderView::updateThumbnailPriorities);
+    }
+    // not restarted, so that the priorities keep up with a long scroll
+    if (!thumbnailPriorityTimer_->isActive()) {
+        thumbnailPriorityTimer_->start(100);
+    }
+}
+
+void FolderView::updateThumbnailPriorities() {
+    if (!view || !model_ || !model_->showThumbnails()) {
+        return;
+    }
+    // Items are laid out in the order of their rows in all modes, along the scrolling direction,
+    // so the rows on screen are found by bisection.
+    bool horizontal = false;
+    if (auto listView = qobject_cast<QListView*>(view)) {
+        horizontal = listView->flow() == QListView::TopToBottom && listView->isWrapping();
+    }
+    const QRect viewport = view->viewport()->rect();
+    auto isBefore = [&](int row) {
+        QRect rect = view->visualRect(model_->index(row, 0));
+        return horizontal ? rect.right() < viewport.left() : rect.bottom() < viewport.top();
+    };
+    auto isAfter = [&](int row) {
+        QRect rect = view->visualRect(model_->index(row, 0));
+        return horizontal ? rect.left() > viewport.right() : rect.top() > viewport.bottom();
+    };
+    const int count = model_->rowCount();
+    int low = 0, high = count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (isBefore(mid)) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    const int firstRow = low;
+    high = count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (isAfter(mid)) {
+            high = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    model_->prioritizeThumbnails(firstRow, low - 1);
+}
+
 void FolderView::onClosingEditor(QWidget* editor, QAbstractItemDelegate::EndEditHint hint) {
     if (hint != QAbstractItemDelegate::NoHint) {
         // we set the hint to NoHint in FolderItemDelegate::eventFilter()
@@ -1157,6 +1219,11 @@ void FolderView::setViewMode(ViewMode _mode) {
         // we want the QEvent::HoverMove event for single click + auto-selection support
         view->viewport()->setAttribute(Qt::WA_Hover, true);
         view->setContextMenuPolicy(Qt::NoContextMenu);  // defer the context menu handling to parent widgets
+        // thumbnails of the items that scrolled into view go first
+        connect(view->verticalScrollBar(), &QScrollBar::valueChanged, this, &FolderView::queueThumbnailPriorities,
+                Qt::UniqueConnection);
+        connect(view->horizontalScrollBar(), &QScrollBar::valueChanged, this, &FolderView::queueThumbnailPriorities,
+                Qt::UniqueConnection);
         view->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
         view->setIconSize(iconSize);
 
@@ -1289,6 +1356,18 @@ void FolderView::setAutoSelectionDelay(int delay) {
     }
 }
 
+void FolderView::prefetchFolderAt(const QModelIndex& index) {
+    // hover events come for every move of the mouse, the other columns of the detailed list included
+    if (!prefetchFolders_ || !index.isValid() || lastPrefetchIndex_ == index.siblingAtColumn(0)) {
+        return;
+    }
+    lastPrefetchIndex_ = index.siblingAtColumn(0);
+    auto info = lastPrefetchIndex_.data(FolderModel::FileInfoRole).value<std::shared_ptr<const Fm::FileInfo>>();
+    if (info && !info->isShortcut() && !info->isMountable() && info->isDir()) {
+        FolderPrefetcher::globalInstance()->prefetch(info->path());
+    }
+}
+
 QAbstractItemView* FolderView::childView() const {
     return view;
 }
@@ -1311,6 +1390,9 @@ void FolderView::setModel(ProxyFolderModel* model) {
         delete model_;
     }
     model_ = model;
+    if (model_) {  // sorting and filtering move rows in and out of view too
+        connect(model_, &QAbstractItemModel::layoutChanged, this, &FolderView::queueThumbnailPriorities);
+    }
 }
 
 bool FolderView::event(QEvent* event) {
@@ -1705,6 +1787,7 @@ bool FolderView::eventFilter(QObject* watched, QEvent* event) {
         switch (event->type()) {
             case QEvent::HoverMove:
             case QEvent::HoverEnter:
+                prefetchFolderAt(view->indexAt(static_cast<QHoverEvent*>(event)->position().toPoint()));
                 // activate items on single click
                 if (style()->styleHint(QStyle::SH_ItemView_ActivateItemOnSingleClick)) {
                     QHoverEvent* hoverEvent = static_cast<QHoverEvent*>(event);
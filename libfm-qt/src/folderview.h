@@ -112,6 +112,10 @@ class LIBFM_QT_API FolderView : public QWidget {
 
     void setCtrlRightClick(bool ctrlRightClick);
 
+    // Lets FolderPrefetcher list the folder under the mouse or the current item in advance.
+    bool prefetchFolders() const { return prefetchFolders_; }
+    void setPrefetchFolders(bool prefetch) { prefetchFolders_ = prefetch; }
+
     QList<int> getCustomColumnWidths() const { return customColumnWidths_; }
     void setCustomColumnWidths(const QList<int>& widths);
 
@@ -141,6 +145,8 @@ class LIBFM_QT_API FolderView : public QWidget {
     virtual void prepareFileMenu(Fm::FileMenu* menu);
     virtual void prepareFolderMenu(Fm::FolderMenu* menu);
 
+    void prefetchFolderAt(const QModelIndex& index);
+
     bool eventFilter(QObject* watched, QEvent* event) override;
 
     void updateGridSize();  // called when view mode, icon size, font size or cell margin is changed
@@ -159,6 +165,8 @@ class LIBFM_QT_API FolderView : public QWidget {
    private Q_SLOTS:
     void onAutoSelectionTimeout();
     void onSelChangedTimeout();
+    void queueThumbnailPriorities();
+    void updateThumbnailPriorities();
     void onClosingEditor(QWidget* editor, QAbstractItemDelegate::EndEditHint hint);
     void scrollSmoothly();
 
@@ -186,11 +194,14 @@ class LIBFM_QT_API FolderView : public QWidget {
     QTimer* autoSelectionTimer_;
     QModelIndex lastAutoSelectionIndex_;
     QTimer* selChangedTimer_;
+    QTimer* thumbnailPriorityTimer_;  // limits how often thumbnails are reprioritized while scrolling
     // the cell margins in the icon and thumbnail modes
     QSize itemDelegateMargins_;
     bool shadowHidden_;
     bool scrollPerPixel_;
     bool ctrlRightClick_;  // show folder context menu with Ctrl + right click
+    bool prefetchFolders_;
+    QPersistentModelIndex lastPrefetchIndex_;
 
     // smooth scrolling:
     struct scrollData {
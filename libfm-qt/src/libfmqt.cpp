@@ -40,13 +40,18 @@ struct LibFmQtData {
 static LibFmQtData* theLibFmData = nullptr;
 
 extern "C" {
-GFile* _fm_vfs_search_new_for_uri(const char* uri);  // defined in vfs-search.c
+GFile* _fm_vfs_search_new_for_uri(const char* uri);   // defined in vfs-search.c
+GFile* _fm_vfs_archive_new_for_uri(const char* uri);  // defined in vfs-archive.c
 }
 
 static GFile* lookupSearchUri(GVfs* /*vfs*/, const char* identifier, gpointer /*user_data*/) {
     return _fm_vfs_search_new_for_uri(identifier);
 }
 
+static GFile* lookupArchiveUri(GVfs* /*vfs*/, const char* identifier, gpointer /*user_data*/) {
+    return _fm_vfs_archive_new_for_uri(identifier);
+}
+
 LibFmQtData::LibFmQtData() : refCount(1) {
 #if !GLIB_CHECK_VERSION(2, 36, 0)
     g_type_init();
@@ -63,6 +68,8 @@ LibFmQtData::LibFmQtData() : refCount(1) {
     // register some URI schemes implemented by libfm
     GVfs* vfs = g_vfs_get_default();
     g_vfs_register_uri_scheme(vfs, "search", lookupSearchUri, nullptr, nullptr, lookupSearchUri, nullptr, nullptr);
+    g_vfs_register_uri_scheme(vfs, "archive", lookupArchiveUri, nullptr, nullptr, lookupArchiveUri, nullptr,
+                              nullptr);
 
     // Initialize the backend registry
 }
@@ -72,6 +79,7 @@ LibFmQtData::~LibFmQtData() {
 
     GVfs* vfs = g_vfs_get_default();
     g_vfs_unregister_uri_scheme(vfs, "search");
+    g_vfs_unregister_uri_scheme(vfs, "archive");
 }
 
 LibFmQt::LibFmQt() {
@@ -21,13 +21,96 @@
 #include "foldermodel.h"
 #include <QCollator>
 #include <QApplication>
+#include <QSemaphore>
+#include <QThreadPool>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <optional>
+#include <vector>
 
 namespace Fm {
 
+struct FolderItemSortKey {
+    // the sorted text split at dots, see ProxyFolderModel::lessThan()
+    std::vector<QCollatorSortKey> parts;
+    std::vector<int> partSizes;
+    std::optional<QCollatorSortKey> nameKey;  // of the display name, made when needed to break a tie
+};
+
+namespace {
+
+// with fewer inserted rows, the sort keys are made on first use
+constexpr int kPreparedSortKeyRows = 2000;
+
+bool isTextColumn(int column) {
+    switch (column) {
+        case FolderModel::ColumnFileMTime:
+        case FolderModel::ColumnFileCrTime:
+        case FolderModel::ColumnFileDTime:
+        case FolderModel::ColumnFileSize:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Calls func(begin, end) for chunks of [0, count), for many rows on up to 8 threads. The other
+// threads are only taken from the global pool if they are idle, and the calling thread works on
+// the chunks as well, so it never waits for a busy pool.
+template <typename Func>
+void forEachChunk(size_t count, Func func) {
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const size_t n_chunks = count >= kPreparedSortKeyRows ? qBound(1, pool->maxThreadCount(), 8) : 1;
+    if (n_chunks == 1) {
+        func(0, count);
+        return;
+    }
+    const size_t chunk = (count + n_chunks - 1) / n_chunks;
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t begin; (begin = next.fetch_add(chunk)) < count;) {
+            func(begin, std::min(begin + chunk, count));
+        }
+    };
+    QSemaphore done;
+    int started = 0;
+    for (size_t i = 1; i < n_chunks; ++i) {
+        if (!pool->tryStart([&]() {
+                work();
+                done.release();
+            })) {
+            break;  // no idle thread
+        }
+        ++started;
+    }
+    work();
+    done.acquire(started);
+}
+
+// the same order as comparing the dot-separated parts with QCollator::compare() one by one
+int compareSortKeys(const FolderItemSortKey& left, const FolderItemSortKey& right) {
+    size_t n_parts = std::min(left.parts.size(), right.parts.size());
+    for (size_t i = 0; i < n_parts; ++i) {
+        int comp = left.parts[i].compare(right.parts[i]);
+        if (comp == 0) {
+            // This is a workaround for QCollator's behavior that, for example,
+            // considers "A0" and "A00" equal when the numeric mode is enabled.
+            comp = left.partSizes[i] - right.partSizes[i];
+        }
+        if (comp != 0) {
+            return comp;
+        }
+    }
+    return static_cast<int>(left.parts.size()) - static_cast<int>(right.parts.size());
+}
+
+}  // namespace
+
 ProxyFolderModel::ProxyFolderModel(QObject* parent)
     : QSortFilterProxyModel(parent),
+      sortKeysColumn_(-1),
       showHidden_(false),
       backupAsHidden_(true),
       folderFirst_(true),
@@ -71,12 +154,72 @@ void ProxyFolderModel::setSourceModel(QAbstractItemModel* model) {
             }
         }
     }
+    // connected before QSortFilterProxyModel does, so that the keys follow the source rows before it sorts them
+    if (oldSrcModel) {
+        disconnect(oldSrcModel, &QAbstractItemModel::rowsInserted, this, &ProxyFolderModel::onSourceRowsInserted);
+        disconnect(oldSrcModel, &QAbstractItemModel::rowsRemoved, this, &ProxyFolderModel::onSourceRowsRemoved);
+        disconnect(oldSrcModel, &QAbstractItemModel::dataChanged, this, &ProxyFolderModel::onSourceDataChanged);
+        disconnect(oldSrcModel, &QAbstractItemModel::modelReset, this, &ProxyFolderModel::onSourceLayoutChanged);
+        disconnect(oldSrcModel, &QAbstractItemModel::layoutChanged, this, &ProxyFolderModel::onSourceLayoutChanged);
+        disconnect(oldSrcModel, &QAbstractItemModel::rowsMoved, this, &ProxyFolderModel::onSourceLayoutChanged);
+    }
+    if (model) {
+        connect(model, &QAbstractItemModel::rowsInserted, this, &ProxyFolderModel::onSourceRowsInserted);
+        connect(model, &QAbstractItemModel::rowsRemoved, this, &ProxyFolderModel::onSourceRowsRemoved);
+        connect(model, &QAbstractItemModel::dataChanged, this, &ProxyFolderModel::onSourceDataChanged);
+        connect(model, &QAbstractItemModel::modelReset, this, &ProxyFolderModel::onSourceLayoutChanged);
+        connect(model, &QAbstractItemModel::layoutChanged, this, &ProxyFolderModel::onSourceLayoutChanged);
+        connect(model, &QAbstractItemModel::rowsMoved, this, &ProxyFolderModel::onSourceLayoutChanged);
+    }
+    clearSortKeys(model ? model->rowCount() : 0);
     QSortFilterProxyModel::setSourceModel(model);
 }
 
+void ProxyFolderModel::onSourceRowsInserted(const QModelIndex& /*parent*/, int first, int last) {
+    sortKeys_.insert(sortKeys_.begin() + first, last - first + 1, nullptr);
+    if (last - first + 1 >= kPreparedSortKeyRows && sortColumn() >= 0) {
+        prepareSortKeys(first, last, sortColumn());
+    }
+}
+
+void ProxyFolderModel::onSourceRowsRemoved(const QModelIndex& /*parent*/, int first, int last) {
+    sortKeys_.erase(sortKeys_.begin() + first, sortKeys_.begin() + last + 1);
+}
+
+void ProxyFolderModel::onSourceDataChanged(const QModelIndex& topLeft,
+                                           const QModelIndex& bottomRight,
+                                           const QList<int>& roles) {
+    if (!roles.isEmpty() && !roles.contains(Qt::DisplayRole)) {
+        return;  // e.g. only cut or not
+    }
+    // the file may have been renamed or its type resolved
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        sortKeys_[row].reset();
+    }
+}
+
+void ProxyFolderModel::onSourceLayoutChanged() {
+    clearSortKeys(sourceModel()->rowCount());
+}
+
+void ProxyFolderModel::clearSortKeys(int rowCount) const {
+    sortKeys_.clear();
+    sortKeys_.resize(rowCount);
+}
+
+void ProxyFolderModel::useSortKeysOf(int column) const {
+    if (column != sortKeysColumn_) {
+        clearSortKeys(sortKeys_.size());
+        sortKeysColumn_ = column;
+    }
+}
+
 void ProxyFolderModel::sort(int column, Qt::SortOrder order) {
     int oldColumn = sortColumn();
     Qt::SortOrder oldOrder = sortOrder();
+    if (sourceModel() && column >= 0) {
+        prepareSortKeys(0, sourceModel()->rowCount() - 1, column);
+    }
     QSortFilterProxyModel::sort(column, order);
     if (column != oldColumn || order != oldOrder) {
         Q_EMIT sortFilterChanged();
@@ -120,6 +263,7 @@ void ProxyFolderModel::setHiddenLast(bool hiddenLast) {
 
 void ProxyFolderModel::setSortCaseSensitivity(Qt::CaseSensitivity cs) {
     collator_.setCaseSensitivity(cs);
+    clearSortKeys(sortKeys_.size());
     QSortFilterProxyModel::setSortCaseSensitivity(cs);
     invalidate();
     Q_EMIT sortFilterChanged();
@@ -149,9 +293,11 @@ bool ProxyFolderModel::filterAcceptsRow(int source_row, const QModelIndex& sourc
 bool ProxyFolderModel::lessThan(const QModelIndex& left, const QModelIndex& right) const {
     FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
     // left and right are indexes of source model, not the proxy model.
-    if (srcModel) {
-        auto leftInfo = srcModel->fileInfoFromIndex(left);
-        auto rightInfo = srcModel->fileInfoFromIndex(right);
+    FolderModelItem* leftItem = srcModel ? srcModel->itemFromIndex(left) : nullptr;
+    FolderModelItem* rightItem = srcModel ? srcModel->itemFromIndex(right) : nullptr;
+    if (leftItem && rightItem) {
+        const auto& leftInfo = leftItem->info;
+        const auto& rightInfo = rightItem->info;
 
         if (folderFirst_) {
             bool leftIsFolder = leftInfo->isDir();
@@ -191,49 +337,115 @@ bool ProxyFolderModel::lessThan(const QModelIndex& left, const QModelIndex& righ
                     return leftInfo->size() < rightInfo->size();
                 }
                 break;
-            default: {
-                // To have a more natural sorting like that of GTK, we consider dot
-                // as a separator and compare sub-strings from left to right.
-                // QString::split() is not used because some dots may not be needed.
-                QString leftText = left.data(Qt::DisplayRole).toString();
-                QString rightText = right.data(Qt::DisplayRole).toString();
-                int leftStart = 0, rightStart = 0;
-                int leftEnd = 0, rightEnd = 0;
-                for (;;) {
-                    leftEnd = leftText.indexOf(QLatin1Char('.'), leftStart);
-                    rightEnd = rightText.indexOf(QLatin1Char('.'), rightStart);
-
-                    QString lefPart = leftEnd == -1 ? leftText.sliced(leftStart, leftText.size() - leftStart)
-                                                    : leftText.sliced(leftStart, leftEnd - leftStart);
-                    QString rightPart = rightEnd == -1 ? rightText.sliced(rightStart, rightText.size() - rightStart)
-                                                       : rightText.sliced(rightStart, rightEnd - rightStart);
-                    comp = collator_.compare(lefPart, rightPart);
-                    if (comp == 0) {
-                        // This is a workaround for QCollator's behavior that, for example,
-                        // considers "A0" and "A00" equal when the numeric mode is enabled.
-                        comp = lefPart.size() - rightPart.size();
-                    }
-                    if (comp != 0 || leftEnd == -1 || rightEnd == -1) {
-                        break;
-                    }
-                    leftStart = leftEnd + 1;
-                    rightStart = rightEnd + 1;
-                }
-                if (comp == 0) {
-                    comp = leftEnd - rightEnd;  // covers all remaining cases
-                }
+            default:
+                comp = compareSortKeys(sortKey(leftItem, left), sortKey(rightItem, right));
                 break;
-            }
         }
         // always sort files by their display names when they have the same property
         if (comp == 0) {
-            return collator_.compare(leftInfo->displayName(), rightInfo->displayName()) < 0;
+            return nameSortKey(leftItem, left).compare(nameSortKey(rightItem, right)) < 0;
         }
         return comp < 0;
     }
     return QSortFilterProxyModel::lessThan(left, right);
 }
 
+std::unique_ptr<FolderItemSortKey> ProxyFolderModel::makeSortKey(const QCollator& collator,
+                                                                 int column,
+                                                                 const QString& text) const {
+    auto key = std::make_unique<FolderItemSortKey>();
+    if (isTextColumn(column)) {
+        // To have a more natural sorting like that of GTK, we consider dot
+        // as a separator and compare sub-strings from left to right.
+        // QString::split() is not used because some dots may not be needed.
+        qsizetype start = 0;
+        for (;;) {
+            qsizetype end = text.indexOf(QLatin1Char('.'), start);
+            QString part = text.sliced(start, (end == -1 ? text.size() : end) - start);
+            key->parts.push_back(collator.sortKey(part));
+            key->partSizes.push_back(part.size());
+            if (end == -1) {
+                break;
+            }
+            start = end + 1;
+        }
+    }
+    return key;
+}
+
+FolderItemSortKey& ProxyFolderModel::sortKey(FolderModelItem* item, const QModelIndex& srcIndex) const {
+    useSortKeysOf(srcIndex.column());
+    auto& key = sortKeys_[srcIndex.row()];
+    if (!key) {
+        // The model shows an empty type until a file's details are resolved in the
+        // background; sorting needs the real one.
+        QString text = srcIndex.column() == FolderModel::ColumnFileType ? item->info->description()
+                                                                        : srcIndex.data(Qt::DisplayRole).toString();
+        key = makeSortKey(collator_, srcIndex.column(), text);
+    }
+    return *key;
+}
+
+const QCollatorSortKey& ProxyFolderModel::nameSortKey(FolderModelItem* item, const QModelIndex& srcIndex) const {
+    auto& key = sortKey(item, srcIndex);
+    if (!key.nameKey) {
+        key.nameKey = collator_.sortKey(item->info->displayName());
+    }
+    return *key.nameKey;
+}
+
+void ProxyFolderModel::prepareSortKeys(int first, int last, int column) const {
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    if (!srcModel || !isTextColumn(column)) {
+        return;  // numbers are compared directly, the names only for ties
+    }
+    useSortKeysOf(column);
+    std::vector<int> rows;
+    std::vector<FolderModelItem*> items;
+    std::vector<QString> texts;
+    for (int row = first; row <= last; ++row) {
+        QModelIndex srcIndex = srcModel->index(row, column);
+        FolderModelItem* item = srcModel->itemFromIndex(srcIndex);
+        if (item && !sortKeys_[row]) {
+            rows.push_back(row);
+            items.push_back(item);
+            if (column != FolderModel::ColumnFileType) {
+                texts.push_back(srcIndex.data(Qt::DisplayRole).toString());
+            }
+        }
+    }
+    if (items.empty()) {
+        return;
+    }
+
+    if (column == FolderModel::ColumnFileType) {
+        // resolving the types may need I/O, do it in parallel; MimeType::desc() is not thread-safe though
+        forEachChunk(items.size(), [&items](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                items[i]->info->mimeType();  // not the emblems, only the type is needed
+            }
+        });
+        for (auto item : items) {
+            texts.push_back(item->info->description());
+        }
+    }
+
+    std::vector<std::unique_ptr<FolderItemSortKey>> keys(items.size());
+    forEachChunk(items.size(), [&](size_t begin, size_t end) {
+        // QCollator is only reentrant, every thread needs its own
+        QCollator collator{collator_.locale()};
+        collator.setCaseSensitivity(collator_.caseSensitivity());
+        collator.setNumericMode(collator_.numericMode());
+        collator.setIgnorePunctuation(collator_.ignorePunctuation());
+        for (size_t i = begin; i < end; ++i) {
+            keys[i] = makeSortKey(collator, column, texts[i]);
+        }
+    });
+    for (size_t i = 0; i < rows.size(); ++i) {
+        sortKeys_[rows[i]] = std::move(keys[i]);
+    }
+}
+
 std::shared_ptr<const Fm::FileInfo> ProxyFolderModel::fileInfoFromIndex(const QModelIndex& index) const {
     if (index.isValid()) {
         FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
@@ -311,6 +523,18 @@ void ProxyFolderModel::setThumbnailSize(int size) {
     }
 }
 
+void ProxyFolderModel::prioritizeThumbnails(int firstRow, int lastRow) {
+    FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
+    if (!showThumbnails_ || !thumbnailSize_ || !srcModel) {
+        return;
+    }
+    std::vector<int> srcRows;
+    for (int row = std::max(firstRow, 0); row <= lastRow && row < rowCount(); ++row) {
+        srcRows.push_back(mapToSource(index(row, 0)).row());
+    }
+    srcModel->prioritizeThumbnails(srcRows);
+}
+
 QVariant ProxyFolderModel::data(const QModelIndex& index, int role) const {
     if (index.column() == 0) {  // only show the decoration role for the first column
         if (role == Qt::DecorationRole && showThumbnails_ && thumbnailSize_) {
@@ -25,6 +25,9 @@
 #include <QList>
 #include <QCollator>
 
+#include <memory>
+#include <vector>
+
 #include "core/fileinfo.h"
 
 namespace Fm {
@@ -33,6 +36,7 @@ namespace Fm {
 
 class FolderModelItem;
 class ProxyFolderModel;
+struct FolderItemSortKey;
 
 class LIBFM_QT_API ProxyFolderModelFilter {
    public:
@@ -70,6 +74,9 @@ class LIBFM_QT_API ProxyFolderModel : public QSortFilterProxyModel {
     int thumbnailSize() { return thumbnailSize_; }
     void setThumbnailSize(int size);
 
+    // Tells that the rows from |firstRow| to |lastRow| are on screen, see FolderModel::prioritizeThumbnails().
+    void prioritizeThumbnails(int firstRow, int lastRow);
+
     std::shared_ptr<const Fm::FileInfo> fileInfoFromIndex(const QModelIndex& index) const;
 
     std::shared_ptr<const Fm::FileInfo> fileInfoFromPath(const FilePath& path) const;
@@ -88,6 +95,10 @@ class LIBFM_QT_API ProxyFolderModel : public QSortFilterProxyModel {
 
    protected Q_SLOTS:
     void onThumbnailLoaded(const QModelIndex& srcIndex, int size);
+    void onSourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void onSourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void onSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QList<int>& roles);
+    void onSourceLayoutChanged();
 
    protected:
     bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const override;
@@ -95,7 +106,20 @@ class LIBFM_QT_API ProxyFolderModel : public QSortFilterProxyModel {
     // void reloadAllThumbnails();
 
    private:
+    // Sorting compares collation keys that are made once per source row instead of collating the
+    // texts on every comparison. They are dropped when the row changes, and all of them when the
+    // sort column or the collation settings change.
+    FolderItemSortKey& sortKey(FolderModelItem* item, const QModelIndex& srcIndex) const;
+    const QCollatorSortKey& nameSortKey(FolderModelItem* item, const QModelIndex& srcIndex) const;
+    std::unique_ptr<FolderItemSortKey> makeSortKey(const QCollator& collator, int column, const QString& text) const;
+    void clearSortKeys(int rowCount) const;
+    void useSortKeysOf(int column) const;
+    // makes the missing keys of the source rows first...last, on several threads for many rows
+    void prepareSortKeys(int first, int last, int column) const;
+
     QCollator collator_;
+    mutable std::vector<std::unique_ptr<FolderItemSortKey>> sortKeys_;  // by source row
+    mutable int sortKeysColumn_;                                        // the column they were made for
     bool showHidden_;
     bool backupAsHidden_;
     bool folderFirst_;
@@ -0,0 +1,116 @@
+/*
+ * Benchmark of DirListJob, through GIO and native
+ * libfm-qt/src/tests/bench-dirlist.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+// Times DirListJob on a folder of N generated files, listed through GIO and natively. The GIO job guesses
+// content types while it lists and the native one leaves them to FileInfo, so both runs resolve the type
+// tier (MIME type and icon) of every file within the timing.
+// Usage: bench-dirlist [count...] (default: 100000 1000000)
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../core/dirlistjob.h"
+
+namespace {
+
+const char* const extensions[] = {".txt", ".png", ".c", ".tar.gz", ".desktop", ""};
+
+bool createFiles(const char* dir, long count) {
+    for (long i = 0; i < count; ++i) {
+        Fm::CStrPtr name{g_strdup_printf("%s/file-%07ld%s", dir, i, extensions[i % G_N_ELEMENTS(extensions)])};
+        int fd = open(name.get(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (i % 2 == 0) {  // keep half of them non-empty so that content types are really guessed
+            (void)!write(fd, "hello\n", 6);
+        }
+        close(fd);
+    }
+    return true;
+}
+
+void removeFiles(const char* dir) {
+    if (GDir* gdir = g_dir_open(dir, 0, nullptr)) {
+        while (const char* name = g_dir_read_name(gdir)) {
+            Fm::CStrPtr path{g_build_filename(dir, name, nullptr)};
+            unlink(path.get());
+        }
+        g_dir_close(gdir);
+    }
+    rmdir(dir);
+}
+
+qint64 listOnce(const Fm::FilePath& path, bool native, std::size_t& count) {
+    Fm::DirListJob job{path, Fm::DirListJob::DETAILED};
+    job.setNativeListing(native);
+    QElapsedTimer timer;
+    timer.start();
+    job.run();
+    const auto& files = job.files();
+    for (const auto& file : files) {
+        file->resolveTypeDetails();
+    }
+    count = files.size();
+    return timer.elapsed();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    std::vector<long> counts;
+    for (int i = 1; i < argc; ++i) {
+        counts.push_back(strtol(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts = {100000, 1000000};
+    }
+
+    for (long count : counts) {
+        Fm::CStrPtr dir{g_dir_make_tmp("bench-dirlist-XXXXXX", nullptr)};
+        if (!dir || !createFiles(dir.get(), count)) {
+            qWarning() << "cannot create" << count << "files";
+            return 1;
+        }
+        auto path = Fm::FilePath::fromLocalPath(dir.get());
+        for (bool native : {false, true}) {
+            // the first run warms the dentry and inode caches, keep the best of three
+            qint64 best = -1;
+            std::size_t listed = 0;
+            for (int run = 0; run < 3; ++run) {
+                qint64 ms = listOnce(path, native, listed);
+                if (best < 0 || ms < best) {
+                    best = ms;
+                }
+            }
+            qDebug().noquote() << QStringLiteral("%1 entries, %2: %3 ms (%4 listed)")
+                                      .arg(count)
+                                      .arg(native ? QStringLiteral("native") : QStringLiteral("gio   "))
+                                      .arg(best)
+                                      .arg(listed);
+        }
+        removeFiles(dir.get());
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Benchmark of thumbnail generation at a reduced decoding size
+ * libfm-qt/src/tests/bench-thumbnail.cpp
+ *
+ * Copyright (C) 2026  The libfm-qt authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+// Times thumbnail generation for the images of a folder (a photo corpus), decoding them in full
+// and scaling them as before against ThumbnailJob, which decodes them at a reduced size.
+// Usage: bench-thumbnail [folder] [size] (default: one generated 48 megapixel JPEG, 256)
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QImageReader>
+#include <QDebug>
+#include <cstdlib>
+#include <unistd.h>
+#include "../core/dirlistjob.h"
+#include "../core/thumbnailjob.h"
+
+namespace {
+
+bool createPhoto(const char* dir) {
+    QImage image{8000, 6000, QImage::Format_RGB32};
+    for (int y = 0; y < image.height(); ++y) {
+        auto line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            line[x] = qRgb(x * 255 / image.width(), y * 255 / image.height(), (x ^ y) & 0xff);
+        }
+    }
+    Fm::CStrPtr path{g_build_filename(dir, "photo.jpg", nullptr)};
+    return image.save(QString::fromUtf8(path.get()), "JPEG", 90);
+}
+
+Fm::FileInfoList listImages(const Fm::FilePath& path) {
+    Fm::DirListJob job{path, Fm::DirListJob::DETAILED};
+    job.run();
+    Fm::FileInfoList images;
+    for (auto& file : job.files()) {
+        if (!file->isDir() && file->isImage()) {
+            images.push_back(file);
+        }
+    }
+    return images;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // the generated thumbnails go to a cache of their own, so that none is found from an earlier run
+    Fm::CStrPtr cacheDir{g_dir_make_tmp("bench-thumbnail-cache-XXXXXX", nullptr)};
+    g_setenv("XDG_CACHE_HOME", cacheDir.get(), TRUE);
+    QCoreApplication app(argc, argv);
+
+    Fm::CStrPtr photoDir;
+    Fm::FilePath path;
+    if (argc > 1) {
+        path = Fm::FilePath::fromLocalPath(argv[1]);
+    }
+    else {
+        photoDir = Fm::CStrPtr{g_dir_make_tmp("bench-thumbnail-XXXXXX", nullptr)};
+        if (!photoDir || !createPhoto(photoDir.get())) {
+            qWarning() << "cannot create a photo";
+            return 1;
+        }
+        path = Fm::FilePath::fromLocalPath(photoDir.get());
+    }
+    const int size = argc > 2 ? atoi(argv[2]) : 256;
+    Fm::ThumbnailJob::setMaxThumbnailFileSize(1024 * 1024);  // KiB, no photo is skipped
+
+    auto images = listImages(path);
+    if (images.empty()) {
+        qWarning() << "no image found";
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (auto& file : images) {
+        QImageReader reader{QString::fromUtf8(file->path().localPath().get())};
+        QImage image = reader.read();
+        image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    const qint64 full = timer.restart();
+
+    Fm::ThumbnailJob job{images, size};
+    job.run();
+    const qint64 reduced = timer.elapsed();
+
+    qDebug().noquote() << QStringLiteral("%1 images at %2 px: full decode %3 ms, ThumbnailJob %4 ms")
+                              .arg(images.size())
+                              .arg(size)
+                              .arg(full)
+                              .arg(reduced);
+
+    // ThumbnailJob saved its thumbnails, which are not wanted
+    QDir{QString::fromUtf8(cacheDir.get())}.removeRecursively();
+    if (photoDir) {
+        Fm::CStrPtr photo{g_build_filename(photoDir.get(), "photo.jpg", nullptr)};
+        unlink(photo.get());
+        rmdir(photoDir.get());
+    }
+    return 0;
+}
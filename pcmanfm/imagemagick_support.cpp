@@ -5,7 +5,9 @@
 
 #include "imagemagick_support.h"
 
+#include <QByteArray>
 #include <QFile>
+#include <QSize>
 
 #ifdef HAVE_MAGICKWAND
 #include <MagickWand/MagickWand.h>
@@ -145,7 +147,8 @@ bool writeFilePosix(const QString& path, const unsigned char* data, size_t size)
     return true;
 }
 
-bool loadWandFromFile(MagickWand* wand, const QString& path) {
+// With |sizeHint|, JPEG files are decoded at a reduced scale that is still at least that large.
+bool loadWandFromFile(MagickWand* wand, const QString& path, const QSize& sizeHint = QSize()) {
     if (!wand) {
         return false;
     }
@@ -178,6 +181,11 @@ bool loadWandFromFile(MagickWand* wand, const QString& path) {
         const size_t sourceWidth = MagickGetImageWidth(probe);
         const size_t sourceHeight = MagickGetImageHeight(probe);
 
+        if (sizeHint.isValid()) {
+            // libjpeg scales the DCT by up to 1/8, so a 50 megapixel photo is not decoded in full
+            const QByteArray size = QByteArray::number(sizeHint.width()) + 'x' + QByteArray::number(sizeHint.height());
+            MagickSetOption(wand, "jpeg:size", size.constData());
+        }
         if (dimensionsWithinLimits(sourceWidth, sourceHeight) && ::fseek(stream, 0, SEEK_SET) == 0 &&
             MagickReadImageFile(wand, stream) != MagickFalse) {
             const size_t decodedWidth = MagickGetImageWidth(wand);
@@ -301,7 +309,8 @@ bool ImageMagickSupport::loadThumbnailBuffer(const QString& path, int maxWidth,
     }
 
     MagickWand* wand = NewMagickWand();
-    if (!loadWandFromFile(wand, path)) {
+    // twice the size, so that the final resampling still has enough pixels
+    if (!loadWandFromFile(wand, path, QSize(maxWidth * 2, maxHeight * 2))) {
         DestroyMagickWand(wand);
         return false;
     }
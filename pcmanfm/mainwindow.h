@@ -163,6 +163,7 @@ class MainWindow : public QMainWindow {
     void on_actionCreateLauncher_triggered();
     void on_actionCopyFullPath_triggered();
     void on_actionFindFiles_triggered();
+    void on_actionDiskUsage_triggered();
 
     void on_actionAbout_triggered();
     void on_actionHiddenShortcuts_triggered();
@@ -6,8 +6,10 @@
 #include "application.h"
 #include "mainwindow.h"
 #include "tabpage.h"
+#include "../src/ui/diskusagewindow.h"
 
 // Qt Headers
+#include <QMessageBox>
 #include <QStandardPaths>
 #include <QTimer>
 
@@ -138,6 +140,22 @@ void MainWindow::on_actionFindFiles_triggered() {
     app->findFiles(paths);
 }
 
+void MainWindow::on_actionDiskUsage_triggered() {
+    TabPage* page = currentPage();
+    if (!page) {
+        return;
+    }
+    const Panel::FilePath path = page->path();
+    if (!path || !path.isNative()) {
+        QMessageBox::warning(this, tr("Disk Usage"), tr("Disk usage is only available for local folders."));
+        return;
+    }
+    auto* window = new DiskUsageWindow();
+    window->resize(960, 720);
+    window->show();
+    window->scan(path);
+}
+
 void MainWindow::on_actionOpenTerminal_triggered() {
     if (TabPage* page = currentPage()) {
         static_cast<Application*>(qApp)->openFolderInTerminal(page->path());
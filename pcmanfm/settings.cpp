@@ -226,6 +226,7 @@ bool Settings::loadFile(QString filePath) {
     setMaxThumbnailFileSize(settings.value(QStringLiteral("MaxThumbnailFileSize"), 4096).toInt());
     setMaxExternalThumbnailFileSize(settings.value(QStringLiteral("MaxExternalThumbnailFileSize"), -1).toInt());
     setThumbnailLocalFilesOnly(settings.value(QStringLiteral("ThumbnailLocalFilesOnly"), true).toBool());
+    setPackedThumbnailStore(settings.value(QStringLiteral("PackedThumbnailStore"), false).toBool());
     settings.endGroup();
 
     settings.beginGroup(QStringLiteral("FolderView"));
@@ -346,6 +347,7 @@ bool Settings::saveFile(QString filePath) {
     settings.setValue(QStringLiteral("MaxThumbnailFileSize"), maxThumbnailFileSize());
     settings.setValue(QStringLiteral("MaxExternalThumbnailFileSize"), maxExternalThumbnailFileSize());
     settings.setValue(QStringLiteral("ThumbnailLocalFilesOnly"), thumbnailLocalFilesOnly());
+    settings.setValue(QStringLiteral("PackedThumbnailStore"), packedThumbnailStore());
     settings.endGroup();
 
     settings.beginGroup(QStringLiteral("FolderView"));
@@ -382,6 +382,10 @@ class Settings : public QObject {
 
     void setMaxExternalThumbnailFileSize(int size) { Panel::ThumbnailJob::setMaxExternalThumbnailFileSize(size); }
 
+    bool packedThumbnailStore() const { return Panel::ThumbnailJob::packedStoreEnabled(); }
+
+    void setPackedThumbnailStore(bool value) { Panel::ThumbnailJob::setPackedStoreEnabled(value); }
+
     void setThumbnailIconSize(int thumbnailIconSize) { thumbnailIconSize_ = thumbnailIconSize; }
 
     bool siUnit() { return siUnit_; }
@@ -176,6 +176,7 @@ TabPage::TabPage(QWidget* parent)
     folderView_ = new View(settings.viewMode(), this);
     folderView_->setMargins(settings.folderViewCellMargins());
     folderView_->setShadowHidden(settings.shadowHidden());
+    folderView_->setPrefetchFolders(true);
 
     connect(folderView_, &View::selChanged, this, &TabPage::onSelChanged);
     connect(folderView_, &View::clickedBack, this, &TabPage::backwardRequested);
@@ -549,11 +550,28 @@ void TabPage::onFolderFinishLoading() {
         overrideCursor_ = false;
     }
 
+    prefetchNeighbours();
+
     // After finishing loading the folder, the model is updated, but Qt delays the
     // UI update for performance reasons. We use a singleShot to wait for it.
     QTimer::singleShot(kUiUpdateDelay, this, &TabPage::onUiUpdated);
 }
 
+void TabPage::prefetchNeighbours() {
+    // the last request goes first: going back is the most likely, then up, then forward
+    auto prefetcher = Panel::FolderPrefetcher::globalInstance();
+    const int current = history_.currentIndex();
+    if (history_.canForward()) {
+        prefetcher->prefetch(history_.at(current + 1).path());
+    }
+    if (auto parent = folder_->path().parent()) {
+        prefetcher->prefetch(parent);
+    }
+    if (history_.canBackward()) {
+        prefetcher->prefetch(history_.at(current - 1).path());
+    }
+}
+
 void TabPage::onFolderError(const Panel::GErrorPtr& err,
                             Panel::Job::ErrorSeverity severity,
                             Panel::Job::ErrorAction& response) {
@@ -681,7 +699,11 @@ void TabPage::chdir(Panel::FilePath newPath, bool addHistory) {
     localizeTitle(newPath);
     Q_EMIT titleChanged();
 
+    auto prefetcher = Panel::FolderPrefetcher::globalInstance();
+    prefetcher->noteOpened(newPath);
     folder_ = Panel::Folder::fromPath(newPath);
+    // what was likely next from the previous folder is not any more
+    prefetcher->cancelAll();
     if (addHistory) {
         // add current path to browse history
         history_.add(path());
@@ -235,6 +235,7 @@ class TabPage : public QWidget {
 
    private:
     void freeFolder();
+    void prefetchNeighbours();  // the folders the user may go to from here
     QScrollBar* historyScrollBar() const;
     int currentHistoryScrollPos() const;
     void saveCurrentHistoryScrollPos();
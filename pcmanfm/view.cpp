@@ -20,6 +20,7 @@
 #include <QInputDialog>
 #include <QLabel>
 #include <QLineEdit>
+#include <QLocale>
 #include <QMessageBox>
 #include <QPointer>
 #include <QPushButton>
@@ -56,6 +57,7 @@
 #include "../src/core/fs_ops.h"
 #include "../src/ui/archivejob.h"
 #include "../src/ui/archiveextractjob.h"
+#include "../src/ui/archivetestjob.h"
 #include "../src/ui/hexeditorwindow.h"
 #include "../src/ui/disassemblywindow.h"
 #include "../src/ui/binarydocument.h"
@@ -116,6 +118,23 @@ bool isSupportedArchive(const QString& path, QString* destinationOut) {
     return true;
 }
 
+// Splits an archive:///<escaped archive path>/<inner path> URI produced by the archive VFS.
+bool parseArchiveUri(const QByteArray& uri, QString* archivePath, QString* innerPath) {
+    static const QByteArray prefix = QByteArrayLiteral("archive:///");
+    if (!uri.startsWith(prefix)) {
+        return false;
+    }
+    const QByteArray rest = uri.mid(prefix.size());
+    const int slash = rest.indexOf('/');
+    const QByteArray archive = QByteArray::fromPercentEncoding(slash < 0 ? rest : rest.left(slash));
+    if (archive.isEmpty()) {
+        return false;
+    }
+    *archivePath = QFile::decodeName(archive);
+    *innerPath = slash < 0 ? QString() : QFile::decodeName(QByteArray::fromPercentEncoding(rest.mid(slash + 1)));
+    return true;
+}
+
 bool isDisassemblySupported(const QString& path) {
     PCManFM::BinaryDocument doc;
     QString error;
@@ -658,7 +677,20 @@ void View::startArchiveCompression(const QStringList& paths) {
     dialog->show();
 }
 
-void View::startArchiveExtraction(const QString& archivePath, const QString& destinationDir) {
+void View::browseArchive(const QString& archivePath) {
+    auto* mainWindow = qobject_cast<MainWindow*>(window());
+    if (!mainWindow) {
+        return;
+    }
+    // archive:///<escaped archive path>/ is served by the read-only archive VFS in libfm-qt
+    const QByteArray uri =
+        QByteArrayLiteral("archive:///") + QFile::encodeName(archivePath).toPercentEncoding() + QByteArrayLiteral("/");
+    mainWindow->chdir(Panel::FilePath::fromUri(uri.constData()));
+}
+
+void View::startArchiveExtraction(const QString& archivePath,
+                                  const QString& destinationDir,
+                                  const QStringList& selectedEntries) {
     auto* job = new ArchiveExtractJob(this);
     auto* dialog = new QProgressDialog(tr("Extracting archive…"), tr("Cancel"), 0, 0, window());
     dialog->setWindowModality(Qt::WindowModal);
@@ -693,7 +725,79 @@ void View::startArchiveExtraction(const QString& archivePath, const QString& des
         }
     });
 
-    job->start(archivePath, destinationDir);
+    job->start(archivePath, destinationDir, selectedEntries);
+    dialog->show();
+}
+
+void View::startArchiveTest(const QStringList& archivePaths) {
+    auto* job = new ArchiveTestJob(this);
+    auto* dialog = new QProgressDialog(tr("Testing archive…"), tr("Cancel"), 0, 0, window());
+    dialog->setWindowModality(Qt::WindowModal);
+    dialog->setAutoClose(false);
+    dialog->setAutoReset(false);
+    dialog->setMinimumDuration(0);
+    dialog->setValue(0);
+    dialog->setLabelText(tr("Testing files…"));
+
+    connect(dialog, &QProgressDialog::canceled, job, &ArchiveTestJob::cancel);
+    connect(job, &ArchiveTestJob::progress, this, [dialog](quint64 done, quint64 total, const QString& current) {
+        if (total > 0 && total <= static_cast<quint64>(std::numeric_limits<int>::max())) {
+            if (dialog->maximum() != static_cast<int>(total)) {
+                dialog->setMaximum(static_cast<int>(total));
+            }
+            dialog->setValue(static_cast<int>(std::min<quint64>(done, total)));
+        }
+        else {
+            dialog->setMaximum(0);
+        }
+        if (!current.isEmpty()) {
+            dialog->setLabelText(tr("Testing %1").arg(current));
+        }
+    });
+    connect(job, &ArchiveTestJob::finished, this,
+            [this, dialog, job](bool ok, const QList<ArchiveTestJob::Result>& results) {
+                dialog->hide();
+                dialog->deleteLater();
+                job->deleteLater();
+
+                const QLocale locale;
+                QStringList lines;
+                for (const auto& result : results) {
+                    const double rate = result.seconds > 0.0 ? result.bytesDecoded / result.seconds : 0.0;
+                    lines << tr("%1: %2").arg(result.archivePath, result.success ? tr("OK") : tr("FAILED"));
+                    lines << tr("    %1 entries, %2 decoded from %3 in %4 s (%5/s)")
+                                 .arg(result.entries)
+                                 .arg(locale.formattedDataSize(static_cast<qint64>(result.bytesDecoded)))
+                                 .arg(locale.formattedDataSize(static_cast<qint64>(result.bytesRead)))
+                                 .arg(result.seconds, 0, 'f', 2)
+                                 .arg(locale.formattedDataSize(static_cast<qint64>(rate)));
+                    for (const auto& failure : result.failures) {
+                        lines << QStringLiteral("    ! %1: %2").arg(failure.path, failure.message);
+                    }
+                    if (!result.success && result.failures.isEmpty() && !result.error.isEmpty()) {
+                        lines << QStringLiteral("    ! %1").arg(result.error);
+                    }
+                }
+
+                auto* report = new QDialog(window());
+                report->setAttribute(Qt::WA_DeleteOnClose);
+                report->setWindowTitle(ok ? tr("Archive test passed") : tr("Archive test failed"));
+                report->setMinimumWidth(640);
+                report->setSizeGripEnabled(true);
+                auto* layout = new QVBoxLayout(report);
+                auto* text = new QPlainTextEdit(report);
+                text->setReadOnly(true);
+                text->setLineWrapMode(QPlainTextEdit::NoWrap);
+                text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+                text->setPlainText(lines.join(QLatin1Char('\n')));
+                layout->addWidget(text);
+                auto* buttons = new QDialogButtonBox(QDialogButtonBox::Close, report);
+                connect(buttons, &QDialogButtonBox::rejected, report, &QDialog::reject);
+                layout->addWidget(buttons);
+                report->show();
+            });
+
+    job->start(archivePaths);
     dialog->show();
 }
 
@@ -952,6 +1056,7 @@ void View::prepareFileMenu(Panel::FileMenu* menu) {
     }
 
     QStringList compressPaths;
+    QStringList testPaths;
     QString extractArchivePath;
     QString extractDestination;
     if (allNative && !files.empty()) {
@@ -968,6 +1073,9 @@ void View::prepareFileMenu(Panel::FileMenu* menu) {
             }
             const QString pathStr = QString::fromUtf8(localPath.get());
             compressPaths << pathStr;
+            if (!fi->isDir() && isSupportedArchive(pathStr, nullptr)) {
+                testPaths << pathStr;
+            }
             if (files.size() == 1 && !fi->isDir() && extractArchivePath.isEmpty()) {
                 QString candidateDestination;
                 if (isSupportedArchive(pathStr, &candidateDestination)) {
@@ -976,6 +1084,9 @@ void View::prepareFileMenu(Panel::FileMenu* menu) {
                 }
             }
         }
+        if (testPaths.size() != compressPaths.size()) {
+            testPaths.clear();
+        }
         if (files.size() == 1 && extractArchivePath == compressPaths.value(0)) {
             // Do not offer "Compress" when right-clicking an archive itself
             compressPaths.clear();
@@ -990,6 +1101,47 @@ void View::prepareFileMenu(Panel::FileMenu* menu) {
             startArchiveExtraction(extractArchivePath, extractDestination);
         });
         menu->insertAction(menu->separator3(), action);
+
+        auto* browseAction =
+            new QAction(QIcon::fromTheme(QStringLiteral("folder-open")), tr("Browse Archive"), menu);
+        connect(browseAction, &QAction::triggered, this, [this, extractArchivePath] {
+            browseArchive(extractArchivePath);
+        });
+        menu->insertAction(menu->separator3(), browseAction);
+    }
+
+    // Any number of local archives can be verified in one batch
+    if (!testPaths.isEmpty()) {
+        auto* action = new QAction(QIcon::fromTheme(QStringLiteral("dialog-ok")),
+                                   testPaths.size() > 1 ? tr("Test Archives") : tr("Test Archive"), menu);
+        connect(action, &QAction::triggered, this, [this, testPaths] { startArchiveTest(testPaths); });
+        menu->insertAction(menu->separator3(), action);
+    }
+
+    // Files shown through the archive VFS can be pulled out without extracting the whole archive
+    if (folder() && folder()->path().hasUriScheme("archive") && !files.empty()) {
+        QString selectedArchive;
+        QStringList selectedEntries;
+        for (const auto& fi : files) {
+            QString archivePath;
+            QString innerPath;
+            if (!fi || !parseArchiveUri(QByteArray(fi->path().uri().get()), &archivePath, &innerPath) ||
+                innerPath.isEmpty() || (!selectedArchive.isEmpty() && archivePath != selectedArchive)) {
+                selectedEntries.clear();
+                break;
+            }
+            selectedArchive = archivePath;
+            selectedEntries << innerPath;
+        }
+        QString destination;
+        if (!selectedEntries.isEmpty() && isSupportedArchive(selectedArchive, &destination)) {
+            auto* action =
+                new QAction(QIcon::fromTheme(QStringLiteral("archive-extract")), tr("Extract Selected"), menu);
+            connect(action, &QAction::triggered, this, [this, selectedArchive, destination, selectedEntries] {
+                startArchiveExtraction(selectedArchive, destination, selectedEntries);
+            });
+            menu->insertAction(menu->separator3(), action);
+        }
     }
 
     if (!compressPaths.isEmpty()) {
@@ -67,7 +67,11 @@ class View : public Panel::FolderView {
     void launchFiles(Panel::FileInfoList files, bool inNewTabs = false);
     void openFolderAndSelectFile(const std::shared_ptr<const Panel::FileInfo>& fileInfo, bool inNewTab = false);
     void startArchiveCompression(const QStringList& paths);
-    void startArchiveExtraction(const QString& archivePath, const QString& destinationDir);
+    void startArchiveExtraction(const QString& archivePath,
+                                const QString& destinationDir,
+                                const QStringList& selectedEntries = {});
+    void browseArchive(const QString& archivePath);
+    void startArchiveTest(const QStringList& archivePaths);
     static void removeLibfmArchiverActions(Panel::FileMenu* menu);
 
     void setupThumbnailHooks();
@@ -5,19 +5,29 @@
 
 #include "archive_extract.h"
 
+#include "bounded_queue.h"
 #include "fs_ops.h"
+#include "seekable_zstd.h"
 
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <string_view>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -142,6 +152,99 @@ std::string parent_dir(const std::string& path) {
     return path.substr(0, pos);
 }
 
+// Applies Options::filter to sanitized entry paths and tracks which explicitly listed paths are
+// still outstanding so the caller can stop reading a streaming archive early.
+class EntrySelector {
+   public:
+    explicit EntrySelector(const EntryFilter& filter) : filter_(filter) {
+        for (const auto& p : filter_.paths) {
+            std::string rel = sanitize_path(p.c_str());
+            if (!rel.empty()) {
+                pending_.insert(rel);
+                paths_.insert(std::move(rel));
+            }
+        }
+    }
+
+    bool active() const { return !filter_.empty(); }
+
+    bool matches(const std::string& rel, bool isDir) {
+        if (!active()) {
+            return true;
+        }
+
+        if (paths_.count(rel) != 0) {
+            if (isDir) {
+                subtreeSelected_ = true;  // children may appear anywhere later in the stream
+            }
+            else {
+                pending_.erase(rel);
+            }
+            return true;
+        }
+        if (const std::string* dir = selected_parent(rel)) {
+            subtreeSelected_ = true;
+            pending_.erase(*dir);
+            return true;
+        }
+        return matches_pattern(rel);
+    }
+
+    // Side-effect free variant of matches(), for entries that are not read in archive order.
+    bool selects(const std::string& rel) const {
+        return !active() || covers(rel) || matches_pattern(rel);
+    }
+
+    // Only plain path lists can be resolved through a seekable archive's entry index.
+    bool path_list_only() const { return !paths_.empty() && filter_.globs.empty() && !filter_.predicate; }
+
+    // Whether the explicit path list selects |rel|, itself or through one of its parents.
+    bool covers(const std::string& rel) const { return paths_.count(rel) != 0 || selected_parent(rel); }
+
+    // True once nothing later in the archive can be selected anymore. Only explicit file lists
+    // can finish early; globs, predicates and directory subtrees need the whole stream.
+    bool exhausted() const {
+        return active() && !paths_.empty() && pending_.empty() && !subtreeSelected_ && filter_.globs.empty() &&
+               !filter_.predicate;
+    }
+
+   private:
+    // The listed path that is a parent directory of |rel|, if any.
+    const std::string* selected_parent(const std::string& rel) const {
+        if (paths_.empty()) {
+            return nullptr;
+        }
+        for (auto pos = rel.find('/'); pos != std::string::npos; pos = rel.find('/', pos + 1)) {
+            prefix_.assign(rel, 0, pos);
+            const auto it = paths_.find(prefix_);
+            if (it != paths_.end()) {
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    bool matches_pattern(const std::string& rel) const {
+        if (!filter_.globs.empty()) {
+            const auto slash = rel.find_last_of('/');
+            const char* base = rel.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+            for (const auto& g : filter_.globs) {
+                const bool fullPath = g.find('/') != std::string::npos;
+                if (::fnmatch(g.c_str(), fullPath ? rel.c_str() : base, fullPath ? FNM_PATHNAME : 0) == 0) {
+                    return true;
+                }
+            }
+        }
+        return filter_.predicate && filter_.predicate(rel);
+    }
+
+    const EntryFilter& filter_;
+    std::unordered_set<std::string> paths_;
+    std::unordered_set<std::string> pending_;
+    mutable std::string prefix_;  // reused by selected_parent()
+    bool subtreeSelected_ = false;
+};
+
 bool ensure_destination_root(const std::string& destinationDir, Error& err) {
     struct stat st{};
     if (::lstat(destinationDir.c_str(), &st) == 0) {
@@ -340,15 +443,13 @@ bool write_all(int fd, const void* data, std::size_t size, off_t offset, Error&
     return true;
 }
 
-bool extract_regular_file(struct archive* ar,
-                          archive_entry* entry,
-                          const std::string& fullPath,
-                          const std::string& relPath,
-                          const std::string& destinationDir,
-                          const Options& opts,
-                          ProgressInfo& progress,
-                          const ProgressCallback& cb,
-                          Error& err) {
+bool open_output_file(archive_entry* entry,
+                      const std::string& fullPath,
+                      const std::string& relPath,
+                      const std::string& destinationDir,
+                      const Options& opts,
+                      Fd& fd,
+                      Error& err) {
     if (!ensure_parent_dirs(destinationDir, parent_dir(relPath), err)) {
         return false;
     }
@@ -366,11 +467,37 @@ bool extract_regular_file(struct archive* ar,
         mode = 0666;
     }
 
-    Fd fd(::open(fullPath.c_str(), flags, mode));
+    fd = Fd(::open(fullPath.c_str(), flags, mode));
     if (!fd.valid()) {
         set_error(err, "open");
         return false;
     }
+    return true;
+}
+
+bool finish_output_file(int fd, const std::string& fullPath, archive_entry* entry, const Options& opts, Error& err) {
+    Error xerr;
+    if (!apply_xattrs(fd, fullPath, entry, opts, xerr)) {
+        err = xerr;
+        return false;
+    }
+    apply_metadata(fd, fullPath, entry, opts, false);
+    return true;
+}
+
+bool extract_regular_file(struct archive* ar,
+                          archive_entry* entry,
+                          const std::string& fullPath,
+                          const std::string& relPath,
+                          const std::string& destinationDir,
+                          const Options& opts,
+                          ProgressInfo& progress,
+                          const ProgressCallback& cb,
+                          Error& err) {
+    Fd fd;
+    if (!open_output_file(entry, fullPath, relPath, destinationDir, opts, fd, err)) {
+        return false;
+    }
 
     const void* buff = nullptr;
     std::size_t size = 0;
@@ -399,12 +526,9 @@ bool extract_regular_file(struct archive* ar,
         }
     }
 
-    Error xerr;
-    if (!apply_xattrs(fd.fd, fullPath, entry, opts, xerr)) {
-        err = xerr;
+    if (!finish_output_file(fd.fd, fullPath, entry, opts, err)) {
         return false;
     }
-    apply_metadata(fd.fd, fullPath, entry, opts, false);
     progress.filesDone += 1;
     return true;
 }
@@ -500,6 +624,528 @@ bool extract_hardlink(archive_entry* entry,
     return true;
 }
 
+bool extract_entry(struct archive* ar,
+                   archive_entry* entry,
+                   const std::string& rel,
+                   const std::string& destinationDir,
+                   const Options& opts,
+                   ProgressInfo& progress,
+                   const ProgressCallback& cb,
+                   Error& err) {
+    std::string fullPath = destinationDir;
+    fullPath.push_back('/');
+    fullPath += rel;
+
+    bool ok = true;
+    if (archive_entry_hardlink(entry)) {
+        ok = extract_hardlink(entry, fullPath, rel, destinationDir, progress, err);
+        archive_read_data_skip(ar);
+        return ok;
+    }
+
+    switch (archive_entry_filetype(entry)) {
+        case AE_IFREG:
+            return extract_regular_file(ar, entry, fullPath, rel, destinationDir, opts, progress, cb, err);
+        case AE_IFDIR:
+            ok = extract_directory(entry, fullPath, rel, destinationDir, opts, progress, err);
+            break;
+        case AE_IFLNK:
+            ok = extract_symlink(entry, fullPath, rel, destinationDir, opts, progress, err);
+            break;
+        default:
+            break;  // unsupported special files or metadata entries
+    }
+    archive_read_data_skip(ar);
+    return ok;
+}
+
+struct EntryDeleter {
+    void operator()(archive_entry* e) const { archive_entry_free(e); }
+};
+using EntryPtr = std::unique_ptr<archive_entry, EntryDeleter>;
+
+// Unit of work handed from the decode thread to a writer. The first item of an entry carries
+// its cloned header; regular files follow with data items and a closing |last| item.
+struct WriteItem {
+    EntryPtr entry;
+    std::string relPath;
+    std::vector<std::uint8_t> data;
+    std::uint64_t offset = 0;
+    bool last = false;
+};
+
+// Rough queue cost of a header so archives of tiny files are bounded too.
+constexpr std::size_t kWriteItemCost = 512;
+
+// Writer threads for the pipelined extraction path. Each writer owns a queue; entries are
+// routed by path so everything touching one path (including hardlinks onto it) is handled by a
+// single writer in archive order, while unrelated files are created in parallel.
+class WriterPool {
+   public:
+    WriterPool(unsigned threads, std::size_t queueBytes, const std::string& destinationDir, const Options& opts)
+        : destinationDir_(destinationDir), opts_(opts) {
+        const std::size_t perQueue = std::max<std::size_t>(queueBytes / threads, 256 * 1024);
+        for (unsigned i = 0; i < threads; ++i) {
+            queues_.push_back(std::make_unique<BoundedQueue<WriteItem>>(perQueue));
+        }
+        for (unsigned i = 0; i < threads; ++i) {
+            workers_.emplace_back([this, i] { run(*queues_[i]); });
+        }
+    }
+
+    ~WriterPool() {
+        cancel();
+        join();
+    }
+
+    WriterPool(const WriterPool&) = delete;
+    WriterPool& operator=(const WriterPool&) = delete;
+
+    // Writer for |rel|. A hardlink is served by the writer that created its target, and later
+    // entries for the link's own path follow it there.
+    std::size_t route(const std::string& rel, const char* hardlinkTarget) {
+        std::size_t index = 0;
+        if (hardlinkTarget) {
+            index = route(sanitize_path(hardlinkTarget), nullptr);
+            linkRoutes_[rel] = index;
+            return index;
+        }
+        const auto it = linkRoutes_.find(rel);
+        if (it != linkRoutes_.end()) {
+            return it->second;
+        }
+        return std::hash<std::string>{}(rel) % queues_.size();
+    }
+
+    // Blocks while the writer is backed up. Returns false once the pool failed or was cancelled.
+    bool push(std::size_t writer, WriteItem item) {
+        const std::size_t cost = kWriteItemCost + item.data.size();
+        return queues_[writer]->push(std::move(item), cost);
+    }
+
+    void cancel() {
+        for (auto& q : queues_) {
+            q->cancel();
+        }
+    }
+
+    // Drains the queues, joins the writers and reports the first writer error.
+    bool finish(Error& err) {
+        for (auto& q : queues_) {
+            q->close();
+        }
+        join();
+        return take_error(err);
+    }
+
+    // The error that stopped the pool, if any.
+    bool take_error(Error& err) {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        if (error_.code == 0) {
+            return true;
+        }
+        err = error_;
+        return false;
+    }
+
+    void publish(ProgressInfo& progress) const {
+        progress.bytesDone = bytesDone_.load(std::memory_order_relaxed);
+        progress.filesDone = filesDone_.load(std::memory_order_relaxed);
+    }
+
+    void add_files_done(std::uint64_t n) { filesDone_.fetch_add(n, std::memory_order_relaxed); }
+
+   private:
+    void join() {
+        for (auto& t : workers_) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+    void fail(const Error& err) {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex_);
+            if (error_.code == 0) {
+                error_ = err;
+            }
+        }
+        cancel();
+    }
+
+    void run(BoundedQueue<WriteItem>& queue) {
+        Fd fd;
+        EntryPtr current;
+        std::string fullPath;
+        WriteItem item;
+        while (queue.pop(item)) {
+            Error err;
+            if (item.entry) {
+                current = std::move(item.entry);
+                fullPath = destinationDir_ + '/' + item.relPath;
+                if (archive_entry_hardlink(current.get()) || archive_entry_filetype(current.get()) != AE_IFREG) {
+                    ProgressInfo local;
+                    const bool ok = archive_entry_hardlink(current.get())
+                                        ? extract_hardlink(current.get(), fullPath, item.relPath, destinationDir_,
+                                                           local, err)
+                                        : extract_symlink(current.get(), fullPath, item.relPath, destinationDir_,
+                                                          opts_, local, err);
+                    if (!ok) {
+                        fail(err);
+                        return;
+                    }
+                    add_files_done(local.filesDone);
+                    current.reset();
+                    continue;
+                }
+                if (!open_output_file(current.get(), fullPath, item.relPath, destinationDir_, opts_, fd, err)) {
+                    fail(err);
+                    return;
+                }
+            }
+            if (!current || !fd.valid()) {
+                continue;
+            }
+            if (!item.data.empty()) {
+                if (!write_all(fd.fd, item.data.data(), item.data.size(), static_cast<off_t>(item.offset), err)) {
+                    fail(err);
+                    return;
+                }
+                bytesDone_.fetch_add(item.data.size(), std::memory_order_relaxed);
+            }
+            if (item.last) {
+                if (!finish_output_file(fd.fd, fullPath, current.get(), opts_, err)) {
+                    fail(err);
+                    return;
+                }
+                fd = Fd();
+                current.reset();
+                add_files_done(1);
+            }
+        }
+    }
+
+    const std::string destinationDir_;
+    const Options& opts_;
+    std::vector<std::unique_ptr<BoundedQueue<WriteItem>>> queues_;
+    std::vector<std::thread> workers_;
+    std::unordered_map<std::string, std::size_t> linkRoutes_;  // decode thread only
+    std::atomic<std::uint64_t> bytesDone_{0};
+    std::atomic<std::uint64_t> filesDone_{0};
+    std::mutex errorMutex_;
+    Error error_;
+};
+
+unsigned writer_count_from_opts(const Options& opts) {
+    if (opts.writerThreads > 0) {
+        return opts.writerThreads;
+    }
+    const unsigned hc = std::thread::hardware_concurrency();
+    return std::clamp(hc, 1u, 4u);
+}
+
+// A push only fails once the pool stopped; report why.
+bool pool_stopped(WriterPool& pool, Error& err) {
+    if (pool.take_error(err)) {
+        err.code = ECANCELED;
+        err.message = "Cancelled";
+    }
+    return false;
+}
+
+// Directories already exist on disk; their mode and times are applied once every writer is done
+// so read-only directories and mtimes survive children being created after them.
+struct DeferredDir {
+    EntryPtr entry;
+    std::string fullPath;
+};
+
+// Decode-thread half of the pipeline: directories are created inline, everything else is copied
+// out of libarchive and handed to the writer that owns its path.
+bool dispatch_entry(struct archive* ar,
+                    archive_entry* entry,
+                    const std::string& rel,
+                    const std::string& destinationDir,
+                    WriterPool& pool,
+                    std::vector<DeferredDir>& dirs,
+                    ProgressInfo& progress,
+                    const ProgressCallback& cb,
+                    Error& err) {
+    const char* hardlink = archive_entry_hardlink(entry);
+    const auto type = archive_entry_filetype(entry);
+
+    if (!hardlink && type == AE_IFDIR) {
+        std::string fullPath = destinationDir;
+        fullPath.push_back('/');
+        fullPath += rel;
+        if (!ensure_parent_dirs(destinationDir, parent_dir(rel), err)) {
+            return false;
+        }
+        mode_t mode = archive_entry_perm(entry);
+        if (mode == 0) {
+            mode = 0777;
+        }
+        // writers may still be filling it, so it stays owner-writable until the deferred pass
+        if (::mkdir(fullPath.c_str(), mode | S_IRWXU) != 0 && errno != EEXIST) {
+            set_error(err, "mkdir");
+            return false;
+        }
+        dirs.push_back({EntryPtr(archive_entry_clone(entry)), std::move(fullPath)});
+        pool.add_files_done(1);
+        archive_read_data_skip(ar);
+        return true;
+    }
+    if (!hardlink && type != AE_IFREG && type != AE_IFLNK) {
+        archive_read_data_skip(ar);
+        return true;  // unsupported special files or metadata entries
+    }
+
+    WriteItem header;
+    header.entry.reset(archive_entry_clone(entry));
+    if (!header.entry) {
+        err.code = ENOMEM;
+        err.message = "Failed to copy archive entry";
+        return false;
+    }
+    // the data is carried separately; writers never need the sparse map
+    archive_entry_sparse_clear(header.entry.get());
+    header.relPath = rel;
+    const std::size_t writer = pool.route(rel, hardlink);
+    if (!pool.push(writer, std::move(header))) {
+        return pool_stopped(pool, err);
+    }
+    if (hardlink || type != AE_IFREG) {
+        archive_read_data_skip(ar);
+        return true;
+    }
+
+    for (;;) {
+        const void* buff = nullptr;
+        std::size_t size = 0;
+        la_int64_t offset = 0;
+        const int r = archive_read_data_block(ar, &buff, &size, &offset);
+        if (r == ARCHIVE_EOF) {
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            set_archive_error(err, ar, "archive_read_data_block");
+            return false;
+        }
+        if (size == 0 || !buff) {
+            continue;
+        }
+        WriteItem chunk;
+        const auto* bytes = static_cast<const std::uint8_t*>(buff);
+        chunk.data.assign(bytes, bytes + size);
+        chunk.offset = static_cast<std::uint64_t>(offset);
+        if (!pool.push(writer, std::move(chunk))) {
+            return pool_stopped(pool, err);
+        }
+        pool.publish(progress);
+        if (!should_continue(cb, progress)) {
+            err.code = ECANCELED;
+            err.message = "Cancelled";
+            return false;
+        }
+    }
+
+    WriteItem close;
+    close.last = true;
+    if (!pool.push(writer, std::move(close))) {
+        return pool_stopped(pool, err);
+    }
+    return true;
+}
+
+void apply_deferred_dirs(std::vector<DeferredDir>& dirs, const Options& opts) {
+    // children before parents, so a parent's mtime is not bumped after it was set
+    for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+        apply_metadata(-1, it->fullPath, it->entry.get(), opts, false);
+    }
+}
+
+// Selected hardlinks whose target was not selected, by target path. The target's data went by
+// already, so the first of them is extracted as a copy of it in a second pass and the others are
+// linked to that copy.
+using DeferredLinks = std::unordered_map<std::string, std::vector<std::string>>;
+
+// Defers |entry| when it is a hardlink onto an entry |selector| does not select.
+bool defer_unselected_link(archive_entry* entry,
+                           const std::string& rel,
+                           const EntrySelector& selector,
+                           DeferredLinks& links) {
+    const char* target = archive_entry_hardlink(entry);
+    if (!target || !selector.active()) {
+        return false;
+    }
+    std::string targetRel = sanitize_path(target);
+    if (targetRel.empty() || selector.selects(targetRel)) {
+        return false;
+    }
+    links[std::move(targetRel)].push_back(rel);
+    return true;
+}
+
+bool extract_deferred_links(const std::string& archivePath,
+                            const std::string& destinationDir,
+                            DeferredLinks& links,
+                            const Options& opts,
+                            ProgressInfo& progress,
+                            const ProgressCallback& cb,
+                            Error& err) {
+    if (links.empty()) {
+        return true;
+    }
+    struct archive* ar = nullptr;
+    if (!open_reader(archivePath, opts, ar, err)) {
+        return false;
+    }
+
+    archive_entry* entry = nullptr;
+    bool ok = true;
+    while (ok && !links.empty() && archive_read_next_header(ar, &entry) == ARCHIVE_OK) {
+        const auto it = links.find(sanitize_path(archive_entry_pathname(entry)));
+        if (it == links.end() || archive_entry_hardlink(entry) || archive_entry_filetype(entry) != AE_IFREG) {
+            archive_read_data_skip(ar);
+            continue;
+        }
+        const std::vector<std::string>& rels = it->second;
+        const std::string copyPath = destinationDir + '/' + rels.front();
+        const la_int64_t sz = archive_entry_size(entry);
+        if (sz > 0) {
+            progress.bytesTotal += static_cast<std::uint64_t>(sz);
+        }
+        ok = extract_regular_file(ar, entry, copyPath, rels.front(), destinationDir, opts, progress, cb, err);
+        for (std::size_t i = 1; ok && i < rels.size(); ++i) {
+            ok = ensure_parent_dirs(destinationDir, parent_dir(rels[i]), err);
+            if (ok && ::link(copyPath.c_str(), (destinationDir + '/' + rels[i]).c_str()) != 0) {
+                set_error(err, "link");
+                ok = false;
+            }
+            if (ok) {
+                progress.filesDone += 1;
+            }
+        }
+        links.erase(it);
+    }
+    if (ok && !links.empty()) {
+        err.code = ENOENT;
+        err.message = "Hardlink target not found in archive: " + links.begin()->first;
+        ok = false;
+    }
+    archive_read_close(ar);
+    archive_read_free(ar);
+    return ok;
+}
+
+struct SeekableSource {
+    SeekableZstd::Reader* reader;
+    Error err;
+};
+
+la_ssize_t seekable_read_cb(struct archive* ar, void* clientData, const void** buffer) {
+    auto* source = static_cast<SeekableSource*>(clientData);
+    std::size_t size = 0;
+    if (!source->reader->next_chunk(*buffer, size, source->err)) {
+        archive_set_error(ar, source->err.code, "%s", source->err.message.c_str());
+        return -1;
+    }
+    return static_cast<la_ssize_t>(size);
+}
+
+// Seekable tar.zst archives written by ArchiveWriter carry an entry index, so an explicit path
+// selection only decodes the frames holding the requested entries. Returns false with
+// |handled| unset when the archive has no usable index and the caller should stream instead.
+bool extract_indexed(const std::string& archivePath,
+                     const std::string& destinationDir,
+                     EntrySelector& selector,
+                     const Options& opts,
+                     ProgressInfo& progress,
+                     const ProgressCallback& cb,
+                     Error& err,
+                     bool& handled) {
+    handled = false;
+    Fd fd(::open(archivePath.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.valid()) {
+        return false;
+    }
+    SeekableZstd::SeekTable table;
+    Error tableErr;
+    if (!SeekableZstd::read_seek_table(fd.fd, table, tableErr) || table.entries.empty()) {
+        return false;
+    }
+    handled = true;
+
+    std::vector<std::uint64_t> offsets;
+    for (const auto& indexed : table.entries) {
+        const std::string rel = sanitize_path(indexed.path.c_str());
+        if (!rel.empty() && selector.covers(rel)) {
+            offsets.push_back(indexed.offset);
+        }
+    }
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    SeekableZstd::Reader reader(fd.fd, table);
+    DeferredLinks links;
+    for (const std::uint64_t offset : offsets) {
+        if (!reader.seek(offset, err)) {
+            return false;
+        }
+        struct archive* ar = archive_read_new();
+        if (!ar) {
+            err.code = ENOMEM;
+            err.message = "Failed to allocate archive reader";
+            return false;
+        }
+        archive_read_support_format_tar(ar);
+        SeekableSource source{&reader, {}};
+        if (archive_read_open(ar, &source, nullptr, seekable_read_cb, nullptr) != ARCHIVE_OK) {
+            set_archive_error(err, ar, "archive_read_open");
+            archive_read_free(ar);
+            return false;
+        }
+
+        archive_entry* entry = nullptr;
+        bool ok = true;
+        if (archive_read_next_header(ar, &entry) != ARCHIVE_OK) {
+            set_archive_error(err, ar, "archive_read_next_header");
+            ok = false;
+        }
+        else {
+            const std::string rel = sanitize_path(archive_entry_pathname(entry));
+            if (rel.empty()) {
+                err.code = EINVAL;
+                err.message = "Unsafe path in archive entry";
+                ok = false;
+            }
+            else if (selector.matches(rel, archive_entry_filetype(entry) == AE_IFDIR)) {
+                const la_int64_t sz = archive_entry_size(entry);
+                if (archive_entry_filetype(entry) == AE_IFREG && sz > 0) {
+                    progress.bytesTotal += static_cast<std::uint64_t>(sz);
+                }
+                progress.filesTotal += 1;
+                progress.currentPath = rel;
+                if (!should_continue(cb, progress)) {
+                    err.code = ECANCELED;
+                    err.message = "Cancelled";
+                    ok = false;
+                }
+                else if (!defer_unselected_link(entry, rel, selector, links)) {
+                    ok = extract_entry(ar, entry, rel, destinationDir, opts, progress, cb, err);
+                }
+            }
+        }
+        archive_read_close(ar);
+        archive_read_free(ar);
+        if (!ok) {
+            return false;
+        }
+    }
+    return extract_deferred_links(archivePath, destinationDir, links, opts, progress, cb, err);
+}
+
 }  // namespace
 
 bool extract_archive(const std::string& archivePath,
@@ -521,15 +1167,35 @@ bool extract_archive(const std::string& archivePath,
         return false;
     }
 
-    ProgressInfo scanProgress;
-    if (!scan_archive(archivePath, opts, scanProgress, err)) {
-        FsOps::Error cleanupErr;
-        ProgressInfo cleanupProg;
-        FsOps::delete_path(destinationDir, cleanupProg, ProgressCallback(), cleanupErr);
-        return false;
+    EntrySelector selector(opts.filter);
+
+    // The totals pre-pass decodes the whole archive, which is exactly the cost selective
+    // extraction is meant to avoid; totals are accumulated per selected entry instead.
+    if (!selector.active()) {
+        ProgressInfo scanProgress;
+        if (!scan_archive(archivePath, opts, scanProgress, err)) {
+            FsOps::Error cleanupErr;
+            ProgressInfo cleanupProg;
+            FsOps::delete_path(destinationDir, cleanupProg, ProgressCallback(), cleanupErr);
+            return false;
+        }
+        progress.bytesTotal = scanProgress.bytesTotal;
+        progress.filesTotal = scanProgress.filesTotal;
+    }
+
+    if (selector.path_list_only()) {
+        bool handled = false;
+        const bool ok =
+            extract_indexed(archivePath, destinationDir, selector, opts, progress, callback, err, handled);
+        if (handled) {
+            if (!ok) {
+                FsOps::Error cleanupErr;
+                ProgressInfo cleanupProg;
+                FsOps::delete_path(destinationDir, cleanupProg, ProgressCallback(), cleanupErr);
+            }
+            return ok;
+        }
     }
-    progress.bytesTotal = scanProgress.bytesTotal;
-    progress.filesTotal = scanProgress.filesTotal;
 
     struct archive* ar = nullptr;
     if (!open_reader(archivePath, opts, ar, err)) {
@@ -539,9 +1205,20 @@ bool extract_archive(const std::string& archivePath,
         return false;
     }
 
+    // Decoding stays on this thread; with more than one writer, file creation and writes move
+    // to the pool so the decoder is not stalled behind per-file syscalls.
+    const unsigned writers = writer_count_from_opts(opts);
+    std::unique_ptr<WriterPool> pool;
+    std::vector<DeferredDir> dirs;
+    if (writers > 1) {
+        pool = std::make_unique<WriterPool>(writers, opts.writerQueueBytes, destinationDir, opts);
+    }
+
     archive_entry* entry = nullptr;
     bool ok = true;
-    while (archive_read_next_header(ar, &entry) == ARCHIVE_OK) {
+    DeferredLinks links;
+    int r = ARCHIVE_OK;
+    while ((r = archive_read_next_header(ar, &entry)) == ARCHIVE_OK) {
         const char* rawPath = archive_entry_pathname(entry);
         std::string rel = sanitize_path(rawPath);
         if (rel.empty()) {
@@ -551,9 +1228,25 @@ bool extract_archive(const std::string& archivePath,
             break;
         }
 
-        std::string fullPath = destinationDir;
-        fullPath.push_back('/');
-        fullPath += rel;
+        const auto type = archive_entry_filetype(entry);
+        if (!selector.matches(rel, type == AE_IFDIR)) {
+            // still give the callback a chance to cancel while skipping through large archives
+            if (!should_continue(callback, progress)) {
+                err.code = ECANCELED;
+                err.message = "Cancelled";
+                ok = false;
+                break;
+            }
+            archive_read_data_skip(ar);
+            continue;
+        }
+        if (selector.active()) {
+            const la_int64_t sz = archive_entry_size(entry);
+            if (type == AE_IFREG && sz > 0) {
+                progress.bytesTotal += static_cast<std::uint64_t>(sz);
+            }
+            progress.filesTotal += 1;
+        }
 
         progress.currentPath = rel;
         if (!should_continue(callback, progress)) {
@@ -563,58 +1256,161 @@ bool extract_archive(const std::string& archivePath,
             break;
         }
 
-        const char* hardlink = archive_entry_hardlink(entry);
-        if (hardlink) {
-            if (!extract_hardlink(entry, fullPath, rel, destinationDir, progress, err)) {
-                ok = false;
-                break;
-            }
+        if (defer_unselected_link(entry, rel, selector, links)) {
             archive_read_data_skip(ar);
-            continue;
         }
+        else if (pool) {
+            pool->publish(progress);
+            ok = dispatch_entry(ar, entry, rel, destinationDir, *pool, dirs, progress, callback, err);
+        }
+        else {
+            ok = extract_entry(ar, entry, rel, destinationDir, opts, progress, callback, err);
+        }
+        if (!ok || selector.exhausted()) {
+            break;
+        }
+    }
+    // a selective extract skips the pre-scan, so a truncated or corrupt archive shows up here
+    if (ok && !selector.exhausted() && r != ARCHIVE_EOF) {
+        set_archive_error(err, ar, "archive_read_next_header");
+        ok = false;
+    }
 
-        const auto type = archive_entry_filetype(entry);
-        switch (type) {
-            case AE_IFREG: {
-                if (!extract_regular_file(ar, entry, fullPath, rel, destinationDir, opts, progress, callback, err)) {
-                    ok = false;
-                }
-                break;
-            }
-            case AE_IFDIR: {
-                if (!extract_directory(entry, fullPath, rel, destinationDir, opts, progress, err)) {
-                    ok = false;
-                }
-                archive_read_data_skip(ar);
+    if (pool) {
+        if (ok) {
+            ok = pool->finish(err);
+            pool->publish(progress);
+        }
+        else {
+            pool->cancel();
+        }
+        pool.reset();
+    }
+    archive_read_close(ar);
+    archive_read_free(ar);
+    if (ok) {
+        ok = extract_deferred_links(archivePath, destinationDir, links, opts, progress, callback, err);
+    }
+    if (ok) {
+        apply_deferred_dirs(dirs, opts);
+    }
+
+    if (!ok) {
+        FsOps::Error cleanupErr;
+        ProgressInfo cleanupProg;
+        FsOps::delete_path(destinationDir, cleanupProg, ProgressCallback(), cleanupErr);
+    }
+
+    return ok;
+}
+
+bool test_archive(const std::string& archivePath,
+                  ProgressInfo& progress,
+                  const ProgressCallback& callback,
+                  TestReport& report,
+                  Error& err,
+                  const Options& opts) {
+    progress = {};
+    report = {};
+    err = {};
+
+    if (archivePath.empty()) {
+        err.code = EINVAL;
+        err.message = "Invalid archive path";
+        return false;
+    }
+
+    struct stat st{};
+    if (::stat(archivePath.c_str(), &st) != 0) {
+        set_error(err, "stat");
+        return false;
+    }
+    progress.bytesTotal = static_cast<std::uint64_t>(st.st_size);
+
+    const auto started = std::chrono::steady_clock::now();
+    struct archive* ar = nullptr;
+    if (!open_reader(archivePath, opts, ar, err)) {
+        return false;
+    }
+
+    bool ok = true;
+    bool cancelled = false;
+    archive_entry* entry = nullptr;
+    int r = ARCHIVE_OK;
+    while ((r = archive_read_next_header(ar, &entry)) == ARCHIVE_OK || r == ARCHIVE_WARN) {
+        EntryCheck check;
+        const char* rawPath = archive_entry_pathname(entry);
+        check.path = rawPath ? rawPath : "";
+        if (sanitize_path(rawPath).empty()) {
+            // not a checksum problem, but extraction would refuse this archive
+            check.ok = false;
+            check.message = "Unsafe path in archive entry";
+        }
+        else if (r == ARCHIVE_WARN) {
+            const char* msg = archive_error_string(ar);
+            check.ok = false;
+            check.message = msg ? msg : "Header warning";
+        }
+
+        progress.currentPath = check.path;
+        bool fatal = false;
+        for (;;) {
+            const void* buff = nullptr;
+            std::size_t size = 0;
+            la_int64_t offset = 0;
+            const int dr = archive_read_data_block(ar, &buff, &size, &offset);
+            if (dr == ARCHIVE_EOF) {
                 break;
             }
-            case AE_IFLNK: {
-                if (!extract_symlink(entry, fullPath, rel, destinationDir, opts, progress, err)) {
-                    ok = false;
-                }
-                archive_read_data_skip(ar);
+            if (dr != ARCHIVE_OK) {
+                const char* msg = archive_error_string(ar);
+                check.ok = false;
+                check.message = msg ? msg : "Data error";
+                fatal = dr == ARCHIVE_FATAL;
                 break;
             }
-            default: {
-                archive_read_data_skip(ar);  // unsupported special files or metadata entries
+            check.bytes += size;
+            progress.bytesDone = static_cast<std::uint64_t>(archive_filter_bytes(ar, -1));
+            if (!should_continue(callback, progress)) {
+                cancelled = true;
                 break;
             }
         }
 
-        if (!ok) {
+        report.bytesDecoded += check.bytes;
+        if (!check.ok) {
+            report.failedEntries += 1;
+            if (ok) {
+                err.code = EIO;
+                err.message = check.path + ": " + check.message;
+            }
+            ok = false;
+        }
+        report.entries.push_back(std::move(check));
+        progress.filesDone += 1;
+        if (cancelled || fatal) {
             break;
         }
     }
 
-    archive_read_close(ar);
-    archive_read_free(ar);
-
-    if (!ok) {
-        FsOps::Error cleanupErr;
-        ProgressInfo cleanupProg;
-        FsOps::delete_path(destinationDir, cleanupProg, ProgressCallback(), cleanupErr);
+    if (cancelled) {
+        err.code = ECANCELED;
+        err.message = "Cancelled";
+        ok = false;
+    }
+    else if (r != ARCHIVE_EOF && r != ARCHIVE_OK && r != ARCHIVE_WARN) {
+        // truncated stream or a broken header: nothing after this point could be checked
+        if (ok) {
+            set_archive_error(err, ar, "archive_read_next_header");
+        }
+        ok = false;
     }
 
+    report.bytesRead = static_cast<std::uint64_t>(archive_filter_bytes(ar, -1));
+    progress.bytesDone = report.bytesRead;
+    archive_read_close(ar);
+    archive_read_free(ar);
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
     return ok;
 }
 
@@ -8,10 +8,29 @@
 
 #include "fs_ops.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 namespace PCManFM::ArchiveExtract {
 
+// Restricts extraction to a subset of entries. An entry is extracted when it matches any of the
+// criteria; an empty filter extracts everything. Entry paths are compared after sanitization
+// (no leading "./", no duplicate slashes). A selected hardlink whose target is not selected is
+// extracted as a copy of the target's data.
+struct EntryFilter {
+    // Exact archive paths. Naming a directory selects its whole subtree.
+    std::vector<std::string> paths;
+    // fnmatch(3) patterns. Patterns without '/' match the basename, others the full path.
+    std::vector<std::string> globs;
+    // Receives the sanitized archive path.
+    std::function<bool(const std::string&)> predicate;
+
+    bool empty() const { return paths.empty() && globs.empty() && !predicate; }
+};
+
 struct Options {
     bool overwriteExisting = true;
     bool keepPermissions = true;
@@ -20,11 +39,19 @@ struct Options {
     bool keepSymlinks = true;
     bool enableFilterThreads = true;
     unsigned maxFilterThreads = 0;  // 0 = use hardware_concurrency or libarchive default
+    // Files are created and written by this many threads while the calling thread decodes
+    // (0 = up to 4, 1 = extract serially). Entries for the same path stay in archive order.
+    unsigned writerThreads = 0;
+    std::size_t writerQueueBytes = 16 * 1024 * 1024;  // decoded data buffered for the writers
+    EntryFilter filter;
 };
 
 // Extracts a wide range of archive formats (zip, tar/tgz/tbz2/txz/tzst/tlz4, cpio, ar, 7z, iso,
 // xar, rpm, deb, etc.) into |destinationDir|. The destination directory must not already exist.
 // Progress/cancel semantics match FsOps: the callback can return false to request cancellation.
+// With a non-empty |opts.filter| the totals pre-pass is skipped (totals grow as entries are
+// selected), non-matching payloads are skipped unread where the format allows, and reading stops
+// as soon as every explicitly listed file has been extracted.
 bool extract_archive(const std::string& archivePath,
                      const std::string& destinationDir,
                      FsOps::ProgressInfo& progress,
@@ -32,6 +59,33 @@ bool extract_archive(const std::string& archivePath,
                      FsOps::Error& err,
                      const Options& opts = {});
 
+struct EntryCheck {
+    std::string path;  // as stored in the archive
+    bool ok = true;
+    std::string message;      // why the entry failed, empty when ok
+    std::uint64_t bytes = 0;  // decoded payload size
+};
+
+struct TestReport {
+    std::vector<EntryCheck> entries;
+    std::uint64_t failedEntries = 0;
+    std::uint64_t bytesRead = 0;     // compressed input consumed
+    std::uint64_t bytesDecoded = 0;  // uncompressed payload produced
+    double seconds = 0.0;
+};
+
+// Decodes every entry of |archivePath| without writing anything, so the format's own checks
+// (zip CRCs, xz/zstd/gzip frame checksums, tar header checksums) run over the whole archive.
+// Per-entry results and throughput go to |report|. Returns false when any entry failed, the
+// archive is truncated or corrupt beyond the current entry, or the callback cancelled; |err|
+// describes the first problem. Progress reports compressed input bytes consumed.
+bool test_archive(const std::string& archivePath,
+                  FsOps::ProgressInfo& progress,
+                  const FsOps::ProgressCallback& callback,
+                  TestReport& report,
+                  FsOps::Error& err,
+                  const Options& opts = {});
+
 }  // namespace PCManFM::ArchiveExtract
 
 #endif  // PCMANFM_ARCHIVE_EXTRACT_H
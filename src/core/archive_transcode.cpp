@@ -0,0 +1,357 @@
+/*
+ * Streaming archive-to-archive conversion built on libarchive
+ * src/core/archive_transcode.cpp
+ */
+
+#include "archive_transcode.h"
+
+#include "bounded_queue.h"
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PCManFM::ArchiveTranscode {
+namespace {
+
+using PCManFM::FsOps::Error;
+using PCManFM::FsOps::ProgressCallback;
+using PCManFM::FsOps::ProgressInfo;
+
+// Rough queue cost of a header so entry-heavy archives are bounded too.
+constexpr std::size_t kHeaderCost = 512;
+
+struct Fd {
+    int fd;
+    explicit Fd(int f = -1) : fd(f) {}
+    ~Fd() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+    bool valid() const { return fd >= 0; }
+};
+
+struct EntryDeleter {
+    void operator()(archive_entry* e) const { archive_entry_free(e); }
+};
+using EntryPtr = std::unique_ptr<archive_entry, EntryDeleter>;
+
+// Either the header of the next entry or a payload chunk of the current one.
+struct Item {
+    EntryPtr entry;
+    std::vector<std::uint8_t> data;
+    std::uint64_t offset = 0;    // position of |data| within the entry; gaps are holes
+    std::uint64_t consumed = 0;  // compressed input bytes read when the item was produced
+};
+
+inline void set_error(Error& err, const std::string& context) {
+    err.code = errno;
+    err.message = context + ": " + std::strerror(errno);
+}
+
+inline void set_archive_error(Error& err, struct archive* ar, const char* context) {
+    err.code = EIO;
+    const char* msg = archive_error_string(ar);
+    err.message = std::string(context) + ": " + (msg ? msg : "unknown error");
+}
+
+bool should_continue(const ProgressCallback& cb, const ProgressInfo& info) {
+    if (!cb) {
+        return true;
+    }
+    return cb(info);
+}
+
+unsigned filter_threads(const Options& opts) {
+    if (opts.maxFilterThreads > 0) {
+        return opts.maxFilterThreads;
+    }
+    const unsigned hc = std::thread::hardware_concurrency();
+    return hc > 0 ? hc : 1;
+}
+
+bool open_reader(const std::string& path, const Options& opts, struct archive*& out, Error& err) {
+    struct archive* ar = archive_read_new();
+    if (!ar) {
+        err.code = ENOMEM;
+        err.message = "Failed to allocate archive reader";
+        return false;
+    }
+    archive_read_support_filter_all(ar);
+    archive_read_support_format_all(ar);
+    const unsigned threads = filter_threads(opts);
+    if (threads > 1) {
+        const std::string value = std::to_string(threads);
+        for (const char* f : {"zstd", "xz", "gzip", "bzip2", "lz4"}) {
+            archive_read_set_filter_option(ar, f, "threads", value.c_str());
+        }
+    }
+    if (archive_read_open_filename(ar, path.c_str(), 128 * 1024) != ARCHIVE_OK) {
+        set_archive_error(err, ar, "archive_read_open_filename");
+        archive_read_free(ar);
+        return false;
+    }
+    out = ar;
+    return true;
+}
+
+bool open_writer(int fd, const Options& opts, struct archive*& out, Error& err) {
+    struct archive* ar = archive_write_new();
+    if (!ar) {
+        err.code = ENOMEM;
+        err.message = "Failed to allocate archive writer";
+        return false;
+    }
+    if (archive_write_set_format_by_name(ar, opts.format.c_str()) != ARCHIVE_OK) {
+        set_archive_error(err, ar, "archive_write_set_format");
+        archive_write_free(ar);
+        return false;
+    }
+    if (opts.filter.empty()) {
+        archive_write_add_filter_none(ar);
+    }
+    else {
+        if (archive_write_add_filter_by_name(ar, opts.filter.c_str()) != ARCHIVE_OK) {
+            set_archive_error(err, ar, "archive_write_add_filter");
+            archive_write_free(ar);
+            return false;
+        }
+        // Options a filter does not know are reported as warnings and ignored.
+        if (opts.compressionLevel >= 0) {
+            archive_write_set_filter_option(ar, nullptr, "compression-level",
+                                            std::to_string(opts.compressionLevel).c_str());
+        }
+        const unsigned threads = filter_threads(opts);
+        if (threads > 1) {
+            archive_write_set_filter_option(ar, nullptr, "threads", std::to_string(threads).c_str());
+        }
+    }
+    if (archive_write_open_fd(ar, fd) != ARCHIVE_OK) {
+        set_archive_error(err, ar, "archive_write_open_fd");
+        archive_write_free(ar);
+        return false;
+    }
+    out = ar;
+    return true;
+}
+
+// Decode thread: pushes each entry header followed by its data blocks.
+void decode_entries(struct archive* in, BoundedQueue<Item>& queue, Error& err) {
+    archive_entry* entry = nullptr;
+    int r = ARCHIVE_OK;
+    while ((r = archive_read_next_header(in, &entry)) == ARCHIVE_OK || r == ARCHIVE_WARN) {
+        Item header;
+        header.entry.reset(archive_entry_clone(entry));
+        if (!header.entry) {
+            err.code = ENOMEM;
+            err.message = "Failed to copy archive entry";
+            queue.cancel();
+            return;
+        }
+        // Holes are materialized by the encoder, so the copy must not advertise a sparse map.
+        archive_entry_sparse_clear(header.entry.get());
+        header.consumed = static_cast<std::uint64_t>(archive_filter_bytes(in, -1));
+        if (!queue.push(std::move(header), kHeaderCost)) {
+            return;
+        }
+
+        for (;;) {
+            const void* buff = nullptr;
+            std::size_t size = 0;
+            la_int64_t offset = 0;
+            const int dr = archive_read_data_block(in, &buff, &size, &offset);
+            if (dr == ARCHIVE_EOF) {
+                break;
+            }
+            if (dr < ARCHIVE_WARN) {
+                set_archive_error(err, in, "archive_read_data_block");
+                queue.cancel();
+                return;
+            }
+            if (size == 0) {
+                continue;
+            }
+            Item chunk;
+            const auto* bytes = static_cast<const std::uint8_t*>(buff);
+            chunk.data.assign(bytes, bytes + size);
+            chunk.offset = static_cast<std::uint64_t>(offset);
+            chunk.consumed = static_cast<std::uint64_t>(archive_filter_bytes(in, -1));
+            if (!queue.push(std::move(chunk), size)) {
+                return;
+            }
+        }
+    }
+
+    if (r != ARCHIVE_EOF) {
+        set_archive_error(err, in, "archive_read_next_header");
+        queue.cancel();
+        return;
+    }
+    queue.close();
+}
+
+bool write_zeros(struct archive* out, std::uint64_t count, Error& err) {
+    static const std::array<std::uint8_t, 64 * 1024> zeros{};
+    while (count > 0) {
+        const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(count, zeros.size()));
+        if (archive_write_data(out, zeros.data(), n) < 0) {
+            set_archive_error(err, out, "archive_write_data");
+            return false;
+        }
+        count -= n;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool transcode_archive(const std::string& sourcePath,
+                       const std::string& destinationPath,
+                       ProgressInfo& progress,
+                       const ProgressCallback& callback,
+                       Error& err,
+                       const Options& opts) {
+    progress = {};
+    err = {};
+
+    if (sourcePath.empty() || destinationPath.empty()) {
+        err.code = EINVAL;
+        err.message = "Invalid source or destination path";
+        return false;
+    }
+
+    struct stat srcSt{};
+    if (::stat(sourcePath.c_str(), &srcSt) != 0) {
+        set_error(err, "stat");
+        return false;
+    }
+    struct stat dstSt{};
+    if (::stat(destinationPath.c_str(), &dstSt) == 0 && dstSt.st_dev == srcSt.st_dev && dstSt.st_ino == srcSt.st_ino) {
+        err.code = EINVAL;
+        err.message = "Source and destination are the same file";
+        return false;
+    }
+    progress.bytesTotal = static_cast<std::uint64_t>(srcSt.st_size);
+
+    struct archive* in = nullptr;
+    if (!open_reader(sourcePath, opts, in, err)) {
+        return false;
+    }
+
+    Fd outFd(::open(destinationPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (!outFd.valid()) {
+        set_error(err, "open");
+        archive_read_free(in);
+        return false;
+    }
+    struct archive* out = nullptr;
+    if (!open_writer(outFd.fd, opts, out, err)) {
+        archive_read_free(in);
+        ::unlink(destinationPath.c_str());
+        return false;
+    }
+
+    BoundedQueue<Item> queue(std::max<std::size_t>(opts.queueBytes, 64 * 1024));
+    Error decodeErr;
+    std::thread decoder([in, &queue, &decodeErr] { decode_entries(in, queue, decodeErr); });
+
+    bool ok = true;
+    EntryPtr current;
+    std::uint64_t written = 0;
+    auto finish_entry = [&]() -> bool {
+        if (!current) {
+            return true;
+        }
+        // Trailing holes: the header promised the full size.
+        const la_int64_t size = archive_entry_size(current.get());
+        if (archive_entry_size_is_set(current.get()) && size > 0 && static_cast<std::uint64_t>(size) > written &&
+            !archive_entry_hardlink(current.get())) {
+            if (!write_zeros(out, static_cast<std::uint64_t>(size) - written, err)) {
+                return false;
+            }
+        }
+        current.reset();
+        return true;
+    };
+
+    Item item;
+    while (queue.pop(item)) {
+        if (item.entry) {
+            if (!finish_entry()) {
+                ok = false;
+                break;
+            }
+            const int r = archive_write_header(out, item.entry.get());
+            if (r < ARCHIVE_WARN) {
+                set_archive_error(err, out, "archive_write_header");
+                ok = false;
+                break;
+            }
+            const char* path = archive_entry_pathname(item.entry.get());
+            progress.currentPath = path ? path : std::string();
+            progress.filesDone += 1;
+            current = std::move(item.entry);
+            written = 0;
+        }
+        else if (current) {
+            if (item.offset > written && !write_zeros(out, item.offset - written, err)) {
+                ok = false;
+                break;
+            }
+            if (archive_write_data(out, item.data.data(), item.data.size()) < 0) {
+                set_archive_error(err, out, "archive_write_data");
+                ok = false;
+                break;
+            }
+            written = std::max(written, item.offset + item.data.size());
+        }
+
+        progress.bytesDone = std::min(item.consumed, progress.bytesTotal);
+        if (!should_continue(callback, progress)) {
+            err.code = ECANCELED;
+            err.message = "Cancelled";
+            ok = false;
+            break;
+        }
+    }
+    if (!ok) {
+        queue.cancel();
+    }
+    decoder.join();
+    if (ok && decodeErr.code != 0) {
+        err = decodeErr;
+        ok = false;
+    }
+    if (ok && !finish_entry()) {
+        ok = false;
+    }
+
+    if (archive_write_close(out) != ARCHIVE_OK && ok) {
+        set_archive_error(err, out, "archive_write_close");
+        ok = false;
+    }
+    archive_write_free(out);
+    archive_read_close(in);
+    archive_read_free(in);
+
+    if (!ok) {
+        ::unlink(destinationPath.c_str());
+    }
+    return ok;
+}
+
+}  // namespace PCManFM::ArchiveTranscode
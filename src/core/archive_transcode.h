@@ -0,0 +1,39 @@
+/*
+ * Streaming archive-to-archive conversion built on libarchive
+ * src/core/archive_transcode.h
+ */
+
+#ifndef PCMANFM_ARCHIVE_TRANSCODE_H
+#define PCMANFM_ARCHIVE_TRANSCODE_H
+
+#include "fs_ops.h"
+
+#include <cstddef>
+#include <string>
+
+namespace PCManFM::ArchiveTranscode {
+
+struct Options {
+    std::string format = "paxr";            // libarchive write format name (paxr = restricted pax)
+    std::string filter = "zstd";            // libarchive write filter name, empty for none
+    int compressionLevel = -1;              // -1 = filter default
+    unsigned maxFilterThreads = 0;          // 0 = use hardware_concurrency for filters that support it
+    std::size_t queueBytes = 32 * 1024 * 1024;  // decoded data buffered between the two threads
+};
+
+// Re-encodes the archive at |sourcePath| into |destinationPath| without touching the filesystem
+// in between: one thread decodes entries, the calling thread encodes them, with a bounded buffer
+// between the two. Entry metadata (type, mode, owner, times, links, xattrs, ACLs) is copied
+// as-is; sparse files are written densely. Progress reports compressed input bytes consumed;
+// the callback runs on the calling thread and can return false to cancel. The destination is
+// removed on failure.
+bool transcode_archive(const std::string& sourcePath,
+                       const std::string& destinationPath,
+                       FsOps::ProgressInfo& progress,
+                       const FsOps::ProgressCallback& callback,
+                       FsOps::Error& err,
+                       const Options& opts = {});
+
+}  // namespace PCManFM::ArchiveTranscode
+
+#endif  // PCMANFM_ARCHIVE_TRANSCODE_H
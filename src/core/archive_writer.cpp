@@ -5,16 +5,25 @@
 
 #include "archive_writer.h"
 
+#include "seekable_zstd.h"
+
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cerrno>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <dirent.h>
 #include <fcntl.h>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <string_view>
+#include <thread>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -100,31 +109,23 @@ bool ensure_parent_dirs(const std::string& path, Error& err) {
     return FsOps::make_dir_parents(parent, err);
 }
 
-bool accumulate_size(const std::string& path, std::uint64_t& totalBytes, int depth, Error& err) {
-    if (depth > FsOps::kMaxRecursionDepth) {
-        err.code = ELOOP;
-        err.message = "Maximum recursion depth exceeded";
-        return false;
-    }
-    struct stat st{};
-    if (::lstat(path.c_str(), &st) != 0) {
-        set_error(err, "lstat");
-        return false;
-    }
-    if (S_ISREG(st.st_mode)) {
-        totalBytes += static_cast<std::uint64_t>(st.st_size);
-        return true;
-    }
-    if (S_ISLNK(st.st_mode)) {
-        return true;  // track but no data payload
-    }
-    if (!S_ISDIR(st.st_mode)) {
-        err.code = ENOTSUP;
-        err.message = "Unsupported file type";
-        return false;
-    }
+// One archive member, captured by the planning walk so totals, read-ahead and writing all
+// work from the same snapshot of the tree. Only the parts of the lstat() result that go into
+// the header are kept, since the plan holds every file of the tree.
+struct PlannedEntry {
+    std::string path;
+    std::string relPath;
+    std::string linkTarget;
+    std::uint64_t size = 0;
+    time_t mtime = 0;
+    time_t atime = 0;
+    mode_t mode = 0;  // file type and permission bits
+    uid_t uid = 0;
+    gid_t gid = 0;
+};
 
-    Fd dir_fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECTORY));
+bool read_dir_names(const std::string& path, std::vector<std::string>& names, Error& err) {
+    Fd dir_fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECTORY | O_NOFOLLOW));
     if (!dir_fd.valid()) {
         set_error(err, "open");
         return false;
@@ -152,27 +153,20 @@ bool accumulate_size(const std::string& path, std::uint64_t& totalBytes, int dep
         if (!name || name[0] == '\0' || std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
             continue;
         }
-        std::string child = path;
-        if (child.back() != '/') {
-            child.push_back('/');
-        }
-        child += name;
-        if (!accumulate_size(child, totalBytes, depth + 1, err)) {
-            ::closedir(dir);
-            return false;
-        }
+        names.emplace_back(name);
     }
     ::closedir(dir);
+    // sorted order keeps the archive deterministic and the read-ahead walking one directory at a time
+    std::sort(names.begin(), names.end());
     return true;
 }
 
-bool write_entry(struct archive* ar,
-                 const std::string& path,
-                 const std::string& base,
-                 ProgressInfo& progress,
-                 const ProgressCallback& cb,
-                 Error& err,
-                 int depth) {
+bool plan_entries(const std::string& path,
+                  const std::string& base,
+                  std::vector<PlannedEntry>& plan,
+                  std::uint64_t& totalBytes,
+                  int depth,
+                  Error& err) {
     if (depth > FsOps::kMaxRecursionDepth) {
         err.code = ELOOP;
         err.message = "Maximum recursion depth exceeded";
@@ -184,158 +178,354 @@ bool write_entry(struct archive* ar,
         set_error(err, "lstat");
         return false;
     }
+    PlannedEntry entry;
+    entry.path = path;
+    entry.relPath = relative_path(path, base);
+    entry.size = static_cast<std::uint64_t>(st.st_size);
+    entry.mtime = st.st_mtime;
+    entry.atime = st.st_atime;
+    entry.mode = st.st_mode;
+    entry.uid = st.st_uid;
+    entry.gid = st.st_gid;
 
-    const std::string relPath = relative_path(path, base);
-    progress.currentPath = relPath;
-    if (!should_continue(cb, progress)) {
-        err.code = ECANCELED;
-        err.message = "Cancelled";
+    if (S_ISREG(st.st_mode)) {
+        totalBytes += entry.size;
+        plan.push_back(std::move(entry));
+        return true;
+    }
+    if (S_ISLNK(st.st_mode)) {
+        std::string target(static_cast<std::size_t>(st.st_size) + 1, '\0');
+        const ssize_t len = ::readlink(path.c_str(), target.data(), target.size());
+        if (len < 0) {
+            set_error(err, "readlink");
+            return false;
+        }
+        target.resize(static_cast<std::size_t>(len));
+        entry.linkTarget = std::move(target);
+        plan.push_back(std::move(entry));
+        return true;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        err.code = ENOTSUP;
+        err.message = "Unsupported file type";
         return false;
     }
 
-    archive_entry* entry = archive_entry_new();
-    if (!entry) {
-        err.code = ENOMEM;
-        err.message = "Failed to allocate archive entry";
+    plan.push_back(std::move(entry));
+    std::vector<std::string> names;
+    if (!read_dir_names(path, names, err)) {
         return false;
     }
+    for (const auto& name : names) {
+        std::string child = path;
+        if (child.back() != '/') {
+            child.push_back('/');
+        }
+        child += name;
+        if (!plan_entries(child, base, plan, totalBytes, depth + 1, err)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    archive_entry_set_pathname(entry, relPath.c_str());
-    archive_entry_set_perm(entry, st.st_mode & 07777);
-    archive_entry_set_uid(entry, st.st_uid);
-    archive_entry_set_gid(entry, st.st_gid);
-    archive_entry_set_mtime(entry, st.st_mtime, 0);
-    archive_entry_set_atime(entry, st.st_atime, 0);
+// Reads upcoming regular files on a small thread pool while the writer compresses. Chunks come
+// from a fixed budget of buffers (the hard memory cap); files are claimed in archive order and
+// delivered to the writer in that order. The file the writer is waiting on may use a reserve
+// the other readers cannot touch, so look-ahead can never starve it.
+class ReadAhead {
+   public:
+    struct Chunk {
+        std::vector<char> data;
+        std::size_t size = 0;
+    };
+
+    ReadAhead(const std::vector<PlannedEntry>& plan, unsigned threads, std::size_t capBytes) : plan_(plan) {
+        for (std::size_t i = 0; i < plan.size(); ++i) {
+            if (S_ISREG(plan[i].mode)) {
+                files_.push_back(i);
+            }
+        }
+        slots_ = std::vector<Slot>(files_.size());
+        const std::size_t budget = std::max(capBytes, kChunkSize * (kReserveChunks + 1));
+        buffersLeft_ = budget / kChunkSize;
+        if (files_.empty()) {
+            return;
+        }
+        threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(files_.size())));
+        for (unsigned i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
 
-    if (S_ISDIR(st.st_mode)) {
-        archive_entry_set_filetype(entry, AE_IFDIR);
-        archive_entry_set_size(entry, 0);
-        if (archive_write_header(ar, entry) != ARCHIVE_OK) {
-            set_archive_error(err, ar, "archive_write_header");
-            archive_entry_free(entry);
-            return false;
+    ~ReadAhead() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
         }
-        archive_entry_free(entry);
-        progress.filesDone += 1;
+        cond_.notify_all();
+        for (auto& t : workers_) {
+            t.join();
+        }
+    }
 
-        Fd dir_fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECTORY));
-        if (!dir_fd.valid()) {
-            set_error(err, "open");
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+
+    // Next chunk of the |fileIndex|-th regular file; |chunk.size| == 0 marks the end of the file.
+    // Files must be consumed in order.
+    bool next(std::size_t fileIndex, Chunk& chunk, Error& err) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        head_ = fileIndex;
+        cond_.notify_all();
+        Slot& slot = slots_[fileIndex];
+        cond_.wait(lock, [&] { return !slot.chunks.empty() || slot.done; });
+        if (!slot.chunks.empty()) {
+            chunk = std::move(slot.chunks.front());
+            slot.chunks.pop_front();
+            return true;
+        }
+        if (slot.err.code != 0) {
+            err = slot.err;
             return false;
         }
-        DIR* dir = ::fdopendir(dir_fd.fd);
-        if (!dir) {
-            set_error(err, "fdopendir");
+        chunk.size = 0;
+        return true;
+    }
+
+    // Returns a consumed chunk's buffer to the pool.
+    void recycle(Chunk& chunk) {
+        if (chunk.data.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(std::move(chunk.data));
+        chunk = {};
+        cond_.notify_all();
+    }
+
+   private:
+    static constexpr std::size_t kChunkSize = 1024 * 1024;
+    static constexpr std::size_t kReserveChunks = 2;
+
+    struct Slot {
+        std::deque<Chunk> chunks;
+        bool done = false;
+        Error err;
+    };
+
+    bool acquire(std::size_t fileIndex, std::vector<char>& buffer) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] {
+            if (stop_) {
+                return true;
+            }
+            const std::size_t available = free_.size() + buffersLeft_;
+            return fileIndex == head_ ? available > 0 : available > kReserveChunks;
+        });
+        if (stop_) {
             return false;
         }
-        dir_fd.fd = -1;
+        if (!free_.empty()) {
+            buffer = std::move(free_.back());
+            free_.pop_back();
+        }
+        else {
+            --buffersLeft_;
+            buffer.resize(kChunkSize);
+        }
+        return true;
+    }
 
+    void deliver(std::size_t fileIndex, Chunk chunk) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_[fileIndex].chunks.push_back(std::move(chunk));
+        cond_.notify_all();
+    }
+
+    void finish(std::size_t fileIndex, const Error& err) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_[fileIndex].done = true;
+        slots_[fileIndex].err = err;
+        cond_.notify_all();
+    }
+
+    void run() {
         for (;;) {
-            errno = 0;
-            dirent* ent = ::readdir(dir);
-            if (!ent) {
-                if (errno != 0) {
-                    set_error(err, "readdir");
-                    ::closedir(dir);
-                    return false;
-                }
-                break;
+            const std::size_t fileIndex = nextFile_.fetch_add(1);
+            if (fileIndex >= files_.size()) {
+                return;
             }
-            const char* name = ent->d_name;
-            if (!name || name[0] == '\0' || std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
-                continue;
-            }
-            std::string child = path;
-            if (child.back() != '/') {
-                child.push_back('/');
-            }
-            child += name;
-            if (!write_entry(ar, child, base, progress, cb, err, depth + 1)) {
-                ::closedir(dir);
-                return false;
+            Error err;
+            read_file(fileIndex, err);
+            finish(fileIndex, err);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) {
+                return;
             }
         }
-        ::closedir(dir);
-        return true;
     }
 
-    if (S_ISLNK(st.st_mode)) {
-        std::string target(static_cast<std::size_t>(st.st_size) + 1, '\0');
-        const ssize_t len = ::readlink(path.c_str(), target.data(), target.size());
-        if (len < 0) {
-            set_error(err, "readlink");
-            archive_entry_free(entry);
-            return false;
+    void read_file(std::size_t fileIndex, Error& err) {
+        const PlannedEntry& entry = plan_[files_[fileIndex]];
+        Fd fd(::open(entry.path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW));
+        if (!fd.valid()) {
+            set_error(err, "open");
+            return;
         }
-        target.resize(static_cast<std::size_t>(len));
-        archive_entry_set_filetype(entry, AE_IFLNK);
-        archive_entry_set_size(entry, 0);
-        archive_entry_set_symlink(entry, target.c_str());
+        ::posix_fadvise(fd.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-        if (archive_write_header(ar, entry) != ARCHIVE_OK) {
-            set_archive_error(err, ar, "archive_write_header");
-            archive_entry_free(entry);
-            return false;
+        // The header already announced the size; the archive pads if the file shrank meanwhile.
+        std::uint64_t remaining = entry.size;
+        while (remaining > 0) {
+            Chunk chunk;
+            if (!acquire(fileIndex, chunk.data)) {
+                return;
+            }
+            const std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, chunk.data.size()));
+            while (chunk.size < want) {
+                const ssize_t n = ::read(fd.fd, chunk.data.data() + chunk.size, want - chunk.size);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    set_error(err, "read");
+                    recycle(chunk);
+                    return;
+                }
+                if (n == 0) {
+                    break;
+                }
+                chunk.size += static_cast<std::size_t>(n);
+            }
+            if (chunk.size == 0) {
+                recycle(chunk);
+                return;
+            }
+            remaining -= chunk.size;
+            const bool shortRead = chunk.size < want;
+            deliver(fileIndex, std::move(chunk));
+            if (shortRead) {
+                return;
+            }
         }
-        archive_entry_free(entry);
-        progress.filesDone += 1;
-        return true;
     }
 
-    if (!S_ISREG(st.st_mode)) {
-        archive_entry_free(entry);
-        err.code = ENOTSUP;
-        err.message = "Unsupported file type";
+    const std::vector<PlannedEntry>& plan_;
+    std::vector<std::size_t> files_;  // plan indices of regular files
+    std::vector<Slot> slots_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> nextFile_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::vector<char>> free_;
+    std::size_t buffersLeft_ = 0;  // buffers that may still be allocated
+    std::size_t head_ = 0;         // file the writer is consuming
+    bool stop_ = false;
+};
+
+// libarchive client callbacks routing the uncompressed tar stream into the seekable framer
+struct SeekableSink {
+    SeekableZstd::Writer* writer;
+    Error err;
+};
+
+la_ssize_t seekable_write_cb(struct archive* ar, void* clientData, const void* buffer, size_t length) {
+    auto* sink = static_cast<SeekableSink*>(clientData);
+    if (!sink->writer->write(buffer, length, sink->err)) {
+        archive_set_error(ar, sink->err.code, "%s", sink->err.message.c_str());
+        return -1;
+    }
+    return static_cast<la_ssize_t>(length);
+}
+
+bool write_entry(struct archive* ar,
+                 const PlannedEntry& planned,
+                 ReadAhead& readAhead,
+                 std::size_t& fileIndex,
+                 ProgressInfo& progress,
+                 const ProgressCallback& cb,
+                 Error& err,
+                 SeekableZstd::Writer* seekable) {
+    progress.currentPath = planned.relPath;
+    if (!should_continue(cb, progress)) {
+        err.code = ECANCELED;
+        err.message = "Cancelled";
+        return false;
+    }
+
+    archive_entry* entry = archive_entry_new();
+    if (!entry) {
+        err.code = ENOMEM;
+        err.message = "Failed to allocate archive entry";
         return false;
     }
 
-    archive_entry_set_filetype(entry, AE_IFREG);
-    archive_entry_set_size(entry, st.st_size);
+    archive_entry_set_pathname(entry, planned.relPath.c_str());
+    if (seekable) {
+        // Flush the previous entry's padding first; libarchive writes unblocked in seekable mode,
+        // so the framer position is then exactly this entry's header offset.
+        archive_write_finish_entry(ar);
+        seekable->mark_entry(planned.relPath);
+    }
+    archive_entry_set_perm(entry, planned.mode & 07777);
+    archive_entry_set_uid(entry, planned.uid);
+    archive_entry_set_gid(entry, planned.gid);
+    archive_entry_set_mtime(entry, planned.mtime, 0);
+    archive_entry_set_atime(entry, planned.atime, 0);
+
+    if (S_ISDIR(planned.mode)) {
+        archive_entry_set_filetype(entry, AE_IFDIR);
+        archive_entry_set_size(entry, 0);
+    }
+    else if (S_ISLNK(planned.mode)) {
+        archive_entry_set_filetype(entry, AE_IFLNK);
+        archive_entry_set_size(entry, 0);
+        archive_entry_set_symlink(entry, planned.linkTarget.c_str());
+    }
+    else {
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_size(entry, static_cast<la_int64_t>(planned.size));
+    }
 
     if (archive_write_header(ar, entry) != ARCHIVE_OK) {
         set_archive_error(err, ar, "archive_write_header");
         archive_entry_free(entry);
         return false;
     }
+    archive_entry_free(entry);
 
-    Fd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW));
-    if (!fd.valid()) {
-        set_error(err, "open");
-        archive_entry_free(entry);
-        return false;
+    if (!S_ISREG(planned.mode)) {
+        progress.filesDone += 1;
+        return true;
     }
 
-    std::array<char, 128 * 1024> buffer{};
+    const std::size_t index = fileIndex++;
     for (;;) {
-        const ssize_t n = ::read(fd.fd, buffer.data(), buffer.size());
-        if (n < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            set_error(err, "read");
-            archive_entry_free(entry);
+        ReadAhead::Chunk chunk;
+        if (!readAhead.next(index, chunk, err)) {
             return false;
         }
-        if (n == 0) {
+        if (chunk.size == 0) {
             break;
         }
 
-        if (archive_write_data(ar, buffer.data(), static_cast<std::size_t>(n)) < 0) {
+        const la_ssize_t written = archive_write_data(ar, chunk.data.data(), chunk.size);
+        readAhead.recycle(chunk);
+        if (written < 0) {
             set_archive_error(err, ar, "archive_write_data");
-            archive_entry_free(entry);
             return false;
         }
 
-        progress.bytesDone += static_cast<std::uint64_t>(n);
+        progress.bytesDone += static_cast<std::uint64_t>(written);
         if (!should_continue(cb, progress)) {
             err.code = ECANCELED;
             err.message = "Cancelled";
-            archive_entry_free(entry);
             return false;
         }
     }
 
-    archive_entry_free(entry);
     progress.filesDone += 1;
     return true;
 }
@@ -346,7 +536,8 @@ bool create_tar_zst(const std::vector<std::string>& sources,
                     const std::string& destination,
                     ProgressInfo& progress,
                     const ProgressCallback& callback,
-                    Error& err) {
+                    Error& err,
+                    const Options& opts) {
     progress = {};
     err = {};
 
@@ -360,10 +551,11 @@ bool create_tar_zst(const std::vector<std::string>& sources,
         return false;
     }
 
-    // Pre-scan for total bytes to feed progress.
+    // One walk yields both the archive layout and the byte total for progress.
+    std::vector<PlannedEntry> plan;
     std::uint64_t totalBytes = 0;
     for (const auto& src : sources) {
-        if (!accumulate_size(src, totalBytes, 0, err)) {
+        if (!plan_entries(src, parent_dir(src), plan, totalBytes, 0, err)) {
             return false;
         }
     }
@@ -383,22 +575,49 @@ bool create_tar_zst(const std::vector<std::string>& sources,
     }
 
     archive_write_set_format_pax_restricted(ar);
-    if (archive_write_add_filter_by_name(ar, "zstd") != ARCHIVE_OK) {
-        archive_write_add_filter_none(ar);  // best-effort fallback
-    }
 
-    if (archive_write_open_fd(ar, out_fd.fd) != ARCHIVE_OK) {
-        set_archive_error(err, ar, "archive_write_open_fd");
+    std::unique_ptr<SeekableZstd::Writer> seekable;
+    SeekableSink sink{nullptr, {}};
+    int openResult = ARCHIVE_OK;
+    if (opts.seekableFrameSize > 0) {
+        // Compression happens in the framer; libarchive only produces the tar stream.
+        seekable = std::make_unique<SeekableZstd::Writer>(out_fd.fd, opts.seekableFrameSize, opts.compressionLevel);
+        sink.writer = seekable.get();
+        archive_write_add_filter_none(ar);
+        archive_write_set_bytes_per_block(ar, 0);
+        openResult = archive_write_open2(ar, &sink, nullptr, seekable_write_cb, nullptr, nullptr);
+    }
+    else {
+        if (archive_write_add_filter_by_name(ar, "zstd") != ARCHIVE_OK) {
+            archive_write_add_filter_none(ar);  // best-effort fallback
+        }
+        else {
+            archive_write_set_filter_option(ar, "zstd", "compression-level",
+                                            std::to_string(opts.compressionLevel).c_str());
+        }
+        openResult = archive_write_open_fd(ar, out_fd.fd);
+    }
+    if (openResult != ARCHIVE_OK) {
+        set_archive_error(err, ar, "archive_write_open");
         archive_write_free(ar);
+        ::unlink(destination.c_str());
         return false;
     }
 
     bool ok = true;
-    for (const auto& src : sources) {
-        const std::string base = parent_dir(src);
-        if (!write_entry(ar, src, base, progress, callback, err, 0)) {
-            ok = false;
-            break;
+    {
+        unsigned readers = opts.readerThreads;
+        if (readers == 0) {
+            const unsigned hc = std::thread::hardware_concurrency();
+            readers = std::clamp(hc, 1u, 4u);
+        }
+        ReadAhead readAhead(plan, readers, opts.readAheadBytes);
+        std::size_t fileIndex = 0;
+        for (const auto& planned : plan) {
+            if (!write_entry(ar, planned, readAhead, fileIndex, progress, callback, err, seekable.get())) {
+                ok = false;
+                break;
+            }
         }
     }
 
@@ -408,6 +627,10 @@ bool create_tar_zst(const std::vector<std::string>& sources,
     }
     archive_write_free(ar);
 
+    if (ok && seekable && !seekable->finish(err)) {
+        ok = false;
+    }
+
     if (!ok) {
         ::unlink(destination.c_str());
     }
@@ -8,11 +8,23 @@
 
 #include "fs_ops.h"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace PCManFM::ArchiveWriter {
 
+struct Options {
+    // When non-zero, write seekable zstd: independent frames of this many uncompressed bytes,
+    // an entry index and a seek table (see seekable_zstd.h). Plain zstd tools still decompress it.
+    std::size_t seekableFrameSize = 0;
+    int compressionLevel = 3;
+    // Source files are read ahead on this many threads (0 = up to 4) while the writer
+    // compresses; buffered file data never exceeds |readAheadBytes|.
+    unsigned readerThreads = 0;
+    std::size_t readAheadBytes = 64 * 1024 * 1024;
+};
+
 // Create a tar archive (compressed with zstd if available in libarchive) at |destination|
 // from the given list of native byte-string paths. Progress and cancellation use the same
 // callback contract as fs_ops.
@@ -20,7 +32,8 @@ bool create_tar_zst(const std::vector<std::string>& sources,
                     const std::string& destination,
                     FsOps::ProgressInfo& progress,
                     const FsOps::ProgressCallback& callback,
-                    FsOps::Error& err);
+                    FsOps::Error& err,
+                    const Options& opts = {});
 
 // Extract a tar or tar.zst archive at |archivePath| into |destinationDir|. The destination
 // directory is created and must not already exist. Progress/cancel semantics match fs_ops.
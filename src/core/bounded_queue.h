@@ -0,0 +1,91 @@
+/*
+ * Byte-bounded blocking queue for producer/consumer pipelines
+ * src/core/bounded_queue.h
+ */
+
+#ifndef PCMANFM_BOUNDED_QUEUE_H
+#define PCMANFM_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace PCManFM {
+
+// Multi-producer/multi-consumer queue whose capacity is expressed in bytes rather than items.
+// A single item larger than the capacity is still admitted when the queue is empty, so the
+// pipeline cannot deadlock; memory use is therefore bounded by max(capacity, largest item).
+template <typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(std::size_t capacityBytes) : capacity_(capacityBytes) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Blocks while the queue is full. Returns false if the queue was cancelled.
+    bool push(T item, std::size_t cost) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [&] { return cancelled_ || items_.empty() || bytes_ + cost <= capacity_; });
+        if (cancelled_) {
+            return false;
+        }
+        bytes_ += cost;
+        items_.emplace_back(std::move(item), cost);
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available. Returns false once the queue is closed and drained,
+    // or cancelled.
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [&] { return cancelled_ || closed_ || !items_.empty(); });
+        if (cancelled_ || items_.empty()) {
+            return false;
+        }
+        out = std::move(items_.front().first);
+        bytes_ -= items_.front().second;
+        items_.pop_front();
+        notFull_.notify_all();
+        return true;
+    }
+
+    // No more items will be pushed; consumers drain what is left.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+    }
+
+    // Wakes every waiter and drops queued items; used for errors and cancellation.
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        items_.clear();
+        bytes_ = 0;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    bool cancelled() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cancelled_;
+    }
+
+   private:
+    const std::size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<std::pair<T, std::size_t>> items_;
+    std::size_t bytes_ = 0;
+    bool closed_ = false;
+    bool cancelled_ = false;
+};
+
+}  // namespace PCManFM
+
+#endif  // PCMANFM_BOUNDED_QUEUE_H
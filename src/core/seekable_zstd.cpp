@@ -0,0 +1,399 @@
+/*
+ * Seekable zstd framing for tar streams (independent frames + seek table)
+ * src/core/seekable_zstd.cpp
+ */
+
+#include "seekable_zstd.h"
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PCManFM::SeekableZstd {
+namespace {
+
+using PCManFM::FsOps::Error;
+
+constexpr std::uint32_t kSeekTableMagic = 0x184D2A5E;  // skippable frame holding the seek table
+constexpr std::uint32_t kIndexMagic = 0x184D2A5D;      // skippable frame holding the entry index
+constexpr std::uint32_t kSeekableFooterMagic = 0x8F92EAB1;
+constexpr std::size_t kSkippableHeaderSize = 8;
+constexpr std::size_t kFooterSize = 9;
+constexpr std::uint8_t kChecksumFlag = 0x80;
+constexpr std::uint8_t kReservedBits = 0x7C;
+constexpr char kIndexTag[8] = {'P', 'F', 'M', 'I', 'D', 'X', '0', '1'};
+
+// Upper bound for a single frame on the read side so a crafted table cannot demand huge buffers.
+constexpr std::uint32_t kMaxFrameSize = 256u * 1024 * 1024;
+
+inline void set_error(Error& err, const std::string& context) {
+    err.code = errno;
+    err.message = context + ": " + std::strerror(errno);
+}
+
+inline void set_format_error(Error& err, const char* message) {
+    err.code = EINVAL;
+    err.message = message;
+}
+
+void put_le32(std::vector<std::uint8_t>& out, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<std::uint8_t>(v >> (8 * i)));
+    }
+}
+
+void put_le64(std::vector<std::uint8_t>& out, std::uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<std::uint8_t>(v >> (8 * i)));
+    }
+}
+
+std::uint32_t get_le32(const std::uint8_t* p) {
+    return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+           (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+std::uint64_t get_le64(const std::uint8_t* p) {
+    return static_cast<std::uint64_t>(get_le32(p)) | (static_cast<std::uint64_t>(get_le32(p + 4)) << 32);
+}
+
+bool pread_all(int fd, void* data, std::size_t size, std::uint64_t offset, Error& err) {
+    auto* ptr = static_cast<std::uint8_t*>(data);
+    std::size_t done = 0;
+    while (done < size) {
+        const ssize_t n = ::pread(fd, ptr + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_error(err, "pread");
+            return false;
+        }
+        if (n == 0) {
+            err.code = EIO;
+            err.message = "Unexpected end of file";
+            return false;
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool parse_index(const std::uint8_t* p, std::size_t size, std::vector<IndexEntry>& entries) {
+    if (size < sizeof(kIndexTag) + 4 || std::memcmp(p, kIndexTag, sizeof(kIndexTag)) != 0) {
+        return false;
+    }
+    const std::uint8_t* end = p + size;
+    p += sizeof(kIndexTag);
+    const std::uint32_t count = get_le32(p);
+    p += 4;
+
+    std::vector<IndexEntry> parsed;
+    parsed.reserve(std::min<std::size_t>(count, size / 12));
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (static_cast<std::size_t>(end - p) < 12) {
+            return false;
+        }
+        IndexEntry entry;
+        entry.offset = get_le64(p);
+        const std::uint32_t len = get_le32(p + 8);
+        p += 12;
+        if (static_cast<std::size_t>(end - p) < len) {
+            return false;
+        }
+        entry.path.assign(reinterpret_cast<const char*>(p), len);
+        p += len;
+        parsed.push_back(std::move(entry));
+    }
+    entries = std::move(parsed);
+    return true;
+}
+
+}  // namespace
+
+std::size_t SeekTable::frame_for_offset(std::uint64_t offset) const {
+    auto it = std::upper_bound(frames.begin(), frames.end(), offset,
+                               [](std::uint64_t off, const Frame& f) { return off < f.decompressedOffset; });
+    if (it == frames.begin()) {
+        return frames.size();
+    }
+    --it;
+    if (offset >= it->decompressedOffset + it->decompressedSize) {
+        return frames.size();
+    }
+    return static_cast<std::size_t>(it - frames.begin());
+}
+
+Writer::Writer(int fd, std::size_t frameSize, int level)
+    : fd_(fd), frameSize_(std::clamp<std::size_t>(frameSize, 64 * 1024, kMaxFrameSize)), level_(level) {
+    cctx_ = ZSTD_createCCtx();
+    if (cctx_) {
+        ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level_);
+        ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 1);
+    }
+    pending_.reserve(frameSize_);
+}
+
+Writer::~Writer() {
+    ZSTD_freeCCtx(cctx_);
+}
+
+bool Writer::write(const void* data, std::size_t size, Error& err) {
+    const auto* ptr = static_cast<const std::uint8_t*>(data);
+    while (size > 0) {
+        const std::size_t take = std::min(size, frameSize_ - pending_.size());
+        pending_.insert(pending_.end(), ptr, ptr + take);
+        ptr += take;
+        size -= take;
+        position_ += take;
+        if (pending_.size() == frameSize_ && !flush_frame(err)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Writer::mark_entry(const std::string& path) {
+    table_.entries.push_back(IndexEntry{path, position_});
+}
+
+bool Writer::write_out(const void* data, std::size_t size, Error& err) {
+    const auto* ptr = static_cast<const std::uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = ::write(fd_, ptr, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            set_error(err, "write");
+            return false;
+        }
+        ptr += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool Writer::flush_frame(Error& err) {
+    if (pending_.empty()) {
+        return true;
+    }
+    if (!cctx_) {
+        err.code = ENOMEM;
+        err.message = "Failed to allocate zstd context";
+        return false;
+    }
+
+    out_.resize(ZSTD_compressBound(pending_.size()));
+    const std::size_t n = ZSTD_compress2(cctx_, out_.data(), out_.size(), pending_.data(), pending_.size());
+    if (ZSTD_isError(n)) {
+        err.code = EIO;
+        err.message = std::string("zstd compression failed: ") + ZSTD_getErrorName(n);
+        return false;
+    }
+    if (!write_out(out_.data(), n, err)) {
+        return false;
+    }
+
+    Frame frame;
+    if (!table_.frames.empty()) {
+        const Frame& last = table_.frames.back();
+        frame.compressedOffset = last.compressedOffset + last.compressedSize;
+        frame.decompressedOffset = last.decompressedOffset + last.decompressedSize;
+    }
+    frame.compressedSize = static_cast<std::uint32_t>(n);
+    frame.decompressedSize = static_cast<std::uint32_t>(pending_.size());
+    table_.frames.push_back(frame);
+    pending_.clear();
+    return true;
+}
+
+bool Writer::finish(Error& err) {
+    if (!flush_frame(err)) {
+        return false;
+    }
+
+    std::vector<std::uint8_t> buf;
+    if (!table_.entries.empty()) {
+        std::vector<std::uint8_t> payload(kIndexTag, kIndexTag + sizeof(kIndexTag));
+        put_le32(payload, static_cast<std::uint32_t>(table_.entries.size()));
+        for (const auto& entry : table_.entries) {
+            put_le64(payload, entry.offset);
+            put_le32(payload, static_cast<std::uint32_t>(entry.path.size()));
+            payload.insert(payload.end(), entry.path.begin(), entry.path.end());
+        }
+        put_le32(buf, kIndexMagic);
+        put_le32(buf, static_cast<std::uint32_t>(payload.size()));
+        buf.insert(buf.end(), payload.begin(), payload.end());
+    }
+
+    // Seek_Table_Entries without checksums, then the Seek_Table_Footer
+    const std::size_t tableSize = table_.frames.size() * 8 + kFooterSize;
+    put_le32(buf, kSeekTableMagic);
+    put_le32(buf, static_cast<std::uint32_t>(tableSize));
+    for (const auto& frame : table_.frames) {
+        put_le32(buf, frame.compressedSize);
+        put_le32(buf, frame.decompressedSize);
+    }
+    put_le32(buf, static_cast<std::uint32_t>(table_.frames.size()));
+    buf.push_back(0);
+    put_le32(buf, kSeekableFooterMagic);
+    return write_out(buf.data(), buf.size(), err);
+}
+
+bool read_seek_table(int fd, SeekTable& table, Error& err) {
+    table = {};
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        set_error(err, "fstat");
+        return false;
+    }
+    const std::uint64_t fileSize = static_cast<std::uint64_t>(st.st_size);
+    if (fileSize < kSkippableHeaderSize + kFooterSize) {
+        err.code = ENOENT;
+        err.message = "No seek table";
+        return false;
+    }
+
+    std::uint8_t footer[kFooterSize];
+    if (!pread_all(fd, footer, sizeof(footer), fileSize - kFooterSize, err)) {
+        return false;
+    }
+    if (get_le32(footer + 5) != kSeekableFooterMagic) {
+        err.code = ENOENT;
+        err.message = "No seek table";
+        return false;
+    }
+    const std::uint32_t frameCount = get_le32(footer);
+    const std::uint8_t descriptor = footer[4];
+    if (descriptor & kReservedBits) {
+        set_format_error(err, "Unsupported seek table descriptor");
+        return false;
+    }
+    const std::uint64_t entrySize = (descriptor & kChecksumFlag) ? 12 : 8;
+    const std::uint64_t tableSize = frameCount * entrySize + kFooterSize;
+    if (tableSize + kSkippableHeaderSize > fileSize) {
+        set_format_error(err, "Truncated seek table");
+        return false;
+    }
+    const std::uint64_t tableStart = fileSize - tableSize - kSkippableHeaderSize;
+
+    std::vector<std::uint8_t> raw(static_cast<std::size_t>(tableSize + kSkippableHeaderSize));
+    if (!pread_all(fd, raw.data(), raw.size(), tableStart, err)) {
+        return false;
+    }
+    if (get_le32(raw.data()) != kSeekTableMagic || get_le32(raw.data() + 4) != tableSize) {
+        set_format_error(err, "Corrupt seek table");
+        return false;
+    }
+
+    table.frames.reserve(frameCount);
+    std::uint64_t compressed = 0;
+    std::uint64_t decompressed = 0;
+    const std::uint8_t* p = raw.data() + kSkippableHeaderSize;
+    for (std::uint32_t i = 0; i < frameCount; ++i, p += entrySize) {
+        Frame frame;
+        frame.compressedOffset = compressed;
+        frame.decompressedOffset = decompressed;
+        frame.compressedSize = get_le32(p);
+        frame.decompressedSize = get_le32(p + 4);
+        if (frame.decompressedSize > kMaxFrameSize || frame.compressedSize > ZSTD_compressBound(kMaxFrameSize)) {
+            set_format_error(err, "Seekable frame too large");
+            table = {};
+            return false;
+        }
+        compressed += frame.compressedSize;
+        decompressed += frame.decompressedSize;
+        table.frames.push_back(frame);
+    }
+    if (compressed > tableStart) {
+        set_format_error(err, "Seek table does not match file size");
+        table = {};
+        return false;
+    }
+
+    // The entry index is optional and sits between the last data frame and the seek table.
+    const std::uint64_t gap = tableStart - compressed;
+    if (gap >= kSkippableHeaderSize) {
+        std::uint8_t header[kSkippableHeaderSize];
+        if (pread_all(fd, header, sizeof(header), compressed, err) && get_le32(header) == kIndexMagic &&
+            get_le32(header + 4) == gap - kSkippableHeaderSize) {
+            std::vector<std::uint8_t> payload(static_cast<std::size_t>(gap - kSkippableHeaderSize));
+            if (pread_all(fd, payload.data(), payload.size(), compressed + kSkippableHeaderSize, err)) {
+                parse_index(payload.data(), payload.size(), table.entries);
+            }
+        }
+        err = {};
+    }
+    return true;
+}
+
+Reader::Reader(int fd, const SeekTable& table) : fd_(fd), table_(table) {
+    dctx_ = ZSTD_createDCtx();
+}
+
+Reader::~Reader() {
+    ZSTD_freeDCtx(dctx_);
+}
+
+bool Reader::load_frame(std::size_t index, Error& err) {
+    const Frame& frame = table_.frames[index];
+    if (!dctx_) {
+        err.code = ENOMEM;
+        err.message = "Failed to allocate zstd context";
+        return false;
+    }
+    compressed_.resize(frame.compressedSize);
+    if (!pread_all(fd_, compressed_.data(), compressed_.size(), frame.compressedOffset, err)) {
+        return false;
+    }
+    buffer_.resize(frame.decompressedSize);
+    const std::size_t n =
+        ZSTD_decompressDCtx(dctx_, buffer_.data(), buffer_.size(), compressed_.data(), compressed_.size());
+    if (ZSTD_isError(n) || n != buffer_.size()) {
+        err.code = EIO;
+        err.message = "Corrupt seekable zstd frame";
+        return false;
+    }
+    bufferPos_ = 0;
+    return true;
+}
+
+bool Reader::seek(std::uint64_t offset, Error& err) {
+    const std::size_t index = table_.frame_for_offset(offset);
+    if (index >= table_.frames.size()) {
+        set_format_error(err, "Offset outside of seekable archive");
+        return false;
+    }
+    if (!load_frame(index, err)) {
+        return false;
+    }
+    bufferPos_ = static_cast<std::size_t>(offset - table_.frames[index].decompressedOffset);
+    nextFrame_ = index + 1;
+    return true;
+}
+
+bool Reader::next_chunk(const void*& data, std::size_t& size, Error& err) {
+    if (bufferPos_ >= buffer_.size()) {
+        if (nextFrame_ >= table_.frames.size()) {
+            data = nullptr;
+            size = 0;
+            return true;
+        }
+        if (!load_frame(nextFrame_++, err)) {
+            return false;
+        }
+    }
+    data = buffer_.data() + bufferPos_;
+    size = buffer_.size() - bufferPos_;
+    bufferPos_ = buffer_.size();
+    return true;
+}
+
+}  // namespace PCManFM::SeekableZstd
@@ -0,0 +1,107 @@
+/*
+ * Seekable zstd framing for tar streams (independent frames + seek table)
+ * src/core/seekable_zstd.h
+ */
+
+#ifndef PCMANFM_SEEKABLE_ZSTD_H
+#define PCMANFM_SEEKABLE_ZSTD_H
+
+#include "fs_ops.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace PCManFM::SeekableZstd {
+
+// Layout written by Writer, readable by any zstd decoder (skippable frames are ignored):
+//
+//   [zstd frame]...[zstd frame][entry index skippable frame][seek table skippable frame]
+//
+// The seek table follows the zstd seekable format (contrib/seekable_format); the entry index
+// maps archive paths to their header offset in the decompressed stream.
+
+struct Frame {
+    std::uint64_t compressedOffset = 0;
+    std::uint64_t decompressedOffset = 0;
+    std::uint32_t compressedSize = 0;
+    std::uint32_t decompressedSize = 0;
+};
+
+struct IndexEntry {
+    std::string path;
+    std::uint64_t offset = 0;  // first header byte of the entry in the decompressed stream
+};
+
+struct SeekTable {
+    std::vector<Frame> frames;
+    std::vector<IndexEntry> entries;  // empty when the archive carries no entry index
+
+    // Index of the frame containing decompressed |offset|, or frames.size() if out of range.
+    std::size_t frame_for_offset(std::uint64_t offset) const;
+};
+
+// Compresses a byte stream into independent frames of |frameSize| uncompressed bytes.
+class Writer {
+   public:
+    Writer(int fd, std::size_t frameSize, int level);
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool write(const void* data, std::size_t size, FsOps::Error& err);
+    // Records that the entry |path| starts at the current stream position.
+    void mark_entry(const std::string& path);
+    // Flushes the last frame and appends the entry index and seek table.
+    bool finish(FsOps::Error& err);
+
+   private:
+    bool flush_frame(FsOps::Error& err);
+    bool write_out(const void* data, std::size_t size, FsOps::Error& err);
+
+    int fd_;
+    std::size_t frameSize_;
+    int level_;
+    ZSTD_CCtx_s* cctx_ = nullptr;
+    std::vector<std::uint8_t> pending_;
+    std::vector<std::uint8_t> out_;
+    std::uint64_t position_ = 0;  // decompressed bytes accepted so far
+    SeekTable table_;
+};
+
+// Reads the seek table (and entry index when present) from the end of |fd|.
+// Fails with ENOENT when the file is not in seekable format.
+bool read_seek_table(int fd, SeekTable& table, FsOps::Error& err);
+
+// Sequential decompressed reader that can start at any decompressed offset.
+class Reader {
+   public:
+    Reader(int fd, const SeekTable& table);
+    ~Reader();
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    bool seek(std::uint64_t offset, FsOps::Error& err);
+    // Exposes the next decompressed chunk without copying; valid until the next call.
+    // |size| is 0 at the end of the stream.
+    bool next_chunk(const void*& data, std::size_t& size, FsOps::Error& err);
+
+   private:
+    bool load_frame(std::size_t index, FsOps::Error& err);
+
+    int fd_;
+    const SeekTable& table_;
+    ZSTD_DCtx_s* dctx_ = nullptr;
+    std::size_t nextFrame_ = 0;
+    std::vector<std::uint8_t> compressed_;
+    std::vector<std::uint8_t> buffer_;
+    std::size_t bufferPos_ = 0;
+};
+
+}  // namespace PCManFM::SeekableZstd
+
+#endif  // PCMANFM_SEEKABLE_ZSTD_H
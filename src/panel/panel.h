@@ -10,11 +10,13 @@
 #include <libfm-qt6/cachedfoldermodel.h>
 #include <libfm-qt6/core/archiver.h>
 #include <libfm-qt6/core/bookmarks.h>
+#include <libfm-qt6/core/diskusagejob.h>
 #include <libfm-qt6/core/fileinfo.h>
 #include <libfm-qt6/core/fileinfojob.h>
 #include <libfm-qt6/core/filepath.h>
 #include <libfm-qt6/core/folder.h>
 #include <libfm-qt6/core/folderconfig.h>
+#include <libfm-qt6/core/folderprefetcher.h>
 #include <libfm-qt6/core/iconinfo.h>
 #include <libfm-qt6/core/mimetype.h>
 #include <libfm-qt6/core/job.h>
@@ -56,6 +58,7 @@ using Bookmarks = Fm::Bookmarks;
 using BookmarkItem = Fm::BookmarkItem;
 using BrowseHistory = Fm::BrowseHistory;
 using BrowseHistoryItem = Fm::BrowseHistoryItem;
+using DiskUsageJob = Fm::DiskUsageJob;
 using Folder = Fm::Folder;
 using FolderModel = Fm::FolderModel;
 using ProxyFolderModel = Fm::ProxyFolderModel;
@@ -67,6 +70,7 @@ using FileMenu = Fm::FileMenu;
 using FileLauncher = Fm::FileLauncher;
 using FileOperation = Fm::FileOperation;
 using FolderConfig = Fm::FolderConfig;
+using FolderPrefetcher = Fm::FolderPrefetcher;
 using IconInfo = Fm::IconInfo;
 using MimeType = Fm::MimeType;
 using ThumbnailJob = Fm::ThumbnailJob;
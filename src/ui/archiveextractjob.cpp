@@ -17,10 +17,12 @@ namespace PCManFM {
 
 ArchiveExtractJob::ArchiveExtractJob(QObject* parent) : QObject(parent), cancelRequested_(false) {}
 
-void ArchiveExtractJob::start(const QString& archivePath, const QString& destinationDir) {
+void ArchiveExtractJob::start(const QString& archivePath,
+                              const QString& destinationDir,
+                              const QStringList& selectedEntries) {
     cancelRequested_.store(false, std::memory_order_relaxed);
 
-    auto future = QtConcurrent::run([this, archivePath, destinationDir]() -> Result {
+    auto future = QtConcurrent::run([this, archivePath, destinationDir, selectedEntries]() -> Result {
         const QByteArray archiveBytes = QFile::encodeName(archivePath);
         const QByteArray destBytes = QFile::encodeName(destinationDir);
 
@@ -47,6 +49,10 @@ void ArchiveExtractJob::start(const QString& archivePath, const QString& destina
         // Use all available cores for filters when libarchive supports it.
         opts.enableFilterThreads = true;
         opts.maxFilterThreads = 0;
+        for (const QString& entry : selectedEntries) {
+            const QByteArray entryBytes = QFile::encodeName(entry);
+            opts.filter.paths.emplace_back(entryBytes.constData(), static_cast<std::size_t>(entryBytes.size()));
+        }
 
         const bool ok = PCManFM::ArchiveExtract::extract_archive(archiveNative, destNative, opProgress, cb, err, opts);
 
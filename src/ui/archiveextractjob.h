@@ -9,6 +9,7 @@
 #include <QFutureWatcher>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 
 #include <atomic>
 
@@ -19,7 +20,9 @@ class ArchiveExtractJob : public QObject {
    public:
     explicit ArchiveExtractJob(QObject* parent = nullptr);
 
-    void start(const QString& archivePath, const QString& destinationDir);
+    // |selectedEntries| lists archive-relative paths to extract (directories include their
+    // contents); an empty list extracts the whole archive.
+    void start(const QString& archivePath, const QString& destinationDir, const QStringList& selectedEntries = {});
     void cancel();
 
    Q_SIGNALS:
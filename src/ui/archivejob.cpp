@@ -46,7 +46,11 @@ void ArchiveJob::start(const QStringList& sourcePaths, const QString& destinatio
             return true;
         };
 
-        const bool ok = ArchiveWriter::create_tar_zst(nativeSources, nativeDest, opProgress, cb, err);
+        // Seekable output lets selective extraction and browsing jump to an entry's frame.
+        ArchiveWriter::Options opts;
+        opts.seekableFrameSize = 4 * 1024 * 1024;
+
+        const bool ok = ArchiveWriter::create_tar_zst(nativeSources, nativeDest, opProgress, cb, err, opts);
         Result result;
         result.success = ok;
         result.error = ok ? QString() : QString::fromLocal8Bit(err.message.c_str());
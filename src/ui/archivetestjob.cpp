@@ -0,0 +1,98 @@
+/*
+ * Qt wrapper for archive integrity testing
+ * src/ui/archivetestjob.cpp
+ */
+
+#include "archivetestjob.h"
+
+#include "../core/archive_extract.h"
+#include "../core/fs_ops.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+#include <string>
+
+namespace PCManFM {
+
+ArchiveTestJob::ArchiveTestJob(QObject* parent) : QObject(parent), cancelRequested_(false), bytesDone_(0) {}
+
+void ArchiveTestJob::start(const QStringList& archivePaths) {
+    cancelRequested_.store(false, std::memory_order_relaxed);
+    bytesDone_.store(0, std::memory_order_relaxed);
+    bytesTotal_ = 0;
+    for (const QString& path : archivePaths) {
+        bytesTotal_ += static_cast<quint64>(std::max<qint64>(QFileInfo(path).size(), 0));
+    }
+    // In a batch the archives themselves are the parallelism; extra filter threads would only
+    // oversubscribe the pool.
+    const bool batch = archivePaths.size() > 1;
+
+    auto future = QtConcurrent::mapped(archivePaths, [this, batch](const QString& archivePath) -> Result {
+        Result result;
+        result.archivePath = archivePath;
+
+        const QByteArray archiveBytes = QFile::encodeName(archivePath);
+        const std::string archiveNative(archiveBytes.constData(), static_cast<std::size_t>(archiveBytes.size()));
+
+        quint64 reported = 0;
+        auto cb = [this, &reported](const PCManFM::FsOps::ProgressInfo& info) {
+            if (cancelRequested_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            if (info.bytesDone > reported) {
+                bytesDone_.fetch_add(info.bytesDone - reported, std::memory_order_relaxed);
+                reported = info.bytesDone;
+            }
+            const quint64 done = bytesDone_.load(std::memory_order_relaxed);
+            const QString current = QString::fromLocal8Bit(info.currentPath.c_str());
+            QMetaObject::invokeMethod(
+                this, [this, done, current]() { Q_EMIT progress(done, bytesTotal_, current); },
+                Qt::QueuedConnection);
+            return true;
+        };
+
+        PCManFM::ArchiveExtract::Options opts;
+        opts.enableFilterThreads = !batch;
+        opts.maxFilterThreads = 0;
+
+        PCManFM::FsOps::ProgressInfo opProgress;
+        PCManFM::FsOps::Error err;
+        PCManFM::ArchiveExtract::TestReport report;
+        result.success = PCManFM::ArchiveExtract::test_archive(archiveNative, opProgress, cb, report, err, opts);
+        if (opProgress.bytesDone > reported) {
+            bytesDone_.fetch_add(opProgress.bytesDone - reported, std::memory_order_relaxed);
+        }
+
+        result.error = result.success ? QString() : QString::fromLocal8Bit(err.message.c_str());
+        result.entries = report.entries.size();
+        for (const auto& entry : report.entries) {
+            if (!entry.ok) {
+                result.failures.push_back(
+                    {QString::fromLocal8Bit(entry.path.c_str()), QString::fromLocal8Bit(entry.message.c_str())});
+            }
+        }
+        result.bytesRead = report.bytesRead;
+        result.bytesDecoded = report.bytesDecoded;
+        result.seconds = report.seconds;
+        return result;
+    });
+
+    connect(&watcher_, &QFutureWatcher<Result>::finished, this, &ArchiveTestJob::onFinished);
+    watcher_.setFuture(future);
+}
+
+void ArchiveTestJob::cancel() {
+    cancelRequested_.store(true, std::memory_order_relaxed);
+}
+
+void ArchiveTestJob::onFinished() {
+    const QList<Result> results = watcher_.future().results();
+    bool success = !results.isEmpty();
+    for (const Result& result : results) {
+        success = success && result.success;
+    }
+    Q_EMIT finished(success, results);
+}
+
+}  // namespace PCManFM
@@ -0,0 +1,61 @@
+/*
+ * Qt wrapper for archive integrity testing
+ * src/ui/archivetestjob.h
+ */
+
+#ifndef PCMANFM_ARCHIVETESTJOB_H
+#define PCMANFM_ARCHIVETESTJOB_H
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+namespace PCManFM {
+
+class ArchiveTestJob : public QObject {
+    Q_OBJECT
+   public:
+    struct EntryFailure {
+        QString path;
+        QString message;
+    };
+
+    struct Result {
+        QString archivePath;
+        bool success = false;
+        QString error;
+        quint64 entries = 0;
+        QList<EntryFailure> failures;
+        quint64 bytesRead = 0;
+        quint64 bytesDecoded = 0;
+        double seconds = 0.0;
+    };
+
+    explicit ArchiveTestJob(QObject* parent = nullptr);
+
+    // Decodes every archive in |archivePaths| without writing anything. Several archives are
+    // tested concurrently on the global thread pool; a single archive gets all filter threads.
+    void start(const QStringList& archivePaths);
+    void cancel();
+
+   Q_SIGNALS:
+    // Bytes are compressed input summed over all archives.
+    void progress(quint64 bytesDone, quint64 bytesTotal, const QString& currentPath);
+    void finished(bool success, const QList<PCManFM::ArchiveTestJob::Result>& results);
+
+   private:
+    void onFinished();
+
+    QFutureWatcher<Result> watcher_;
+    std::atomic<bool> cancelRequested_;
+    std::atomic<quint64> bytesDone_;
+    quint64 bytesTotal_ = 0;
+};
+
+}  // namespace PCManFM
+
+#endif  // PCMANFM_ARCHIVETESTJOB_H
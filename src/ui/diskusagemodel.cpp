@@ -0,0 +1,273 @@
+/*
+ * Tree model of the sizes found by a disk usage scan
+ * src/ui/diskusagemodel.cpp
+ */
+
+#include "diskusagemodel.h"
+
+#include <QFile>
+#include <QIcon>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace PCManFM {
+
+namespace {
+QString joinPath(const QString& dir, const QString& name) {
+    return dir.endsWith(QLatin1Char('/')) ? dir + name : dir + QLatin1Char('/') + name;
+}
+}  // namespace
+
+DiskUsageModel::DiskUsageModel(QObject* parent) : QAbstractItemModel(parent) {}
+
+DiskUsageModel::~DiskUsageModel() = default;
+
+void DiskUsageModel::reset(const std::string& rootPath) {
+    beginResetModel();
+    top_.children.clear();
+    top_.files.clear();
+    unread_.clear();
+    rootPath_ = rootPath;
+    auto root = std::make_unique<Node>();
+    root->parent = &top_;
+    root->name = QFile::decodeName(rootPath.c_str());
+    unread_.emplace(rootPath_, root.get());
+    top_.children.push_back(std::move(root));
+    endResetModel();
+}
+
+QModelIndex DiskUsageModel::rootIndex() const {
+    return top_.children.empty() ? QModelIndex() : indexOf(top_.children.front().get());
+}
+
+void DiskUsageModel::addDirs(std::vector<Panel::DiskUsageJob::Dir> dirs) {
+    std::unordered_set<Node*> changed;
+    for (auto& dir : dirs) {
+        auto it = unread_.find(dir.path);
+        if (it == unread_.end()) {
+            continue;  // from a scan of another folder
+        }
+        Node* node = it->second;
+        unread_.erase(it);
+        node->read = true;
+
+        std::vector<std::unique_ptr<Node>> children;
+        children.reserve(dir.subdirs.size());
+        const std::string prefix = dir.path.back() == '/' ? dir.path : dir.path + '/';
+        for (auto& name : dir.subdirs) {
+            auto child = std::make_unique<Node>();
+            child->parent = node;
+            child->name = QFile::decodeName(name.c_str());
+            child->row = static_cast<int>(children.size());
+            unread_.emplace(prefix + name, child.get());
+            children.push_back(std::move(child));
+        }
+
+        // whatever the largest files leave is shown as one row, the subdirectories themselves included
+        std::vector<File> files;
+        quint64 restSize = dir.size;
+        quint64 restOnDiskSize = dir.onDiskSize;
+        quint64 restItems = dir.fileCount;
+        restItems -= std::min<quint64>(restItems, dir.subdirs.size());
+        for (auto& file : dir.largestFiles) {
+            files.push_back(File{QFile::decodeName(file.name.c_str()), file.size, file.onDiskSize, 1});
+            restSize -= std::min<quint64>(restSize, file.size);
+            restOnDiskSize -= std::min<quint64>(restOnDiskSize, file.onDiskSize);
+            restItems -= std::min<quint64>(restItems, 1);
+        }
+        if (restItems > 0 || restOnDiskSize > 0) {
+            files.push_back(File{QString(), restSize, restOnDiskSize, restItems});
+        }
+
+        const int count = static_cast<int>(children.size() + files.size());
+        if (count > 0) {
+            beginInsertRows(indexOf(node), 0, count - 1);
+            node->children = std::move(children);
+            node->files = std::move(files);
+            endInsertRows();
+        }
+
+        for (Node* n = node; n != &top_; n = n->parent) {
+            n->size += dir.size;
+            n->onDiskSize += dir.onDiskSize;
+            n->items += dir.fileCount;
+            changed.insert(n);
+        }
+    }
+
+    // the shares of the siblings change with the total of their parent, so whole parents are updated
+    std::unordered_set<Node*> parents;
+    for (Node* node : changed) {
+        parents.insert(node->parent);
+    }
+    for (Node* parent : parents) {
+        const QModelIndex parentIndex = indexOf(parent);
+        const int rows = rowCount(parentIndex);
+        if (rows > 0) {
+            Q_EMIT dataChanged(index(0, OnDiskSize, parentIndex), index(rows - 1, ColumnCount - 1, parentIndex));
+        }
+    }
+}
+
+DiskUsageModel::Node* DiskUsageModel::nodeOf(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return const_cast<Node*>(&top_);
+    }
+    return reinterpret_cast<Node*>(index.internalId() & ~quintptr(1));
+}
+
+QModelIndex DiskUsageModel::indexOf(const Node* node, int column) const {
+    if (node == &top_) {
+        return QModelIndex();
+    }
+    return createIndex(node->row, column, const_cast<Node*>(node));
+}
+
+QString DiskUsageModel::pathOf(const Node* node) const {
+    if (node->parent == &top_) {
+        return node->name;
+    }
+    return joinPath(pathOf(node->parent), node->name);
+}
+
+QModelIndex DiskUsageModel::index(int row, int column, const QModelIndex& parent) const {
+    if (row < 0 || column < 0 || column >= ColumnCount || isFileIndex(parent)) {
+        return QModelIndex();
+    }
+    Node* node = nodeOf(parent);
+    const auto subdirs = node->children.size();
+    if (static_cast<std::size_t>(row) < subdirs) {
+        return createIndex(row, column, node->children[row].get());
+    }
+    if (static_cast<std::size_t>(row) < subdirs + node->files.size()) {
+        return createIndex(row, column, reinterpret_cast<quintptr>(node) | 1);
+    }
+    return QModelIndex();
+}
+
+QModelIndex DiskUsageModel::parent(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return QModelIndex();
+    }
+    Node* node = nodeOf(index);
+    return isFileIndex(index) ? indexOf(node) : indexOf(node->parent);
+}
+
+int DiskUsageModel::rowCount(const QModelIndex& parent) const {
+    if (parent.column() > 0 || isFileIndex(parent)) {
+        return 0;
+    }
+    const Node* node = nodeOf(parent);
+    return static_cast<int>(node->children.size() + node->files.size());
+}
+
+int DiskUsageModel::columnCount(const QModelIndex& /*parent*/) const {
+    return ColumnCount;
+}
+
+QVariant DiskUsageModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid()) {
+        return {};
+    }
+    const Node* node = nodeOf(index);
+    const bool isFile = isFileIndex(index);
+    const File* file = isFile ? &node->files[index.row() - node->children.size()] : nullptr;
+    const Node* parentNode = isFile ? node : node->parent;
+    const quint64 size = isFile ? file->size : node->size;
+    const quint64 onDiskSize = isFile ? file->onDiskSize : node->onDiskSize;
+    const quint64 items = isFile ? file->items : node->items;
+    const double share = parentNode != &top_ && parentNode->onDiskSize > 0
+                             ? 100.0 * onDiskSize / parentNode->onDiskSize
+                             : 100.0;
+
+    switch (role) {
+        case Qt::DisplayRole:
+            switch (index.column()) {
+                case Name:
+                    if (file && file->name.isEmpty()) {
+                        return tr("(%n other item(s))", nullptr, static_cast<int>(file->items));
+                    }
+                    return isFile ? file->name : node->name;
+                case OnDiskSize:
+                    return Panel::formatFileSize(onDiskSize);
+                case Share:
+                    return QStringLiteral("%1%").arg(share, 0, 'f', 1);
+                case Size:
+                    return Panel::formatFileSize(size);
+                case Items:
+                    return QString::number(items);
+                default:
+                    break;
+            }
+            break;
+        case Qt::DecorationRole:
+            if (index.column() == Name) {
+                if (!isFile) {
+                    return QIcon::fromTheme(QStringLiteral("folder"));
+                }
+                return QIcon::fromTheme(file->name.isEmpty() ? QStringLiteral("document-multiple")
+                                                             : QStringLiteral("text-x-generic"));
+            }
+            break;
+        case Qt::TextAlignmentRole:
+            if (index.column() != Name) {
+                return QVariant::fromValue(Qt::AlignRight | Qt::AlignVCenter);
+            }
+            break;
+        case Qt::ToolTipRole:
+            if (!isFile && !node->read && index.column() == Name) {
+                return tr("Not read yet or unreadable");
+            }
+            break;
+        case SortRole:
+            switch (index.column()) {
+                case Name:
+                    return isFile ? file->name : node->name;
+                case OnDiskSize:
+                case Share:
+                    return onDiskSize;
+                case Size:
+                    return size;
+                case Items:
+                    return items;
+                default:
+                    break;
+            }
+            break;
+        case OnDiskSizeRole:
+            return onDiskSize;
+        case IsDirRole:
+            return !isFile;
+        case PathRole:
+            if (!isFile) {
+                return pathOf(node);
+            }
+            return file->name.isEmpty() ? QString() : joinPath(pathOf(node), file->name);
+        default:
+            break;
+    }
+    return {};
+}
+
+QVariant DiskUsageModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return {};
+    }
+    switch (section) {
+        case Name:
+            return tr("Name");
+        case OnDiskSize:
+            return tr("Size on Disk");
+        case Share:
+            return tr("Share");
+        case Size:
+            return tr("Size");
+        case Items:
+            return tr("Items");
+        default:
+            return {};
+    }
+}
+
+}  // namespace PCManFM
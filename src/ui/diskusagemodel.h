@@ -0,0 +1,89 @@
+/*
+ * Tree model of the sizes found by a disk usage scan
+ * src/ui/diskusagemodel.h
+ */
+
+#ifndef PCMANFM_DISKUSAGEMODEL_H
+#define PCMANFM_DISKUSAGEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QString>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../panel/panel.h"
+
+namespace PCManFM {
+
+// The scanned folder is the only top-level row. The rows of a directory are its subdirectories,
+// then its largest files and the rest of its files together; they are inserted at once when the
+// directory is read and never move, while the totals of the directory and of its parents grow.
+class DiskUsageModel : public QAbstractItemModel {
+    Q_OBJECT
+
+   public:
+    enum Column { Name = 0, OnDiskSize, Share, Size, Items, ColumnCount };
+
+    enum Role {
+        SortRole = Qt::UserRole + 1,  // the raw value of the column
+        OnDiskSizeRole,               // quint64, for any column
+        IsDirRole,
+        PathRole,  // local path of a directory or a file, empty for the rest of the files
+    };
+
+    explicit DiskUsageModel(QObject* parent = nullptr);
+    ~DiskUsageModel() override;
+
+    // Starts over with |rootPath| as the only, empty, row.
+    void reset(const std::string& rootPath);
+
+    // Adds the directories read by the scan, each after its parent.
+    void addDirs(std::vector<Panel::DiskUsageJob::Dir> dirs);
+
+    QModelIndex rootIndex() const;
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& index) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+   private:
+    struct File {
+        QString name;  // empty for the rest of the files
+        quint64 size;
+        quint64 onDiskSize;
+        quint64 items;
+    };
+
+    struct Node {
+        Node* parent = nullptr;
+        QString name;
+        int row = 0;
+        bool read = false;
+        // of the whole subtree
+        quint64 size = 0;
+        quint64 onDiskSize = 0;
+        quint64 items = 0;
+        std::vector<std::unique_ptr<Node>> children;
+        std::vector<File> files;
+    };
+
+    // Files have no node: their index points to the node of their directory, tagged.
+    static bool isFileIndex(const QModelIndex& index) { return index.internalId() & 1; }
+    Node* nodeOf(const QModelIndex& index) const;
+    QModelIndex indexOf(const Node* node, int column = 0) const;
+    QString pathOf(const Node* node) const;
+
+    Node top_;  // the invisible root, which holds the scanned folder
+    std::string rootPath_;
+    std::unordered_map<std::string, Node*> unread_;  // by local path
+};
+
+}  // namespace PCManFM
+
+#endif  // PCMANFM_DISKUSAGEMODEL_H
@@ -0,0 +1,232 @@
+/*
+ * Disk usage of a folder as a treemap and a sorted tree
+ * src/ui/diskusagewindow.cpp
+ */
+
+#include "diskusagewindow.h"
+
+#include <QAction>
+#include <QHeaderView>
+#include <QSortFilterProxyModel>
+#include <QSplitter>
+#include <QStatusBar>
+#include <QToolBar>
+#include <QTreeView>
+
+#include "diskusagemodel.h"
+#include "treemapview.h"
+
+namespace PCManFM {
+
+namespace {
+// how often the directories read meanwhile are added to the model
+constexpr int kPollInterval = 200;  // ms
+}  // namespace
+
+DiskUsageWindow::DiskUsageWindow(QWidget* parent) : QMainWindow(parent) {
+    setupUi();
+}
+
+DiskUsageWindow::~DiskUsageWindow() {
+    stopJob();
+}
+
+void DiskUsageWindow::setupUi() {
+    setWindowTitle(tr("Disk Usage"));
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    model_ = new DiskUsageModel(this);
+    proxyModel_ = new QSortFilterProxyModel(this);
+    proxyModel_->setSourceModel(model_);
+    proxyModel_->setSortRole(DiskUsageModel::SortRole);
+    proxyModel_->setDynamicSortFilter(true);
+
+    auto* splitter = new QSplitter(Qt::Vertical, this);
+
+    treemap_ = new TreemapView(splitter);
+    treemap_->setModel(model_, DiskUsageModel::OnDiskSizeRole, DiskUsageModel::IsDirRole);
+    connect(treemap_, &TreemapView::clicked, this, &DiskUsageWindow::selectIndex);
+    connect(treemap_, &TreemapView::activated, this, [this](const QModelIndex& index) {
+        if (index.data(DiskUsageModel::IsDirRole).toBool()) {
+            setCurrentIndex(index);
+        }
+    });
+
+    tree_ = new QTreeView(splitter);
+    tree_->setModel(proxyModel_);
+    tree_->setUniformRowHeights(true);
+    tree_->setAlternatingRowColors(true);
+    tree_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    tree_->setExpandsOnDoubleClick(false);
+    tree_->setSortingEnabled(true);
+    tree_->sortByColumn(DiskUsageModel::OnDiskSize, Qt::DescendingOrder);
+    tree_->header()->setStretchLastSection(false);
+    tree_->header()->setSectionResizeMode(DiskUsageModel::Name, QHeaderView::Stretch);
+    connect(tree_, &QTreeView::doubleClicked, this, [this](const QModelIndex& proxyIndex) {
+        const QModelIndex index = proxyModel_->mapToSource(proxyIndex);
+        if (index.data(DiskUsageModel::IsDirRole).toBool()) {
+            setCurrentIndex(index);
+        }
+    });
+
+    splitter->setStretchFactor(0, 3);
+    splitter->setStretchFactor(1, 2);
+    setCentralWidget(splitter);
+
+    auto* toolbar = addToolBar(tr("Disk Usage"));
+    toolbar->setMovable(false);
+
+    upAction_ = toolbar->addAction(QIcon::fromTheme(QStringLiteral("go-up")), tr("Up"));
+    upAction_->setEnabled(false);
+    connect(upAction_, &QAction::triggered, this, [this] {
+        const QModelIndex parent = treemap_->rootIndex().parent();
+        if (parent.isValid()) {
+            setCurrentIndex(parent);
+        }
+    });
+
+    rescanAction_ = toolbar->addAction(QIcon::fromTheme(QStringLiteral("view-refresh")), tr("Rescan"));
+    connect(rescanAction_, &QAction::triggered, this, [this] {
+        if (path_) {
+            scan(path_);
+        }
+    });
+
+    stopAction_ = toolbar->addAction(QIcon::fromTheme(QStringLiteral("process-stop")), tr("Stop"));
+    stopAction_->setEnabled(false);
+    connect(stopAction_, &QAction::triggered, this, [this] {
+        if (job_) {
+            job_->cancel();  // what was read so far stays
+        }
+    });
+
+    pollTimer_.setInterval(kPollInterval);
+    connect(&pollTimer_, &QTimer::timeout, this, &DiskUsageWindow::onPollTimeout);
+}
+
+void DiskUsageWindow::scan(const Panel::FilePath& path) {
+    stopJob();
+    path_ = path;
+    jobError_.clear();
+    unreadableDirCount_ = 0;
+    stopped_ = false;
+
+    auto localPath = path.localPath();
+    if (!localPath) {
+        model_->reset(std::string());
+        statusBar()->showMessage(tr("Disk usage is only available for local folders."));
+        return;
+    }
+    model_->reset(localPath.get());
+    setCurrentIndex(model_->rootIndex());
+
+    auto* job = new Panel::DiskUsageJob(path);
+    // a job stopped for a rescan may still finish while the next one runs
+    connect(
+        job, &Panel::Job::finished, this,
+        [this, job] {
+            if (job == job_) {
+                onJobFinished();
+            }
+        },
+        Qt::BlockingQueuedConnection);
+    connect(
+        job, &Panel::Job::error, this,
+        [this, job](const Panel::GErrorPtr& err, Panel::Job::ErrorSeverity severity,
+                    Panel::Job::ErrorAction& response) {
+            if (job == job_) {
+                onJobError(err, severity, response);
+            }
+        },
+        Qt::BlockingQueuedConnection);
+    job->setAutoDelete(true);
+    job_ = job;
+    stopAction_->setEnabled(true);
+    elapsed_.start();
+    pollTimer_.start();
+    updateStatus();
+    // the window stays responsive while a whole volume is read
+    job->runAsync(QThread::LowPriority);
+}
+
+void DiskUsageWindow::stopJob() {
+    pollTimer_.stop();
+    if (job_) {
+        disconnect(job_, nullptr, this, nullptr);
+        job_->cancel();
+        job_ = nullptr;
+    }
+    if (stopAction_) {
+        stopAction_->setEnabled(false);
+    }
+}
+
+void DiskUsageWindow::setCurrentIndex(const QModelIndex& sourceIndex) {
+    treemap_->setRootIndex(sourceIndex);
+    tree_->setRootIndex(proxyModel_->mapFromSource(sourceIndex));
+    upAction_->setEnabled(sourceIndex.parent().isValid());
+    const QString path = sourceIndex.data(DiskUsageModel::PathRole).toString();
+    setWindowTitle(path.isEmpty() ? tr("Disk Usage") : tr("Disk Usage - %1").arg(path));
+}
+
+void DiskUsageWindow::selectIndex(const QModelIndex& sourceIndex) {
+    const QModelIndex proxyIndex = proxyModel_->mapFromSource(sourceIndex);
+    if (proxyIndex.isValid()) {
+        tree_->setCurrentIndex(proxyIndex);
+        tree_->scrollTo(proxyIndex);  // expands the folders above it
+    }
+}
+
+void DiskUsageWindow::onPollTimeout() {
+    if (!job_) {
+        return;
+    }
+    auto dirs = job_->takeDirs();
+    if (!dirs.empty()) {
+        model_->addDirs(std::move(dirs));
+    }
+    updateStatus();
+}
+
+void DiskUsageWindow::onJobFinished() {
+    // called while the job waits, so nothing is added meanwhile
+    pollTimer_.stop();
+    model_->addDirs(job_->takeDirs());
+    unreadableDirCount_ = job_->unreadableDirCount();
+    stopped_ = job_->isCancelled();
+    job_ = nullptr;
+    stopAction_->setEnabled(false);
+    updateStatus();
+}
+
+void DiskUsageWindow::onJobError(const Panel::GErrorPtr& err, Panel::Job::ErrorSeverity /*severity*/,
+                                 Panel::Job::ErrorAction& /*response*/) {
+    // only the scanned folder itself fails the job; unreadable folders below it are counted
+    jobError_ = err.message();
+}
+
+void DiskUsageWindow::updateStatus() {
+    if (!jobError_.isEmpty()) {
+        statusBar()->showMessage(jobError_);
+        return;
+    }
+    const QModelIndex root = model_->rootIndex();
+    const QString items = root.siblingAtColumn(DiskUsageModel::Items).data().toString();
+    const QString size = root.siblingAtColumn(DiskUsageModel::OnDiskSize).data().toString();
+    if (job_) {
+        statusBar()->showMessage(tr("Scanning... %1 items, %2").arg(items, size));
+        return;
+    }
+    QString message = tr("%1 items, %2 on disk, read in %3 s")
+                          .arg(items, size, QString::number(elapsed_.elapsed() / 1000.0, 'f', 1));
+    if (unreadableDirCount_ > 0) {
+        message += QLatin1String("; ") +
+                   tr("%n folder(s) could not be read", nullptr, static_cast<int>(unreadableDirCount_));
+    }
+    if (stopped_) {
+        message += QLatin1String("; ") + tr("stopped");
+    }
+    statusBar()->showMessage(message);
+}
+
+}  // namespace PCManFM
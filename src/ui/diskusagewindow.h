@@ -0,0 +1,65 @@
+/*
+ * Disk usage of a folder as a treemap and a sorted tree
+ * src/ui/diskusagewindow.h
+ */
+
+#ifndef PCMANFM_DISKUSAGEWINDOW_H
+#define PCMANFM_DISKUSAGEWINDOW_H
+
+#include <QElapsedTimer>
+#include <QMainWindow>
+#include <QModelIndex>
+#include <QTimer>
+
+#include "../panel/panel.h"
+
+class QAction;
+class QSortFilterProxyModel;
+class QTreeView;
+
+namespace PCManFM {
+
+class DiskUsageModel;
+class TreemapView;
+
+class DiskUsageWindow : public QMainWindow {
+    Q_OBJECT
+
+   public:
+    explicit DiskUsageWindow(QWidget* parent = nullptr);
+    ~DiskUsageWindow() override;
+
+    // Scans the local folder |path| from scratch; folders that did not change since an earlier
+    // scan are not read again.
+    void scan(const Panel::FilePath& path);
+
+   private:
+    void setupUi();
+    void stopJob();
+    void setCurrentIndex(const QModelIndex& sourceIndex);  // the folder shown
+    void selectIndex(const QModelIndex& sourceIndex);
+    void onPollTimeout();
+    void onJobFinished();
+    void onJobError(const Panel::GErrorPtr& err, Panel::Job::ErrorSeverity severity,
+                    Panel::Job::ErrorAction& response);
+    void updateStatus();
+
+    Panel::FilePath path_;
+    Panel::DiskUsageJob* job_ = nullptr;
+    QString jobError_;
+    unsigned int unreadableDirCount_ = 0;
+    bool stopped_ = false;
+    DiskUsageModel* model_ = nullptr;
+    QSortFilterProxyModel* proxyModel_ = nullptr;
+    TreemapView* treemap_ = nullptr;
+    QTreeView* tree_ = nullptr;
+    QAction* upAction_ = nullptr;
+    QAction* rescanAction_ = nullptr;
+    QAction* stopAction_ = nullptr;
+    QTimer pollTimer_;
+    QElapsedTimer elapsed_;
+};
+
+}  // namespace PCManFM
+
+#endif  // PCMANFM_DISKUSAGEWINDOW_H
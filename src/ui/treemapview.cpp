@@ -0,0 +1,274 @@
+/*
+ * Squarified treemap of a tree model with sizes
+ * src/ui/treemapview.cpp
+ */
+
+#include "treemapview.h"
+
+#include <QAbstractItemModel>
+#include <QHelpEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace PCManFM {
+
+namespace {
+constexpr int kMaxDepth = 3;
+// tiles smaller than this, in px², are left to the color of their parent
+constexpr double kMinArea = 4.0;
+constexpr int kLayoutDelay = 300;  // ms
+
+// The worst aspect ratio of a row of the areas |first| >= ... >= |last| adding up to |sum|
+// along a side of |side|.
+double worstRatio(double first, double last, double sum, double side) {
+    const double side2 = side * side;
+    const double sum2 = sum * sum;
+    return std::max(side2 * first / sum2, sum2 / (side2 * last));
+}
+
+// Splits |rect| into rectangles with the |areas|, sorted from the largest, and as square as
+// possible (Bruls, Huizing and van Wijk, "Squarified Treemaps").
+std::vector<QRectF> squarify(const std::vector<double>& areas, QRectF rect) {
+    std::vector<QRectF> rects;
+    rects.reserve(areas.size());
+    std::size_t i = 0;
+    while (i < areas.size()) {
+        const bool vertical = rect.width() >= rect.height();  // the row goes down the left side
+        const double side = vertical ? rect.height() : rect.width();
+        if (side <= 0) {
+            break;
+        }
+        double sum = 0;
+        double worst = std::numeric_limits<double>::max();
+        std::size_t j = i;
+        for (; j < areas.size(); ++j) {
+            const double ratio = worstRatio(areas[i], areas[j], sum + areas[j], side);
+            if (j > i && ratio > worst) {
+                break;
+            }
+            worst = ratio;
+            sum += areas[j];
+        }
+        const double thickness = sum / side;
+        double offset = 0;
+        for (; i < j; ++i) {
+            const double length = areas[i] / thickness;
+            if (vertical) {
+                rects.emplace_back(rect.left(), rect.top() + offset, thickness, length);
+            }
+            else {
+                rects.emplace_back(rect.left() + offset, rect.top(), length, thickness);
+            }
+            offset += length;
+        }
+        if (vertical) {
+            rect.setLeft(rect.left() + thickness);
+        }
+        else {
+            rect.setTop(rect.top() + thickness);
+        }
+    }
+    return rects;
+}
+}  // namespace
+
+TreemapView::TreemapView(QWidget* parent) : QWidget(parent) {
+    setMinimumSize(120, 80);
+    setBackgroundRole(QPalette::Base);
+    setAutoFillBackground(true);
+    layoutTimer_.setSingleShot(true);
+    layoutTimer_.setInterval(kLayoutDelay);
+    connect(&layoutTimer_, &QTimer::timeout, this, &TreemapView::doLayout);
+}
+
+TreemapView::~TreemapView() = default;
+
+void TreemapView::setModel(QAbstractItemModel* model, int sizeRole, int isDirRole) {
+    if (model_) {
+        disconnect(model_, nullptr, this, nullptr);
+    }
+    model_ = model;
+    sizeRole_ = sizeRole;
+    isDirRole_ = isDirRole;
+    rootIndex_ = QPersistentModelIndex();
+    if (model_) {
+        connect(model_, &QAbstractItemModel::rowsInserted, this, &TreemapView::scheduleLayout);
+        connect(model_, &QAbstractItemModel::dataChanged, this, &TreemapView::scheduleLayout);
+        connect(model_, &QAbstractItemModel::rowsAboutToBeRemoved, this, &TreemapView::clearTiles);
+        connect(model_, &QAbstractItemModel::rowsAboutToBeMoved, this, &TreemapView::clearTiles);
+        connect(model_, &QAbstractItemModel::layoutAboutToBeChanged, this, &TreemapView::clearTiles);
+        connect(model_, &QAbstractItemModel::modelAboutToBeReset, this, &TreemapView::clearTiles);
+    }
+    doLayout();
+}
+
+void TreemapView::setRootIndex(const QModelIndex& index) {
+    rootIndex_ = index;
+    doLayout();
+}
+
+void TreemapView::scheduleLayout() {
+    if (!layoutTimer_.isActive()) {
+        layoutTimer_.start();
+    }
+}
+
+void TreemapView::clearTiles() {
+    tiles_.clear();
+    update();
+    scheduleLayout();
+}
+
+void TreemapView::doLayout() {
+    layoutTimer_.stop();
+    tiles_.clear();
+    if (model_ && rootIndex_.isValid()) {
+        layoutChildren(rootIndex_, QRectF(rect()).adjusted(1, 1, -1, -1), 0, -1);
+    }
+    update();
+}
+
+void TreemapView::layoutChildren(const QModelIndex& parent, const QRectF& rect, int depth, int hue) {
+    const int rows = model_->rowCount(parent);
+    std::vector<std::pair<double, int>> sizes;  // and rows
+    sizes.reserve(rows);
+    double total = 0;
+    for (int row = 0; row < rows; ++row) {
+        const double size = model_->index(row, 0, parent).data(sizeRole_).toDouble();
+        if (size > 0) {
+            sizes.emplace_back(size, row);
+            total += size;
+        }
+    }
+    if (total <= 0 || rect.width() < 1 || rect.height() < 1) {
+        return;
+    }
+    std::sort(sizes.begin(), sizes.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    // the smallest ones are laid out as a single rectangle that is not drawn
+    const double scale = rect.width() * rect.height() / total;
+    std::vector<double> areas;
+    areas.reserve(sizes.size() + 1);
+    double rest = 0;
+    for (const auto& size : sizes) {
+        const double area = size.first * scale;
+        if (area < kMinArea) {
+            rest += area;
+        }
+        else {
+            areas.push_back(area);
+        }
+    }
+    const std::size_t shown = areas.size();
+    if (rest > 0) {
+        areas.push_back(rest);
+    }
+    const std::vector<QRectF> rects = squarify(areas, rect);
+
+    const int fontHeight = fontMetrics().height();
+    for (std::size_t i = 0; i < shown && i < rects.size(); ++i) {
+        const QModelIndex index = model_->index(sizes[i].second, 0, parent);
+        const int tileHue = hue < 0 ? static_cast<int>(i * 137) % 360 : hue;  // golden angle apart
+        const bool isDir = index.data(isDirRole_).toBool();
+        const QRectF& tileRect = rects[i];
+        const QColor color = isDir ? QColor::fromHsv(tileHue, 110, std::max(250 - depth * 30, 120))
+                                   : QColor::fromHsv(tileHue, 60, std::max(255 - depth * 25, 150));
+        const bool labeled = isDir && tileRect.height() > fontHeight * 2 + 4 && tileRect.width() > fontHeight * 3;
+        tiles_.push_back(Tile{tileRect, index, color, isDir, labeled});
+        if (isDir && depth + 1 < kMaxDepth) {
+            const QRectF inner = labeled ? tileRect.adjusted(2, fontHeight + 2, -2, -2)
+                                         : tileRect.adjusted(1, 1, -1, -1);
+            layoutChildren(index, inner, depth + 1, tileHue);
+        }
+    }
+}
+
+QModelIndex TreemapView::indexAt(const QPoint& pos) const {
+    // the innermost tile, which comes last
+    for (auto it = tiles_.rbegin(); it != tiles_.rend(); ++it) {
+        if (it->rect.contains(pos) && it->index.isValid()) {
+            return it->index;
+        }
+    }
+    return QModelIndex();
+}
+
+bool TreemapView::event(QEvent* event) {
+    if (event->type() == QEvent::ToolTip) {
+        auto helpEvent = static_cast<QHelpEvent*>(event);
+        const QModelIndex index = indexAt(helpEvent->pos());
+        if (index.isValid()) {
+            // the columns after the name hold the size on disk and the share of it
+            const QString text = QStringLiteral("%1\n%2 (%3)")
+                                     .arg(index.data().toString(), index.siblingAtColumn(1).data().toString(),
+                                          index.siblingAtColumn(2).data().toString());
+            QToolTip::showText(helpEvent->globalPos(), text, this);
+        }
+        else {
+            QToolTip::hideText();
+            event->ignore();
+        }
+        return true;
+    }
+    return QWidget::event(event);
+}
+
+void TreemapView::paintEvent(QPaintEvent* /*event*/) {
+    QPainter painter(this);
+    const QColor border = palette().color(QPalette::Mid);
+    const QColor text = QColor(Qt::black);
+    const int fontHeight = fontMetrics().height();
+    for (const auto& tile : tiles_) {
+        if (!tile.index.isValid()) {
+            continue;
+        }
+        painter.setPen(tile.rect.width() > 3 && tile.rect.height() > 3 ? border : Qt::NoPen);
+        painter.setBrush(tile.color);
+        painter.drawRect(tile.rect);
+        QRectF textRect;
+        if (tile.labeled) {
+            textRect = QRectF(tile.rect.left() + 3, tile.rect.top() + 1, tile.rect.width() - 6, fontHeight);
+        }
+        else if (!tile.isDir && tile.rect.height() > fontHeight && tile.rect.width() > fontHeight * 2) {
+            textRect = tile.rect.adjusted(3, 1, -3, -1);
+        }
+        if (!textRect.isEmpty()) {
+            const QString name = fontMetrics().elidedText(tile.index.data().toString(), Qt::ElideMiddle,
+                                                          static_cast<int>(textRect.width()));
+            painter.setPen(text);
+            painter.drawText(textRect, Qt::AlignLeft | Qt::AlignTop, name);
+        }
+    }
+}
+
+void TreemapView::resizeEvent(QResizeEvent* event) {
+    QWidget::resizeEvent(event);
+    doLayout();
+}
+
+void TreemapView::mousePressEvent(QMouseEvent* event) {
+    if (event->button() == Qt::LeftButton) {
+        const QModelIndex index = indexAt(event->position().toPoint());
+        if (index.isValid()) {
+            Q_EMIT clicked(index);
+        }
+    }
+    QWidget::mousePressEvent(event);
+}
+
+void TreemapView::mouseDoubleClickEvent(QMouseEvent* event) {
+    if (event->button() == Qt::LeftButton) {
+        const QModelIndex index = indexAt(event->position().toPoint());
+        if (index.isValid()) {
+            Q_EMIT activated(index);
+        }
+    }
+    QWidget::mouseDoubleClickEvent(event);
+}
+
+}  // namespace PCManFM
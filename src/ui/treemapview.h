@@ -0,0 +1,76 @@
+/*
+ * Squarified treemap of a tree model with sizes
+ * src/ui/treemapview.h
+ */
+
+#ifndef PCMANFM_TREEMAPVIEW_H
+#define PCMANFM_TREEMAPVIEW_H
+
+#include <QColor>
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include <QRectF>
+#include <QTimer>
+#include <QWidget>
+
+#include <vector>
+
+class QAbstractItemModel;
+
+namespace PCManFM {
+
+// Draws the rows below the root index as nested rectangles with areas in proportion to their
+// sizes, a few levels deep. It reads the sizes from |sizeRole| and tells directories by |isDirRole|;
+// the layout follows changes of the model after a short delay, so that a running scan does not
+// make it redo the layout for every directory read.
+class TreemapView : public QWidget {
+    Q_OBJECT
+
+   public:
+    explicit TreemapView(QWidget* parent = nullptr);
+    ~TreemapView() override;
+
+    void setModel(QAbstractItemModel* model, int sizeRole, int isDirRole);
+
+    void setRootIndex(const QModelIndex& index);
+
+    QModelIndex rootIndex() const { return rootIndex_; }
+
+    QModelIndex indexAt(const QPoint& pos) const;
+
+   Q_SIGNALS:
+    void clicked(const QModelIndex& index);
+    void activated(const QModelIndex& index);
+
+   protected:
+    bool event(QEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+
+   private:
+    struct Tile {
+        QRectF rect;
+        QModelIndex index;  // the tiles are dropped before rows can move
+        QColor color;
+        bool isDir;
+        bool labeled;  // a directory with its name above its contents
+    };
+
+    void scheduleLayout();
+    void clearTiles();
+    void doLayout();
+    void layoutChildren(const QModelIndex& parent, const QRectF& rect, int depth, int hue);
+
+    QPointer<QAbstractItemModel> model_;
+    int sizeRole_ = Qt::UserRole;
+    int isDirRole_ = Qt::UserRole;
+    QPersistentModelIndex rootIndex_;
+    std::vector<Tile> tiles_;  // parents before their children
+    QTimer layoutTimer_;
+};
+
+}  // namespace PCManFM
+
+#endif  // PCMANFM_TREEMAPVIEW_H
@@ -5,6 +5,7 @@
 
 #include <QTest>
 #include <QTemporaryDir>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 
@@ -12,11 +13,20 @@
 #include <archive_entry.h>
 
 #include "../src/core/archive_extract.h"
+#include "../src/core/archive_transcode.h"
+#include "../src/core/archive_writer.h"
 #include "../src/core/fs_ops.h"
+#include "../src/core/seekable_zstd.h"
 
 #include <vector>
 #include <string>
+#include <utility>
 #include <cerrno>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using PCManFM::ArchiveExtract::Options;
 using PCManFM::FsOps::Error;
@@ -157,6 +167,93 @@ bool write_archive_with_symlink(const QString& path,
     return true;
 }
 
+bool write_archive_entries(const QString& path,
+                           const std::vector<std::pair<QString, QByteArray>>& entries,
+                           const QString& format,
+                           QString* errorOut) {
+    struct archive* ar = archive_write_new();
+    if (!ar) {
+        *errorOut = QStringLiteral("archive_write_new failed");
+        return false;
+    }
+    archive_write_add_filter_none(ar);
+    if (archive_write_set_format_by_name(ar, format.toUtf8().constData()) != ARCHIVE_OK ||
+        archive_write_open_filename(ar, path.toUtf8().constData()) != ARCHIVE_OK) {
+        *errorOut = QStringLiteral("open failed: %1").arg(QString::fromUtf8(archive_error_string(ar)));
+        archive_write_free(ar);
+        return false;
+    }
+
+    for (const auto& [entryPath, data] : entries) {
+        archive_entry* entry = archive_entry_new();
+        archive_entry_set_pathname(entry, entryPath.toUtf8().constData());
+        archive_entry_set_size(entry, data.size());
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+        if (archive_write_header(ar, entry) != ARCHIVE_OK ||
+            archive_write_data(ar, data.constData(), static_cast<size_t>(data.size())) < 0) {
+            *errorOut = QStringLiteral("write entry failed: %1").arg(QString::fromUtf8(archive_error_string(ar)));
+            archive_entry_free(entry);
+            archive_write_free(ar);
+            return false;
+        }
+        archive_entry_free(entry);
+    }
+
+    archive_write_close(ar);
+    archive_write_free(ar);
+    return true;
+}
+
+// A regular file followed by two hardlinks onto it.
+bool write_archive_with_hardlinks(const QString& path,
+                                  const QString& target,
+                                  const QByteArray& data,
+                                  const QStringList& links,
+                                  QString* errorOut) {
+    struct archive* ar = archive_write_new();
+    if (!ar) {
+        *errorOut = QStringLiteral("archive_write_new failed");
+        return false;
+    }
+    archive_write_add_filter_none(ar);
+    if (archive_write_set_format_by_name(ar, "gnutar") != ARCHIVE_OK ||
+        archive_write_open_filename(ar, path.toUtf8().constData()) != ARCHIVE_OK) {
+        *errorOut = QStringLiteral("open failed: %1").arg(QString::fromUtf8(archive_error_string(ar)));
+        archive_write_free(ar);
+        return false;
+    }
+
+    archive_entry* entry = archive_entry_new();
+    archive_entry_set_pathname(entry, target.toUtf8().constData());
+    archive_entry_set_size(entry, data.size());
+    archive_entry_set_filetype(entry, AE_IFREG);
+    archive_entry_set_perm(entry, 0644);
+    bool ok = archive_write_header(ar, entry) == ARCHIVE_OK &&
+              archive_write_data(ar, data.constData(), static_cast<size_t>(data.size())) >= 0;
+    archive_entry_free(entry);
+    for (const QString& link : links) {
+        if (!ok) {
+            break;
+        }
+        entry = archive_entry_new();
+        archive_entry_set_pathname(entry, link.toUtf8().constData());
+        archive_entry_set_hardlink(entry, target.toUtf8().constData());
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+        archive_entry_set_size(entry, 0);
+        ok = archive_write_header(ar, entry) == ARCHIVE_OK;
+        archive_entry_free(entry);
+    }
+    if (!ok) {
+        *errorOut = QStringLiteral("write entry failed: %1").arg(QString::fromUtf8(archive_error_string(ar)));
+    }
+
+    archive_write_close(ar);
+    archive_write_free(ar);
+    return ok;
+}
+
 QString readFile(const QString& path) {
     QFile f(path);
     if (!f.open(QIODevice::ReadOnly)) {
@@ -176,6 +273,17 @@ class ArchiveExtractTest : public QObject {
     void extractPreservesSymlinkInTar();
     void cancelStopsAndCleansUp();
     void rejectsUnsafePaths();
+    void extractSelectedPathsStopsEarly();
+    void extractSelectedByGlobAndPredicate();
+    void extractSelectedHardlinkWithoutTarget_data();
+    void extractSelectedHardlinkWithoutTarget();
+    void extractSelectedFailsOnTruncatedArchive_data();
+    void extractSelectedFailsOnTruncatedArchive();
+    void seekableTarZstRoundTrip();
+    void transcodeGzipToZstd();
+    void createWithBoundedReadAhead();
+    void pipelinedExtractKeepsPerPathOrder();
+    void testArchiveDetectsCorruption();
 };
 
 void ArchiveExtractTest::extractKnownFormats_data() {
@@ -331,5 +439,406 @@ void ArchiveExtractTest::rejectsUnsafePaths() {
     QVERIFY(!QFileInfo::exists(destDir));
 }
 
+void ArchiveExtractTest::extractSelectedPathsStopsEarly() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // The trailing unsafe entry makes a full extraction fail; a path-list extraction must stop
+    // reading once the requested file is out and never reach it.
+    const QString archivePath = dir.path() + QLatin1String("/selective.tar");
+    QString error;
+    QVERIFY2(write_archive_entries(archivePath,
+                                   {{QStringLiteral("docs/wanted.txt"), QByteArray("wanted")},
+                                    {QStringLiteral("docs/other.txt"), QByteArray("other")},
+                                    {QStringLiteral("../evil.txt"), QByteArray("bad")}},
+                                   QStringLiteral("gnutar"), &error),
+             qPrintable(error));
+
+    const QString destDir = dir.path() + QLatin1String("/out-selective");
+    ProgressInfo progress;
+    Error err;
+    Options opts;
+    opts.filter.paths = {"./docs//wanted.txt"};
+
+    const bool ok = PCManFM::ArchiveExtract::extract_archive(archivePath.toLocal8Bit().toStdString(),
+                                                             destDir.toLocal8Bit().toStdString(), progress,
+                                                             ProgressCallback(), err, opts);
+    QVERIFY2(ok, err.message.c_str());
+    QCOMPARE(readFile(destDir + QLatin1String("/docs/wanted.txt")), QStringLiteral("wanted"));
+    QVERIFY(!QFileInfo::exists(destDir + QLatin1String("/docs/other.txt")));
+    QCOMPARE(progress.filesDone, std::uint64_t(1));
+    QCOMPARE(progress.filesTotal, std::uint64_t(1));
+    QCOMPARE(progress.bytesTotal, std::uint64_t(6));
+}
+
+void ArchiveExtractTest::extractSelectedByGlobAndPredicate() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QString archivePath = dir.path() + QLatin1String("/selective.zip");
+    QString error;
+    QVERIFY2(write_archive_entries(archivePath,
+                                   {{QStringLiteral("logs/a.log"), QByteArray("a")},
+                                    {QStringLiteral("b.log"), QByteArray("b")},
+                                    {QStringLiteral("src/main.c"), QByteArray("c")},
+                                    {QStringLiteral("README"), QByteArray("r")}},
+                                   QStringLiteral("zip"), &error),
+             qPrintable(error));
+
+    const QString destDir = dir.path() + QLatin1String("/out-glob");
+    ProgressInfo progress;
+    Error err;
+    Options opts;
+    opts.filter.globs = {"*.log"};
+    opts.filter.predicate = [](const std::string& path) { return path == "README"; };
+
+    const bool ok = PCManFM::ArchiveExtract::extract_archive(archivePath.toLocal8Bit().toStdString(),
+                                                             destDir.toLocal8Bit().toStdString(), progress,
+                                                             ProgressCallback(), err, opts);
+    QVERIFY2(ok, err.message.c_str());
+    QVERIFY(QFileInfo::exists(destDir + QLatin1String("/logs/a.log")));
+    QVERIFY(QFileInfo::exists(destDir + QLatin1String("/b.log")));
+    QVERIFY(QFileInfo::exists(destDir + QLatin1String("/README")));
+    QVERIFY(!QFileInfo::exists(destDir + QLatin1String("/src")));
+    QCOMPARE(progress.filesDone, std::uint64_t(3));
+}
+
+void ArchiveExtractTest::extractSelectedHardlinkWithoutTarget_data() {
+    QTest::addColumn<unsigned>("writerThreads");
+
+    QTest::newRow("inline") << 1u;
+    QTest::newRow("pipelined") << 3u;
+}
+
+void ArchiveExtractTest::extractSelectedHardlinkWithoutTarget() {
+    QFETCH(unsigned, writerThreads);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QString archivePath = dir.path() + QLatin1String("/links.tar");
+    QString error;
+    QVERIFY2(write_archive_with_hardlinks(archivePath, QStringLiteral("data/orig.bin"), QByteArray("payload"),
+                                          {QStringLiteral("links/one"), QStringLiteral("links/two")}, &error),
+             qPrintable(error));
+
+    // the links are selected, the file holding their data is not
+    const QString destDir = dir.path() + QLatin1String("/out-links");
+    ProgressInfo progress;
+    Error err;
+    Options opts;
+    opts.writerThreads = writerThreads;
+    opts.filter.paths = {"links"};
+
+    const bool ok = PCManFM::ArchiveExtract::extract_archive(archivePath.toLocal8Bit().toStdString(),
+                                                             destDir.toLocal8Bit().toStdString(), progress,
+                                                             ProgressCallback(), err, opts);
+    QVERIFY2(ok, err.message.c_str());
+    QVERIFY(!QFileInfo::exists(destDir + QLatin1String("/data")));
+    QCOMPARE(readFile(destDir + QLatin1String("/links/one")), QStringLiteral("payload"));
+    QCOMPARE(readFile(destDir + QLatin1String("/links/two")), QStringLiteral("payload"));
+
+    struct stat one{};
+    struct stat two{};
+    QCOMPARE(::stat(QFile::encodeName(destDir + QLatin1String("/links/one")).constData(), &one), 0);
+    QCOMPARE(::stat(QFile::encodeName(destDir + QLatin1String("/links/two")).constData(), &two), 0);
+    QCOMPARE(one.st_ino, two.st_ino);
+    QCOMPARE(progress.filesDone, std::uint64_t(2));
+}
+
+void ArchiveExtractTest::extractSelectedFailsOnTruncatedArchive_data() {
+    QTest::addColumn<unsigned>("writers");
+
+    QTest::newRow("inline") << 1u;
+    QTest::newRow("writer pool") << 4u;
+}
+
+void ArchiveExtractTest::extractSelectedFailsOnTruncatedArchive() {
+    QFETCH(unsigned, writers);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // A selective extraction skips the pre-scan, so the broken header must be caught while extracting
+    const QString archivePath = dir.path() + QLatin1String("/truncated.tar");
+    QString error;
+    QVERIFY2(write_archive_entries(archivePath,
+                                   {{QStringLiteral("a.txt"), QByteArray("a")},
+                                    {QStringLiteral("b.txt"), QByteArray("b")},
+                                    {QStringLiteral("c.txt"), QByteArray("c")}},
+                                   QStringLiteral("gnutar"), &error),
+             qPrintable(error));
+    // the header and the data block of a.txt, then half of the header of b.txt
+    QVERIFY(QFile::resize(archivePath, 512 + 512 + 256));
+
+    const QString destDir = dir.path() + QLatin1String("/out-truncated");
+    ProgressInfo progress;
+    Error err;
+    Options opts;
+    opts.filter.globs = {"*.txt"};
+    opts.writerThreads = writers;
+
+    QVERIFY(!PCManFM::ArchiveExtract::extract_archive(archivePath.toLocal8Bit().toStdString(),
+                                                      destDir.toLocal8Bit().toStdString(), progress,
+                                                      ProgressCallback(), err, opts));
+    QVERIFY(!err.message.empty());
+    QVERIFY(!QFileInfo::exists(destDir));
+}
+
+void ArchiveExtractTest::seekableTarZstRoundTrip() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QString srcDir = dir.path() + QLatin1String("/src");
+    QVERIFY(QDir().mkpath(srcDir + QLatin1String("/sub")));
+    QByteArray big;
+    for (int i = 0; i < 300000; ++i) {
+        big.append(static_cast<char>((i * 7919) & 0xff));
+    }
+    QFile bigFile(srcDir + QLatin1String("/big.bin"));
+    QVERIFY(bigFile.open(QIODevice::WriteOnly));
+    bigFile.write(big);
+    bigFile.close();
+    QFile smallFile(srcDir + QLatin1String("/sub/small.txt"));
+    QVERIFY(smallFile.open(QIODevice::WriteOnly));
+    smallFile.write("small");
+    smallFile.close();
+
+    const std::string archivePath = (dir.path() + QLatin1String("/out.tar.zst")).toLocal8Bit().toStdString();
+    PCManFM::ArchiveWriter::Options writeOpts;
+    writeOpts.seekableFrameSize = 64 * 1024;
+    ProgressInfo progress;
+    Error err;
+    QVERIFY2(PCManFM::ArchiveWriter::create_tar_zst({srcDir.toLocal8Bit().toStdString()}, archivePath, progress,
+                                                    ProgressCallback(), err, writeOpts),
+             err.message.c_str());
+
+    // Several independent frames plus an index naming every written entry
+    const int fd = ::open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+    QVERIFY(fd >= 0);
+    PCManFM::SeekableZstd::SeekTable table;
+    const bool haveTable = PCManFM::SeekableZstd::read_seek_table(fd, table, err);
+    ::close(fd);
+    QVERIFY2(haveTable, err.message.c_str());
+    QVERIFY(table.frames.size() > 2);
+    QCOMPARE(table.entries.size(), std::size_t(4));
+    for (const auto& entry : table.entries) {
+        QCOMPARE(entry.offset % 512, std::uint64_t(0));
+    }
+
+    // The regular libarchive path still reads it as a plain tar.zst
+    const QString fullDest = dir.path() + QLatin1String("/full");
+    QVERIFY2(PCManFM::ArchiveExtract::extract_archive(archivePath, fullDest.toLocal8Bit().toStdString(), progress,
+                                                      ProgressCallback(), err, Options()),
+             err.message.c_str());
+    QFile extractedBig(fullDest + QLatin1String("/src/big.bin"));
+    QVERIFY(extractedBig.open(QIODevice::ReadOnly));
+    QCOMPARE(extractedBig.readAll(), big);
+
+    // Path selections are served from the index
+    const QString selDest = dir.path() + QLatin1String("/selected");
+    Options selOpts;
+    selOpts.filter.paths = {"src/sub"};
+    QVERIFY2(PCManFM::ArchiveExtract::extract_archive(archivePath, selDest.toLocal8Bit().toStdString(), progress,
+                                                      ProgressCallback(), err, selOpts),
+             err.message.c_str());
+    QCOMPARE(readFile(selDest + QLatin1String("/src/sub/small.txt")), QStringLiteral("small"));
+    QVERIFY(!QFileInfo::exists(selDest + QLatin1String("/src/big.bin")));
+}
+
+void ArchiveExtractTest::transcodeGzipToZstd() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QString sourcePath = dir.path() + QLatin1String("/vendor.tar.gz");
+    QByteArray payload;
+    payload.fill('v', 512 * 1024);
+    QString error;
+    QVERIFY2(write_archive_with_symlink(sourcePath, QStringLiteral("pkg/data.bin"), payload,
+                                        QStringLiteral("pkg/current"), QStringLiteral("data.bin"),
+                                        QStringLiteral("gnutar"), QStringLiteral("gzip"), &error),
+             qPrintable(error));
+
+    const std::string destPath = (dir.path() + QLatin1String("/vendor.tar.zst")).toLocal8Bit().toStdString();
+    PCManFM::ArchiveTranscode::Options opts;
+    opts.queueBytes = 64 * 1024;  // force the decoder to block on the encoder
+    ProgressInfo progress;
+    Error err;
+    QVERIFY2(PCManFM::ArchiveTranscode::transcode_archive(sourcePath.toLocal8Bit().toStdString(), destPath, progress,
+                                                          ProgressCallback(), err, opts),
+             err.message.c_str());
+    QCOMPARE(progress.filesDone, std::uint64_t(2));
+    QCOMPARE(progress.bytesDone, progress.bytesTotal);
+
+    struct archive* ar = archive_read_new();
+    archive_read_support_filter_all(ar);
+    archive_read_support_format_all(ar);
+    QCOMPARE(archive_read_open_filename(ar, destPath.c_str(), 10240), ARCHIVE_OK);
+    archive_entry* entry = nullptr;
+    QCOMPARE(archive_read_next_header(ar, &entry), ARCHIVE_OK);
+    QCOMPARE(archive_filter_code(ar, 0), ARCHIVE_FILTER_ZSTD);
+    archive_read_free(ar);
+
+    const QString outDir = dir.path() + QLatin1String("/out");
+    QVERIFY2(PCManFM::ArchiveExtract::extract_archive(destPath, outDir.toLocal8Bit().toStdString(), progress,
+                                                      ProgressCallback(), err, Options()),
+             err.message.c_str());
+    QFile data(outDir + QLatin1String("/pkg/data.bin"));
+    QVERIFY(data.open(QIODevice::ReadOnly));
+    QCOMPARE(data.readAll(), payload);
+    QVERIFY(QFileInfo(outDir + QLatin1String("/pkg/current")).isSymLink());
+
+    // cancellation removes the partial output
+    const std::string cancelPath = (dir.path() + QLatin1String("/cancel.tar.zst")).toLocal8Bit().toStdString();
+    QVERIFY(!PCManFM::ArchiveTranscode::transcode_archive(sourcePath.toLocal8Bit().toStdString(), cancelPath,
+                                                          progress, [](const ProgressInfo&) { return false; }, err,
+                                                          opts));
+    QCOMPARE(err.code, ECANCELED);
+    QVERIFY(!QFileInfo::exists(QString::fromLocal8Bit(cancelPath.c_str())));
+}
+
+void ArchiveExtractTest::createWithBoundedReadAhead() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // More data per file than one read-ahead chunk and more files than reader threads
+    const QString srcDir = dir.path() + QLatin1String("/src");
+    QVERIFY(QDir().mkpath(srcDir));
+    std::vector<QByteArray> payloads;
+    for (int f = 0; f < 6; ++f) {
+        QByteArray data;
+        data.reserve(1536 * 1024);
+        for (int i = 0; i < 1536 * 1024; ++i) {
+            data.append(static_cast<char>((i * 31 + f) & 0xff));
+        }
+        QFile file(srcDir + QStringLiteral("/f%1.bin").arg(f));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(data);
+        payloads.push_back(data);
+    }
+
+    const std::string archivePath = (dir.path() + QLatin1String("/out.tar.zst")).toLocal8Bit().toStdString();
+    PCManFM::ArchiveWriter::Options writeOpts;
+    writeOpts.readerThreads = 3;
+    writeOpts.readAheadBytes = 1;  // clamped to the minimum pool
+    ProgressInfo progress;
+    Error err;
+    QVERIFY2(PCManFM::ArchiveWriter::create_tar_zst({srcDir.toLocal8Bit().toStdString()}, archivePath, progress,
+                                                    ProgressCallback(), err, writeOpts),
+             err.message.c_str());
+    QCOMPARE(progress.bytesDone, progress.bytesTotal);
+
+    const QString outDir = dir.path() + QLatin1String("/out");
+    QVERIFY2(PCManFM::ArchiveExtract::extract_archive(archivePath, outDir.toLocal8Bit().toStdString(), progress,
+                                                      ProgressCallback(), err, Options()),
+             err.message.c_str());
+    for (int f = 0; f < 6; ++f) {
+        QFile file(outDir + QStringLiteral("/src/f%1.bin").arg(f));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), payloads[static_cast<std::size_t>(f)]);
+    }
+
+    // Cancelling mid-file stops the reader threads and reports ECANCELED
+    int calls = 0;
+    QVERIFY(!PCManFM::ArchiveWriter::create_tar_zst({srcDir.toLocal8Bit().toStdString()}, archivePath + ".cancel",
+                                                    progress, [&calls](const ProgressInfo&) { return ++calls < 4; },
+                                                    err, writeOpts));
+    QCOMPARE(err.code, ECANCELED);
+}
+
+void ArchiveExtractTest::pipelinedExtractKeepsPerPathOrder() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // Many small files spread over the writers, plus a path written twice: the later copy wins
+    std::vector<std::pair<QString, QByteArray>> entries;
+    entries.emplace_back(QStringLiteral("dup.txt"), QByteArray("first"));
+    for (int i = 0; i < 500; ++i) {
+        entries.emplace_back(QStringLiteral("tree/d%1/f%2.txt").arg(i % 7).arg(i), QByteArray::number(i));
+    }
+    entries.emplace_back(QStringLiteral("dup.txt"), QByteArray("second"));
+    entries.emplace_back(QStringLiteral("../evil.txt"), QByteArray("bad"));
+
+    const QString archivePath = dir.path() + QLatin1String("/many.tar");
+    QString error;
+    QVERIFY2(write_archive_entries(archivePath, entries, QStringLiteral("gnutar"), &error), qPrintable(error));
+
+    // The unsafe entry still aborts the whole extraction and removes the destination
+    const QString badDest = dir.path() + QLatin1String("/out-bad");
+    Options opts;
+    opts.writerThreads = 4;
+    opts.writerQueueBytes = 64 * 1024;
+    ProgressInfo progress;
+    Error err;
+    QVERIFY(!PCManFM::ArchiveExtract::extract_archive(archivePath.toLocal8Bit().toStdString(),
+                                                      badDest.toLocal8Bit().toStdString(), progress,
+                                                      ProgressCallback(), err, opts));
+    QCOMPARE(err.code, EINVAL);
+    QVERIFY(!QFileInfo::exists(badDest));
+
+    entries.pop_back();
+    QVERIFY2(write_archive_entries(archivePath, entries, QStringLiteral("gnutar"), &error), qPrintable(error));
+    const QString destDir = dir.path() + QLatin1String("/out");
+    QVERIFY2(PCManFM::ArchiveExtract::extract_archive(archivePath.toLocal8Bit().toStdString(),
+                                                      destDir.toLocal8Bit().toStdString(), progress,
+                                                      ProgressCallback(), err, opts),
+             err.message.c_str());
+    QCOMPARE(progress.filesDone, std::uint64_t(entries.size()));
+    QCOMPARE(readFile(destDir + QLatin1String("/dup.txt")), QStringLiteral("second"));
+    for (int i = 0; i < 500; i += 37) {
+        QCOMPARE(readFile(destDir + QStringLiteral("/tree/d%1/f%2.txt").arg(i % 7).arg(i)), QString::number(i));
+    }
+}
+
+void ArchiveExtractTest::testArchiveDetectsCorruption() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // incompressible, so the payload dominates the archive and the byte flipped below lands in it
+    QByteArray payload;
+    std::uint32_t seed = 12345;
+    for (int i = 0; i < 64 * 1024; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        payload.append(static_cast<char>(seed >> 24));
+    }
+    const QString goodPath = dir.path() + QLatin1String("/good.tar.xz");
+    QString error;
+    QVERIFY2(write_archive_file(goodPath, QStringLiteral("data/file.txt"), payload, QStringLiteral("gnutar"),
+                                QStringLiteral("xz"), &error),
+             qPrintable(error));
+
+    ProgressInfo progress;
+    Error err;
+    PCManFM::ArchiveExtract::TestReport report;
+    QVERIFY2(PCManFM::ArchiveExtract::test_archive(goodPath.toLocal8Bit().toStdString(), progress,
+                                                   ProgressCallback(), report, err),
+             err.message.c_str());
+    QCOMPARE(report.entries.size(), std::size_t(1));
+    QCOMPARE(report.failedEntries, std::uint64_t(0));
+    QCOMPARE(report.bytesDecoded, std::uint64_t(payload.size()));
+    QCOMPARE(progress.bytesDone, progress.bytesTotal);
+
+    // Flip a byte inside the stored payload; the zip CRC check must catch it
+    const QString zipPath = dir.path() + QLatin1String("/bad.zip");
+    QVERIFY2(write_archive_file(zipPath, QStringLiteral("data/file.txt"), payload, QStringLiteral("zip"),
+                                QString(), &error),
+             qPrintable(error));
+    QFile zip(zipPath);
+    QVERIFY(zip.open(QIODevice::ReadWrite));
+    QByteArray bytes = zip.readAll();
+    const int at = bytes.size() / 2;
+    bytes[at] = static_cast<char>(bytes[at] ^ 0x5a);
+    QVERIFY(zip.seek(0));
+    zip.write(bytes);
+    zip.close();
+
+    QVERIFY(!PCManFM::ArchiveExtract::test_archive(zipPath.toLocal8Bit().toStdString(), progress, ProgressCallback(),
+                                                   report, err));
+    QCOMPARE(report.failedEntries, std::uint64_t(1));
+    QVERIFY(!report.entries.front().ok);
+    QVERIFY(!report.entries.front().message.empty());
+    QVERIFY(!QFileInfo::exists(dir.path() + QLatin1String("/data")));
+}
+
 QTEST_MAIN(ArchiveExtractTest)
 #include "archive_extract_test.moc"
@@ -0,0 +1,218 @@
+/*
+ * Tests for the tree model of the disk usage window
+ * tests/test_diskusagemodel.cpp
+ */
+
+#include <QTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDir>
+
+#include "../src/ui/diskusagemodel.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+using PCManFM::DiskUsageModel;
+
+namespace {
+
+Panel::DiskUsageJob::Dir makeDir(std::string path,
+                                 quint64 size,
+                                 quint64 onDiskSize,
+                                 unsigned int fileCount,
+                                 std::vector<std::string> subdirs,
+                                 std::vector<Panel::DiskUsageJob::File> largestFiles = {}) {
+    return Panel::DiskUsageJob::Dir{std::move(path), size, onDiskSize, fileCount, std::move(subdirs),
+                                    std::move(largestFiles)};
+}
+
+std::vector<Panel::DiskUsageJob::Dir> dirsOf(std::initializer_list<Panel::DiskUsageJob::Dir> dirs) {
+    return std::vector<Panel::DiskUsageJob::Dir>(dirs);
+}
+
+QString nameAt(const DiskUsageModel& model, int row, const QModelIndex& parent) {
+    return model.data(model.index(row, DiskUsageModel::Name, parent)).toString();
+}
+
+quint64 valueAt(const DiskUsageModel& model, int row, int column, const QModelIndex& parent) {
+    return model.data(model.index(row, column, parent), DiskUsageModel::SortRole).toULongLong();
+}
+
+bool writeFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+}  // namespace
+
+class DiskUsageModelTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void startsWithTheUnreadRoot();
+    void addsTheRowsOfEachDirectory();
+    void addsUpTheTotalsOfTheParents();
+    void ignoresDirectoriesOfAnotherScan();
+    void showsWhatTheJobFound();
+};
+
+void DiskUsageModelTest::startsWithTheUnreadRoot() {
+    DiskUsageModel model;
+    model.reset("/scan");
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.columnCount(), int(DiskUsageModel::ColumnCount));
+
+    const QModelIndex root = model.rootIndex();
+    QVERIFY(root.isValid());
+    QCOMPARE(model.rowCount(root), 0);
+    QCOMPARE(model.data(root).toString(), QStringLiteral("/scan"));
+    QVERIFY(model.data(root, DiskUsageModel::IsDirRole).toBool());
+    QCOMPARE(model.data(root, DiskUsageModel::PathRole).toString(), QStringLiteral("/scan"));
+    QVERIFY(!model.data(root, Qt::ToolTipRole).toString().isEmpty());  // not read yet
+    QVERIFY(!model.parent(root).isValid());
+
+    // starting over drops what was added
+    model.addDirs(dirsOf({makeDir("/scan", 10, 10, 1, {}, {{"file", 10, 10}})}));
+    QCOMPARE(model.rowCount(model.rootIndex()), 1);
+    model.reset("/other");
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.rowCount(model.rootIndex()), 0);
+    QCOMPARE(model.data(model.rootIndex()).toString(), QStringLiteral("/other"));
+}
+
+void DiskUsageModelTest::addsTheRowsOfEachDirectory() {
+    DiskUsageModel model;
+    model.reset("/scan");
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+
+    // two subdirectories, one large file and two others that are only counted
+    model.addDirs(dirsOf({makeDir("/scan", 300, 400, 5, {"a", "b"}, {{"big", 200, 300}})}));
+    const QModelIndex root = model.rootIndex();
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(inserted.at(0).at(1).toInt(), 0);
+    QCOMPARE(inserted.at(0).at(2).toInt(), 3);
+    QCOMPARE(model.rowCount(root), 4);
+
+    QCOMPARE(nameAt(model, 0, root), QStringLiteral("a"));
+    QCOMPARE(nameAt(model, 1, root), QStringLiteral("b"));
+    QCOMPARE(nameAt(model, 2, root), QStringLiteral("big"));
+    QVERIFY(model.data(model.index(0, 0, root), DiskUsageModel::IsDirRole).toBool());
+    QVERIFY(!model.data(model.index(2, 0, root), DiskUsageModel::IsDirRole).toBool());
+    QCOMPARE(model.data(model.index(0, 0, root), DiskUsageModel::PathRole).toString(), QStringLiteral("/scan/a"));
+    QCOMPARE(model.data(model.index(2, 0, root), DiskUsageModel::PathRole).toString(), QStringLiteral("/scan/big"));
+    QCOMPARE(model.parent(model.index(2, 0, root)), root);
+    QCOMPARE(model.rowCount(model.index(2, 0, root)), 0);
+
+    QCOMPARE(valueAt(model, 2, DiskUsageModel::Size, root), quint64(200));
+    QCOMPARE(valueAt(model, 2, DiskUsageModel::OnDiskSize, root), quint64(300));
+    // the rest of the files, without the subdirectories
+    const QModelIndex rest = model.index(3, DiskUsageModel::Name, root);
+    QVERIFY(model.data(rest, DiskUsageModel::PathRole).toString().isEmpty());
+    QCOMPARE(valueAt(model, 3, DiskUsageModel::Items, root), quint64(2));
+    QCOMPARE(valueAt(model, 3, DiskUsageModel::Size, root), quint64(100));
+    QCOMPARE(model.data(rest, DiskUsageModel::OnDiskSizeRole).toULongLong(), quint64(100));
+    QCOMPARE(model.data(model.index(3, DiskUsageModel::Share, root)).toString(), QStringLiteral("25.0%"));
+
+    // a subdirectory is filled once it is read
+    model.addDirs(dirsOf({makeDir("/scan/a", 50, 60, 1, {}, {{"x", 50, 60}})}));
+    const QModelIndex a = model.index(0, 0, root);
+    QCOMPARE(inserted.count(), 2);
+    QCOMPARE(model.rowCount(a), 1);
+    QCOMPARE(nameAt(model, 0, a), QStringLiteral("x"));
+    QCOMPARE(model.data(model.index(0, 0, a), DiskUsageModel::PathRole).toString(), QStringLiteral("/scan/a/x"));
+    QVERIFY(model.data(a, Qt::ToolTipRole).isNull());
+    QVERIFY(!model.data(model.index(1, 0, root), Qt::ToolTipRole).toString().isEmpty());  // b is unread
+}
+
+void DiskUsageModelTest::addsUpTheTotalsOfTheParents() {
+    DiskUsageModel model;
+    model.reset("/scan/");  // the trailing slash is not doubled
+    QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+    model.addDirs(dirsOf({makeDir("/scan/", 100, 100, 2, {"a"}),
+                          makeDir("/scan/a", 40, 50, 3, {"b"}),
+                          makeDir("/scan/a/b", 5, 50, 1, {})}));
+    QVERIFY(changed.count() > 0);
+
+    const QModelIndex root = model.rootIndex();
+    const QModelIndex a = model.index(0, 0, root);
+    const QModelIndex b = model.index(0, 0, a);
+    QCOMPARE(model.data(b, DiskUsageModel::PathRole).toString(), QStringLiteral("/scan/a/b"));
+    QCOMPARE(model.data(root.siblingAtColumn(DiskUsageModel::Items), DiskUsageModel::SortRole).toULongLong(),
+             quint64(6));
+    QCOMPARE(model.data(root, DiskUsageModel::OnDiskSizeRole).toULongLong(), quint64(200));
+    QCOMPARE(model.data(root.siblingAtColumn(DiskUsageModel::Size), DiskUsageModel::SortRole).toULongLong(),
+             quint64(145));
+    QCOMPARE(model.data(a, DiskUsageModel::OnDiskSizeRole).toULongLong(), quint64(100));
+    QCOMPARE(model.data(a.siblingAtColumn(DiskUsageModel::Items)).toString(), QStringLiteral("4"));
+    // half of the root
+    QCOMPARE(model.data(a.siblingAtColumn(DiskUsageModel::Share)).toString(), QStringLiteral("50.0%"));
+    QCOMPARE(model.data(b, DiskUsageModel::OnDiskSizeRole).toULongLong(), quint64(50));
+}
+
+void DiskUsageModelTest::ignoresDirectoriesOfAnotherScan() {
+    DiskUsageModel model;
+    model.reset("/scan");
+    model.addDirs(dirsOf({makeDir("/scan", 10, 10, 1, {"a"})}));
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+
+    // from the previous scan, or read twice
+    model.addDirs(dirsOf({makeDir("/elsewhere", 10, 10, 1, {"c"}), makeDir("/scan", 10, 10, 1, {"a"})}));
+    QCOMPARE(inserted.count(), 0);
+    QCOMPARE(model.data(model.rootIndex(), DiskUsageModel::OnDiskSizeRole).toULongLong(), quint64(10));
+}
+
+void DiskUsageModelTest::showsWhatTheJobFound() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QDir root(dir.path());
+    QVERIFY(root.mkpath(QStringLiteral("sub/deeper")));
+    QVERIFY(writeFile(dir.filePath(QStringLiteral("top")), QByteArray(4096, 't')));
+    QVERIFY(writeFile(dir.filePath(QStringLiteral("sub/inner")), QByteArray(100, 'i')));
+    QVERIFY(root.mkdir(QStringLiteral("locked")));
+    QVERIFY(writeFile(dir.filePath(QStringLiteral("locked/hidden")), "x"));
+    const QByteArray lockedPath = QFile::encodeName(dir.filePath(QStringLiteral("locked")));
+    QVERIFY(chmod(lockedPath.constData(), 0) == 0);
+    const bool canReadLocked = access(lockedPath.constData(), R_OK) == 0;  // as root
+
+    const std::string rootPath = QFile::encodeName(dir.path()).toStdString();
+    Panel::DiskUsageJob job{Fm::FilePath::fromLocalPath(rootPath.c_str())};
+    job.run();
+    chmod(lockedPath.constData(), 0700);
+
+    DiskUsageModel model;
+    model.reset(rootPath);
+    model.addDirs(job.takeDirs());
+    QVERIFY(job.takeDirs().empty());
+    QCOMPARE(job.unreadableDirCount(), canReadLocked ? 0u : 1u);
+
+    const QModelIndex rootIndex = model.rootIndex();
+    QVERIFY(model.data(rootIndex, Qt::ToolTipRole).isNull());
+    QStringList names;  // without the row of the rest, which holds the size of the directories themselves
+    for (int row = 0; row < model.rowCount(rootIndex); ++row) {
+        if (!model.data(model.index(row, 0, rootIndex), DiskUsageModel::PathRole).toString().isEmpty()) {
+            names << nameAt(model, row, rootIndex);
+        }
+    }
+    QCOMPARE(names.size(), 3);  // the subdirectories, then the file
+    QVERIFY(names.contains(QStringLiteral("sub")) && names.contains(QStringLiteral("locked")));
+    QCOMPARE(names.last(), QStringLiteral("top"));
+    // the job counts the root itself too
+    QCOMPARE(model.data(rootIndex.siblingAtColumn(DiskUsageModel::Items), DiskUsageModel::SortRole).toULongLong() + 1,
+             quint64(job.fileCount()));
+
+    const QModelIndex sub = model.index(names.indexOf(QStringLiteral("sub")), 0, rootIndex);
+    QVERIFY(model.rowCount(sub) >= 2);
+    QCOMPARE(nameAt(model, 0, sub), QStringLiteral("deeper"));
+    QCOMPARE(nameAt(model, 1, sub), QStringLiteral("inner"));
+    QCOMPARE(valueAt(model, 1, DiskUsageModel::Size, sub), quint64(100));
+}
+
+QTEST_MAIN(DiskUsageModelTest)
+#include "test_diskusagemodel.moc"
@@ -0,0 +1,182 @@
+/*
+ * Tests for row bookkeeping in the folder model of libfm-qt
+ * tests/test_foldermodel.cpp
+ */
+
+#include <QTest>
+#include <QSignalSpy>
+#include <QStringList>
+
+#include <libfm-qt6/foldermodel.h>
+#include <libfm-qt6/proxyfoldermodel.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// the slots the folder drives are protected
+class TestFolderModel : public Fm::FolderModel {
+   public:
+    using Fm::FolderModel::onFilesAdded;
+    using Fm::FolderModel::onFilesChanged;
+    using Fm::FolderModel::onFilesRemoved;
+};
+
+std::shared_ptr<const Fm::FileInfo> makeFile(const char* name, off_t size = 0) {
+    Fm::NativeFileAttrs attrs;
+    attrs.name = name;
+    attrs.st.st_mode = S_IFREG | 0644;
+    attrs.st.st_size = size;
+    attrs.contentType = "text/plain";
+    auto info = std::make_shared<Fm::FileInfo>();
+    info->setFromNative(attrs, Fm::FilePath::fromLocalPath("/nonexistent"));
+    return info;
+}
+
+Fm::FileInfoList listOf(std::initializer_list<std::shared_ptr<const Fm::FileInfo>> files) {
+    Fm::FileInfoList list;
+    list.assign(files.begin(), files.end());
+    return list;
+}
+
+Fm::FileInfoList makeFiles(int count) {
+    Fm::FileInfoList files;
+    for (int i = 0; i < count; ++i) {
+        files.push_back(makeFile(QByteArray("file-").append(QByteArray::number(i)).constData()));
+    }
+    return files;
+}
+
+QStringList names(const Fm::FolderModel& model) {
+    QStringList list;
+    for (int row = 0; row < model.rowCount(); ++row) {
+        list << QString::fromStdString(model.fileInfoFromIndex(model.index(row, 0))->name());
+    }
+    return list;
+}
+
+QStringList proxyNames(const Fm::ProxyFolderModel& proxy) {
+    QStringList list;
+    for (int row = 0; row < proxy.rowCount(); ++row) {
+        list << QString::fromStdString(proxy.fileInfoFromIndex(proxy.index(row, 0))->name());
+    }
+    return list;
+}
+
+std::vector<std::pair<int, int>> removedRanges(const QSignalSpy& spy) {
+    std::vector<std::pair<int, int>> ranges;
+    for (const auto& args : spy) {
+        ranges.emplace_back(args.at(1).toInt(), args.at(2).toInt());
+    }
+    return ranges;
+}
+
+}  // namespace
+
+class FolderModelTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void removesEachRunOfRowsAtOnce();
+    void findsMovedRowsAfterRemoval();
+    void removesByNameIfTheInfoWasReplaced();
+    void ignoresUnknownFiles();
+    void sortsWithSeveralProxies();
+};
+
+void FolderModelTest::removesEachRunOfRowsAtOnce() {
+    TestFolderModel model;
+    const auto files = makeFiles(10);
+    model.onFilesAdded(files);
+    QCOMPARE(model.rowCount(), 10);
+
+    QSignalSpy spy(&model, &QAbstractItemModel::rowsRemoved);
+    // out of order and with a duplicate
+    model.onFilesRemoved(listOf({files[6], files[2], files[9], files[1], files[8], files[3], files[2]}));
+
+    // the last run first, so that the rows given for the earlier ones stay valid
+    const std::vector<std::pair<int, int>> expected{{8, 9}, {6, 6}, {1, 3}};
+    QVERIFY(removedRanges(spy) == expected);
+    QCOMPARE(names(model), (QStringList{QStringLiteral("file-0"), QStringLiteral("file-4"), QStringLiteral("file-5"),
+                                        QStringLiteral("file-7")}));
+}
+
+void FolderModelTest::findsMovedRowsAfterRemoval() {
+    TestFolderModel model;
+    const auto files = makeFiles(6);
+    model.onFilesAdded(files);
+    model.onFilesRemoved(listOf({files[0], files[2]}));
+
+    // file-5 moved from row 5 to row 3
+    QSignalSpy spy(&model, &QAbstractItemModel::dataChanged);
+    QSignalSpy sizeSpy(&model, &Fm::FolderModel::fileSizeChanged);
+    auto changed = makeFile("file-5", 42);
+    std::vector<Fm::FileInfoPair> changes{{files[5], changed}};
+    model.onFilesChanged(changes);
+
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<QModelIndex>().row(), 3);
+    QCOMPARE(spy.at(0).at(1).value<QModelIndex>().row(), 3);
+    QCOMPARE(sizeSpy.count(), 1);
+    QVERIFY(model.fileInfoFromIndex(model.index(3, 0)) == changed);
+
+    // and is removed by its new info
+    model.onFilesRemoved(listOf({changed}));
+    QCOMPARE(names(model), (QStringList{QStringLiteral("file-1"), QStringLiteral("file-3"), QStringLiteral("file-4")}));
+}
+
+void FolderModelTest::removesByNameIfTheInfoWasReplaced() {
+    TestFolderModel model;
+    const auto files = makeFiles(3);
+    model.onFilesAdded(files);
+
+    // an info the model never saw, e.g. after it missed an update
+    model.onFilesRemoved(listOf({makeFile("file-1")}));
+    QCOMPARE(names(model), (QStringList{QStringLiteral("file-0"), QStringLiteral("file-2")}));
+}
+
+void FolderModelTest::ignoresUnknownFiles() {
+    TestFolderModel model;
+    model.onFilesAdded(makeFiles(3));
+
+    QSignalSpy spy(&model, &QAbstractItemModel::rowsRemoved);
+    model.onFilesRemoved(listOf({makeFile("other")}));
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(model.rowCount(), 3);
+}
+
+void FolderModelTest::sortsWithSeveralProxies() {
+    TestFolderModel model;
+    Fm::ProxyFolderModel ascending;
+    Fm::ProxyFolderModel descending;
+    ascending.setSourceModel(&model);
+    descending.setSourceModel(&model);
+    ascending.sort(Fm::FolderModel::ColumnFileName, Qt::AscendingOrder);
+    descending.sort(Fm::FolderModel::ColumnFileName, Qt::DescendingOrder);
+
+    // enough rows for the keys to be made up front, on several threads
+    const auto files = makeFiles(2500);
+    model.onFilesAdded(files);
+    model.onFilesRemoved(listOf({files[0], files[1], files[2]}));
+    // renamed, so its old key must not be used
+    std::vector<Fm::FileInfoPair> changes{{files[3], makeFile("a-first")}};
+    model.onFilesChanged(changes);
+
+    QStringList expected;
+    expected << QStringLiteral("a-first");
+    for (int i = 4; i < 2500; ++i) {
+        expected << QStringLiteral("file-%1").arg(i);
+    }
+    // numeric mode: file-4, file-5, ..., file-2499
+    QCOMPARE(proxyNames(ascending), expected);
+    std::reverse(expected.begin(), expected.end());
+    QCOMPARE(proxyNames(descending), expected);
+}
+
+QTEST_MAIN(FolderModelTest)
+#include "test_foldermodel.moc"
@@ -0,0 +1,237 @@
+/*
+ * Tests for the saved listing snapshots of libfm-qt
+ * tests/test_foldersnapshot.cpp
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSet>
+
+#include <libfm-qt6/core/foldersnapshot_p.h>
+#include <libfm-qt6/core/nativedirlister_p.h>
+
+#include <sys/stat.h>
+
+namespace {
+
+// long enough for any listing to be saved (ms)
+constexpr qint64 kSlowListing = 1000;
+
+bool writeFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+Fm::FilePath pathOf(const QString& path) {
+    return Fm::FilePath::fromLocalPath(path.toUtf8().constData());
+}
+
+// Lists the directory the way DirListJob does, recording a new snapshot; returns whether the saved one was loaded.
+bool listAndSave(const QString& dir, Fm::FileInfoList* loaded = nullptr) {
+    Fm::FolderSnapshot snapshot{pathOf(dir)};
+    if (!snapshot.open()) {
+        return false;
+    }
+    Fm::FileInfoList snapshotFiles;
+    const bool found = snapshot.load(snapshotFiles);
+    if (loaded) {
+        *loaded = std::move(snapshotFiles);
+    }
+    Fm::NativeDirLister lister{pathOf(dir), false};
+    lister.setSnapshot(&snapshot);
+    Fm::GErrorPtr err;
+    Fm::FileInfoList files;
+    if (lister.open(err)) {
+        while (lister.nextBatch(files, err)) {
+        }
+    }
+    if (!err) {
+        snapshot.save(kSlowListing);
+    }
+    return found;
+}
+
+QSet<QString> names(const Fm::FileInfoList& files) {
+    QSet<QString> set;
+    for (const auto& file : files) {
+        set.insert(QString::fromStdString(file->name()));
+    }
+    return set;
+}
+
+ino_t inodeOf(const QString& path) {
+    struct stat st;
+    return stat(path.toUtf8().constData(), &st) == 0 ? st.st_ino : 0;
+}
+
+}  // namespace
+
+class FolderSnapshotTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void savesAndLoadsListings();
+    void keepsTheFileIfNothingChanged();
+    void ignoresSnapshotsOfAnotherState();
+    void rejectsCorruptSnapshots_data();
+    void rejectsCorruptSnapshots();
+    void evictsTheLeastRecentlyUsed();
+
+   private:
+    QString snapshotPath() const;
+
+    QTemporaryDir cacheDir_;
+    QTemporaryDir dir_;
+    QDir snapshotDir_;
+};
+
+void FolderSnapshotTest::initTestCase() {
+    QVERIFY(cacheDir_.isValid());
+    QVERIFY(dir_.isValid());
+    // the snapshots go here instead of the cache of the user
+    qputenv("XDG_CACHE_HOME", cacheDir_.path().toUtf8());
+    snapshotDir_.setPath(cacheDir_.filePath(QStringLiteral("libfm-qt/folders")));
+
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("file.txt")), "12345"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral(".dotfile")), "x"));
+    QVERIFY(QDir(dir_.path()).mkdir(QStringLiteral("sub")));
+    QVERIFY(QFile::link(QStringLiteral("sub"), dir_.filePath(QStringLiteral("link-to-sub"))));
+    for (int i = 0; i < 50; ++i) {
+        QVERIFY(writeFile(dir_.filePath(QStringLiteral("many-%1").arg(i)), QByteArray::number(i)));
+    }
+}
+
+void FolderSnapshotTest::init() {
+    snapshotDir_.removeRecursively();
+}
+
+QString FolderSnapshotTest::snapshotPath() const {
+    const QStringList files = snapshotDir_.entryList(QDir::Files);
+    return files.size() == 1 ? snapshotDir_.filePath(files.first()) : QString();
+}
+
+void FolderSnapshotTest::savesAndLoadsListings() {
+    QVERIFY(!listAndSave(dir_.path()));
+    QVERIFY(!snapshotPath().isEmpty());
+
+    Fm::FileInfoList loaded;
+    QVERIFY(listAndSave(dir_.path(), &loaded));
+    QCOMPARE(loaded.size(), std::size_t(54));
+    QVERIFY(names(loaded).contains(QStringLiteral("many-49")));
+    for (const auto& file : loaded) {
+        if (file->name() == "file.txt") {
+            QCOMPARE(file->size(), uint64_t(5));
+            QVERIFY(!file->isDir());
+            QCOMPARE(QByteArray(file->path().localPath().get()), dir_.filePath(QStringLiteral("file.txt")).toUtf8());
+        }
+        else if (file->name() == "link-to-sub") {
+            QVERIFY(file->isSymlink());
+            QVERIFY(file->isDir());
+        }
+        else if (file->name() == ".dotfile") {
+            QVERIFY(file->isHidden());
+        }
+    }
+}
+
+void FolderSnapshotTest::keepsTheFileIfNothingChanged() {
+    listAndSave(dir_.path());
+    const QString path = snapshotPath();
+    const ino_t inode = inodeOf(path);
+    QVERIFY(inode != 0);
+
+    // a rewritten snapshot would be a new file put in its place
+    QVERIFY(listAndSave(dir_.path()));
+    QCOMPARE(inodeOf(path), inode);
+
+    // an entry that changed without the directory changing
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("file.txt")), "1234567"));
+    QVERIFY(listAndSave(dir_.path()));
+    QVERIFY(inodeOf(path) != inode);
+    Fm::FileInfoList loaded;
+    QVERIFY(listAndSave(dir_.path(), &loaded));
+    for (const auto& file : loaded) {
+        if (file->name() == "file.txt") {
+            QCOMPARE(file->size(), uint64_t(7));
+        }
+    }
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("file.txt")), "12345"));
+}
+
+void FolderSnapshotTest::ignoresSnapshotsOfAnotherState() {
+    listAndSave(dir_.path());
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("added")), "x"));
+
+    Fm::FileInfoList loaded;
+    QVERIFY(!listAndSave(dir_.path(), &loaded));
+    QVERIFY(loaded.empty());
+    // replaced by one of the new state
+    QVERIFY(listAndSave(dir_.path(), &loaded));
+    QVERIFY(names(loaded).contains(QStringLiteral("added")));
+    QVERIFY(QFile::remove(dir_.filePath(QStringLiteral("added"))));
+}
+
+void FolderSnapshotTest::rejectsCorruptSnapshots_data() {
+    QTest::addColumn<int>("keep");
+    QTest::addColumn<int>("flip");
+
+    QTest::newRow("empty") << 0 << -1;
+    QTest::newRow("header cut short") << 20 << -1;
+    QTest::newRow("records cut short") << -200 << -1;
+    QTest::newRow("bad magic") << -1 << 0;
+    QTest::newRow("bad version") << -1 << 4;
+    // the high byte of the count, far more records than the file holds
+    QTest::newRow("bad count") << -1 << 59;
+}
+
+void FolderSnapshotTest::rejectsCorruptSnapshots() {
+    QFETCH(int, keep);
+    QFETCH(int, flip);
+
+    listAndSave(dir_.path());
+    const QString path = snapshotPath();
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    file.close();
+    if (keep >= 0) {
+        data.truncate(keep);
+    }
+    else if (keep < -1) {
+        data.chop(-keep);
+    }
+    if (flip >= 0) {
+        data[flip] = static_cast<char>(~data[flip]);
+    }
+    QVERIFY(writeFile(path, data));
+
+    Fm::FolderSnapshot snapshot{pathOf(dir_.path())};
+    QVERIFY(snapshot.open());
+    Fm::FileInfoList files;
+    QVERIFY(!snapshot.load(files));
+    QVERIFY(files.empty());
+}
+
+void FolderSnapshotTest::evictsTheLeastRecentlyUsed() {
+    // an old snapshot larger than what may be kept, sparse so that it takes no space
+    QVERIFY(snapshotDir_.mkpath(QStringLiteral(".")));
+    const QString old = snapshotDir_.filePath(QStringLiteral("old"));
+    QFile file(old);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QVERIFY(file.resize(256 * 1024 * 1024));
+    QVERIFY(file.setFileTime(QDateTime::currentDateTime().addDays(-1), QFileDevice::FileModificationTime));
+    file.close();
+
+    listAndSave(dir_.path());
+    QVERIFY(!QFile::exists(old));
+    QVERIFY(!snapshotPath().isEmpty());
+}
+
+QTEST_MAIN(FolderSnapshotTest)
+#include "test_foldersnapshot.moc"
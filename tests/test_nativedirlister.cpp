@@ -0,0 +1,147 @@
+/*
+ * Tests for the native directory lister of libfm-qt
+ * tests/test_nativedirlister.cpp
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDir>
+#include <QSet>
+
+#include <libfm-qt6/core/nativedirlister_p.h>
+
+#include <cstring>
+#include <map>
+#include <string>
+
+namespace {
+
+bool writeFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+std::map<std::string, std::shared_ptr<const Fm::FileInfo>> byName(const Fm::FileInfoList& files) {
+    std::map<std::string, std::shared_ptr<const Fm::FileInfo>> map;
+    for (const auto& file : files) {
+        map.emplace(file->name(), file);
+    }
+    return map;
+}
+
+bool listAll(Fm::NativeDirLister& lister, Fm::FileInfoList& files, std::size_t maxEntries, Fm::GErrorPtr& err) {
+    while (lister.nextBatch(files, err, maxEntries)) {
+    }
+    return !err;
+}
+
+}  // namespace
+
+class NativeDirListerTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void initTestCase();
+    void listsEntriesWithTheirAttributes();
+    void returnsBatchesOfAtMostMaxEntries();
+    void dropsFilteredEntries();
+    void failsOnMissingDirectory();
+
+   private:
+    QTemporaryDir dir_;
+};
+
+void NativeDirListerTest::initTestCase() {
+    QVERIFY(dir_.isValid());
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("file.txt")), "12345"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("empty")), QByteArray()));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral(".dotfile")), "x"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("listed-hidden")), "x"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral(".hidden")), "listed-hidden\n"));
+    QVERIFY(QDir(dir_.path()).mkdir(QStringLiteral("sub")));
+    QVERIFY(QFile::link(QStringLiteral("sub"), dir_.filePath(QStringLiteral("link-to-sub"))));
+    QVERIFY(QFile::link(QStringLiteral("missing"), dir_.filePath(QStringLiteral("dangling"))));
+    for (int i = 0; i < 200; ++i) {
+        QVERIFY(writeFile(dir_.filePath(QStringLiteral("many-%1").arg(i)), QByteArray::number(i)));
+    }
+}
+
+void NativeDirListerTest::listsEntriesWithTheirAttributes() {
+    Fm::NativeDirLister lister{Fm::FilePath::fromLocalPath(dir_.path().toUtf8().constData()), false};
+    Fm::GErrorPtr err;
+    QVERIFY(lister.open(err));
+    Fm::FileInfoList files;
+    QVERIFY(listAll(lister, files, SIZE_MAX, err));
+
+    const auto map = byName(files);
+    QCOMPARE(map.size(), std::size_t(208));  // without "." and ".."
+    QCOMPARE(map.size(), files.size());
+    QVERIFY(map.count(".") == 0 && map.count("..") == 0);
+
+    const auto& file = map.at("file.txt");
+    QCOMPARE(file->size(), uint64_t(5));
+    QVERIFY(!file->isDir());
+    QVERIFY(!file->isHidden());
+    QCOMPARE(QByteArray(file->path().localPath().get()),
+             dir_.filePath(QStringLiteral("file.txt")).toUtf8());
+
+    QVERIFY(map.at("sub")->isDir());
+    QVERIFY(map.at(".dotfile")->isHidden());
+    QVERIFY(map.at("listed-hidden")->isHidden());
+
+    const auto& link = map.at("link-to-sub");
+    QVERIFY(link->isSymlink());
+    QVERIFY(link->isDir());
+    QVERIFY(map.at("dangling")->isSymlink());
+    QVERIFY(!map.at("dangling")->isDir());
+}
+
+void NativeDirListerTest::returnsBatchesOfAtMostMaxEntries() {
+    Fm::NativeDirLister lister{Fm::FilePath::fromLocalPath(dir_.path().toUtf8().constData()), false};
+    Fm::GErrorPtr err;
+    QVERIFY(lister.open(err));
+
+    QSet<QString> names;
+    for (;;) {
+        Fm::FileInfoList batch;
+        if (!lister.nextBatch(batch, err, 7)) {
+            break;
+        }
+        QVERIFY(batch.size() <= 7);
+        for (const auto& file : batch) {
+            QVERIFY(!names.contains(QString::fromStdString(file->name())));  // nothing twice
+            names.insert(QString::fromStdString(file->name()));
+        }
+    }
+    QVERIFY(!err);
+    QCOMPARE(names.size(), 208);
+}
+
+void NativeDirListerTest::dropsFilteredEntries() {
+    Fm::NativeDirLister lister{Fm::FilePath::fromLocalPath(dir_.path().toUtf8().constData()), false};
+    int seen = 0;
+    lister.setFilter([&seen](const Fm::NativeFileAttrs& attrs) {
+        ++seen;
+        return strncmp(attrs.name, "many-", 5) != 0;
+    });
+    Fm::GErrorPtr err;
+    QVERIFY(lister.open(err));
+    Fm::FileInfoList files;
+    QVERIFY(listAll(lister, files, 3, err));
+    QCOMPARE(seen, 208);
+    QCOMPARE(files.size(), std::size_t(8));
+}
+
+void NativeDirListerTest::failsOnMissingDirectory() {
+    Fm::NativeDirLister lister{Fm::FilePath::fromLocalPath(dir_.filePath(QStringLiteral("none")).toUtf8().constData()),
+                               false};
+    Fm::GErrorPtr err;
+    QVERIFY(!lister.open(err));
+    QVERIFY(err);
+    QCOMPARE(err.domain(), std::uint32_t(G_IO_ERROR));
+    QCOMPARE(err.code(), static_cast<unsigned int>(G_IO_ERROR_NOT_FOUND));
+}
+
+QTEST_MAIN(NativeDirListerTest)
+#include "test_nativedirlister.moc"
@@ -0,0 +1,218 @@
+/*
+ * Tests for the native search:// implementation of libfm-qt
+ * tests/test_nativefilesearch.cpp
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+#include <QUrl>
+
+#include <libfm-qt6/core/nativefilesearch_p.h>
+
+#include <chrono>
+
+namespace {
+
+// long enough for any of these searches to be over (ms)
+constexpr qint64 kSearchTimeout = 30000;
+
+bool writeFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+// Collects every match of |search| as a path relative to |root|, sorted; false if it does not end in time.
+bool collect(Fm::NativeFileSearch& search, const QString& root, QStringList& found) {
+    Fm::FileInfoList files;
+    QElapsedTimer timer;
+    timer.start();
+    while (search.waitForMatches(files, std::chrono::milliseconds{100})) {
+        if (timer.hasExpired(kSearchTimeout)) {
+            return false;
+        }
+    }
+    const QDir rootDir(root);
+    for (const auto& file : files) {
+        found << rootDir.relativeFilePath(QString::fromUtf8(file->path().localPath().get()));
+    }
+    found.sort();
+    return true;
+}
+
+}  // namespace
+
+class NativeFileSearchTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void initTestCase();
+    void rejectsWhatItCannotSearch_data();
+    void rejectsWhatItCannotSearch();
+    void matchesTheQuery_data();
+    void matchesTheQuery();
+    void searchesSeveralFolders();
+    void reportsMissingFolders();
+    void matchesMoreFilesThanAreQueued();
+    void stopsWhenCancelled();
+
+   private:
+    QByteArray uriOf(const QString& folder, const QByteArray& query) const;
+
+    QTemporaryDir dir_;
+    QString manyPath_;  // a folder with more files than the walk queues for the content threads
+};
+
+void NativeFileSearchTest::initTestCase() {
+    QVERIFY(dir_.isValid());
+    QDir root(dir_.path());
+    QVERIFY(root.mkpath(QStringLiteral("tree/sub/deeper")));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/a.txt")), "hello World\n"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/b.TXT")), "nothing here"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/empty.txt")), QByteArray()));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/.hidden-file")), "hello"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/nul.bin")), QByteArray("text\0after-nul\nnext line\n", 25)));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/sub/c.txt")), "line one\nHELLO again\n"));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/sub/big.bin")), QByteArray(10000, 'x')));
+    QVERIFY(writeFile(dir_.filePath(QStringLiteral("tree/sub/deeper/d.png")), "not really"));
+    // not followed, or everything in sub would be found twice
+    QVERIFY(QFile::link(QStringLiteral("sub"), dir_.filePath(QStringLiteral("tree/link-to-sub"))));
+
+    QVERIFY(root.mkdir(QStringLiteral("many")));
+    manyPath_ = dir_.filePath(QStringLiteral("many"));
+    for (int i = 0; i < 5000; ++i) {
+        QVERIFY(writeFile(manyPath_ + QStringLiteral("/file-%1").arg(i), i % 2 ? "a needle" : "a haystack"));
+    }
+}
+
+QByteArray NativeFileSearchTest::uriOf(const QString& folder, const QByteArray& query) const {
+    return "search://" + QUrl::toPercentEncoding(folder, "/") + '?' + query;
+}
+
+void NativeFileSearchTest::rejectsWhatItCannotSearch_data() {
+    QTest::addColumn<QByteArray>("uri");
+
+    QTest::newRow("file") << QByteArray("file:///tmp");
+    QTest::newRow("no scheme") << QByteArray("/tmp?name=*");
+    QTest::newRow("remote folder") << QByteArray("search://sftp://host/dir?name=*");
+    QTest::newRow("one remote folder") << QByteArray("search:///tmp,sftp://host/dir?name=*");
+}
+
+void NativeFileSearchTest::rejectsWhatItCannotSearch() {
+    QFETCH(QByteArray, uri);
+
+    Fm::NativeFileSearch search{nullptr, false};
+    QVERIFY(!search.start(uri.constData()));
+}
+
+void NativeFileSearchTest::matchesTheQuery_data() {
+    QTest::addColumn<QByteArray>("query");
+    QTest::addColumn<QStringList>("expected");
+
+    const QString a = QStringLiteral("a.txt");
+    const QString b = QStringLiteral("b.TXT");
+    const QString empty = QStringLiteral("empty.txt");
+    const QString hidden = QStringLiteral(".hidden-file");
+    const QString nul = QStringLiteral("nul.bin");
+    const QString c = QStringLiteral("sub/c.txt");
+    const QString big = QStringLiteral("sub/big.bin");
+    const QString png = QStringLiteral("sub/deeper/d.png");
+
+    QTest::newRow("name") << QByteArray("name=*.txt") << QStringList{a, empty};
+    QTest::newRow("names") << QByteArray("name=a.*,b.*") << QStringList{a, b};
+    QTest::newRow("name_ci") << QByteArray("name=*.txt&name_ci=1") << QStringList{a, b, empty};
+    QTest::newRow("recursive") << QByteArray("name=*.txt&recursive=1") << QStringList{a, empty, c};
+    QTest::newRow("hidden") << QByteArray("name_regex=hidden") << QStringList{};
+    QTest::newRow("show_hidden") << QByteArray("name_regex=hidden&show_hidden=1") << QStringList{hidden};
+    QTest::newRow("name_regex") << "name_regex=" + QUrl::toPercentEncoding(QStringLiteral("^[ab]\\.")) << QStringList{a};
+    QTest::newRow("name_regex ci") << "name_regex=" + QUrl::toPercentEncoding(QStringLiteral("^[AB]\\.")) + "&name_ci=1"
+                                   << QStringList{a, b};
+    QTest::newRow("min_size") << QByteArray("min_size=5000&recursive=1") << QStringList{big};
+    QTest::newRow("max_size") << QByteArray("name=*.txt&max_size=5") << QStringList{empty};
+    QTest::newRow("max_mtime") << QByteArray("max_mtime=2000-01-01&recursive=1") << QStringList{};
+    QTest::newRow("mime_types") << QByteArray("mime_types=image/*&recursive=1") << QStringList{png};
+    QTest::newRow("content") << QByteArray("content=hello&recursive=1") << QStringList{a};
+    QTest::newRow("content_ci") << QByteArray("content=hello&content_ci=1&recursive=1") << QStringList{a, c};
+    QTest::newRow("content_regex") << "content_regex=" + QUrl::toPercentEncoding(QStringLiteral("^line")) + "&recursive=1"
+                                   << QStringList{c};
+    // lines end before their newline
+    QTest::newRow("content_regex end") << "content_regex=" + QUrl::toPercentEncoding(QStringLiteral("again$")) +
+                                              "&recursive=1"
+                                       << QStringList{c};
+    // like the GIO search, a match does not span a line break and a line ends at its first NUL
+    QTest::newRow("content across lines") << "content=" + QUrl::toPercentEncoding(QStringLiteral("one\nHELLO")) +
+                                                 "&recursive=1"
+                                          << QStringList{};
+    QTest::newRow("content after NUL") << QByteArray("content=after-nul&recursive=1") << QStringList{};
+    QTest::newRow("content after NUL line") << "content=" + QUrl::toPercentEncoding(QStringLiteral("next line"))
+                                            << QStringList{nul};
+}
+
+void NativeFileSearchTest::matchesTheQuery() {
+    QFETCH(QByteArray, query);
+    QFETCH(QStringList, expected);
+
+    const QString tree = dir_.filePath(QStringLiteral("tree"));
+    Fm::NativeFileSearch search{nullptr, false};
+    QVERIFY(search.start(uriOf(tree, query).constData()));
+    QStringList found;
+    QVERIFY(collect(search, tree, found));
+    QCOMPARE(found, expected);
+    QVERIFY(search.takeErrors().empty());
+}
+
+void NativeFileSearchTest::searchesSeveralFolders() {
+    const QString sub = dir_.filePath(QStringLiteral("tree/sub"));
+    // the scheme is not case sensitive
+    const QByteArray uri = "SEARCH://" + QUrl::toPercentEncoding(sub, "/") + ',' +
+                           QUrl::toPercentEncoding(sub + QStringLiteral("/deeper"), "/") + "?name=*";
+    Fm::NativeFileSearch search{nullptr, false};
+    QVERIFY(search.start(uri.constData()));
+    QStringList found;
+    QVERIFY(collect(search, sub, found));
+    QCOMPARE(found, (QStringList{QStringLiteral("big.bin"), QStringLiteral("c.txt"), QStringLiteral("deeper"),
+                                 QStringLiteral("deeper/d.png")}));
+}
+
+void NativeFileSearchTest::reportsMissingFolders() {
+    Fm::NativeFileSearch search{nullptr, false};
+    QVERIFY(search.start(uriOf(dir_.filePath(QStringLiteral("missing")), "name=*").constData()));
+    QStringList found;
+    QVERIFY(collect(search, dir_.path(), found));
+    QVERIFY(found.isEmpty());
+    const auto errors = search.takeErrors();
+    QCOMPARE(errors.size(), std::size_t(1));
+    QCOMPARE(errors.front().code(), static_cast<unsigned int>(G_IO_ERROR_NOT_FOUND));
+    QVERIFY(search.takeErrors().empty());
+}
+
+void NativeFileSearchTest::matchesMoreFilesThanAreQueued() {
+    Fm::NativeFileSearch search{nullptr, false};
+    QVERIFY(search.start(uriOf(manyPath_, "content=needle").constData()));
+    QStringList found;
+    QVERIFY(collect(search, manyPath_, found));
+    QCOMPARE(found.size(), 2500);
+    QVERIFY(found.contains(QStringLiteral("file-4999")) && !found.contains(QStringLiteral("file-4998")));
+}
+
+void NativeFileSearchTest::stopsWhenCancelled() {
+    GCancellable* cancellable = g_cancellable_new();
+    {
+        Fm::NativeFileSearch search{cancellable, false};
+        QVERIFY(search.start(uriOf(manyPath_, "content_regex=needle").constData()));
+        g_cancellable_cancel(cancellable);
+        QStringList found;
+        QVERIFY(collect(search, manyPath_, found));
+    }
+    {
+        // and without waiting for it, while the walk may wait for the content threads
+        Fm::NativeFileSearch search{nullptr, false};
+        QVERIFY(search.start(uriOf(manyPath_, "content_regex=needle").constData()));
+    }
+    g_object_unref(cancellable);
+}
+
+QTEST_MAIN(NativeFileSearchTest)
+#include "test_nativefilesearch.moc"
@@ -0,0 +1,169 @@
+/*
+ * Tests for counting local trees in libfm-qt
+ * tests/test_nativesizewalker.cpp
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDir>
+
+#include <libfm-qt6/core/nativesizewalker_p.h>
+#include <libfm-qt6/core/totalsizejob.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace {
+
+bool writeFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+std::uint64_t onDiskSizeOf(const QString& path) {
+    struct stat st;
+    return lstat(QFile::encodeName(path).constData(), &st) == 0 ? std::uint64_t(st.st_blocks) * 512 : 0;
+}
+
+// Walks |path|, adding up the counts and keeping what was read of each directory by path.
+Fm::NativeSizeWalker::Counts walk(const QString& path,
+                                  std::map<std::string, Fm::NativeSizeWalker::Dir>* dirs = nullptr) {
+    std::mutex mutex;
+    Fm::NativeSizeWalker::Counts totals;
+    Fm::NativeSizeWalker walker{false, nullptr, [&](const Fm::NativeSizeWalker::Counts& counts) {
+                                    std::lock_guard<std::mutex> lock{mutex};
+                                    totals.size += counts.size;
+                                    totals.onDiskSize += counts.onDiskSize;
+                                    totals.fileCount += counts.fileCount;
+                                }};
+    if (dirs) {
+        walker.setDirRead([&](Fm::NativeSizeWalker::Dir&& dir) {
+            std::lock_guard<std::mutex> lock{mutex};
+            std::string key = dir.path;
+            dirs->emplace(std::move(key), std::move(dir));
+        });
+    }
+    if (!walker.walk(QFile::encodeName(path).constData(), false)) {
+        return Fm::NativeSizeWalker::Counts{};
+    }
+    return totals;
+}
+
+}  // namespace
+
+class NativeSizeWalkerTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void init();
+    void cleanup();
+    void countsHardLinksOnceOnDisk();
+    void reportsEachDirectory();
+    void seesFilesRewrittenInPlace();
+    void totalSizeJobCountsLocalTrees();
+
+   private:
+    QString path(const QString& name) const { return dir_->filePath(name); }
+
+    std::unique_ptr<QTemporaryDir> dir_;
+};
+
+void NativeSizeWalkerTest::init() {
+    dir_ = std::make_unique<QTemporaryDir>();
+    QVERIFY(dir_->isValid());
+}
+
+void NativeSizeWalkerTest::cleanup() {
+    dir_.reset();
+}
+
+void NativeSizeWalkerTest::countsHardLinksOnceOnDisk() {
+    QVERIFY(QDir(dir_->path()).mkdir(QStringLiteral("sub")));
+    QVERIFY(writeFile(path(QStringLiteral("data")), QByteArray(64 * 1024, 'x')));
+    // one link beside it and one in a directory read by another thread maybe
+    QVERIFY(link(QFile::encodeName(path(QStringLiteral("data"))).constData(),
+                 QFile::encodeName(path(QStringLiteral("link"))).constData()) == 0);
+    QVERIFY(link(QFile::encodeName(path(QStringLiteral("data"))).constData(),
+                 QFile::encodeName(path(QStringLiteral("sub/link"))).constData()) == 0);
+
+    const auto counts = walk(dir_->path());
+    QCOMPARE(counts.fileCount, 5u);  // the root, sub and the three links
+    QCOMPARE(counts.size, std::uint64_t(3 * 64 * 1024));
+    QCOMPARE(counts.onDiskSize, onDiskSizeOf(dir_->path()) + onDiskSizeOf(path(QStringLiteral("sub"))) +
+                                    onDiskSizeOf(path(QStringLiteral("data"))));
+}
+
+void NativeSizeWalkerTest::reportsEachDirectory() {
+    QDir root(dir_->path());
+    QVERIFY(root.mkpath(QStringLiteral("sub/deeper")));
+    QVERIFY(root.mkdir(QStringLiteral("empty")));
+    QVERIFY(writeFile(path(QStringLiteral("top")), "0123456789"));
+    QVERIFY(writeFile(path(QStringLiteral("sub/large")), QByteArray(100 * 1024, 'x')));
+    QVERIFY(writeFile(path(QStringLiteral("sub/small")), "12345"));
+    QVERIFY(writeFile(path(QStringLiteral("sub/deeper/file")), "1"));
+
+    std::map<std::string, Fm::NativeSizeWalker::Dir> dirs;
+    const auto counts = walk(dir_->path(), &dirs);
+    QCOMPARE(counts.fileCount, 8u);
+    QCOMPARE(counts.size, std::uint64_t(10 + 100 * 1024 + 5 + 1));
+    QCOMPARE(dirs.size(), std::size_t(4));
+
+    const auto& top = dirs.at(QFile::encodeName(dir_->path()).toStdString());
+    QCOMPARE(top.counts.fileCount, 3u);  // top, sub and empty
+    QCOMPARE(top.counts.size, std::uint64_t(10));
+    QCOMPARE(top.counts.onDiskSize, onDiskSizeOf(path(QStringLiteral("top"))) +
+                                        onDiskSizeOf(path(QStringLiteral("sub"))) +
+                                        onDiskSizeOf(path(QStringLiteral("empty"))));
+    QCOMPARE(top.subdirs.size(), std::size_t(2));
+
+    const auto& sub = dirs.at(QFile::encodeName(path(QStringLiteral("sub"))).toStdString());
+    QCOMPARE(sub.counts.fileCount, 3u);
+    QCOMPARE(sub.counts.size, std::uint64_t(100 * 1024 + 5));
+    QVERIFY(sub.subdirs == std::vector<std::string>{"deeper"});
+    QCOMPARE(sub.largestFiles.size(), std::size_t(2));
+    QVERIFY(sub.largestFiles.front().name == "large");
+    QCOMPARE(sub.largestFiles.front().size, std::uint64_t(100 * 1024));
+
+    const auto& empty = dirs.at(QFile::encodeName(path(QStringLiteral("empty"))).toStdString());
+    QCOMPARE(empty.counts.fileCount, 0u);
+    QVERIFY(empty.subdirs.empty() && empty.largestFiles.empty());
+}
+
+void NativeSizeWalkerTest::seesFilesRewrittenInPlace() {
+    QVERIFY(writeFile(path(QStringLiteral("file")), "1234"));
+    QCOMPARE(walk(dir_->path()).size, std::uint64_t(4));
+
+    // the directory itself does not change
+    QVERIFY(writeFile(path(QStringLiteral("file")), "123456789"));
+    QCOMPARE(walk(dir_->path()).size, std::uint64_t(9));
+}
+
+void NativeSizeWalkerTest::totalSizeJobCountsLocalTrees() {
+    QVERIFY(QDir(dir_->path()).mkdir(QStringLiteral("sub")));
+    QVERIFY(writeFile(path(QStringLiteral("sub/a")), QByteArray(8192, 'a')));
+    QVERIFY(writeFile(path(QStringLiteral("b")), "bb"));
+    QVERIFY(link(QFile::encodeName(path(QStringLiteral("b"))).constData(),
+                 QFile::encodeName(path(QStringLiteral("sub/b"))).constData()) == 0);
+
+    // the tree and, again, a path inside it: a hard link counts once on disk in the whole job
+    Fm::FilePathList paths;
+    paths.push_back(Fm::FilePath::fromLocalPath(QFile::encodeName(dir_->path()).constData()));
+    paths.push_back(Fm::FilePath::fromLocalPath(QFile::encodeName(path(QStringLiteral("sub/b"))).constData()));
+    Fm::TotalSizeJob job{std::move(paths), Fm::TotalSizeJob::SAME_FS};
+    job.run();
+
+    QCOMPARE(job.fileCount(), 6u);
+    QCOMPARE(job.totalSize(), std::uint64_t(8192 + 2 + 2 + 2));
+    QCOMPARE(job.totalOnDiskSize(), onDiskSizeOf(dir_->path()) + onDiskSizeOf(path(QStringLiteral("sub"))) +
+                                        onDiskSizeOf(path(QStringLiteral("sub/a"))) +
+                                        onDiskSizeOf(path(QStringLiteral("b"))));
+}
+
+QTEST_MAIN(NativeSizeWalkerTest)
+#include "test_nativesizewalker.moc"
@@ -0,0 +1,231 @@
+/*
+ * Tests for the packed thumbnail store of libfm-qt
+ * tests/test_thumbnailstore.cpp
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QUrl>
+
+#include <libfm-qt6/core/thumbnailstore.h>
+
+#include <sys/stat.h>
+
+#include <cstring>
+
+namespace {
+
+// where the width of the first record is in the data file, see RecordHeader
+constexpr qint64 kFirstRecordWidth = 32;
+
+Fm::ThumbnailStore::Digest digestOf(const QByteArray& uri) {
+    const QByteArray md5 = QCryptographicHash::hash(uri, QCryptographicHash::Md5);
+    Fm::ThumbnailStore::Digest digest;
+    memcpy(digest.data(), md5.constData(), digest.size());
+    return digest;
+}
+
+QImage gradient(int width, int height, bool alpha) {
+    QImage image{width, height, alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32};
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            // small steps, large steps and runs, so that every kind of QOI chunk is used
+            const int r = x < width / 4 ? 17 : (x * 7 + y) & 0xff;
+            const int g = (x + y * 3) & 0xff;
+            const int b = x % 3 == 0 ? (x * 91 + y * 13) & 0xff : (x + 1) & 0xff;
+            image.setPixel(x, y, qRgba(r, g, b, alpha ? (x * 5 + y) & 0xff : 255));
+        }
+    }
+    return image;
+}
+
+bool samePixels(const QImage& a, const QImage& b) {
+    const QImage::Format format = a.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+    return a.size() == b.size() && a.convertToFormat(format) == b.convertToFormat(format);
+}
+
+bool patchFile(const QString& path, qint64 offset, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::ReadWrite) && file.seek(offset) && file.write(data) == data.size();
+}
+
+quint64 mtimeOf(const QString& path) {
+    struct stat st;
+    return stat(QFile::encodeName(path).constData(), &st) == 0 ? st.st_mtime : 0;
+}
+
+}  // namespace
+
+class ThumbnailStoreTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void init();
+    void cleanup();
+    void roundTripsImages_data();
+    void roundTripsImages();
+    void replacesOlderThumbnails();
+    void rejectsDamagedRecords_data();
+    void rejectsDamagedRecords();
+    void startsOverWithADamagedIndex();
+    void compactionDropsThumbnailsOfGoneFiles();
+    void otherInstancesFollowACompaction();
+
+   private:
+    QString storePath() const { return dir_->filePath(QStringLiteral("store")); }
+
+    std::unique_ptr<QTemporaryDir> dir_;
+};
+
+void ThumbnailStoreTest::init() {
+    dir_ = std::make_unique<QTemporaryDir>();
+    QVERIFY(dir_->isValid());
+}
+
+void ThumbnailStoreTest::cleanup() {
+    dir_.reset();
+}
+
+void ThumbnailStoreTest::roundTripsImages_data() {
+    QTest::addColumn<QImage>("image");
+
+    QTest::newRow("opaque") << gradient(128, 96, false);
+    QTest::newRow("alpha") << gradient(97, 128, true);
+    QImage solid{256, 3, QImage::Format_RGB32};  // runs longer than a chunk holds
+    solid.fill(qRgb(10, 200, 30));
+    QTest::newRow("solid") << solid;
+    QTest::newRow("one pixel") << gradient(1, 1, true);
+    QTest::newRow("largest") << gradient(1024, 1024, false);
+}
+
+void ThumbnailStoreTest::roundTripsImages() {
+    QFETCH(QImage, image);
+
+    Fm::ThumbnailStore store{storePath()};
+    const auto digest = digestOf("file:///round-trip");
+    store.insert(digest, 42, "file:///round-trip", image);
+
+    QImage found;
+    QVERIFY(store.find(digest, 42, found));
+    QVERIFY(samePixels(found, image));
+    QCOMPARE(found.hasAlphaChannel(), image.hasAlphaChannel());
+}
+
+void ThumbnailStoreTest::replacesOlderThumbnails() {
+    Fm::ThumbnailStore store{storePath()};
+    const auto digest = digestOf("file:///replaced");
+    const QImage older = gradient(16, 16, false);
+    const QImage newer = gradient(20, 10, true);
+    store.insert(digest, 1, "file:///replaced", older);
+    store.insert(digest, 2, "file:///replaced", newer);
+
+    QImage found;
+    QVERIFY(!store.find(digest, 1, found));
+    QVERIFY(store.find(digest, 2, found));
+    QVERIFY(samePixels(found, newer));
+    QVERIFY(!store.find(digestOf("file:///other"), 2, found));
+
+    // too large to be stored
+    const auto large = digestOf("file:///large");
+    store.insert(large, 1, "file:///large", QImage{1025, 8, QImage::Format_RGB32});
+    QVERIFY(!store.find(large, 1, found));
+}
+
+void ThumbnailStoreTest::rejectsDamagedRecords_data() {
+    QTest::addColumn<qint64>("offset");
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("truncate");
+
+    QTest::newRow("magic") << qint64(0) << QByteArray("XXXX") << -1;
+    QTest::newRow("digest") << qint64(8) << QByteArray("\xff\xff") << -1;
+    // a size that is never stored must not be allocated
+    QTest::newRow("width") << kFirstRecordWidth << QByteArray("\xff\xff") << -1;
+    QTest::newRow("height") << kFirstRecordWidth + 2 << QByteArray("\xff\xff") << -1;
+    QTest::newRow("truncated") << qint64(0) << QByteArray() << 100;
+}
+
+void ThumbnailStoreTest::rejectsDamagedRecords() {
+    QFETCH(qint64, offset);
+    QFETCH(QByteArray, data);
+    QFETCH(int, truncate);
+
+    const auto digest = digestOf("file:///damaged");
+    {
+        Fm::ThumbnailStore store{storePath()};
+        store.insert(digest, 7, "file:///damaged", gradient(64, 64, false));
+    }
+    const QString dataPath = storePath() + QStringLiteral("/data");
+    QVERIFY(patchFile(dataPath, offset, data));
+    if (truncate >= 0) {
+        QVERIFY(QFile::resize(dataPath, truncate));
+    }
+
+    Fm::ThumbnailStore store{storePath()};
+    QImage found;
+    QVERIFY(!store.find(digest, 7, found));
+    QVERIFY(found.isNull());
+    // and can be stored again
+    store.insert(digest, 7, "file:///damaged", gradient(8, 8, false));
+    QVERIFY(store.find(digest, 7, found));
+}
+
+void ThumbnailStoreTest::startsOverWithADamagedIndex() {
+    const auto digest = digestOf("file:///index");
+    {
+        Fm::ThumbnailStore store{storePath()};
+        store.insert(digest, 3, "file:///index", gradient(8, 8, false));
+    }
+    QVERIFY(patchFile(storePath() + QStringLiteral("/index"), 0, "garbage!"));
+
+    Fm::ThumbnailStore store{storePath()};
+    QImage found;
+    QVERIFY(!store.find(digest, 3, found));
+    store.insert(digest, 3, "file:///index", gradient(8, 8, false));
+    QVERIFY(store.find(digest, 3, found));
+}
+
+void ThumbnailStoreTest::compactionDropsThumbnailsOfGoneFiles() {
+    const QString kept = dir_->filePath(QStringLiteral("kept.png"));
+    const QString gone = dir_->filePath(QStringLiteral("gone.png"));
+    for (const QString& path : {kept, gone}) {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+    const QByteArray keptUri = QUrl::fromLocalFile(kept).toEncoded();
+    const QByteArray goneUri = QUrl::fromLocalFile(gone).toEncoded();
+
+    Fm::ThumbnailStore store{storePath()};
+    store.insert(digestOf(keptUri), mtimeOf(kept), keptUri.constData(), gradient(32, 32, false));
+    store.insert(digestOf(goneUri), mtimeOf(gone), goneUri.constData(), gradient(32, 32, true));
+    // not a local file, so it is kept
+    store.insert(digestOf("sftp://host/remote"), 5, "sftp://host/remote", gradient(16, 16, false));
+    const quint64 goneMtime = mtimeOf(gone);
+    QVERIFY(QFile::remove(gone));
+
+    store.compact();
+    QImage found;
+    QVERIFY(store.find(digestOf(keptUri), mtimeOf(kept), found));
+    QVERIFY(samePixels(found, gradient(32, 32, false)));
+    QVERIFY(!store.find(digestOf(goneUri), goneMtime, found));
+    QVERIFY(store.find(digestOf("sftp://host/remote"), 5, found));
+}
+
+void ThumbnailStoreTest::otherInstancesFollowACompaction() {
+    // as if in two processes
+    Fm::ThumbnailStore first{storePath()};
+    Fm::ThumbnailStore second{storePath()};
+    const auto digest = digestOf("sftp://host/shared");
+    first.insert(digest, 9, "sftp://host/shared", gradient(24, 24, false));
+    QImage found;
+    QVERIFY(second.find(digest, 9, found));
+
+    first.compact();
+    QVERIFY(second.find(digest, 9, found));
+    second.insert(digestOf("sftp://host/after"), 1, "sftp://host/after", gradient(4, 4, false));
+    QVERIFY(first.find(digestOf("sftp://host/after"), 1, found));
+}
+
+QTEST_MAIN(ThumbnailStoreTest)
+#include "test_thumbnailstore.moc"
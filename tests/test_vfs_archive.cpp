@@ -0,0 +1,253 @@
+/*
+ * Tests for the archive:// VFS
+ * tests/test_vfs_archive.cpp
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QSet>
+
+#include <archive.h>
+#include <archive_entry.h>
+#include <gio/gio.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+extern "C" {
+GFile* _fm_vfs_archive_new_for_uri(const char* uri);  // defined in vfs-archive.c
+}
+
+namespace {
+
+using Entries = std::vector<std::pair<QByteArray, QByteArray>>;  // path and data
+
+bool writeArchive(const QString& path, const Entries& entries, const char* format, const char* filter) {
+    struct archive* ar = archive_write_new();
+    if (!ar) {
+        return false;
+    }
+    bool ok = (filter ? archive_write_add_filter_by_name(ar, filter) : archive_write_add_filter_none(ar)) ==
+                  ARCHIVE_OK &&
+              archive_write_set_format_by_name(ar, format) == ARCHIVE_OK &&
+              archive_write_open_filename(ar, path.toUtf8().constData()) == ARCHIVE_OK;
+    for (auto it = entries.begin(); ok && it != entries.end(); ++it) {
+        archive_entry* entry = archive_entry_new();
+        archive_entry_set_pathname(entry, it->first.constData());
+        archive_entry_set_size(entry, it->second.size());
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+        ok = archive_write_header(ar, entry) == ARCHIVE_OK &&
+             archive_write_data(ar, it->second.constData(), static_cast<size_t>(it->second.size())) >= 0;
+        archive_entry_free(entry);
+    }
+    ok = archive_write_close(ar) == ARCHIVE_OK && ok;
+    archive_write_free(ar);
+    return ok;
+}
+
+GFile* archiveFile(const QString& archivePath, const char* inner) {
+    gchar* escaped = g_uri_escape_string(archivePath.toUtf8().constData(), nullptr, FALSE);
+    QByteArray uri = QByteArray("archive:///") + escaped + '/' + inner;
+    g_free(escaped);
+    return _fm_vfs_archive_new_for_uri(uri.constData());
+}
+
+QSet<QString> listNames(const QString& archivePath, const char* inner, GError** error) {
+    QSet<QString> names;
+    GFile* dir = archiveFile(archivePath, inner);
+    GFileEnumerator* enumerator =
+        g_file_enumerate_children(dir, G_FILE_ATTRIBUTE_STANDARD_NAME, G_FILE_QUERY_INFO_NONE, nullptr, error);
+    if (enumerator) {
+        while (GFileInfo* info = g_file_enumerator_next_file(enumerator, nullptr, error)) {
+            names.insert(QString::fromUtf8(g_file_info_get_name(info)));
+            g_object_unref(info);
+        }
+        g_object_unref(enumerator);
+    }
+    g_object_unref(dir);
+    return names;
+}
+
+QByteArray readAll(GFileInputStream* stream) {
+    QByteArray data;
+    char buf[4096];
+    gssize n;
+    while ((n = g_input_stream_read(G_INPUT_STREAM(stream), buf, sizeof(buf), nullptr, nullptr)) > 0) {
+        data.append(buf, static_cast<int>(n));
+    }
+    return n < 0 ? QByteArray("<error>") : data;
+}
+
+QByteArray readMember(const QString& archivePath, const char* inner, GError** error) {
+    GFile* file = archiveFile(archivePath, inner);
+    GFileInputStream* stream = g_file_read(file, nullptr, error);
+    g_object_unref(file);
+    if (!stream) {
+        return QByteArray();
+    }
+    QByteArray data = readAll(stream);
+    g_input_stream_close(G_INPUT_STREAM(stream), nullptr, nullptr);
+    g_object_unref(stream);
+    return data;
+}
+
+Entries numberedEntries(int count) {
+    Entries entries;
+    for (int i = 0; i < count; ++i) {
+        // sizes across the 512 byte tar blocks, so that padding is skipped too
+        entries.emplace_back(QByteArray("dir/file-") + QByteArray::number(i),
+                             QByteArray::number(i).repeated(1 + i * 97 % 1500));
+    }
+    return entries;
+}
+
+}  // namespace
+
+class VfsArchiveTest : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void initTestCase();
+    void listsEntriesAndImpliedFolders();
+    void readsMembersInAnyOrder_data();
+    void readsMembersInAnyOrder();
+    void readsInterleavedStreams();
+    void reportsMissingMembersAndFolders();
+    void cachesEmptyArchives();
+
+   private:
+    QTemporaryDir cacheDir_;
+    QTemporaryDir dir_;
+};
+
+void VfsArchiveTest::initTestCase() {
+    QVERIFY(cacheDir_.isValid());
+    QVERIFY(dir_.isValid());
+    // the index files go here instead of the cache of the user
+    qputenv("XDG_CACHE_HOME", cacheDir_.path().toUtf8());
+}
+
+void VfsArchiveTest::listsEntriesAndImpliedFolders() {
+    const QString path = dir_.filePath(QStringLiteral("list.tar"));
+    QVERIFY(writeArchive(path, {{"a.txt", "a"}, {"dir/sub/b.txt", "b"}, {"./dir/c.txt", "c"}}, "gnutar", nullptr));
+
+    GError* error = nullptr;
+    QCOMPARE(listNames(path, "", &error), (QSet<QString>{QStringLiteral("a.txt"), QStringLiteral("dir")}));
+    QVERIFY(error == nullptr);
+    QCOMPARE(listNames(path, "dir", &error), (QSet<QString>{QStringLiteral("sub"), QStringLiteral("c.txt")}));
+    QCOMPARE(listNames(path, "dir/sub", &error), QSet<QString>{QStringLiteral("b.txt")});
+    QVERIFY(error == nullptr);
+
+    GFile* sub = archiveFile(path, "dir/sub");
+    GFileInfo* info = g_file_query_info(sub, G_FILE_ATTRIBUTE_STANDARD_TYPE, G_FILE_QUERY_INFO_NONE, nullptr, &error);
+    QVERIFY(info != nullptr);
+    QCOMPARE(g_file_info_get_file_type(info), G_FILE_TYPE_DIRECTORY);
+    g_object_unref(info);
+    g_object_unref(sub);
+}
+
+void VfsArchiveTest::readsMembersInAnyOrder_data() {
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<QString>("filter");
+
+    // seeks to the entries
+    QTest::newRow("tar") << QStringLiteral("order.tar") << QStringLiteral("pax") << QString();
+    // continues parked readers
+    QTest::newRow("tar.gz") << QStringLiteral("order.tar.gz") << QStringLiteral("pax") << QStringLiteral("gzip");
+    QTest::newRow("zip") << QStringLiteral("order.zip") << QStringLiteral("zip") << QString();
+}
+
+void VfsArchiveTest::readsMembersInAnyOrder() {
+    QFETCH(QString, name);
+    QFETCH(QString, format);
+    QFETCH(QString, filter);
+
+    const QString path = dir_.filePath(name);
+    const Entries entries = numberedEntries(40);
+    const QByteArray filterName = filter.toUtf8();
+    QVERIFY(writeArchive(path, entries, format.toUtf8().constData(), filter.isEmpty() ? nullptr : filterName.constData()));
+
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        order.push_back(i);  // in archive order
+    }
+    for (std::size_t i = entries.size(); i-- > 0;) {
+        order.push_back(i);  // backwards
+    }
+    for (std::size_t i = 0; i < entries.size(); i += 3) {
+        order.push_back(i);  // skipping some
+    }
+    order.push_back(7);
+    order.push_back(7);  // the same one twice
+
+    for (std::size_t i : order) {
+        GError* error = nullptr;
+        const QByteArray data = readMember(path, entries[i].first.constData(), &error);
+        QVERIFY2(error == nullptr, error ? error->message : "");
+        QCOMPARE(data, entries[i].second);
+    }
+}
+
+void VfsArchiveTest::readsInterleavedStreams() {
+    const QString path = dir_.filePath(QStringLiteral("interleaved.tar.gz"));
+    const Entries entries = numberedEntries(6);
+    QVERIFY(writeArchive(path, entries, "gnutar", "gzip"));
+
+    GError* error = nullptr;
+    GFile* first = archiveFile(path, entries[1].first.constData());
+    GFile* second = archiveFile(path, entries[4].first.constData());
+    GFileInputStream* firstStream = g_file_read(first, nullptr, &error);
+    GFileInputStream* secondStream = g_file_read(second, nullptr, &error);
+    QVERIFY(firstStream != nullptr && secondStream != nullptr);
+
+    // a parked reader must not be handed out while its stream is still open
+    char head[8];
+    QCOMPARE(g_input_stream_read(G_INPUT_STREAM(firstStream), head, 1, nullptr, nullptr), gssize(1));
+    QCOMPARE(readMember(path, entries[2].first.constData(), &error), entries[2].second);
+    QCOMPARE(readAll(secondStream), entries[4].second);
+    QCOMPARE(QByteArray(head, 1) + readAll(firstStream), entries[1].second);
+
+    g_object_unref(firstStream);
+    g_object_unref(secondStream);
+    g_object_unref(first);
+    g_object_unref(second);
+    QVERIFY(error == nullptr);
+}
+
+void VfsArchiveTest::reportsMissingMembersAndFolders() {
+    const QString path = dir_.filePath(QStringLiteral("missing.tar"));
+    QVERIFY(writeArchive(path, {{"dir/file", "data"}}, "gnutar", nullptr));
+
+    GError* error = nullptr;
+    readMember(path, "dir/none", &error);
+    QVERIFY(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND));
+    g_clear_error(&error);
+
+    readMember(path, "dir", &error);
+    QVERIFY(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY));
+    g_clear_error(&error);
+
+    listNames(path, "dir/file", &error);
+    QVERIFY(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_DIRECTORY));
+    g_clear_error(&error);
+}
+
+void VfsArchiveTest::cachesEmptyArchives() {
+    const QString path = dir_.filePath(QStringLiteral("empty.tar"));
+    QVERIFY(writeArchive(path, {}, "gnutar", nullptr));
+
+    QDir indexDir(cacheDir_.filePath(QStringLiteral("libfm-qt/archives")));
+    const QStringList before = indexDir.entryList(QDir::Files);
+
+    GError* error = nullptr;
+    QVERIFY(listNames(path, "", &error).isEmpty());
+    QVERIFY(error == nullptr);
+    QCOMPARE(indexDir.entryList(QDir::Files).size(), before.size() + 1);
+}
+
+QTEST_MAIN(VfsArchiveTest)
+#include "test_vfs_archive.moc"